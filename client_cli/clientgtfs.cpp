@@ -49,38 +49,45 @@ void ClientGtfs::once(bool prettyPrint)
 {
     QTextStream screen(stdout);
     QTextStream stdinquery(stdin);
-    stdinquery.skipWhiteSpace();
-    QString query = stdinquery.readLine(1024);
-    QString response;
 
-    // Assume here that the script / client knows what they're doing, so send the request to the server
-    QByteArray serverRequest = query.toUtf8();
-    this->commSocket.write(serverRequest);
+    // Assume here that the script / client knows what they're doing, so send the request(s) to the server: every line
+    // of the input is a request, they are all sent at once (the server responds to them in the same order)
+    QByteArray serverRequests;
+    qint32     nbRequests = 0;
+    while (!stdinquery.atEnd()) {
+        QString query = stdinquery.readLine().trimmed();
+        if (!query.isEmpty()) {
+            serverRequests += query.toUtf8() + '\n';
+            ++nbRequests;
+        }
+    }
+    this->commSocket.write(serverRequests);
 
     // Socket communication is a pain, so there is "an understanding" with the server that a newline character
-    // indicates the end of a transmission, read text off the socket until a newline is found.
-    while (1) {
+    // indicates the end of a transmission, read text off the socket until a newline is found for every request.
+    QByteArray responses;
+    while (responses.count('\n') < nbRequests) {
         // Wait for response (15 seconds)
         if (! this->commSocket.waitForReadyRead(15000)) {
             this->disp.showError(this->commSocket.errorString());
             break;
         }
 
-        QString tempRespStr = QString(this->commSocket.readAll());
-        response += tempRespStr;
-        //qDebug() << "==> " << responseStr;
-        if (response.indexOf('\n') != -1) {
-            break;
-        }
+        responses += this->commSocket.readAll();
+        //qDebug() << "==> " << responses;
     }
 
-    // Dump the JSON response to standard output
-    if (prettyPrint) {
-        QJsonDocument respDoc = QJsonDocument::fromJson(response.toUtf8());
-        QString formattedDoc  = respDoc.toJson(QJsonDocument::Indented);
-        screen << formattedDoc;
-    } else {
-        screen << response;
+    // Dump the JSON responses to standard output
+    const QList<QByteArray> responseLines = responses.split('\n');
+    for (qint32 respIdx = 0; respIdx < nbRequests && respIdx < responseLines.size(); ++respIdx) {
+        QString response = QString(responseLines.at(respIdx)) + '\n';
+        if (prettyPrint) {
+            QJsonDocument respDoc = QJsonDocument::fromJson(response.toUtf8());
+            QString formattedDoc  = respDoc.toJson(QJsonDocument::Indented);
+            screen << formattedDoc;
+        } else {
+            screen << response;
+        }
     }
 }
 
@@ -120,7 +127,7 @@ void ClientGtfs::repl()
         //
         // Send query to remote system
         //
-        QByteArray serverRequest = qquery.toUtf8();
+        QByteArray serverRequest = qquery.toUtf8() + '\n';
         this->commSocket.write(serverRequest);
 
         //
@@ -1075,9 +1082,10 @@ void ClientGtfs::repl()
 
             screen.setFieldAlignment(QTextStream::AlignLeft);
 
-            // Mutual Exclusion
-            screen << "[ Mutual Exclusion ]" << Qt::endl
-                   << "Active Side  . . . " << respObj["active_side"].toString() << Qt::endl
+            // Published real-time data
+            screen << "[ Published Data ]" << Qt::endl
+                   << "Generation . . . . " << respObj["feed_generation"].toInt()
+                   << (respObj["fetching_idled"].toBool() ? " (IDLE)" : "") << Qt::endl
                    << "Data Age . . . . . " << respObj["active_age_sec"].toInt() << " s" << Qt::endl
                    << "Feed Time  . . . . " << respObj["active_feed_time"].toString() << Qt::endl
                    << "Download Time  . . " << respObj["active_download_ms"].toInt() << " ms" << Qt::endl
@@ -40,7 +40,8 @@ public:
     bool startConnection(QString hostname, quint16 port, int userTimeout);
 
     // Prompts for user input one (also therefore will take injection) for scripting / front-end interaction.
-    // Forwards the server the user query and returns the response in JSON to STDOUT
+    // Forwards the server the user query and returns the response in JSON to STDOUT (every line of the input is a query
+    // of its own, all of them are sent at once and the responses are returned in the same order)
     void once(bool prettyPrint);
 
     // Awaits user input and sends each query to the server - interactive mode for playing browsing in command line
@@ -142,8 +142,8 @@ void EndToEndTrips::fillResponseData(QJsonObject &resp)
             startStopIds.push_back(_tripCnx[1]);
         }
         GTFS::TripStopReconciler desStopTripLoader(startStopIds, _rtData, _systemDate, getAgencyTime(),
-                                                   _futureMinutes, _status, _service, _stops, _routes,
-                                                   _tripDB, _stopTimes, _realTimeProc);
+                                                   _futureMinutes, 0, _status, _service, _stops, _routes,
+                                                   _tripDB, _stopTimes, _realTimeProc.get());
         desStopTripLoader.getTripsByRoute(tripInProgDest);
         QString routeId;
         qsizetype tripIdx = -1;
@@ -286,8 +286,9 @@ void EndToEndTrips::fillRecoOD(quint8                             legNum,
     } else {
         startStopIds.push_back(oriStopId);
     }
-    GTFS::TripStopReconciler oriStopTripLoader(startStopIds, _rtData, _systemDate, getAgencyTime(), _futureMinutes,
-                                               _status, _service, _stops, _routes, _tripDB, _stopTimes, _realTimeProc);
+    GTFS::TripStopReconciler oriStopTripLoader(startStopIds, _rtData, _systemDate, getAgencyTime(), _futureMinutes, 0,
+                                               _status, _service, _stops, _routes, _tripDB, _stopTimes,
+                                               _realTimeProc.get());
     oriStopTripLoader.getTripsByRoute(tripsForOriStopByRouteID);
 
     QHash<QString, GTFS::StopRecoRouteRec> tripsForDesStopByRouteID;
@@ -297,8 +298,9 @@ void EndToEndTrips::fillRecoOD(quint8                             legNum,
     } else {
         destStopIds.push_back(desStopId);
     }
-    GTFS::TripStopReconciler desStopTripLoader(destStopIds, _rtData, _systemDate, getAgencyTime(), _futureMinutes,
-                                               _status, _service, _stops, _routes, _tripDB, _stopTimes, _realTimeProc);
+    GTFS::TripStopReconciler desStopTripLoader(destStopIds, _rtData, _systemDate, getAgencyTime(), _futureMinutes, 0,
+                                               _status, _service, _stops, _routes, _tripDB, _stopTimes,
+                                               _realTimeProc.get());
     desStopTripLoader.getTripsByRoute(tripsForDesStopByRouteID);
 
     // Only work with trips the hit both stops appropriately
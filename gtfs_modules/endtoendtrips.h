@@ -103,7 +103,7 @@ private:
     const TripData       *_tripDB;
     const StopTimeData   *_stopTimes;
 
-    const GTFS::RealTimeTripUpdate *_realTimeProc;
+    GTFS::RealTimeFeedPin _realTimeProc;
 };
 
 }  // namespace GTFS
@@ -2,6 +2,9 @@
 #CONFIG += qxt
 #QXT += core
 
+# Batched requests evaluate their stops in parallel
+QT += concurrent
+
 INCLUDEPATH += $$PWD
 
 DEPENDPATH += $$PWD
@@ -13,6 +16,8 @@ HEADERS += \
     $$PWD/realtimestatus.h \
     $$PWD/realtimetripinformation.h \
     $$PWD/routerealtimedata.h \
+    $$PWD/serverstatus.h \
+    $$PWD/servicealerts.h \
     $$PWD/servicebetweenstops.h \
     $$PWD/staticstatus.h \
     $$PWD/stationdetailsdisplay.h \
@@ -21,7 +26,13 @@ HEADERS += \
     $$PWD/tripscheduledisplay.h \
     $$PWD/tripsservingroute.h \
     $$PWD/tripsservingstop.h \
-    $$PWD/upcomingstopservice.h
+    $$PWD/upcomingstopbatch.h \
+    $$PWD/upcomingstopcache.h \
+    $$PWD/upcomingstopprecompute.h \
+    $$PWD/upcomingstopservice.h \
+    $$PWD/upcomingstopsubscriber.h \
+    $$PWD/upcomingstopsubscriptions.h \
+    $$PWD/vehiclepositions.h
 
 SOURCES += \
     $$PWD/availableroutes.cpp \
@@ -30,6 +41,8 @@ SOURCES += \
     $$PWD/realtimestatus.cpp \
     $$PWD/realtimetripinformation.cpp \
     $$PWD/routerealtimedata.cpp \
+    $$PWD/serverstatus.cpp \
+    $$PWD/servicealerts.cpp \
     $$PWD/servicebetweenstops.cpp \
     $$PWD/staticstatus.cpp \
     $$PWD/stationdetailsdisplay.cpp \
@@ -38,4 +51,10 @@ SOURCES += \
     $$PWD/tripscheduledisplay.cpp \
     $$PWD/tripsservingroute.cpp \
     $$PWD/tripsservingstop.cpp \
-    $$PWD/upcomingstopservice.cpp
+    $$PWD/upcomingstopbatch.cpp \
+    $$PWD/upcomingstopcache.cpp \
+    $$PWD/upcomingstopprecompute.cpp \
+    $$PWD/upcomingstopservice.cpp \
+    $$PWD/upcomingstopsubscriber.cpp \
+    $$PWD/upcomingstopsubscriptions.cpp \
+    $$PWD/vehiclepositions.cpp
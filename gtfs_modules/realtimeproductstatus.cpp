@@ -21,6 +21,8 @@
 #include "realtimeproductstatus.h"
 
 #include "datagateway.h"
+#include "upcomingstopcache.h"
+#include "upcomingstopprecompute.h"
 
 namespace GTFS {
 
@@ -51,20 +53,24 @@ void RealtimeProductStatus::fillResponseData(QJsonObject &resp)
                                                      .toString("dd-MMM-yyyy hh:mm:ss t");
     }
 
-    QString activeSideStr;
-    GTFS::RealTimeDataRepo    active = _rg.activeBuffer();
-    if (active == GTFS::SIDE_A) {
-        activeSideStr = "A";
-    } else if (active == GTFS::SIDE_B) {
-        activeSideStr = "B";
-    } else if (active == GTFS::IDLED) {
-        activeSideStr = "IDLE";
-    } else {
-        activeSideStr = "NONE";
-    }
-    resp["rt_buff"] = activeSideStr;
-
-    GTFS::RealTimeTripUpdate *rTrips = _rg.getActiveFeed();
+    std::shared_ptr<const GTFS::RealTimeSnapshot> snapshot = _rg.activeSnapshot();
+    resp["rt_gen"]  = (double) snapshot->generation;
+    resp["rt_idle"] = snapshot->idled;
+
+    // Background precomputation of the most requested boards, and the share of the cache lookups it served
+    qint64  precomputeMSec;
+    qint32  precomputeBoards;
+    quint64 cacheLookups, cacheHits;
+    qint64  cacheEntries, cacheBytes;
+    GTFS::UpcomingStopPrecompute::inst().getStatistics(precomputeMSec, precomputeBoards);
+    GTFS::UpcomingStopCache::inst().getStatistics(cacheLookups, cacheHits, cacheEntries, cacheBytes);
+    quint64 precomputedHits = GTFS::UpcomingStopCache::inst().getPrecomputedHits();
+    resp["pcmp_ms"] = precomputeMSec;
+    resp["pcmpbds"] = precomputeBoards;
+    resp["pcmphit"] = (cacheLookups == 0) ? 0.0
+                                          : static_cast<double>(precomputedHits) / static_cast<double>(cacheLookups);
+
+    GTFS::RealTimeFeedPin rTrips = snapshot->feed;
     if (rTrips) {
         QDateTime activeFeedTime = rTrips->getFeedTime();
         if (activeFeedTime.isNull()) {
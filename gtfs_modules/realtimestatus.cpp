@@ -19,6 +19,9 @@
  */
 
 #include "realtimestatus.h"
+#include "upcomingstopcache.h"
+
+#include <QJsonArray>
 
 namespace GTFS {
 
@@ -26,22 +29,19 @@ RealtimeStatus::RealtimeStatus() : StaticStatus(), _rg(GTFS::RealTimeGateway::in
 
 void RealtimeStatus::fillResponseData(QJsonObject &resp)
 {
+    // Fetch statistics of the trip updates (all zero when real-time data is disabled)
+    RealTimeSourceStatus tripStatus;
+    tripStatus.unchangedFetches  = 0;
+    tripStatus.failedFetches     = 0;
+    tripStatus.publishCadenceSec = 0;
+    _rg.tripUpdatesStatus(tripStatus);
+
     resp["seconds_to_next_fetch"] = _rg.secondsToFetch();
+    resp["publish_cadence_sec"]   = tripStatus.publishCadenceSec;
 
-    QString activeSideStr, inactiveSideStr;
-    GTFS::RealTimeDataRepo    active = _rg.activeBuffer();
-    GTFS::RealTimeTripUpdate *rTrips = _rg.getActiveFeed();
-    if (active == GTFS::SIDE_A) {
-        activeSideStr   = "A";
-        inactiveSideStr = "B";
-    } else if (active == GTFS::SIDE_B) {
-        activeSideStr   = "B";
-        inactiveSideStr = "A";
-    } else if (active == GTFS::IDLED) {
-        activeSideStr   = "IDLE";
-    } else {
-        activeSideStr = inactiveSideStr = "N/A";
-    }
+    // A single snapshot so the generation, idling and feed reported all match
+    std::shared_ptr<const GTFS::RealTimeSnapshot> snapshot = _rg.activeSnapshot();
+    GTFS::RealTimeFeedPin rTrips = snapshot->feed;
 
     if (getStatus()->format12h()) {
         resp["last_realtime_query"] = _rg.mostRecentTransaction().toTimeZone(getAgencyTime().timeZone())
@@ -51,15 +51,106 @@ void RealtimeStatus::fillResponseData(QJsonObject &resp)
                                                                  .toString("dd-MMM-yyyy hh:mm:ss t");
     }
 
-    if (rTrips == nullptr) {
-        resp["active_side"] = activeSideStr;
-    } else {
+    // Each publication of the real-time data (trip updates, vehicles, alerts or idling) makes a new generation
+    resp["feed_generation"] = (double) snapshot->generation;
+    resp["fetching_idled"]  = snapshot->idled;
+
+    // Fetches which found the same data as the active feed keep it (it is not integrated again)
+    resp["unchanged_fetches"] = (double) tripStatus.unchangedFetches;
+    resp["failed_fetches"]    = (qint64) tripStatus.failedFetches;
+    resp["last_fetch_time"]   = formatStatusTime(tripStatus.lastFetchUTC);
+
+    // When several trip update feeds are merged, each one is reported on its own (the fields above are of the first)
+    if (_rg.nbTripUpdateFeeds() > 1) {
+        QJsonArray tripFeeds;
+        for (qint32 feedIdx = 0; feedIdx < _rg.nbTripUpdateFeeds(); ++feedIdx) {
+            RealTimeSourceStatus feedStatus;
+            _rg.tripUpdatesStatus(feedStatus, feedIdx);
+
+            QJsonObject tripFeed;
+            tripFeed["name"]                  = feedStatus.name;
+            tripFeed["failed_fetches"]        = (qint64) feedStatus.failedFetches;
+            tripFeed["unchanged_fetches"]     = (double) feedStatus.unchangedFetches;
+            tripFeed["last_fetch_time"]       = formatStatusTime(feedStatus.lastFetchUTC);
+            tripFeed["publish_cadence_sec"]   = feedStatus.publishCadenceSec;
+            tripFeed["seconds_to_next_fetch"] = feedStatus.nextFetchUTC.isNull()
+                                                    ? 0
+                                                    : QDateTime::currentDateTimeUtc().secsTo(feedStatus.nextFetchUTC);
+            if (feedStatus.feedTimePOSIX == 0) {
+                tripFeed["feed_time"] = "-";
+                tripFeed["age_sec"]   = "-";
+            } else {
+                QDateTime feedTime = QDateTime::fromSecsSinceEpoch(feedStatus.feedTimePOSIX);
+                tripFeed["feed_time"] = formatStatusTime(feedTime);
+                tripFeed["age_sec"]   = feedTime.secsTo(getAgencyTime());
+            }
+            tripFeeds.push_back(tripFeed);
+        }
+        resp["trip_feeds"] = tripFeeds;
+    }
+
+    // Vehicle positions are only reported when their feed is configured
+    RealTimeSourceStatus vehicleStatus;
+    if (_rg.vehiclePositionsStatus(vehicleStatus)) {
+        RealTimeVehiclesPin vehicles = snapshot->vehicles;
+        resp["vehicles_failed_fetches"]    = (qint64) vehicleStatus.failedFetches;
+        resp["vehicles_unchanged_fetches"] = (double) vehicleStatus.unchangedFetches;
+        resp["vehicles_last_fetch_time"]   = formatStatusTime(vehicleStatus.lastFetchUTC);
+        if (vehicles == nullptr) {
+            resp["vehicles_count"]     = 0;
+            resp["vehicles_feed_time"] = "-";
+        } else {
+            resp["vehicles_count"]          = vehicles->getNbVehicles();
+            resp["vehicles_feed_time"]      = formatStatusTime(vehicles->getFeedTime());
+            resp["vehicles_integration_ms"] = vehicles->getIntegrationTimeMSec();
+        }
+    }
+
+    // Service alerts are only reported when their feed is configured
+    RealTimeSourceStatus alertStatus;
+    if (_rg.alertsStatus(alertStatus)) {
+        RealTimeAlertsPin alerts = snapshot->alerts;
+        resp["alerts_failed_fetches"]    = (qint64) alertStatus.failedFetches;
+        resp["alerts_unchanged_fetches"] = (double) alertStatus.unchangedFetches;
+        resp["alerts_last_fetch_time"]   = formatStatusTime(alertStatus.lastFetchUTC);
+        if (alerts == nullptr) {
+            resp["alerts_count"]     = 0;
+            resp["alerts_feed_time"] = "-";
+        } else {
+            resp["alerts_count"]          = alerts->getNbAlerts();
+            resp["alerts_feed_time"]      = formatStatusTime(alerts->getFeedTime());
+            resp["alerts_integration_ms"] = alerts->getIntegrationTimeMSec();
+        }
+    }
+
+    // The NEX/NCF/NXR cache is only valid for a feed generation: how well it does depends on the real-time refreshes
+    if (UpcomingStopCache::inst().getGranularity() > 0) {
+        quint64 cacheLookups, cacheHits;
+        qint64  cacheEntries, cacheBytes;
+        UpcomingStopCache::inst().getStatistics(cacheLookups, cacheHits, cacheEntries, cacheBytes);
+        resp["nex_cache_hit_rate"] = (cacheLookups == 0) ? 0.0
+                                                         : static_cast<double>(cacheHits) / cacheLookups;
+        resp["nex_cache_entries"]  = cacheEntries;
+        resp["nex_cache_bytes"]    = cacheBytes;
+    }
+
+    // Progress of the replay, only reported when the fetches are replayed from an archive
+    RealTimeReplayStatus replayStatus;
+    if (_rg.replayStatus(replayStatus)) {
+        resp["replay_time"]     = formatStatusTime(replayStatus.replayedUTC);
+        resp["replay_fetches"]  = (double) replayStatus.records;
+        resp["replay_finished"] = replayStatus.finished;
+    }
+
+    if (rTrips != nullptr) {
         // Active and inactive data information
-        QDateTime activeFeedTime      = rTrips->getFeedTime();
-        resp["active_rt_version"]     = rTrips->getFeedGTFSVersion();
-        resp["active_side"]           = activeSideStr;
-        resp["active_download_ms"]    = rTrips->getDownloadTimeMSec();
-        resp["active_integration_ms"] = rTrips->getIntegrationTimeMSec();
+        QDateTime activeFeedTime           = rTrips->getFeedTime();
+        resp["active_rt_version"]          = rTrips->getFeedGTFSVersion();
+        resp["active_download_ms"]         = rTrips->getDownloadTimeMSec();
+        resp["active_integration_ms"]      = rTrips->getIntegrationTimeMSec();
+        resp["active_integration_reused"]  = rTrips->getReusedEntities();
+        resp["active_integration_threads"] = rTrips->getIntegrationThreads();
+        resp["active_parse_ms"]            = rTrips->getParseTimeMSec();
 
         if (activeFeedTime.isNull()) {
             resp["active_feed_time"] = "-";
@@ -79,4 +170,15 @@ void RealtimeStatus::fillResponseData(QJsonObject &resp)
     fillProtocolFields("RDS", 0, resp);
 }
 
+QString RealtimeStatus::formatStatusTime(const QDateTime &timeUTC)
+{
+    if (timeUTC.isNull()) {
+        return "-";
+    } else if (getStatus()->format12h()) {
+        return timeUTC.toTimeZone(getAgencyTime().timeZone()).toString("dd-MMM-yyyy h:mm:ss a t");
+    } else {
+        return timeUTC.toTimeZone(getAgencyTime().timeZone()).toString("dd-MMM-yyyy hh:mm:ss t");
+    }
+}
+
 }  // Namespace GTFS
@@ -41,6 +41,9 @@ public:
     void fillResponseData(QJsonObject &resp);
 
 private:
+    // Format a fetch or feed time in the agency's time zone ("-" if there is none)
+    QString formatStatusTime(const QDateTime &timeUTC);
+
     GTFS::RealTimeGateway &_rg;
 };
 
@@ -55,7 +55,7 @@ public:
 
 private:
     // Realtime Gateway
-    GTFS::RealTimeTripUpdate *_rTrips;
+    GTFS::RealTimeFeedPin _rTrips;
     GTFS::Status const *_status;
 };
 
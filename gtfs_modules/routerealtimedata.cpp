@@ -31,9 +31,11 @@ RouteRealtimeData::RouteRealtimeData(QList<QString> routeIDs)
       _routeIDs(routeIDs),
       _rtData(false)
 {
-    // Realtime Data Determination
+    // Realtime Data Determination (the feed and the alerts from the same snapshot)
     RealTimeGateway::inst().realTimeTransactionHandled();
-    _realTimeProc = GTFS::RealTimeGateway::inst().getActiveFeed();
+    std::shared_ptr<const GTFS::RealTimeSnapshot> snapshot = GTFS::RealTimeGateway::inst().activeSnapshot();
+    _realTimeProc = snapshot->feed;
+    _alerts       = snapshot->alerts;
     if (_realTimeProc != nullptr) {
         _rtData = true;
     }
@@ -80,6 +82,7 @@ void RouteRealtimeData::fillResponseData(QJsonObject &resp)
         routeEntry["route_long_name"] = (*_routes)[routeID].route_long_name;
         routeEntry["color"] = (*_routes)[routeID].route_color;
         routeEntry["text_color"] = (*_routes)[routeID].route_text_color;
+        fillAlertIDs(routeID, "", "", routeEntry);
 
         // Sort by trip ID (lexicographically) to make output more consistent between each update/call
         QVector<QString> tripIDsForRouteID;
@@ -200,6 +203,7 @@ void RouteRealtimeData::fillResponseData(QJsonObject &resp)
                 tripInfo["depart"] = rtstu.depTime.toTimeZone(getAgencyTime().timeZone()).toString(timeFormat);
                 break;
             }
+            fillAlertIDs(routeID, tripInfo["next_stop_id"].toString(), tripID, tripInfo);
             tripsForRoute.push_back(tripInfo);
         }
         routeEntry["trips"] = tripsForRoute;
@@ -213,6 +217,23 @@ void RouteRealtimeData::fillResponseData(QJsonObject &resp)
     fillProtocolFields("TRR", 0, resp);
 }
 
+void RouteRealtimeData::fillAlertIDs(const QString &routeID, const QString &stopID, const QString &tripID,
+                                     QJsonObject &item)
+{
+    if (_alerts == nullptr) {
+        return;
+    }
+    QVector<QString> alertIDs;
+    _alerts->alertsFor(routeID, (stopID == "-") ? QString() : stopID, tripID, getAgencyTime(), alertIDs);
+    if (!alertIDs.isEmpty()) {
+        QJsonArray alertArray;
+        for (const QString &alertID : alertIDs) {
+            alertArray.push_back(alertID);
+        }
+        item["alert_ids"] = alertArray;
+    }
+}
+
 bool RouteRealtimeData::allRoutesExistInFeed()
 {
     for (const QString &routeID : _routeIDs) {
@@ -63,6 +63,9 @@ private:
     // Utility function to determine that all the routes sent in the constructor actually exist in the feed
     bool allRoutesExistInFeed();
 
+    // Attach the IDs of the active alerts affecting a route / trip / stop to item (nothing if there are none)
+    void fillAlertIDs(const QString &routeID, const QString &stopID, const QString &tripID, QJsonObject &item);
+
     QList<QString> _routeIDs;
 
     // GTFS Datasets
@@ -73,7 +76,8 @@ private:
 
     // Real-Time Data Feed Access
     bool _rtData;
-    const RealTimeTripUpdate *_realTimeProc;
+    RealTimeFeedPin _realTimeProc;
+    RealTimeAlertsPin _alerts;
 };
 
 }  // Namespace GTFS
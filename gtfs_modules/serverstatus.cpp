@@ -0,0 +1,53 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "serverstatus.h"
+
+namespace GTFS {
+
+ServerStatus &ServerStatus::inst()
+{
+    static ServerStatus *_instance = nullptr;
+    if (_instance == nullptr) {
+        _instance = new ServerStatus();
+    }
+    return *_instance;
+}
+
+ServerStatus::ServerStatus()
+{
+}
+
+void ServerStatus::setIoThreads(const QVector<IoThreadStatus> &ioThreads)
+{
+    _lock_status.lock();
+    _ioThreads = ioThreads;
+    _lock_status.unlock();
+}
+
+QVector<IoThreadStatus> ServerStatus::getIoThreads()
+{
+    _lock_status.lock();
+    QVector<IoThreadStatus> ioThreads = _ioThreads;
+    _lock_status.unlock();
+    return ioThreads;
+}
+
+} // Namespace GTFS
@@ -0,0 +1,64 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef SERVERSTATUS_H
+#define SERVERSTATUS_H
+
+#include <QMutex>
+#include <QVector>
+
+namespace GTFS {
+
+// Connections and event loop lag of an I/O thread of the server
+typedef struct {
+    qint32 connections;  // Connections currently assigned to the thread
+    qint64 lagMSec;      // How late the latest event loop probe ran
+    qint64 maxLagMSec;   // Latest an event loop probe ran since the thread started
+} IoThreadStatus;
+
+/*
+ * GTFS::ServerStatus is a singleton holding the statistics of the server listening for the requests, for the modules
+ * to report them (SDS) without knowing about the server itself: the server pushes them as they change (periodically).
+ */
+class ServerStatus
+{
+public:
+    // Singleton Operations
+    static ServerStatus &inst();
+
+    // Replace the status of the I/O threads (none while the server is not listening)
+    void setIoThreads(const QVector<IoThreadStatus> &ioThreads);
+
+    // Status of each I/O thread as last pushed by the server
+    QVector<IoThreadStatus> getIoThreads();
+
+private:
+    // Singleton Pattern Requirements
+    ServerStatus();
+    explicit ServerStatus(const ServerStatus &);
+    ServerStatus &operator =(ServerStatus const &other);
+
+    QMutex                  _lock_status;  // Guards everything below (pushed and read from different threads)
+    QVector<IoThreadStatus> _ioThreads;    // Status of each I/O thread
+};
+
+} // Namespace GTFS
+
+#endif // SERVERSTATUS_H
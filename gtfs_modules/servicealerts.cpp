@@ -0,0 +1,100 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "servicealerts.h"
+
+#include <QJsonArray>
+
+namespace GTFS {
+
+ServiceAlerts::ServiceAlerts(QList<QString> alertIDs)
+    : StaticStatus(),
+      _alertIDs(alertIDs)
+{
+    // Notify real-time processor that real-time data is (still) being used
+    RealTimeGateway::inst().realTimeTransactionHandled();
+    _alerts = RealTimeGateway::inst().getActiveAlerts();
+}
+
+void ServiceAlerts::fillResponseData(QJsonObject &resp)
+{
+    if (_alerts == nullptr) {
+        // No alerts loaded? This transaction is pointless
+        fillProtocolFields("ALR", 1201, resp);
+        return;
+    }
+
+    QJsonArray alertArray;
+    for (const QString &alertID : _alertIDs) {
+        const rtServiceAlert *alert = _alerts->alertForID(alertID);
+        if (alert == nullptr) {
+            // The alert may have been lifted since its ID was handed out
+            fillProtocolFields("ALR", 1202, resp);
+            return;
+        }
+
+        QJsonObject alertEntry;
+        alertEntry["alert_id"]         = alert->alertID;
+        alertEntry["cause"]            = alert->cause;
+        alertEntry["effect"]           = alert->effect;
+        alertEntry["header_text"]      = alert->headerText;
+        alertEntry["description_text"] = alert->descriptionText;
+        alertEntry["url"]              = alert->url;
+
+        QJsonArray periods;
+        for (const QPair<qint64, qint64> &period : alert->activePeriods) {
+            QJsonObject periodEntry;
+            periodEntry["start"] = formatPeriodTime(period.first);
+            periodEntry["end"]   = formatPeriodTime(period.second);
+            periods.push_back(periodEntry);
+        }
+        alertEntry["active_periods"] = periods;
+
+        QJsonArray entities;
+        for (const rtAlertEntity &affected : alert->entities) {
+            QJsonObject entityEntry;
+            entityEntry["route_id"]   = affected.routeID;
+            entityEntry["route_type"] = affected.routeType;
+            entityEntry["stop_id"]    = affected.stopID;
+            entityEntry["trip_id"]    = affected.tripID;
+            entities.push_back(entityEntry);
+        }
+        alertEntry["informed_entities"] = entities;
+        alertArray.push_back(alertEntry);
+    }
+    resp["alerts"] = alertArray;
+
+    QDateTime feedTime = _alerts->getFeedTime();
+    resp["realtime_age_sec"] = feedTime.isNull() ? QJsonValue("-") : QJsonValue(feedTime.secsTo(getAgencyTime()));
+
+    // fill standard protocol information
+    fillProtocolFields("ALR", 0, resp);
+}
+
+QString ServiceAlerts::formatPeriodTime(qint64 timePOSIX)
+{
+    if (timePOSIX == 0) {
+        return "-";
+    }
+    QDateTime periodTime = QDateTime::fromSecsSinceEpoch(timePOSIX).toTimeZone(getAgencyTime().timeZone());
+    return periodTime.toString(getStatus()->format12h() ? "dd-MMM-yyyy h:mm:ss a t" : "dd-MMM-yyyy hh:mm:ss t");
+}
+
+}  // Namespace GTFS
@@ -0,0 +1,63 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef SERVICEALERTS_H
+#define SERVICEALERTS_H
+
+#include "staticstatus.h"
+#include "gtfsrealtimegateway.h"
+
+namespace GTFS {
+
+/*
+ * GTFS::ServiceAlerts
+ * Retrieves the text of service alerts from the real-time alerts feed. NEX, NCF and TRR responses only carry the IDs
+ * of the alerts affecting each trip / route (so that the same alert is not repeated for every trip it affects), this
+ * module gives their cause, effect, text and active periods.
+ *
+ * The following information is required:
+ *  - Realtime Service Alerts
+ */
+class ServiceAlerts : public StaticStatus
+{
+public:
+    /*
+     * Constructor requires the following details
+     *
+     * alertIDs        - list of alert IDs for which to retrieve the alerts
+     */
+    ServiceAlerts(QList<QString> alertIDs);
+
+    /* See GtfsProc_Documentation.html for JSON response format */
+    void fillResponseData(QJsonObject &resp);
+
+private:
+    // Format a POSIX time in the agency's time zone ("-" for open-ended periods)
+    QString formatPeriodTime(qint64 timePOSIX);
+
+    QList<QString> _alertIDs;
+
+    // Real-Time Alerts Access
+    RealTimeAlertsPin _alerts;
+};
+
+}  // Namespace GTFS
+
+#endif // SERVICEALERTS_H
@@ -21,6 +21,8 @@
 #include "staticstatus.h"
 
 #include "datagateway.h"
+#include "upcomingstopcache.h"
+#include "serverstatus.h"
 
 #include <QJsonArray>
 #include <QThreadPool>
@@ -98,6 +100,30 @@ void StaticStatus::fillResponseData(QJsonObject &resp)
     resp["rt_date_match"]    = (double) _stat->getRtDateMatchLevel();
     resp["rt_trip_seq_match"]= !_stat->getRtLooseSeqMatch();
 
+    // Upcoming-service (NEX/NCF/NXR) response cache usage
+    quint64 cacheLookups, cacheHits;
+    qint64  cacheEntries, cacheBytes;
+    GTFS::UpcomingStopCache::inst().getStatistics(cacheLookups, cacheHits, cacheEntries, cacheBytes);
+    resp["nex_cache_sec"]     = GTFS::UpcomingStopCache::inst().getGranularity();
+    resp["nex_cache_lookups"] = (double) cacheLookups;
+    resp["nex_cache_hits"]    = (double) cacheHits;
+    resp["nex_cache_entries"] = cacheEntries;
+    resp["nex_cache_bytes"]   = cacheBytes;
+
+    // Connections and event loop lag of each I/O thread, when they are spread over several
+    const QVector<IoThreadStatus> ioThreads = ServerStatus::inst().getIoThreads();
+    if (ioThreads.size() > 1) {
+        QJsonArray ioThreadArray;
+        for (const IoThreadStatus &ioThread : ioThreads) {
+            QJsonObject ioThreadJSON;
+            ioThreadJSON["connections"] = ioThread.connections;
+            ioThreadJSON["lag_ms"]      = ioThread.lagMSec;
+            ioThreadJSON["max_lag_ms"]  = ioThread.maxLagMSec;
+            ioThreadArray.push_back(ioThreadJSON);
+        }
+        resp["io_threads"] = ioThreadArray;
+    }
+
     QJsonArray agencyArray;
     const QVector<GTFS::AgencyRecord> agencyVec = _stat->getAgencies();
     for (const GTFS::AgencyRecord &agency : agencyVec) {
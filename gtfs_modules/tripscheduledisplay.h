@@ -79,7 +79,7 @@ private:
     const GTFS::RouteData          *_routes;
     const GTFS::StopData           *_stops;
     const GTFS::StopTimeData       *_stopTimes;
-    const GTFS::RealTimeTripUpdate *_realTimeProc;
+    GTFS::RealTimeFeedPin _realTimeProc;
 };
 
 }  // Namespace GTFS
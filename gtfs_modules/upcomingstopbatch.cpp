@@ -0,0 +1,103 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2024, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "upcomingstopbatch.h"
+#include "upcomingstopcache.h"
+
+#include <QJsonArray>
+#include <QtConcurrent>
+
+namespace GTFS {
+
+// A single board of the batch (evaluated on its own, possibly on another thread)
+typedef struct {
+    QList<QString> stopIDs;
+    QJsonObject    board;
+} BatchBoard;
+
+UpcomingStopBatch::UpcomingStopBatch(QList<QList<QString>> stopGroups,
+                                     qint32                futureMinutes,
+                                     bool                  nexCombFormat)
+    : StaticStatus   (),
+      _stopGroups    (stopGroups),
+      _futureMinutes (futureMinutes),
+      _combinedFormat(nexCombFormat)
+{
+    RealTimeGateway::inst().realTimeTransactionHandled();
+    UpcomingStopService::initContext(getAgencyTime(), _context);
+
+    // Resolve the calendar once for the three service days every board looks at (a single board is cheaper without)
+    if (_stopGroups.size() > 1) {
+        const OperatingDay *service = GTFS::DataGateway::inst().getServiceDB();
+        for (qint64 dayOffset = -1; dayOffset <= 1; ++dayOffset) {
+            QDate serviceDay = _context.serviceDate.addDays(dayOffset);
+            _serviceDays.runningServices[serviceDay] = service->servicesRunning(serviceDay);
+        }
+        _context.serviceDays = &_serviceDays;
+    }
+}
+
+void UpcomingStopBatch::fillResponseData(QJsonObject &resp)
+{
+    const QString moduleID = _combinedFormat ? "NCB" : "NEB";
+
+    QVector<BatchBoard> boards;
+    for (const QList<QString> &stopIDs : qAsConst(_stopGroups)) {
+        BatchBoard batchBoard;
+        batchBoard.stopIDs = stopIDs;
+        boards.push_back(batchBoard);
+    }
+
+    // Every board only reads the shared context and writes to its own JSON object. Boards can also be served from the
+    // upcoming-service cache, under their own key as they have no protocol fields.
+    const UpcomingStopContext &context = _context;
+    const qint32  futureMinutes = _futureMinutes;
+    const bool    combinedFormat = _combinedFormat;
+    auto fillBatchBoard = [&context, &moduleID, futureMinutes, combinedFormat](BatchBoard &batchBoard) {
+        QString cacheKey = UpcomingStopCache::makeKey(moduleID, batchBoard.stopIDs, futureMinutes);
+        if (UpcomingStopCache::inst().lookup(cacheKey, context.feedGeneration, context.agencyTime, batchBoard.board)) {
+            return;
+        }
+        qint64 errorID = UpcomingStopService::fillBoard(context, batchBoard.stopIDs, futureMinutes, combinedFormat,
+                                                        false, batchBoard.board);
+        batchBoard.board["error"] = errorID;
+        if (errorID == 0 && context.feedGeneration == GTFS::RealTimeGateway::inst().feedGeneration()) {
+            UpcomingStopCache::inst().insert(cacheKey, context.feedGeneration, context.agencyTime, batchBoard.board);
+        }
+    };
+
+    // The requesting thread takes part in the work, so this cannot starve even if the thread pool is fully busy
+    if (boards.size() > 1) {
+        QtConcurrent::blockingMap(boards, fillBatchBoard);
+    } else if (boards.size() == 1) {
+        fillBatchBoard(boards.first());
+    }
+
+    QJsonArray boardArray;
+    for (const BatchBoard &batchBoard : qAsConst(boards)) {
+        boardArray.push_back(batchBoard.board);
+    }
+    resp["boards"] = boardArray;
+
+    UpcomingStopService::fillDataAges(_context, resp);
+    fillProtocolFields(moduleID, 0, resp);
+}
+
+}  // Namespace GTFS
@@ -0,0 +1,71 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2024, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef UPCOMINGSTOPBATCH_H
+#define UPCOMINGSTOPBATCH_H
+
+#include "staticstatus.h"
+#include "upcomingstopservice.h"
+
+#include <QList>
+
+namespace GTFS {
+
+/*
+ * GTFS::UpcomingStopBatch
+ * Departure boards for many independent stops (or groups of stops) in a single request, as a sign backend polling a
+ * whole fleet of displays would otherwise send one NEX/NCF request per display.
+ *
+ * Each group is evaluated exactly like a NEX (or NCF) request for the same stop ID(s), but everything which does not
+ * depend on the stops is only done once for the whole batch: agency time, service date, the services running on the
+ * three service days, the active real-time feed and the age of the data. Groups are evaluated in parallel on the
+ * global thread pool.
+ */
+class UpcomingStopBatch : public StaticStatus
+{
+public:
+    /*
+     * Constructor requires the following details:
+     *
+     * stopGroups       - the stop ID(s) of each board: a single stop ID, a parent station, or several stop IDs
+     *
+     * futureMinutes    - number of minutes into the future that should be scanned for stop trip service (max of 4320)
+     *
+     * nexCombFormat    - true to render each board like NCF (all trips sorted by time), false to render like NEX
+     */
+    UpcomingStopBatch(QList<QList<QString>> stopGroups,
+                      qint32                futureMinutes,
+                      bool                  nexCombFormat);
+
+    /* See GtfsProc_Documentation.html for JSON response format */
+    void fillResponseData(QJsonObject &resp);
+
+private:
+    QList<QList<QString>> _stopGroups;
+    qint32                _futureMinutes;
+    bool                  _combinedFormat;
+
+    ServiceDaySnapshot    _serviceDays;
+    UpcomingStopContext   _context;
+};
+
+}  // Namespace GTFS
+
+#endif // UPCOMINGSTOPBATCH_H
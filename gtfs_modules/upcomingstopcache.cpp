@@ -0,0 +1,214 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2024, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "upcomingstopcache.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+namespace GTFS {
+
+UpcomingStopCache &UpcomingStopCache::inst()
+{
+    static UpcomingStopCache *_instance = nullptr;
+    if (_instance == nullptr) {
+        _instance = new UpcomingStopCache();
+    }
+    return *_instance;
+}
+
+void UpcomingStopCache::setGranularity(qint32 seconds)
+{
+    _granularitySec = (seconds > 0) ? seconds : 0;
+}
+
+qint32 UpcomingStopCache::getGranularity() const
+{
+    return _granularitySec;
+}
+
+QString UpcomingStopCache::makeKey(const QString &moduleID, const QList<QString> &stopIDs, qint32 futureMinutes)
+{
+    // The order of the stop IDs is kept: it is reflected in the stop_id and stop_name of the response
+    QStringList normalizedIDs;
+    for (const QString &stopID : stopIDs) {
+        normalizedIDs.append(stopID.trimmed());
+    }
+    return moduleID.toUpper() + " " + QString::number(futureMinutes) + " " + normalizedIDs.join('|');
+}
+
+bool UpcomingStopCache::lookup(const QString   &key,
+                               quint64          feedGeneration,
+                               const QDateTime &agencyTime,
+                               QJsonObject     &resp)
+{
+    if (_granularitySec == 0) {
+        return false;
+    }
+
+    qint64 nowSec     = agencyTime.toSecsSinceEpoch();
+    qint64 elapsedSec = 0;
+    bool   found      = false;
+
+    _lock_cache.lock();
+    ++_lookups;
+    expireEntries(feedGeneration, nowSec / _granularitySec);
+    QHash<QString, CachedStopResponse>::const_iterator entry = _entries.constFind(key);
+    if (entry != _entries.constEnd() &&
+        entry->feedGen == feedGeneration && entry->timeBucket == nowSec / _granularitySec) {
+        ++_hits;
+        if (entry->precomputed) {
+            ++_precomputedHits;
+        }
+        resp       = entry->response;
+        elapsedSec = nowSec - entry->computedSec;
+        found      = true;
+    }
+    _lock_cache.unlock();
+
+    if (found) {
+        adjustResponse(resp, elapsedSec);
+    }
+    return found;
+}
+
+void UpcomingStopCache::insert(const QString     &key,
+                               quint64            feedGeneration,
+                               const QDateTime   &agencyTime,
+                               const QJsonObject &resp,
+                               bool               precomputed)
+{
+    if (_granularitySec == 0) {
+        return;
+    }
+
+    CachedStopResponse cached;
+    cached.response    = resp;
+    cached.feedGen     = feedGeneration;
+    cached.computedSec = agencyTime.toSecsSinceEpoch();
+    cached.timeBucket  = cached.computedSec / _granularitySec;
+    cached.sizeBytes   = QJsonDocument(resp).toJson(QJsonDocument::Compact).size();
+    cached.precomputed = precomputed;
+
+    _lock_cache.lock();
+    expireEntries(feedGeneration, cached.timeBucket);
+    if (feedGeneration == _currentFeedGen && cached.timeBucket == _currentBucket) {
+        if (_entries.contains(key)) {
+            _totalBytes -= _entries[key].sizeBytes;
+        }
+        _entries[key] = cached;
+        _totalBytes  += cached.sizeBytes;
+    }
+    _lock_cache.unlock();
+}
+
+void UpcomingStopCache::getStatistics(quint64 &lookups, quint64 &hits, qint64 &entries, qint64 &sizeBytes)
+{
+    _lock_cache.lock();
+    lookups   = _lookups;
+    hits      = _hits;
+    entries   = _entries.size();
+    sizeBytes = _totalBytes;
+    _lock_cache.unlock();
+}
+
+quint64 UpcomingStopCache::getPrecomputedHits()
+{
+    _lock_cache.lock();
+    quint64 precomputedHits = _precomputedHits;
+    _lock_cache.unlock();
+    return precomputedHits;
+}
+
+void UpcomingStopCache::expireEntries(quint64 feedGeneration, qint64 timeBucket)
+{
+    // Nothing can expire until either a new real-time buffer is activated or a new time bucket is entered
+    if (feedGeneration <= _currentFeedGen && timeBucket <= _currentBucket) {
+        return;
+    }
+    _currentFeedGen = qMax(_currentFeedGen, feedGeneration);
+    _currentBucket  = qMax(_currentBucket, timeBucket);
+
+    QHash<QString, CachedStopResponse>::iterator entry = _entries.begin();
+    while (entry != _entries.end()) {
+        if (entry->feedGen != _currentFeedGen || entry->timeBucket != _currentBucket) {
+            _totalBytes -= entry->sizeBytes;
+            entry = _entries.erase(entry);
+        } else {
+            ++entry;
+        }
+    }
+}
+
+void UpcomingStopCache::adjustResponse(QJsonObject &resp, qint64 elapsedSec)
+{
+    if (elapsedSec == 0) {
+        return;
+    }
+
+    // The real-time data used to compute the response aged as well
+    if (resp.contains("realtime_age_sec") && resp["realtime_age_sec"].isDouble()) {
+        resp["realtime_age_sec"] = resp["realtime_age_sec"].toInteger() + elapsedSec;
+    }
+
+    // NCF lists trips directly, NEX lists them within each route
+    auto shiftWaitTimes = [elapsedSec](QJsonArray trips) {
+        for (qsizetype tripIdx = 0; tripIdx < trips.size(); ++tripIdx) {
+            QJsonObject trip = trips[tripIdx].toObject();
+            trip["wait_time_sec"] = trip["wait_time_sec"].toInteger() - elapsedSec;
+            trips[tripIdx] = trip;
+        }
+        return trips;
+    };
+
+    if (resp.contains("trips")) {
+        resp["trips"] = shiftWaitTimes(resp["trips"].toArray());
+    }
+    if (resp.contains("routes")) {
+        QJsonArray routes = resp["routes"].toArray();
+        for (qsizetype routeIdx = 0; routeIdx < routes.size(); ++routeIdx) {
+            QJsonObject route = routes[routeIdx].toObject();
+            route["trips"] = shiftWaitTimes(route["trips"].toArray());
+            routes[routeIdx] = route;
+        }
+        resp["routes"] = routes;
+    }
+}
+
+/*
+ * Singleton Pattern Requirements
+ */
+UpcomingStopCache::UpcomingStopCache(QObject *parent) :
+    QObject(parent),
+    _granularitySec(0),
+    _currentFeedGen(0),
+    _currentBucket(0),
+    _totalBytes(0),
+    _lookups(0),
+    _hits(0),
+    _precomputedHits(0)
+{
+}
+
+UpcomingStopCache::~UpcomingStopCache()
+{
+}
+
+} // Namespace GTFS
@@ -0,0 +1,109 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2024, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef UPCOMINGSTOPCACHE_H
+#define UPCOMINGSTOPCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QDateTime>
+#include <QJsonObject>
+
+namespace GTFS {
+
+// A cached NEX/NCF response and what it is valid for
+typedef struct {
+    QJsonObject response;      // Full response as it was sent out when computed
+    quint64     feedGen;       // Real-time feed generation the response was computed against
+    qint64      timeBucket;    // Agency time (seconds since epoch) divided by the cache granularity
+    qint64      computedSec;   // Agency time (seconds since epoch) at which the response was computed
+    qint64      sizeBytes;     // Size of the compact JSON rendering of the response (for memory reporting)
+    bool        precomputed;   // Computed ahead of any request for it (see UpcomingStopPrecompute)
+} CachedStopResponse;
+
+/*
+ * GTFS::UpcomingStopCache is a singleton holding recently-computed NEX/NCF responses so that many clients polling the
+ * same stops (countdown signs, for instance) do not each trigger a full trip reconciliation.
+ *
+ * Entries are keyed by the request type, lookahead and stop IDs. An entry only serves requests arriving within the
+ * same time bucket (of the configured granularity) and against the same real-time feed generation: every buffer swap
+ * in the RealTimeGateway thus invalidates the whole cache. The wait times of a served entry are adjusted by the time
+ * elapsed since it was computed, but the trip statuses (ARRV, BRDG, DPRT, ...) are those of the computation time.
+ */
+class UpcomingStopCache : public QObject
+{
+    Q_OBJECT
+public:
+    // Singleton Operations
+    static UpcomingStopCache &inst();
+
+    // Seconds for which a response remains valid (0 disables the cache entirely)
+    void   setGranularity(qint32 seconds);
+    qint32 getGranularity() const;
+
+    // Build the cache key of a request
+    static QString makeKey(const QString        &moduleID,
+                           const QList<QString> &stopIDs,
+                           qint32                futureMinutes);
+
+    // Fill resp with a still-valid entry for the request key, returns false (and resp is untouched) if there is none
+    bool lookup(const QString &key, quint64 feedGeneration, const QDateTime &agencyTime, QJsonObject &resp);
+
+    // Store a freshly-computed response (precomputed: it was computed ahead of any request, in the background)
+    void insert(const QString     &key,
+                quint64            feedGeneration,
+                const QDateTime   &agencyTime,
+                const QJsonObject &resp,
+                bool               precomputed = false);
+
+    // Statistics for status reporting (SDS and RDS)
+    void getStatistics(quint64 &lookups, quint64 &hits, qint64 &entries, qint64 &sizeBytes);
+
+    // Number of lookups served with a precomputed response
+    quint64 getPrecomputedHits();
+
+private:
+    // Singleton Pattern Requirements
+    explicit UpcomingStopCache(QObject *parent = nullptr);
+    explicit UpcomingStopCache(const UpcomingStopCache &);
+    UpcomingStopCache &operator =(UpcomingStopCache const &other);
+    virtual ~UpcomingStopCache();
+
+    // Drop every entry which can no longer be served (call with _lock_cache held)
+    void expireEntries(quint64 feedGeneration, qint64 timeBucket);
+
+    // Shift the wait times and real-time age of a response computed elapsedSec seconds ago
+    static void adjustResponse(QJsonObject &resp, qint64 elapsedSec);
+
+    qint32                             _granularitySec;  // Validity of an entry (0 = cache disabled)
+    QMutex                             _lock_cache;      // Guards everything below
+    QHash<QString, CachedStopResponse> _entries;         // Cached responses per request key
+    quint64                            _currentFeedGen;  // Newest real-time feed generation seen
+    qint64                             _currentBucket;   // Newest time bucket seen
+    qint64                             _totalBytes;      // Sum of the sizeBytes of all entries
+    quint64                            _lookups;         // Number of lookups performed
+    quint64                            _hits;            // Number of lookups served from the cache
+    quint64                            _precomputedHits; // Number of lookups served with a precomputed response
+};
+
+} // Namespace GTFS
+
+#endif // UPCOMINGSTOPCACHE_H
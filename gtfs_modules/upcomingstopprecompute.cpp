@@ -0,0 +1,215 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2024, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "upcomingstopprecompute.h"
+#include "upcomingstopservice.h"
+#include "upcomingstopcache.h"
+#include "gtfsrealtimegateway.h"
+
+#include <QElapsedTimer>
+
+namespace GTFS {
+
+UpcomingStopPrecompute &UpcomingStopPrecompute::inst()
+{
+    static UpcomingStopPrecompute *_instance = nullptr;
+    if (_instance == nullptr) {
+        _instance = new UpcomingStopPrecompute();
+    }
+    return *_instance;
+}
+
+void UpcomingStopPrecompute::setParameters(qint32 nbBoards, qint32 budgetMSec)
+{
+    _nbBoards   = (nbBoards > 0)   ? nbBoards   : 0;
+    _budgetMSec = (budgetMSec > 0) ? budgetMSec : 0;
+}
+
+void UpcomingStopPrecompute::startPrecomputing()
+{
+    // Precomputed boards are only ever served from the cache
+    if (_nbBoards == 0 || UpcomingStopCache::inst().getGranularity() == 0) {
+        return;
+    }
+
+    // Armed by each precomputation, for the next time bucket (it moves to the thread along with its parent)
+    _rolloverTimer = new QTimer(this);
+    _rolloverTimer->setSingleShot(true);
+    connect(_rolloverTimer, &QTimer::timeout, this, &UpcomingStopPrecompute::bucketRolledOver);
+
+    _thread = new QThread;
+    moveToThread(_thread);
+    connect(&RealTimeGateway::inst(), &RealTimeGateway::feedActivated,
+            this, &UpcomingStopPrecompute::precomputeBoards, Qt::QueuedConnection);
+    _thread->start(QThread::LowPriority);
+}
+
+void UpcomingStopPrecompute::recordRequest(const QString &moduleID, const QList<QString> &stopIDs, qint32 futureMinutes)
+{
+    if (_nbBoards == 0) {
+        return;
+    }
+
+    QString boardKey = UpcomingStopCache::makeKey(moduleID, stopIDs, futureMinutes);
+
+    _lock_boards.lock();
+    QHash<QString, HotStopBoard>::iterator board = _boards.find(boardKey);
+    if (board == _boards.end()) {
+        HotStopBoard newBoard;
+        newBoard.moduleID      = moduleID;
+        newBoard.stopIDs       = stopIDs;
+        newBoard.futureMinutes = futureMinutes;
+        newBoard.requestCount  = 0;
+        board = _boards.insert(boardKey, newBoard);
+    }
+    ++board.value().requestCount;
+    _lock_boards.unlock();
+}
+
+void UpcomingStopPrecompute::getStatistics(qint64 &lastRunMSec, qint32 &lastRunBoards)
+{
+    _lock_boards.lock();
+    lastRunMSec   = _lastRunMSec;
+    lastRunBoards = _lastRunBoards;
+    _lock_boards.unlock();
+}
+
+void UpcomingStopPrecompute::precomputeBoards(quint64 generation)
+{
+    // A newer feed is already active (its own precomputation is queued), or the feed was idled / disabled
+    std::shared_ptr<const RealTimeSnapshot> snapshot = RealTimeGateway::inst().activeSnapshot();
+    if (generation != snapshot->generation || snapshot->feed == nullptr) {
+        return;
+    }
+    precompute(true);
+}
+
+void UpcomingStopPrecompute::bucketRolledOver()
+{
+    // Still within the bucket (the agency time is frozen, or the timer fired early): wait for the next one again
+    qint32 granularitySec = UpcomingStopCache::inst().getGranularity();
+    if (agencyTime().toSecsSinceEpoch() / granularitySec == _lastRunBucket) {
+        _rolloverTimer->start(granularitySec * 1000);
+        return;
+    }
+
+    // Nothing to compute while the feed is idled / disabled, its next activation starts over
+    if (RealTimeGateway::inst().getActiveFeed() == nullptr) {
+        return;
+    }
+    precompute(false);
+}
+
+void UpcomingStopPrecompute::precompute(bool fadeCounts)
+{
+    QElapsedTimer precomputeTimer;
+    precomputeTimer.start();
+
+    // Pick the most requested boards, then halve the counts (at each activation) so that boards no longer requested
+    // fade away
+    QList<HotStopBoard> hotBoards;
+    _lock_boards.lock();
+    for (const HotStopBoard &board : qAsConst(_boards)) {
+        hotBoards.append(board);
+    }
+    QHash<QString, HotStopBoard>::iterator board = _boards.begin();
+    while (fadeCounts && board != _boards.end()) {
+        board.value().requestCount /= 2;
+        if (board.value().requestCount == 0) {
+            board = _boards.erase(board);
+        } else {
+            ++board;
+        }
+    }
+    _lock_boards.unlock();
+
+    std::sort(hotBoards.begin(), hotBoards.end(), [](const HotStopBoard &boardA, const HotStopBoard &boardB) {
+        return boardA.requestCount > boardB.requestCount;
+    });
+    if (hotBoards.size() > _nbBoards) {
+        hotBoards.erase(hotBoards.begin() + _nbBoards, hotBoards.end());
+    }
+
+    // Every board is computed for the same instant and against the active feed
+    QDateTime computeTime = agencyTime();
+    UpcomingStopContext context;
+    UpcomingStopService::initContext(computeTime, context);
+
+    qint32 boardsComputed = 0;
+    for (const HotStopBoard &hotBoard : qAsConst(hotBoards)) {
+        if ((_budgetMSec != 0 && precomputeTimer.elapsed() >= _budgetMSec) ||
+            context.feedGeneration != RealTimeGateway::inst().feedGeneration()) {
+            break;
+        }
+
+        // Stored without the protocol fields: those are filled when the response is served
+        QJsonObject resp;
+        bool combinedFormat = (hotBoard.moduleID == "NCF");
+        bool realtimeOnly   = (hotBoard.moduleID == "NXR");
+        if (UpcomingStopService::fillBoard(context, hotBoard.stopIDs, hotBoard.futureMinutes,
+                                           combinedFormat, realtimeOnly, resp) != 0) {
+            continue;
+        }
+        UpcomingStopService::fillDataAges(context, resp);
+        UpcomingStopCache::inst().insert(UpcomingStopCache::makeKey(hotBoard.moduleID, hotBoard.stopIDs,
+                                                                    hotBoard.futureMinutes),
+                                         context.feedGeneration, computeTime, resp, true);
+        ++boardsComputed;
+    }
+
+    // The boards are computed again once the cache moves on to the next time bucket (just after it starts)
+    qint32 granularitySec = UpcomingStopCache::inst().getGranularity();
+    qint64 computeMSec    = computeTime.toMSecsSinceEpoch();
+    _lastRunBucket = computeTime.toSecsSinceEpoch() / granularitySec;
+    _rolloverTimer->start(static_cast<int>((_lastRunBucket + 1) * granularitySec * 1000 - computeMSec + 1));
+
+    _lock_boards.lock();
+    _lastRunMSec   = precomputeTimer.elapsed();
+    _lastRunBoards = boardsComputed;
+    _lock_boards.unlock();
+}
+
+QDateTime UpcomingStopPrecompute::agencyTime()
+{
+    const Status *status = GTFS::DataGateway::inst().getStatus();
+    QDateTime agencyTime = status->getOverrideDateTime();
+    if (agencyTime.isNull()) {
+        agencyTime = QDateTime::currentDateTimeUtc().toTimeZone(status->getAgencyTZ());
+    }
+    return agencyTime;
+}
+
+UpcomingStopPrecompute::UpcomingStopPrecompute(QObject *parent) :
+    QObject(parent),
+    _nbBoards(0),
+    _budgetMSec(0),
+    _thread(nullptr),
+    _rolloverTimer(nullptr),
+    _lastRunBucket(0),
+    _lastRunMSec(0),
+    _lastRunBoards(0)
+{
+}
+
+UpcomingStopPrecompute::~UpcomingStopPrecompute()
+{
+}
+
+} // Namespace GTFS
@@ -0,0 +1,105 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2024, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef UPCOMINGSTOPPRECOMPUTE_H
+#define UPCOMINGSTOPPRECOMPUTE_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QTimer>
+
+namespace GTFS {
+
+// A NEX/NCF/NXR request that was asked for, and how often
+typedef struct {
+    QString        moduleID;       // NEX, NCF or NXR
+    QList<QString> stopIDs;
+    qint32         futureMinutes;
+    quint64        requestCount;   // Requests since the last precomputation (decayed at each precomputation)
+} HotStopBoard;
+
+/*
+ * GTFS::UpcomingStopPrecompute is a singleton tracking how often each NEX/NCF/NXR request (stop IDs and lookahead) is
+ * made, so that right after the RealTimeGateway activates a new feed the most requested boards are computed ahead of
+ * time, in the background, and stored in the UpcomingStopCache. Requests for them are then served from the cache
+ * instead of running the trip reconciliation on the request thread (the cache must thus be enabled).
+ *
+ * The precomputation runs on its own low-priority thread and stops once its time budget is spent, the boards being
+ * computed from the most requested to the least. Request counts are halved at each activation, so the boards computed
+ * follow the requests made recently. The cache only serves a response within the time bucket it was computed in, so
+ * the boards are computed again (within the same budget) as soon as the next bucket starts, whatever the feed.
+ */
+class UpcomingStopPrecompute : public QObject
+{
+    Q_OBJECT
+public:
+    // Singleton Operations
+    static UpcomingStopPrecompute &inst();
+
+    // Number of boards to precompute after each activation (0 disables the precomputation) and the time budget
+    // (milliseconds of computation per precomputation, 0 for no limit)
+    void setParameters(qint32 nbBoards, qint32 budgetMSec);
+
+    // Start precomputing boards on a background thread whenever the RealTimeGateway activates a new feed
+    void startPrecomputing();
+
+    // Note that a NEX/NCF/NXR request was made
+    void recordRequest(const QString &moduleID, const QList<QString> &stopIDs, qint32 futureMinutes);
+
+    // Statistics for status reporting (RPS) about the latest precomputation
+    void getStatistics(qint64 &lastRunMSec, qint32 &lastRunBoards);
+
+public slots:
+    // Compute the most requested boards against the feed generation activated
+    void precomputeBoards(quint64 generation);
+
+private slots:
+    // The time bucket of the latest precomputation may be over: compute the boards again for the next one
+    void bucketRolledOver();
+
+private:
+    // Singleton Pattern Requirements
+    explicit UpcomingStopPrecompute(QObject *parent = nullptr);
+    explicit UpcomingStopPrecompute(const UpcomingStopPrecompute &);
+    UpcomingStopPrecompute &operator =(UpcomingStopPrecompute const &other);
+    virtual ~UpcomingStopPrecompute();
+
+    // Compute the most requested boards against the active feed (fadeCounts: halve the request counts afterwards)
+    void precompute(bool fadeCounts);
+
+    // Agency time the boards are computed for
+    static QDateTime agencyTime();
+
+    qint32                       _nbBoards;       // Number of boards to precompute (0 = disabled)
+    qint32                       _budgetMSec;     // Time budget of a precomputation (0 = no limit)
+    QThread                     *_thread;         // Low-priority thread running the precomputations
+    QTimer                      *_rolloverTimer;  // Fires at the start of the next time bucket of the cache
+    qint64                       _lastRunBucket;  // Time bucket the latest precomputation was made in
+    QMutex                       _lock_boards;    // Guards everything below
+    QHash<QString, HotStopBoard> _boards;         // Requested boards (by UpcomingStopCache key)
+    qint64                       _lastRunMSec;    // Duration of the latest precomputation
+    qint32                       _lastRunBoards;  // Boards computed by the latest precomputation
+};
+
+} // Namespace GTFS
+
+#endif // UPCOMINGSTOPPRECOMPUTE_H
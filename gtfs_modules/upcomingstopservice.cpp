@@ -19,6 +19,8 @@
  */
 
 #include "upcomingstopservice.h"
+#include "upcomingstopcache.h"
+#include "upcomingstopprecompute.h"
 
 #include <QJsonArray>
 #include <QDebug>
@@ -38,100 +40,108 @@ UpcomingStopService::UpcomingStopService(QList<QString> stopIDs,
                                          bool           realtimeOnly)
     : StaticStatus   (),
       _stopIDs       (stopIDs),
-      _serviceDate   (QDate::currentDate()),
       _futureMinutes (futureMinutes),
       _combinedFormat(nexCombFormat),
-      _realtimeOnly  (realtimeOnly),
-      _rtData        (false)
+      _realtimeOnly  (realtimeOnly)
 {
-    // Realtime Data Determination
     RealTimeGateway::inst().realTimeTransactionHandled();
-    _realTimeProc = GTFS::RealTimeGateway::inst().getActiveFeed();
-    if (_realTimeProc != nullptr) {
-        _rtData = true;
+    initContext(getAgencyTime(), _context);
+}
+
+void UpcomingStopService::fillResponseData(QJsonObject &resp)
+{
+    // Serve a recent-enough response computed for the same request if there is one (see UpcomingStopCache)
+    QString moduleID = _combinedFormat ? "NCF" : "NEX";
+    QString cacheKey = UpcomingStopCache::makeKey(_realtimeOnly ? "NXR" : moduleID, _stopIDs, _futureMinutes);
+    UpcomingStopPrecompute::inst().recordRequest(_realtimeOnly ? "NXR" : moduleID, _stopIDs, _futureMinutes);
+    if (UpcomingStopCache::inst().lookup(cacheKey, _context.feedGeneration, getAgencyTime(), resp)) {
+        fillProtocolFields(moduleID, 0, resp);
+        return;
     }
 
-    // Static Datasets for the TripStopReconciler
-    _status    = GTFS::DataGateway::inst().getStatus();
-    _service   = GTFS::DataGateway::inst().getServiceDB();
-    _stops     = GTFS::DataGateway::inst().getStopsDB();
-    _parentSta = GTFS::DataGateway::inst().getParentsDB();
-    _routes    = GTFS::DataGateway::inst().getRoutesDB();
-    _stopTimes = GTFS::DataGateway::inst().getStopTimesDB();
-    _tripDB    = GTFS::DataGateway::inst().getTripsDB();
+    qint64 errorID = fillBoard(_context, _stopIDs, _futureMinutes, _combinedFormat, _realtimeOnly, resp);
+    if (errorID != 0) {
+        fillProtocolFields(moduleID, errorID, resp);
+        return;
+    }
+    fillDataAges(_context, resp);
 
-    // Override the service date if in the fixed debugging date mode
-    if (!_status->getOverrideDateTime().isNull()) {
-        _serviceDate = _status->getOverrideDateTime().date();
+    // Fill standard protocol-required information ... the grammars are different if using combined format vs. standard!
+    fillProtocolFields(moduleID, 0, resp);
+
+    // Only keep the response if the active real-time feed was not switched while it was being computed
+    if (_context.feedGeneration == GTFS::RealTimeGateway::inst().feedGeneration()) {
+        UpcomingStopCache::inst().insert(cacheKey, _context.feedGeneration, getAgencyTime(), resp);
     }
 }
 
-void UpcomingStopService::fillResponseData(QJsonObject &resp)
+qint64 UpcomingStopService::fillBoard(const UpcomingStopContext &context,
+                                      QList<QString>             stopIDs,
+                                      qint32                     futureMinutes,
+                                      bool                       nexCombFormat,
+                                      bool                       realtimeOnly,
+                                      QJsonObject               &board)
 {
+    // Static Datasets for the TripStopReconciler
+    const Status         *status    = GTFS::DataGateway::inst().getStatus();
+    const OperatingDay   *service   = GTFS::DataGateway::inst().getServiceDB();
+    const StopData       *stops     = GTFS::DataGateway::inst().getStopsDB();
+    const ParentStopData *parentSta = GTFS::DataGateway::inst().getParentsDB();
+    const RouteData      *routes    = GTFS::DataGateway::inst().getRoutesDB();
+    const StopTimeData   *stopTimes = GTFS::DataGateway::inst().getStopTimesDB();
+    const TripData       *tripDB    = GTFS::DataGateway::inst().getTripsDB();
+
     // If a parent station was requested, fetch all the relevant trips to all its child stops
     bool parentStationMode = false;
     QString parentStation;
-    if (_stopIDs.size() == 1 && _parentSta->contains(_stopIDs.at(0))) {
-        parentStation = _stopIDs.at(0);
-        _stopIDs = (*_parentSta)[parentStation].toList();
+    if (stopIDs.size() == 1 && parentSta->contains(stopIDs.at(0))) {
+        parentStation = stopIDs.at(0);
+        stopIDs = (*parentSta)[parentStation].toList();
         parentStationMode = true;
     }
 
+    // Only the grouped-by-route format with schedule-based trips caps the number of trips (see getNbTripsPerRoute)
+    // so only then can the reconciler stop evaluating the trips of a route early.
+    quint32 maxTripsPerRoute = (!nexCombFormat && !realtimeOnly) ? status->getNbTripsPerRoute() : 0;
+
     // Array to populate based on the response of the tripStopLoader
-    GTFS::TripStopReconciler tripStopLoader(_stopIDs,
-                                            _rtData,
-                                            _serviceDate,
-                                            getAgencyTime(),
-                                            _futureMinutes,
-                                            _status,
-                                            _service,
-                                            _stops,
-                                            _routes,
-                                            _tripDB,
-                                            _stopTimes,
-                                            _realTimeProc);
+    GTFS::TripStopReconciler tripStopLoader(stopIDs,
+                                            context.realTimeProc != nullptr,
+                                            context.serviceDate,
+                                            context.agencyTime,
+                                            futureMinutes,
+                                            maxTripsPerRoute,
+                                            status,
+                                            service,
+                                            stops,
+                                            routes,
+                                            tripDB,
+                                            stopTimes,
+                                            context.realTimeProc.get(),
+                                            context.serviceDays);
 
     // The stop ID requested does not exist
     if (!tripStopLoader.stopIdExists()) {
-        if (_combinedFormat) {
-            fillProtocolFields("NCF", 601, resp);
-        } else {
-            fillProtocolFields("NEX", 601, resp);
-        }
-        return;
-    }
-
-    // Store dataset modification time
-    resp["static_data_modif"] = _status->getStaticDatasetModifiedTime().toString("dd-MMM-yyyy hh:mm:ss t");
-
-    // If real-time data is available (regardless of if it's relevant for this request or not), store the age of the
-    // data in the active buffer used to produce real-time predictions in this transaction.
-    if (_rtData) {
-        QDateTime activeFeedTime = _realTimeProc->getFeedTime();
-        if (activeFeedTime.isNull()) {
-            resp["realtime_age_sec"] = "-";
-        } else {
-            resp["realtime_age_sec"] = activeFeedTime.secsTo(getAgencyTime());
-        }
+        return 601;
     }
 
     // Fill stop information in response
     if (parentStationMode) {
-        resp["stop_id"] = parentStation;
-        resp["stop_name"] = (*_stops)[parentStation].stop_name;
-        resp["stop_desc"] = "Parent Station";
+        board["stop_id"] = parentStation;
+        board["stop_name"] = (*stops)[parentStation].stop_name;
+        board["stop_desc"] = "Parent Station";
     } else {
-        if (_stopIDs.size() == 1) {
-            resp["stop_id"] = _stopIDs.at(0);
+        if (stopIDs.size() == 1) {
+            board["stop_id"] = stopIDs.at(0);
         } else {
             QString stopIDconcat;
-            for (const QString &stopID : qAsConst(_stopIDs)) {
+            for (const QString &stopID : qAsConst(stopIDs)) {
                 stopIDconcat += stopID + " | ";
             }
-            resp["stop_id"] = stopIDconcat;
+            board["stop_id"] = stopIDconcat;
         }
-        resp["stop_name"] = tripStopLoader.getStopName();
-        resp["stop_desc"] = tripStopLoader.getStopDesciption();
+        board["stop_name"] = tripStopLoader.getStopName();
+        board["stop_desc"] = tripStopLoader.getStopDesciption();
     }
 
     // Populate the valid upcoming routes with trips for the stop_id requested
@@ -140,7 +150,7 @@ void UpcomingStopService::fillResponseData(QJsonObject &resp)
     tripStopLoader.getTripsByRoute(tripsForStopByRouteID);
 
     // DEFAULT MODE: "NEX" IS THE UPCOMING ARRIVALS GROUPED BY THE TRIP'S RESPECTIVE ROUTE ID
-    if (!_combinedFormat) {
+    if (!nexCombFormat) {
         for (const QString &routeID : tripsForStopByRouteID.keys()) {
             QJsonObject routeItem;
             routeItem["route_id"] = routeID;
@@ -150,17 +160,18 @@ void UpcomingStopService::fillResponseData(QJsonObject &resp)
             quint32    tripsFoundForRoute = 0;
             for (const GTFS::StopRecoTripRec &rts : qAsConst(tripsForStopByRouteID[routeID].tripRecos)) {
                 GTFS::TripRecStat tripStat = rts.tripStatus;
-                if ((tripStat == GTFS::IRRELEVANT) || (_status->hideTerminatingTripsForNEXNCF() && rts.endOfTrip) ||
-                    (_realtimeOnly && (tripStat == GTFS::SCHEDULE || tripStat == GTFS::NOSCHEDULE))) {
+                if ((tripStat == GTFS::IRRELEVANT) || (status->hideTerminatingTripsForNEXNCF() && rts.endOfTrip) ||
+                    (realtimeOnly && (tripStat == GTFS::SCHEDULE || tripStat == GTFS::NOSCHEDULE))) {
                     continue;
                 }
 
                 QJsonObject stopTripItem;
-                fillTripData(rts, stopTripItem, getStatus()->format12h(), (*_tripDB)[rts.tripID].trip_short_name);
+                fillTripData(rts, stopTripItem, status->format12h(), (*tripDB)[rts.tripID].trip_short_name,
+                             &context);
                 stopTrips.push_back(stopTripItem);
 
                 ++tripsFoundForRoute;
-                if (tripsFoundForRoute == _status->getNbTripsPerRoute()) {
+                if (tripsFoundForRoute == status->getNbTripsPerRoute()) {
                     break;
                 }
             }
@@ -177,7 +188,7 @@ void UpcomingStopService::fillResponseData(QJsonObject &resp)
         });
 
         // Finally, attach the route list!
-        resp["routes"] = stopRouteArray;
+        board["routes"] = stopRouteArray;
     }
 
     // COMBINED-FORMAT MODE: "NCF" IS THE UPCOMING ARRIVALS IN ONE LINEAR ARRAY, SORTED BY ARRIVAL/DEPARTURE TIME
@@ -188,8 +199,8 @@ void UpcomingStopService::fillResponseData(QJsonObject &resp)
             // Flatten trips into a single array (as opposed to the nesting by route present) to sorted times together
             for (const GTFS::StopRecoTripRec &rts : tripsForStopByRouteID[routeID].tripRecos) {
                 GTFS::TripRecStat tripStat = rts.tripStatus;
-                if ((tripStat == GTFS::IRRELEVANT) || (_status->hideTerminatingTripsForNEXNCF() && rts.endOfTrip) ||
-                    (_realtimeOnly && (tripStat == GTFS::SCHEDULE || tripStat == GTFS::NOSCHEDULE))) {
+                if ((tripStat == GTFS::IRRELEVANT) || (status->hideTerminatingTripsForNEXNCF() && rts.endOfTrip) ||
+                    (realtimeOnly && (tripStat == GTFS::SCHEDULE || tripStat == GTFS::NOSCHEDULE))) {
                     continue;
                 }
                 unifiedTrips.push_back(qMakePair(rts, routeID));
@@ -206,24 +217,60 @@ void UpcomingStopService::fillResponseData(QJsonObject &resp)
         for (const QPair<GTFS::StopRecoTripRec, QString> &rts : unifiedTrips) {
             QJsonObject stopTripItem;
             stopTripItem["route_id"] = rts.second;    // Link to the route information
-            fillTripData(rts.first, stopTripItem, getStatus()->format12h(),
-                         (*_tripDB)[rts.first.tripID].trip_short_name);
+            fillTripData(rts.first, stopTripItem, status->format12h(),
+                         (*tripDB)[rts.first.tripID].trip_short_name, &context);
             stopRouteArray.push_back(stopTripItem);
         }
 
         // Attach the routes and trips collections
-        resp["trips"]  = stopRouteArray;
+        board["trips"]  = stopRouteArray;
     }
 
-    // Fill standard protocol-required information ... the grammars are different if using combined format vs. standard!
-    if (_combinedFormat) {
-        fillProtocolFields("NCF", 0, resp);
-    } else {
-        fillProtocolFields("NEX", 0, resp);
+    return 0;
+}
+
+void UpcomingStopService::fillDataAges(const UpcomingStopContext &context, QJsonObject &resp)
+{
+    // Store dataset modification time
+    const Status *status = GTFS::DataGateway::inst().getStatus();
+    resp["static_data_modif"] = status->getStaticDatasetModifiedTime().toString("dd-MMM-yyyy hh:mm:ss t");
+
+    // If real-time data is available (regardless of if it's relevant for this request or not), store the age of the
+    // data in the active buffer used to produce real-time predictions in this transaction.
+    if (context.realTimeProc != nullptr) {
+        QDateTime activeFeedTime = context.realTimeProc->getFeedTime();
+        if (activeFeedTime.isNull()) {
+            resp["realtime_age_sec"] = "-";
+        } else {
+            resp["realtime_age_sec"] = activeFeedTime.secsTo(context.agencyTime);
+        }
     }
 }
 
-void UpcomingStopService::fillTripData(const StopRecoTripRec &rts, QJsonObject &stopTripItem, bool format12h, QString shortName)
+void UpcomingStopService::initContext(const QDateTime &agencyTime, UpcomingStopContext &context)
+{
+    // Realtime Data Determination (the generation and the feed come from the same snapshot, so a cached response is
+    // always attributed to the feed it was computed from)
+    std::shared_ptr<const GTFS::RealTimeSnapshot> snapshot = GTFS::RealTimeGateway::inst().activeSnapshot();
+    context.feedGeneration = snapshot->generation;
+    context.realTimeProc   = snapshot->feed;
+    context.vehicles       = snapshot->vehicles;
+    context.alerts         = snapshot->alerts;
+
+    // The calendar is checked as the trips of the stop(s) are loaded
+    context.serviceDays = nullptr;
+
+    // Override the service date if in the fixed debugging date mode
+    const Status *status = GTFS::DataGateway::inst().getStatus();
+    context.agencyTime  = agencyTime;
+    context.serviceDate = QDate::currentDate();
+    if (!status->getOverrideDateTime().isNull()) {
+        context.serviceDate = status->getOverrideDateTime().date();
+    }
+}
+
+void UpcomingStopService::fillTripData(const StopRecoTripRec &rts, QJsonObject &stopTripItem, bool format12h, QString shortName,
+                                       const UpcomingStopContext *context)
 {
     GTFS::TripRecStat tripStat = rts.tripStatus;
 
@@ -278,6 +325,41 @@ void UpcomingStopService::fillTripData(const StopRecoTripRec &rts, QJsonObject &
 
         stopTripItem["realtime_data"] = realTimeData;
     }
+
+    if (context == nullptr) {
+        return;
+    }
+
+    // Where the vehicle operating the trip currently is (only when the vehicle positions feed knows about the trip)
+    const rtVehiclePosition *vehicle = (context->vehicles != nullptr) ? context->vehicles->vehicleForTrip(rts.tripID)
+                                                                      : nullptr;
+    if (vehicle != nullptr) {
+        QJsonObject vehiclePosition;
+        vehiclePosition["vehicle_id"]      = vehicle->vehicleID;
+        vehiclePosition["current_stop_id"] = vehicle->stopID;
+        vehiclePosition["current_status"]  = vehicle->status;
+        if (vehicle->hasPosition) {
+            vehiclePosition["latitude"]  = vehicle->latitude;
+            vehiclePosition["longitude"] = vehicle->longitude;
+        } else {
+            vehiclePosition["latitude"]  = "-";
+            vehiclePosition["longitude"] = "-";
+        }
+        stopTripItem["vehicle_position"] = vehiclePosition;
+    }
+
+    // Alerts affecting the trip at the stop (their text is retrieved with ALR)
+    if (context->alerts != nullptr) {
+        QVector<QString> alertIDs;
+        context->alerts->alertsFor(rts.routeID, rts.stopID, rts.tripID, context->agencyTime, alertIDs);
+        if (!alertIDs.isEmpty()) {
+            QJsonArray alertArray;
+            for (const QString &alertID : alertIDs) {
+                alertArray.push_back(alertID);
+            }
+            stopTripItem["alert_ids"] = alertArray;
+        }
+    }
 }
 
 }  // Namespace GTFS
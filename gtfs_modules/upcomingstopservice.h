@@ -29,11 +29,27 @@
 #include "gtfsroute.h"
 #include "operatingday.h"
 #include "tripstopreconciler.h"
+#include "gtfsrealtimevehicles.h"
+#include "gtfsrealtimealerts.h"
 
 #include <QList>
 
 namespace GTFS {
 
+/*
+ * State shared by every board (the upcoming service of a stop or group of stops) computed within a request. None of it
+ * depends on the stops requested, so requests producing many boards (see UpcomingStopBatch) only compute it once.
+ */
+typedef struct {
+    QDateTime                 agencyTime;      // Agency time at which the request is processed
+    QDate                     serviceDate;     // Service date of the request ("today")
+    RealTimeFeedPin           realTimeProc;    // Active real-time feed, pinned for the request (nullptr if none)
+    quint64                   feedGeneration;  // Generation of the active real-time feed (see UpcomingStopCache)
+    RealTimeVehiclesPin       vehicles;        // Active vehicle positions, pinned for the request (nullptr if none)
+    RealTimeAlertsPin         alerts;          // Active service alerts, pinned for the request (nullptr if none)
+    const ServiceDaySnapshot *serviceDays;     // Services running around the service date (nullptr: use the calendar)
+} UpcomingStopContext;
+
 /*
  * GTFS::UpcomingStopService
  * This was really the initial intent of the GtfsProc - a way to avoid the API call limitations that transit agencies
@@ -81,25 +97,34 @@ public:
     void fillResponseData(QJsonObject &resp);
 
     // Utility Functions
-    static void fillTripData(const GTFS::StopRecoTripRec &rts, QJsonObject &stopTripItem, bool format12h, QString shortName);
+    // (the position of the vehicle operating the trip and the alerts affecting it are added when a context is given)
+    static void fillTripData(const GTFS::StopRecoTripRec &rts, QJsonObject &stopTripItem, bool format12h, QString shortName,
+                             const UpcomingStopContext *context = nullptr);
+
+    // Fill the stop information and upcoming trips ("routes" or "trips") of a single board into board, that is the
+    // NEX/NCF response without the protocol, static dataset and real-time age fields. Returns the error code (0, or
+    // 601 if a stop ID does not exist, in which case board is left untouched).
+    static qint64 fillBoard(const UpcomingStopContext &context,
+                            QList<QString>             stopIDs,
+                            qint32                     futureMinutes,
+                            bool                       nexCombFormat,
+                            bool                       realtimeOnly,
+                            QJsonObject               &board);
+
+    // Fill the static dataset modification time and the age of the real-time data used
+    static void fillDataAges(const UpcomingStopContext &context, QJsonObject &resp);
+
+    // Fill the context of boards computed at agencyTime against the active real-time feed (the calendar is checked as
+    // the trips are loaded). This does not count as a real-time transaction for the RealTimeGateway.
+    static void initContext(const QDateTime &agencyTime, UpcomingStopContext &context);
 
 private:
     QList<QString> _stopIDs;
-    QDate          _serviceDate;
     qint32         _futureMinutes;
     bool           _combinedFormat;
     bool           _realtimeOnly;
 
-    const Status         *_status;
-    const OperatingDay   *_service;
-    const StopData       *_stops;
-    const ParentStopData *_parentSta;
-    const RouteData      *_routes;
-    const TripData       *_tripDB;
-    const StopTimeData   *_stopTimes;
-
-    bool _rtData;
-    const GTFS::RealTimeTripUpdate *_realTimeProc;
+    UpcomingStopContext _context;
 };
 
 }  // Namespace GTFS
@@ -0,0 +1,87 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2024, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "upcomingstopsubscriber.h"
+#include "upcomingstopsubscriptions.h"
+
+namespace GTFS {
+
+UpcomingStopSubscriber::UpcomingStopSubscriber(quint64         clientID,
+                                               QList<QString>  stopIDs,
+                                               qint32          futureMinutes)
+    : StaticStatus   (),
+      _clientID      (clientID),
+      _cancellation  (false),
+      _stopIDs       (stopIDs),
+      _futureMinutes (futureMinutes),
+      _subscriptionID(0)
+{
+    RealTimeGateway::inst().realTimeTransactionHandled();
+    UpcomingStopService::initContext(getAgencyTime(), _context);
+}
+
+UpcomingStopSubscriber::UpcomingStopSubscriber(quint64 clientID, quint64 subscriptionID)
+    : StaticStatus   (),
+      _clientID      (clientID),
+      _cancellation  (true),
+      _futureMinutes (0),
+      _subscriptionID(subscriptionID)
+{
+}
+
+void UpcomingStopSubscriber::fillResponseData(QJsonObject &resp)
+{
+    if (_cancellation) {
+        resp["subscription_id"] = static_cast<qint64>(_subscriptionID);
+        if (!UpcomingStopSubscriptions::inst().unsubscribe(_clientID, _subscriptionID)) {
+            fillProtocolFields("UNS", 1001, resp);
+            return;
+        }
+        fillProtocolFields("UNS", 0, resp);
+        return;
+    }
+
+    // Nobody to push the changes to
+    if (_clientID == 0) {
+        fillProtocolFields("SUB", 1002, resp);
+        return;
+    }
+
+    // The initial board is rendered exactly like NCF, which is also how the subscription's pushes list their trips
+    qint64 errorID = UpcomingStopService::fillBoard(_context, _stopIDs, _futureMinutes, true, false, resp);
+    if (errorID != 0) {
+        fillProtocolFields("SUB", errorID, resp);
+        return;
+    }
+
+    // The client may have disconnected while its board was computed
+    _subscriptionID = UpcomingStopSubscriptions::inst().subscribe(_clientID, _stopIDs, _futureMinutes,
+                                                                  _context.agencyTime, resp);
+    if (_subscriptionID == 0) {
+        fillProtocolFields("SUB", 1002, resp);
+        return;
+    }
+    resp["subscription_id"] = static_cast<qint64>(_subscriptionID);
+
+    UpcomingStopService::fillDataAges(_context, resp);
+    fillProtocolFields("SUB", 0, resp);
+}
+
+}  // Namespace GTFS
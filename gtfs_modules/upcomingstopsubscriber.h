@@ -0,0 +1,77 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2024, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef UPCOMINGSTOPSUBSCRIBER_H
+#define UPCOMINGSTOPSUBSCRIBER_H
+
+#include "staticstatus.h"
+#include "upcomingstopservice.h"
+
+#include <QList>
+
+namespace GTFS {
+
+/*
+ * GTFS::UpcomingStopSubscriber handles the requests of a client managing its subscriptions to departure boards:
+ *  - SUB returns the board of the stop ID(s) requested (rendered like NCF) and subscribes the client to its changes,
+ *    which are then pushed to it by the UpcomingStopSubscriptions on every real-time data refresh and minute boundary
+ *  - UNS cancels one of the client's subscriptions (subscriptions also end when the client disconnects)
+ */
+class UpcomingStopSubscriber : public StaticStatus
+{
+public:
+    /*
+     * Subscription (SUB) constructor:
+     *
+     * clientID         - client subscribing (it receives the pushes), as registered to UpcomingStopSubscriptions
+     *
+     * stopIDs          - the stop ID(s) of the board: a single stop ID, a parent station, or several stop IDs
+     *
+     * futureMinutes    - number of minutes into the future that should be scanned for stop trip service (max of 4320)
+     */
+    UpcomingStopSubscriber(quint64         clientID,
+                           QList<QString>  stopIDs,
+                           qint32          futureMinutes);
+
+    /*
+     * Cancellation (UNS) constructor:
+     *
+     * clientID         - client which subscribed
+     *
+     * subscriptionID   - the subscription to cancel (as returned in the SUB response)
+     */
+    UpcomingStopSubscriber(quint64 clientID, quint64 subscriptionID);
+
+    /* See GtfsProc_Documentation.html for JSON response format */
+    void fillResponseData(QJsonObject &resp);
+
+private:
+    quint64         _clientID;
+    bool            _cancellation;
+    QList<QString>  _stopIDs;
+    qint32          _futureMinutes;
+    quint64         _subscriptionID;
+
+    UpcomingStopContext _context;
+};
+
+}  // Namespace GTFS
+
+#endif // UPCOMINGSTOPSUBSCRIBER_H
@@ -0,0 +1,288 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2024, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "upcomingstopsubscriptions.h"
+#include "upcomingstopbatch.h"
+#include "upcomingstopcache.h"
+#include "gtfsrealtimegateway.h"
+
+#include <QMap>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+namespace GTFS {
+
+UpcomingStopSubscriptions &UpcomingStopSubscriptions::inst()
+{
+    static UpcomingStopSubscriptions *_instance = nullptr;
+    if (_instance == nullptr) {
+        _instance = new UpcomingStopSubscriptions();
+    }
+    return *_instance;
+}
+
+void UpcomingStopSubscriptions::startRefreshing()
+{
+    // New real-time data can change any board
+    connect(&RealTimeGateway::inst(), &RealTimeGateway::feedActivated,
+            this, &UpcomingStopSubscriptions::refreshBoards, Qt::QueuedConnection);
+
+    // ... and so does the clock, as trips come and go from the lookahead window
+    _minuteTimer = new QTimer(this);
+    _minuteTimer->setSingleShot(true);
+    connect(_minuteTimer, &QTimer::timeout, this, &UpcomingStopSubscriptions::minuteElapsed);
+    minuteElapsed();
+}
+
+quint64 UpcomingStopSubscriptions::registerClient(QObject *client)
+{
+    _lock_subscriptions.lock();
+    quint64 clientID = _nextClientID++;
+    _clients.insert(clientID, client);
+    _lock_subscriptions.unlock();
+
+    return clientID;
+}
+
+void UpcomingStopSubscriptions::unregisterClient(quint64 clientID)
+{
+    _lock_subscriptions.lock();
+    if (_clients.remove(clientID) > 0) {
+        QList<quint64> clientSubscriptions;
+        for (QHash<quint64, BoardSubscription>::const_iterator subscription = _subscriptions.constBegin();
+             subscription != _subscriptions.constEnd();
+             ++subscription) {
+            if (subscription.value().clientID == clientID) {
+                clientSubscriptions.append(subscription.key());
+            }
+        }
+        for (quint64 subscriptionID : qAsConst(clientSubscriptions)) {
+            removeSubscription(subscriptionID);
+        }
+    }
+    _lock_subscriptions.unlock();
+}
+
+quint64 UpcomingStopSubscriptions::subscribe(quint64               clientID,
+                                             const QList<QString> &stopIDs,
+                                             qint32                futureMinutes,
+                                             const QDateTime      &agencyTime,
+                                             const QJsonObject    &board)
+{
+    QString boardKey = UpcomingStopCache::makeKey("SUB", stopIDs, futureMinutes);
+
+    _lock_subscriptions.lock();
+    if (!_clients.contains(clientID)) {
+        _lock_subscriptions.unlock();
+        return 0;
+    }
+    quint64 subscriptionID = _nextSubscriptionID++;
+
+    BoardSubscription subscription;
+    subscription.clientID = clientID;
+    subscription.boardKey = boardKey;
+    _subscriptions[subscriptionID] = subscription;
+
+    // The first subscriber of a board provides what was last sent out, later ones just join the existing board
+    QHash<QString, SubscribedBoard>::iterator subscribed = _boards.find(boardKey);
+    if (subscribed == _boards.end()) {
+        SubscribedBoard newBoard;
+        newBoard.stopIDs       = stopIDs;
+        newBoard.futureMinutes = futureMinutes;
+        fillComparableTrips(board, agencyTime, newBoard.pushedTrips);
+        subscribed = _boards.insert(boardKey, newBoard);
+    }
+    subscribed.value().subscriptions.insert(subscriptionID);
+    _lock_subscriptions.unlock();
+
+    return subscriptionID;
+}
+
+bool UpcomingStopSubscriptions::unsubscribe(quint64 clientID, quint64 subscriptionID)
+{
+    bool removed = false;
+
+    _lock_subscriptions.lock();
+    QHash<quint64, BoardSubscription>::const_iterator subscription = _subscriptions.constFind(subscriptionID);
+    if (subscription != _subscriptions.constEnd() && subscription.value().clientID == clientID) {
+        removeSubscription(subscriptionID);
+        removed = true;
+    }
+    _lock_subscriptions.unlock();
+
+    return removed;
+}
+
+void UpcomingStopSubscriptions::refreshBoards()
+{
+    // Gather the boards to compute, grouped by lookahead (each group is computed as a single NCB batch)
+    QMap<qint32, QList<QString>>        boardKeys;
+    QMap<qint32, QList<QList<QString>>> stopGroups;
+
+    _lock_subscriptions.lock();
+    for (QHash<QString, SubscribedBoard>::const_iterator board = _boards.constBegin();
+         board != _boards.constEnd();
+         ++board) {
+        boardKeys[board.value().futureMinutes].append(board.key());
+        stopGroups[board.value().futureMinutes].append(board.value().stopIDs);
+    }
+    _lock_subscriptions.unlock();
+
+    for (qint32 futureMinutes : stopGroups.keys()) {
+        // The boards are computed without holding the lock: subscriptions may come and go in the meantime
+        UpcomingStopBatch NCB(stopGroups[futureMinutes], futureMinutes, true);
+        QJsonObject batchResp;
+        NCB.fillResponseData(batchResp);
+
+        const QJsonArray      boards = batchResp["boards"].toArray();
+        const QList<QString> &keys   = boardKeys[futureMinutes];
+
+        _lock_subscriptions.lock();
+        for (qint32 boardIdx = 0; boardIdx < keys.size() && boardIdx < boards.size(); ++boardIdx) {
+            QHash<QString, SubscribedBoard>::iterator subscribed = _boards.find(keys.at(boardIdx));
+            const QJsonObject board = boards.at(boardIdx).toObject();
+            if (subscribed == _boards.end() || board["error"].toInt() != 0) {
+                continue;
+            }
+
+            QHash<QString, QJsonObject> currentTrips;
+            fillComparableTrips(board, NCB.getAgencyTime(), currentTrips);
+
+            // New and changed trips, in the order of the board
+            const QHash<QString, QJsonObject> &pushedTrips = subscribed.value().pushedTrips;
+            QJsonArray changedTrips;
+            for (const QJsonValue &trip : board["trips"].toArray()) {
+                QString key = tripKey(trip.toObject());
+                QHash<QString, QJsonObject>::const_iterator pushed = pushedTrips.constFind(key);
+                if (pushed == pushedTrips.constEnd() || pushed.value() != currentTrips[key]) {
+                    changedTrips.push_back(trip);
+                }
+            }
+
+            // Trips which are gone from the board (departed, out of the lookahead, ...)
+            QJsonArray removedTrips;
+            for (QHash<QString, QJsonObject>::const_iterator pushed = pushedTrips.constBegin();
+                 pushed != pushedTrips.constEnd();
+                 ++pushed) {
+                if (!currentTrips.contains(pushed.key())) {
+                    QJsonObject removedTrip;
+                    removedTrip["route_id"] = pushed.value()["route_id"];
+                    removedTrip["trip_id"]  = pushed.value()["trip_id"];
+                    removedTrip["stop_id"]  = pushed.value()["stop_id"];
+                    removedTrips.push_back(removedTrip);
+                }
+            }
+
+            subscribed.value().pushedTrips = currentTrips;
+            if (changedTrips.isEmpty() && removedTrips.isEmpty()) {
+                continue;
+            }
+
+            QJsonObject push;
+            push["message_type"]      = "SUP";
+            push["error"]             = 0;
+            push["message_time"]      = batchResp.value("message_time");
+            push["proc_time_ms"]      = batchResp.value("proc_time_ms");
+            push["static_data_modif"] = batchResp.value("static_data_modif");
+            if (batchResp.contains("realtime_age_sec")) {
+                push["realtime_age_sec"] = batchResp.value("realtime_age_sec");
+            }
+            push["stop_id"]       = board["stop_id"];
+            push["trips_changed"] = changedTrips;
+            push["trips_removed"] = removedTrips;
+
+            /*
+             * Hand the push to the connections (on their own thread) just like the response to a request. This is done
+             * while holding the lock: a subscription cancelled (or a client unregistered, which may be destroyed right
+             * after) is never pushed to, and the queued call is posted before the client can go away.
+             */
+            for (quint64 subscriptionID : qAsConst(subscribed.value().subscriptions)) {
+                QObject *client = _clients.value(_subscriptions[subscriptionID].clientID, nullptr);
+                if (client == nullptr) {
+                    continue;
+                }
+                push["subscription_id"] = static_cast<qint64>(subscriptionID);
+                QJsonDocument jdoc(push);
+                QMetaObject::invokeMethod(client, "taskResult", Qt::QueuedConnection,
+                                          Q_ARG(QString, QString(jdoc.toJson(QJsonDocument::Compact) + "\n")));
+            }
+        }
+        _lock_subscriptions.unlock();
+    }
+}
+
+void UpcomingStopSubscriptions::minuteElapsed()
+{
+    refreshBoards();
+
+    // Aim slightly past the boundary so that the refresh does not run just before it
+    qint64 msecsToBoundary = 60000 - (QDateTime::currentMSecsSinceEpoch() % 60000);
+    _minuteTimer->start(msecsToBoundary + 50);
+}
+
+UpcomingStopSubscriptions::UpcomingStopSubscriptions(QObject *parent)
+    : QObject(parent),
+      _nextSubscriptionID(1),
+      _nextClientID(1),
+      _minuteTimer(nullptr)
+{
+}
+
+UpcomingStopSubscriptions::~UpcomingStopSubscriptions()
+{
+}
+
+QString UpcomingStopSubscriptions::tripKey(const QJsonObject &trip)
+{
+    return trip["route_id"].toString() + "|" + trip["trip_id"].toString() + "|" + trip["stop_id"].toString();
+}
+
+QJsonObject UpcomingStopSubscriptions::comparableTrip(const QJsonObject &trip, const QDateTime &agencyTime)
+{
+    QJsonObject comparable = trip;
+    comparable.remove("wait_time_sec");
+    comparable["due_time"] = agencyTime.toSecsSinceEpoch() + trip["wait_time_sec"].toInteger();
+    return comparable;
+}
+
+void UpcomingStopSubscriptions::fillComparableTrips(const QJsonObject           &board,
+                                                    const QDateTime             &agencyTime,
+                                                    QHash<QString, QJsonObject> &comparableTrips)
+{
+    for (const QJsonValue &trip : board["trips"].toArray()) {
+        comparableTrips[tripKey(trip.toObject())] = comparableTrip(trip.toObject(), agencyTime);
+    }
+}
+
+void UpcomingStopSubscriptions::removeSubscription(quint64 subscriptionID)
+{
+    QString boardKey = _subscriptions[subscriptionID].boardKey;
+    _subscriptions.remove(subscriptionID);
+
+    QHash<QString, SubscribedBoard>::iterator subscribed = _boards.find(boardKey);
+    if (subscribed != _boards.end()) {
+        subscribed.value().subscriptions.remove(subscriptionID);
+        if (subscribed.value().subscriptions.isEmpty()) {
+            _boards.erase(subscribed);
+        }
+    }
+}
+
+} // Namespace GTFS
@@ -0,0 +1,133 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2024, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef UPCOMINGSTOPSUBSCRIPTIONS_H
+#define UPCOMINGSTOPSUBSCRIPTIONS_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QTimer>
+#include <QDateTime>
+#include <QJsonObject>
+
+namespace GTFS {
+
+// A board at least one client subscribed to, along with the trips last sent out to its subscribers
+typedef struct {
+    QList<QString>              stopIDs;
+    qint32                      futureMinutes;
+    QHash<QString, QJsonObject> pushedTrips;    // Trips of the board as last sent out (see comparableTrip)
+    QSet<quint64>               subscriptions;  // IDs of the subscriptions to the board
+} SubscribedBoard;
+
+// The subscription of a single client to a board
+typedef struct {
+    quint64 clientID;  // Client which subscribed (see registerClient)
+    QString boardKey;  // Board subscribed to
+} BoardSubscription;
+
+/*
+ * GTFS::UpcomingStopSubscriptions is a singleton keeping track of the departure boards clients subscribed to (SUB)
+ * so that they do not have to poll NEX/NCF on a timer.
+ *
+ * Whenever the RealTimeGateway activates a new feed, or a minute boundary passes, every board subscribed to is
+ * recomputed once (no matter how many clients subscribed to it, boards with the same lookahead are computed together
+ * as an NCB batch) and only the trips which changed since the previous push are sent to the subscribers. A trip has
+ * changed when any of its fields did, except for the wait time which changes with the clock: the time at which the
+ * trip is due (agency time + wait_time_sec) is compared instead. Pushes are delivered to the subscribers exactly like
+ * the response to a request (a single JSON line), see "SUP" in GtfsProc_Documentation.html.
+ */
+class UpcomingStopSubscriptions : public QObject
+{
+    Q_OBJECT
+public:
+    // Singleton Operations
+    static UpcomingStopSubscriptions &inst();
+
+    // Start refreshing the boards subscribed to. This must be called from a thread running an event loop (the server's
+    // main thread) as the refreshes are triggered by the real-time gateway's signals and by a timer.
+    void startRefreshing();
+
+    /*
+     * Register the connection of a client (pushes go to its taskResult(QString) slot), returning the ID by which the
+     * requests of the client refer to it. This must be called from the thread the client lives on, and the client
+     * must be unregistered before it is destroyed: pushes are only ever delivered to the clients still registered.
+     */
+    quint64 registerClient(QObject *client);
+
+    // Cancel all the subscriptions of a client and forget about it (when it disconnects), nothing is pushed to it after
+    // this returns. Unregistering a client which is not registered (anymore) does nothing.
+    void unregisterClient(quint64 clientID);
+
+    // Subscribe a client to the board of the stop IDs (rendered like NCF), board being its contents computed at
+    // agencyTime (as returned to the client in the SUB response). Returns the ID of the new subscription (0 if the
+    // client is not registered, it has disconnected already).
+    quint64 subscribe(quint64                clientID,
+                      const QList<QString>  &stopIDs,
+                      qint32                 futureMinutes,
+                      const QDateTime       &agencyTime,
+                      const QJsonObject     &board);
+
+    // Cancel a subscription of the client, returns false if the client holds no such subscription
+    bool unsubscribe(quint64 clientID, quint64 subscriptionID);
+
+public slots:
+    // Recompute every board subscribed to and push the changed trips to the subscribers
+    void refreshBoards();
+
+private slots:
+    // A minute boundary passed: refresh the boards, then wait for the next one
+    void minuteElapsed();
+
+private:
+    // Singleton Pattern Requirements
+    explicit UpcomingStopSubscriptions(QObject *parent = nullptr);
+    explicit UpcomingStopSubscriptions(const UpcomingStopSubscriptions &);
+    UpcomingStopSubscriptions &operator =(UpcomingStopSubscriptions const &other);
+    virtual ~UpcomingStopSubscriptions();
+
+    // Identify a trip of a board (a trip may serve several of the stops requested)
+    static QString tripKey(const QJsonObject &trip);
+
+    // The trip as compared between two computations of a board: the wait time is replaced by the time it is due
+    static QJsonObject comparableTrip(const QJsonObject &trip, const QDateTime &agencyTime);
+
+    // Comparable trips of a board (from its "trips" array) computed at agencyTime
+    static void fillComparableTrips(const QJsonObject           &board,
+                                    const QDateTime             &agencyTime,
+                                    QHash<QString, QJsonObject> &comparableTrips);
+
+    // Remove a subscription (call with _lock_subscriptions held), the board goes away with its last subscriber
+    void removeSubscription(quint64 subscriptionID);
+
+    QMutex                            _lock_subscriptions;  // Guards everything below
+    QHash<QString, SubscribedBoard>   _boards;              // Boards subscribed to (same keys as UpcomingStopCache)
+    QHash<quint64, BoardSubscription> _subscriptions;       // Subscriptions by ID
+    quint64                           _nextSubscriptionID;  // ID given to the next subscription
+    QHash<quint64, QObject *>         _clients;             // Connections of the clients registered, by ID
+    quint64                           _nextClientID;        // ID given to the next client registered
+    QTimer                           *_minuteTimer;         // Fires at the next minute boundary
+};
+
+} // Namespace GTFS
+
+#endif // UPCOMINGSTOPSUBSCRIPTIONS_H
@@ -0,0 +1,131 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "vehiclepositions.h"
+
+#include "datagateway.h"
+
+#include <QJsonArray>
+
+#include <algorithm>
+
+namespace GTFS {
+
+VehiclePositions::VehiclePositions(QList<QString> routeIDs)
+    : StaticStatus(),
+      _byRoute(true),
+      _routeIDs(routeIDs),
+      _lat1(0), _lon1(0), _lat2(0), _lon2(0)
+{
+    initVehicles();
+}
+
+VehiclePositions::VehiclePositions(double lat1, double lon1, double lat2, double lon2)
+    : StaticStatus(),
+      _byRoute(false),
+      _lat1(lat1), _lon1(lon1), _lat2(lat2), _lon2(lon2)
+{
+    initVehicles();
+}
+
+void VehiclePositions::initVehicles()
+{
+    // Notify real-time processor that real-time data is (still) being used
+    RealTimeGateway::inst().realTimeTransactionHandled();
+    _vehicles = RealTimeGateway::inst().getActiveVehicles();
+
+    // GTFS Database Items
+    _routes = GTFS::DataGateway::inst().getRoutesDB();
+    _trips  = GTFS::DataGateway::inst().getTripsDB();
+}
+
+void VehiclePositions::fillResponseData(QJsonObject &resp)
+{
+    if (_vehicles == nullptr) {
+        // No vehicle positions loaded? This transaction is pointless
+        fillProtocolFields("VEH", 1101, resp);
+        return;
+    }
+
+    QVector<const rtVehiclePosition *> vehicles;
+    if (_byRoute) {
+        for (const QString &routeID : _routeIDs) {
+            if (!_routes->contains(routeID)) {
+                // Is the requested route ID even available?
+                fillProtocolFields("VEH", 1103, resp);
+                return;
+            }
+            _vehicles->vehiclesOnRoute(routeID, vehicles);
+        }
+    } else {
+        if (qAbs(_lat1) > 90 || qAbs(_lat2) > 90 || qAbs(_lon1) > 180 || qAbs(_lon2) > 180) {
+            fillProtocolFields("VEH", 1102, resp);
+            return;
+        }
+        _vehicles->vehiclesInBox(_lat1, _lon1, _lat2, _lon2, vehicles);
+    }
+
+    QDateTime feedTime = _vehicles->getFeedTime();
+    resp["realtime_age_sec"] = feedTime.isNull() ? QJsonValue("-") : QJsonValue(feedTime.secsTo(getAgencyTime()));
+
+    // Vehicles are listed in the same order whichever index found them
+    std::sort(vehicles.begin(), vehicles.end(), [](const rtVehiclePosition *a, const rtVehiclePosition *b) {
+        return a->vehicleID < b->vehicleID;
+    });
+
+    QJsonArray vehicleArray;
+    for (const rtVehiclePosition *vehicle : vehicles) {
+        QJsonObject vehicleEntry;
+        vehicleEntry["vehicle_id"]     = vehicle->vehicleID;
+        vehicleEntry["label"]          = vehicle->label;
+        vehicleEntry["trip_id"]        = vehicle->tripID;
+        vehicleEntry["route_id"]       = vehicle->routeID;
+        vehicleEntry["trip_headsign"]  = _trips->contains(vehicle->tripID) ? (*_trips)[vehicle->tripID].trip_headsign
+                                                                           : "";
+        vehicleEntry["stop_id"]        = vehicle->stopID;
+        vehicleEntry["stop_sequence"]  = vehicle->stopSequence;
+        vehicleEntry["current_status"] = vehicle->status;
+        if (vehicle->hasPosition) {
+            vehicleEntry["latitude"]  = vehicle->latitude;
+            vehicleEntry["longitude"] = vehicle->longitude;
+        } else {
+            vehicleEntry["latitude"]  = "-";
+            vehicleEntry["longitude"] = "-";
+        }
+        vehicleEntry["bearing"] = vehicle->bearing;
+        vehicleEntry["speed"]   = vehicle->speed;
+        if (vehicle->timestamp.isNull()) {
+            vehicleEntry["timestamp"] = "-";
+        } else if (getStatus()->format12h()) {
+            vehicleEntry["timestamp"] = vehicle->timestamp.toTimeZone(getAgencyTime().timeZone())
+                                                          .toString("dd-MMM-yyyy h:mm:ss a t");
+        } else {
+            vehicleEntry["timestamp"] = vehicle->timestamp.toTimeZone(getAgencyTime().timeZone())
+                                                          .toString("dd-MMM-yyyy hh:mm:ss t");
+        }
+        vehicleArray.push_back(vehicleEntry);
+    }
+    resp["vehicles"] = vehicleArray;
+
+    // fill standard protocol information
+    fillProtocolFields("VEH", 0, resp);
+}
+
+}  // Namespace GTFS
@@ -0,0 +1,82 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef VEHICLEPOSITIONS_H
+#define VEHICLEPOSITIONS_H
+
+#include "staticstatus.h"
+#include "gtfsroute.h"
+#include "gtfstrip.h"
+#include "gtfsrealtimegateway.h"
+
+namespace GTFS {
+
+/*
+ * GTFS::VehiclePositions
+ * Lists the vehicles of the real-time vehicle positions feed, either those on one or more routes or those positioned
+ * inside of a box of latitudes and longitudes. The vehicles are looked up in the indexes built when the feed was
+ * integrated (by route, and on a grid of positions), so the whole fleet is never scanned. Each vehicle gives its
+ * position, the trip it operates and its current stop.
+ *
+ * The following information is required:
+ *  - Routes
+ *  - Trips
+ *  - Realtime Vehicle Positions
+ */
+class VehiclePositions : public StaticStatus
+{
+public:
+    /*
+     * Constructor for the vehicles on routes
+     *
+     * routeIDs        - list of route IDs for which to list the vehicles
+     */
+    VehiclePositions(QList<QString> routeIDs);
+
+    /*
+     * Constructor for the vehicles inside of a box
+     *
+     * lat1, lon1      - one corner of the box
+     * lat2, lon2      - the opposite corner of the box
+     */
+    VehiclePositions(double lat1, double lon1, double lat2, double lon2);
+
+    /* See GtfsProc_Documentation.html for JSON response format */
+    void fillResponseData(QJsonObject &resp);
+
+private:
+    // Common part of the constructors
+    void initVehicles();
+
+    bool           _byRoute;
+    QList<QString> _routeIDs;
+    double         _lat1, _lon1, _lat2, _lon2;
+
+    // GTFS Datasets
+    const RouteData *_routes;
+    const TripData  *_trips;
+
+    // Real-Time Vehicle Positions Access
+    RealTimeVehiclesPin _vehicles;
+};
+
+}  // Namespace GTFS
+
+#endif // VEHICLEPOSITIONS_H
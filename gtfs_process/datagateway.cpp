@@ -43,6 +43,7 @@ void DataGateway::initStatus(const QString frozenLocalDateTime,
                              bool          use12hourTimes,
                              quint32       maxTripsNEX,
                              bool          hideTermTrips,
+                             qint32        delayBoundNEX,
                              quint32       rtDateMatchLev,
                              bool          loosenRealTimeStopSeq,
                              const QString zOptions)
@@ -52,6 +53,7 @@ void DataGateway::initStatus(const QString frozenLocalDateTime,
                                use12hourTimes,
                                maxTripsNEX,
                                hideTermTrips,
+                               delayBoundNEX,
                                rtDateMatchLev,
                                loosenRealTimeStopSeq,
                                zOptions,
@@ -170,6 +172,7 @@ const StopData       *DataGateway::getStopsDB()     {return &_stops->getStopDB()
 const ParentStopData *DataGateway::getParentsDB()   {return &_stops->getParentStationDB();}
 const OperatingDay   *DataGateway::getServiceDB()   {return _opDay;}
 void  DataGateway::setStatusLoadFinishTimeUTC()     {_status->setLoadFinishTimeUTC();}
+void  DataGateway::setStatusOverrideDateTime(const QDateTime &agencyTime) {_status->setOverrideDateTime(agencyTime);}
 
 qint64 DataGateway::incrementHandledRequests()
 {
@@ -51,6 +51,7 @@ public:
                     bool          use12hourTimes,
                     quint32       maxTripsNEX,
                     bool          hideTermTrips,
+                    qint32        delayBoundNEX,
                     quint32       rtDateMatchLev,
                     bool          loosenRealTimeStopSeq,
                     const QString zOptions);
@@ -76,6 +77,11 @@ public:
     //
     void setStatusLoadFinishTimeUTC();
 
+    //
+    // Move the frozen time of every transaction (real-time feed replays advance it along the recorded fetches)
+    //
+    void setStatusOverrideDateTime(const QDateTime &agencyTime);
+
     //
     // increment the number of transactions
     //
@@ -2,6 +2,9 @@
 #CONFIG += qxt
 #QXT += core
 
+# Stops of a request (like the children of a parent station) are reconciled in parallel
+QT += concurrent
+
 INCLUDEPATH += $$PWD
 
 DEPENDPATH += $$PWD
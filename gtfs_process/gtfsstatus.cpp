@@ -27,13 +27,19 @@
 #include <QVector>
 #include <QFileInfo>
 
+#include <limits>
+
 namespace GTFS {
 
+// Value of the frozen agency time when the actual current time is used
+static const qint64 kNoFrozenTime = std::numeric_limits<qint64>::min();
+
 Status::Status(const QString dataRootPath,
                const QString &frozenDateTime,
                bool           use12hClock,
                quint32        nbTripsPerRouteNEX,
                bool           hideTermTrips,
+               qint32         delayBoundNEX,
                quint32        rtDateMatchLev,
                bool           loosenRealTimeStopSeq,
                const QString  zOptions,
@@ -41,10 +47,13 @@ Status::Status(const QString dataRootPath,
     : QObject(parent),
       numberTripsPerRouteNEX(nbTripsPerRouteNEX),
       hideEndingTrips(hideTermTrips),
+      delayBoundSecNEX(delayBoundNEX),
       zOpts(zOptions),
       rtDateMatchLevel(rtDateMatchLev),
       rtLooseSeqMatch(loosenRealTimeStopSeq)
 {
+    this->frozenAgencyMSec.storeRelaxed(kNoFrozenTime);
+
     // We should pass the start time from the main server start?
     this->serverStartTimeUTC = QDateTime::currentDateTimeUtc();
     this->recordsLoaded = 0;
@@ -125,7 +134,6 @@ Status::Status(const QString dataRootPath,
 
     // Decode any date string from input in case the time of every transaction should always be the same. This might
     // be useful for debugging static data or a realtime feed that is giving any particular issue
-    frozenAgencyTime = QDateTime();
     if (!frozenDateTime.isNull()) {
         QStringList brokenDateParams = frozenDateTime.split(',');
         if (brokenDateParams.size() != 6) {
@@ -138,7 +146,8 @@ Status::Status(const QString dataRootPath,
         QTime frozenTime(brokenDateParams.at(3).toInt(),
                          brokenDateParams.at(4).toInt(),
                          brokenDateParams.at(5).toInt());
-        frozenAgencyTime = QDateTime(frozenDate, frozenTime, this->serverFeedTZ);
+        QDateTime frozenAgencyTime(frozenDate, frozenTime, this->serverFeedTZ);
+        this->frozenAgencyMSec.storeRelaxed(frozenAgencyTime.toMSecsSinceEpoch());
         qDebug() << Qt::endl << "TESTING/DEBUGGING/ANALYSIS MODE: All transaction will be processed as if it is "
                  << frozenAgencyTime << Qt::endl;
     }
@@ -197,9 +206,18 @@ const QTimeZone &Status::getAgencyTZ() const
     return this->serverFeedTZ;
 }
 
-const QDateTime &Status::getOverrideDateTime() const
+QDateTime Status::getOverrideDateTime() const
+{
+    qint64 frozenMSec = this->frozenAgencyMSec.loadAcquire();
+    if (frozenMSec == kNoFrozenTime) {
+        return QDateTime();
+    }
+    return QDateTime::fromMSecsSinceEpoch(frozenMSec, this->serverFeedTZ);
+}
+
+void Status::setOverrideDateTime(const QDateTime &agencyTime)
 {
-    return this->frozenAgencyTime;
+    this->frozenAgencyMSec.storeRelease(agencyTime.isNull() ? kNoFrozenTime : agencyTime.toMSecsSinceEpoch());
 }
 
 bool Status::format12h() const
@@ -217,6 +235,11 @@ bool Status::hideTerminatingTripsForNEXNCF() const
     return hideEndingTrips;
 }
 
+qint32 Status::getNexDelayBoundSec() const
+{
+    return delayBoundSecNEX;
+}
+
 QDateTime Status::getStaticDatasetModifiedTime() const
 {
     return staticDataRevision;
@@ -25,6 +25,7 @@
 #include <QDateTime>
 #include <QTimeZone>
 #include <QVector>
+#include <QAtomicInteger>
 
 namespace GTFS {
 
@@ -51,6 +52,7 @@ public:
                     bool           use12hClock,
                     quint32        numberTripsPerRouteNEX,
                     bool           hideEndingTrips,
+                    qint32         delayBoundSecNEX,
                     quint32        rtDateMatchLev,
                     bool           loosenRealTimeStopSeq,
                     const QString  zOptions,
@@ -85,7 +87,11 @@ public:
 
     // Return a null QDateTime if there is no override in place. A valid QDateTime indicates the actual current time
     // should not be used for the sake of showing upcoming trips
-    const QDateTime &getOverrideDateTime() const;
+    QDateTime getOverrideDateTime() const;
+
+    // Move the override to another date and time (a real-time feed replay advances it as the recorded feeds are
+    // replayed), safe to call while requests are processed
+    void setOverrideDateTime(const QDateTime &agencyTime);
 
     // Return true if 12-hour times with AM/PM indicators should be generated instead of the standard 24-hour times
     bool format12h() const;
@@ -96,6 +102,9 @@ public:
     // Returns true if terminating trips are expected to not show up in output of NEX/NCF responses
     bool hideTerminatingTripsForNEXNCF() const;
 
+    // Maximum deviation (seconds) real-time data may apply to a scheduled time for bounded NEX evaluation (0 = off)
+    qint32 getNexDelayBoundSec() const;
+
     // Returns the last-modified time from the agency.txt file in the static dataset
     QDateTime getStaticDatasetModifiedTime() const;
 
@@ -144,8 +153,8 @@ private:
     // 12- or 24-hour clock format
     bool use12h;
 
-    // A date and time to force the local time to for debugging purposes
-    QDateTime  frozenAgencyTime;
+    // A date and time to force the local time to for debugging purposes (ms since the epoch, or kNoFrozenTime)
+    QAtomicInteger<qint64> frozenAgencyMSec;
 
     // Number of trips to show per route in NEX responses
     quint32 numberTripsPerRouteNEX;
@@ -153,6 +162,9 @@ private:
     // Hide trips which terminate in NEX/NCF responses (like Google Maps does)
     bool hideEndingTrips;
 
+    // Bound on real-time deviation from the schedule, allows NEX to stop evaluating trips once the cap is reached
+    qint32 delayBoundSecNEX;
+
     // When was the static dataset last revised?
     QDateTime staticDataRevision;
 
@@ -162,6 +162,24 @@ bool OperatingDay::serviceRunning(QDate serviceDate, QString serviceName) const
     return false;
 }
 
+QSet<QString> OperatingDay::servicesRunning(const QDate &serviceDate) const
+{
+    QSet<QString> runningServices;
+    for (const QString &serviceName : this->calendarDb.keys()) {
+        if (serviceRunning(serviceDate, serviceName)) {
+            runningServices.insert(serviceName);
+        }
+    }
+
+    // Services which only exist as calendar dates (a calendar.txt entry was already resolved above)
+    for (const QString &serviceName : this->calendarDateDb.keys()) {
+        if (!this->calendarDb.contains(serviceName) && serviceRunning(serviceDate, serviceName)) {
+            runningServices.insert(serviceName);
+        }
+    }
+    return runningServices;
+}
+
 QString OperatingDay::serializeOpDays(const QString &serviceName) const
 {
     CalendarRec serviceCal = this->calendarDb[serviceName];
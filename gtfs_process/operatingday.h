@@ -26,6 +26,7 @@
 #include <QDate>
 #include <QVector>
 #include <QHash>
+#include <QSet>
 
 namespace GTFS {
 
@@ -71,6 +72,12 @@ public:
      */
     bool serviceRunning(QDate serviceDate, QString serviceName) const;
 
+    /*
+     * Returns every service (from both calendar.txt and calendar_dates.txt) running on the date specified, so that
+     * requests checking many trips against the same date can do so with a single lookup per trip.
+     */
+    QSet<QString> servicesRunning(const QDate &serviceDate) const;
+
     /*
      * Get a list of days (of the week) for which the serviceName is active
      */
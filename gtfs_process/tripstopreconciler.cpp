@@ -20,15 +20,25 @@
 
 #include "tripstopreconciler.h"
 
+#include <QtConcurrent>
+
 #include <algorithm>
+#include <queue>
 
 namespace GTFS {
 
+// The trips of all the routes serving a single stop of the request (see getTripsByRoute)
+typedef struct {
+    QString                          stopID;
+    QHash<QString, StopRecoRouteRec> stopTrips;
+} StopEvaluation;
+
 TripStopReconciler::TripStopReconciler(const QList<QString>     &stop_ids,
                                        bool                      realTimeProcess,
                                        QDate                     serviceDate,
                                        const QDateTime          &currAgencyTime,
                                        qint32                    futureMinutes,
+                                       quint32                   maxTripsPerRoute,
                                        const Status             *status,
                                        const OperatingDay       *services,
                                        const StopData           *stopDB,
@@ -36,10 +46,12 @@ TripStopReconciler::TripStopReconciler(const QList<QString>     &stop_ids,
                                        const TripData           *tripDB,
                                        const StopTimeData       *stopTimeDB,
                                        const RealTimeTripUpdate *activeFeed,
+                                       const ServiceDaySnapshot *serviceDays,
                                        QObject                  *parent)
     : QObject(parent), _realTimeMode(realTimeProcess), _svcDate(serviceDate), _stopIDs(stop_ids),
-      _lookaheadMins(futureMinutes), _agencyTime(currAgencyTime), sStatus(status), sService(services), sStops(stopDB),
-      sRoutes(routeDB), sTripDB(tripDB), sStopTimes(stopTimeDB), rActiveFeed(activeFeed)
+      _lookaheadMins(futureMinutes), _maxTripsPerRoute(maxTripsPerRoute), _agencyTime(currAgencyTime),
+      sStatus(status), sService(services), sStops(stopDB), sRoutes(routeDB), sTripDB(tripDB), sStopTimes(stopTimeDB),
+      sServiceDays(serviceDays), rActiveFeed(activeFeed)
 {
     // Set the current time and other time-based parameters
     // First we will get the 3 days' worth of trips so we can start narrowing them down based on additional critera
@@ -89,21 +101,76 @@ void TripStopReconciler::getTripsByRoute(QHash<QString, StopRecoRouteRec> &route
     // requested. Only the "relevant" trips will be stored in routeTrips for the JSON-building services to use.
     QHash<QString, StopRecoRouteRec> fullTrips;
 
-    // For every stop requested, find all relevant trips
+    // The bounded (top-K) evaluation only applies to requests with a trip cap. It keeps the most relevant trips of each
+    // route at each stop, which always include the most relevant trips of the route across all the stops requested.
+    // It cannot be used when real-time trips of all service days are matched (the best-matching service day of a trip
+    // is only known once all of them have been evaluated, see invalidateTrips).
+    bool boundedMode = _maxTripsPerRoute != 0 && sStatus->getNexDelayBoundSec() > 0 &&
+                       !(_realTimeMode && rActiveFeed->getDateEnforcement() == NO_MATCHING);
+
+    // Every stop requested is evaluated on its own, in parallel when there are several of them (the children of a
+    // parent station, for instance). The requesting thread takes part in the work so a busy pool cannot starve it.
+    QVector<StopEvaluation> stopEvaluations;
     for (const QString &stopID : qAsConst(_stopIDs)) {
+        StopEvaluation stopEvaluation;
+        stopEvaluation.stopID = stopID;
+        stopEvaluations.push_back(stopEvaluation);
+    }
+    auto evaluateStop = [this, boundedMode](StopEvaluation &stopEvaluation) {
+        addTripRecordsForStop(stopEvaluation.stopID, boundedMode, stopEvaluation.stopTrips);
+    };
+    if (stopEvaluations.size() > 1) {
+        QtConcurrent::blockingMap(stopEvaluations, evaluateStop);
+    } else if (stopEvaluations.size() == 1) {
+        evaluateStop(stopEvaluations.first());
+    }
 
+    // Merge the trips of all stops (in the order the stops were requested)
+    for (const StopEvaluation &stopEvaluation : qAsConst(stopEvaluations)) {
+        for (const QString &routeID : (*sStops)[stopEvaluation.stopID].stopTripsRoutes.keys()) {
+            StopRecoRouteRec &routeRecord = routeTrips[routeID];
+            routeRecord.longRouteName  = (*sRoutes)[routeID].route_long_name;
+            routeRecord.shortRouteName = (*sRoutes)[routeID].route_short_name;
+            routeRecord.routeColor     = (*sRoutes)[routeID].route_color;
+            routeRecord.routeTextColor = (*sRoutes)[routeID].route_text_color;
+        }
+        QHash<QString, StopRecoRouteRec>::const_iterator stopRoute;
+        for (stopRoute = stopEvaluation.stopTrips.constBegin(); stopRoute != stopEvaluation.stopTrips.constEnd();
+             ++stopRoute) {
+            fullTrips[stopRoute.key()].tripRecos.append(stopRoute.value().tripRecos);
+        }
+    }
+
+    // Invalidate trips which fall outside of the lookaheadTime
+    for (const QString &routeID : fullTrips.keys()) {
+        invalidateTrips(routeID, fullTrips, routeTrips);
+    }
+
+    // Now that all requested stops and routes have been filled, each trip must be sorted by arrival time or else any
+    // reordering based on available real-time data will not be accounted for
+    for (const QString &routeID : routeTrips.keys()) {
+        std::sort(routeTrips[routeID].tripRecos.begin(),
+                  routeTrips[routeID].tripRecos.end(),
+                  [](const StopRecoTripRec &rt1, const StopRecoTripRec &rt2) {
+            return rt1.waitTimeSec < rt2.waitTimeSec;
+        });
+    }
+}
+
+void TripStopReconciler::addTripRecordsForStop(const QString                    &stopID,
+                                               bool                              boundedMode,
+                                               QHash<QString, StopRecoRouteRec> &stopTrips) const
+{
     // Retrieve all the trips that could service the stop (from yesterday, today, and tomorrow service days)
     for (const QString &routeID : (*sStops)[stopID].stopTripsRoutes.keys()) {
-        StopRecoRouteRec &routeRecord = routeTrips[routeID];
-        routeRecord.longRouteName  = (*sRoutes)[routeID].route_long_name;
-        routeRecord.shortRouteName = (*sRoutes)[routeID].route_short_name;
-        routeRecord.routeColor     = (*sRoutes)[routeID].route_color;
-        routeRecord.routeTextColor = (*sRoutes)[routeID].route_text_color;
-
-        StopRecoRouteRec &fullRouteRecord = fullTrips[routeID];
-        addTripRecordsForServiceDay(routeID, _svcYesterday, stopID, fullRouteRecord);
-        addTripRecordsForServiceDay(routeID, _svcToday,     stopID, fullRouteRecord);
-        addTripRecordsForServiceDay(routeID, _svcTomorrow,  stopID, fullRouteRecord);
+        StopRecoRouteRec &fullRouteRecord = stopTrips[routeID];
+        if (boundedMode) {
+            addBoundedTripRecords(routeID, stopID, fullRouteRecord);
+        } else {
+            addTripRecordsForServiceDay(routeID, _svcYesterday, stopID, fullRouteRecord);
+            addTripRecordsForServiceDay(routeID, _svcToday,     stopID, fullRouteRecord);
+            addTripRecordsForServiceDay(routeID, _svcTomorrow,  stopID, fullRouteRecord);
+        }
     }
 
     /*
@@ -112,137 +179,16 @@ void TripStopReconciler::getTripsByRoute(QHash<QString, StopRecoRouteRec> &route
      * The presence of realtime information adds some complexity like added trips and new times / countdowns
      */
     if (_realTimeMode) {
-        // Mark any cancelled trips as such (tripStatus)
-        for (const QString &routeID : fullTrips.keys()) {
-            for (StopRecoTripRec &tripRecord : fullTrips[routeID].tripRecos) {
-                if (rActiveFeed->tripIsCancelled(tripRecord.tripID,
-                                                 tripRecord.tripServiceDate,
-                                                 tripRecord.tripFirstDeparture.date())) {
-                    tripRecord.tripStatus = CANCEL;
-                    tripRecord.realTimeDataAvail = true;
-                }
-            }
-        }
-
-        // Mark trips which will skip the stop instead of serve it
-        for (const QString &routeID : fullTrips.keys()) {
-            for (StopRecoTripRec &tripRecord : fullTrips[routeID].tripRecos) {
-                if (rActiveFeed->tripSkipsStop(stopID, tripRecord.tripID,
-                                               tripRecord.stopSequenceNum,
-                                               tripRecord.tripServiceDate,
-                                               tripRecord.tripFirstDeparture.date())) {
-                    tripRecord.tripStatus = SKIP;
-                    tripRecord.realTimeDataAvail = true;
+        // Mark cancelled trips and skipped stops, inject realtime information in scheduled trips (the bounded mode
+        // has already done this for the trips it retained)
+        if (!boundedMode) {
+            for (StopRecoRouteRec &routeRecord : stopTrips) {
+                for (StopRecoTripRec &tripRecord : routeRecord.tripRecos) {
+                    applyRealTimeData(stopID, tripRecord);
                 }
             }
         }
 
-        // Inject realtime information in scheduled trips (realTimeActual, realTimeOffsetSec, waitTimeSec, tripStatus)
-        for (const QString &routeID : fullTrips.keys()) {
-            for (StopRecoTripRec &tripRecord : fullTrips[routeID].tripRecos) {
-                QDate dateUsedByRT;
-
-                // Do not return undefined values for offset for canceled / skipping-stop trips
-                tripRecord.realTimeOffsetSec = 0;
-                if (rActiveFeed->scheduledTripIsRunning(tripRecord.tripID,
-                                                        tripRecord.tripServiceDate,
-                                                        tripRecord.tripFirstDeparture.date(),
-                                                        dateUsedByRT)) {
-                    // Scheduled trip arrival/departure converted to UTC for offset calculation standardization
-                    // TODO: this might be unnecessary, but for the sake of all the subsequent time maths, it makes
-                    //       more sense to leave the real-time library as "UTC-only" (for now at least)
-                    QDateTime schedArrUTC = tripRecord.schArrTime.toUTC();
-                    QDateTime schedDepUTC = tripRecord.schDepTime.toUTC();
-
-                    // Parameters filled by the "actual time" service (returned in UTC)
-                    QDateTime predictArrUTC = QDateTime();
-                    QDateTime predictDepUTC = QDateTime();
-                    if (tripRecord.tripStatus != SKIP && tripRecord.tripStatus != CANCEL) {
-                        // At this point, consider a trip as RUNNING (the status will be broken down further here
-                        tripRecord.tripStatus = RUNNING;
-
-                        if (rActiveFeed->scheduledTripAlreadyPassed(tripRecord.tripID, tripRecord.stopSequenceNum)) {
-                            // A scheduled trip with realtime data might have left the stop in question early so we
-                            // need to account for that and expunge the trip from displaying. This is not needed for
-                            // added trips (as there is nothing to compare them to). This will only be the case if
-                            // strict stop sequence matching is applied!
-                            tripRecord.tripStatus = IRRELEVANT;
-                            continue;
-                        }
-
-                        // It is possible that a trip only has partial real-time information, and this stop isn't
-                        // covered by it even though it is on the trip's static schedule and NOT explicitly skipped.
-                        rActiveFeed->tripStopActualTime(tripRecord.tripID,
-                                                        tripRecord.stopSequenceNum,
-                                                        tripRecord.stopID,
-                                                        _agencyTime.timeZone(),
-                                                        (*sStopTimes)[tripRecord.tripID],
-                                                        dateUsedByRT,
-                                                        predictArrUTC,
-                                                        predictDepUTC);
-
-                        // The logic to determine how many seconds to fill for the wait time and what level of real-time
-                        // versus schedule information available to compute lateness is actually rather complex.
-                        fillStopStatWaitTimeOffset(schedArrUTC,
-                                                   schedDepUTC,
-                                                   predictArrUTC,
-                                                   predictDepUTC,
-                                                   tripRecord.stopStatus,
-                                                   tripRecord.waitTimeSec,
-                                                   tripRecord.realTimeOffsetSec,
-                                                   tripRecord.realTimeArrival,
-                                                   tripRecord.realTimeDeparture);
-
-                        // Trip has an arrival time, so we can mark a trip as arriving withing 30 seconds
-                        if (!predictArrUTC.isNull()) {
-                            if (_agencyTime.secsTo(predictArrUTC) < 0)
-                                tripRecord.tripStatus = IRRELEVANT;
-                            else if (_agencyTime.secsTo(predictArrUTC) < 30)
-                                tripRecord.tripStatus = ARRIVE;
-                        }
-
-                        // Trip has already departed, still shows up in the feed and departed more than 30 seconds ago
-                        qint64 secondsUntilDeparture = _agencyTime.secsTo(predictDepUTC);
-                        if (!predictDepUTC.isNull() && secondsUntilDeparture <= 0) {
-                            if (secondsUntilDeparture > -30)
-                                tripRecord.tripStatus = DEPART;
-                            else
-                                tripRecord.tripStatus = IRRELEVANT;
-                        }
-
-                        // Trip is boarding (current time is between the drop-off and pickup - requires both times))
-                        if (!predictArrUTC.isNull() && !predictDepUTC.isNull()) {
-                            if (_agencyTime >= predictArrUTC && _agencyTime < predictDepUTC)
-                                tripRecord.tripStatus = BOARD;
-                        }
-
-                        // Vehicle id and real-time indicators for output to indicate it is actually available
-                        tripRecord.vehicleRealTime   = rActiveFeed->getOperatingVehicle(tripRecord.tripID);
-                        tripRecord.realTimeDataAvail = true;
-
-                        // Make a stop irrelevant if it has no arrival nor departure data and its schedule time is
-                        // purely in the past -- Could this be handled in invalidateTrips() better?
-                        if (predictArrUTC.isNull() && predictDepUTC.isNull()) {
-                            if (!tripRecord.schDepTime.isNull() && _agencyTime > tripRecord.schDepTime) {
-                                tripRecord.tripStatus = IRRELEVANT;
-                            } else if (tripRecord.schDepTime.isNull() && tripRecord.waitTimeSec < 0) {
-                                // Interpolated trip-stops should not be allowed to go negative (this can happen when
-                                // a trip has passed the stop and stop-sequence based matching is not done)
-                                tripRecord.tripStatus = IRRELEVANT;
-                            }
-                            if (!tripRecord.schArrTime.isNull() && _agencyTime > tripRecord.schArrTime) {
-                                tripRecord.tripStatus = IRRELEVANT;
-                            } else if (tripRecord.schArrTime.isNull() && tripRecord.waitTimeSec < 0) {
-                                // Interpolated trip-stops should not be allowed to go negative (this can happen when
-                                // a trip has passed the stop and stop-sequence based matching is not done)
-                                tripRecord.tripStatus = IRRELEVANT;
-                            }
-                        }
-                    } // End of processing an actual trip with real-time information (non-cancelled, non-stop-skip)
-                } // End of active (real-time) trip handling condition
-            } // End of loop on trips
-        } // End of loop on routes
-
         // Add the 'added' trips (mark with SUPPLEMENT)
         // We first fill a separate compatible data structure which will then merge into the vector of trip-records
         QHash<QString, QVector<QPair<QString, quint32>>> addedTrips;
@@ -301,53 +247,31 @@ void TripStopReconciler::getTripsByRoute(QHash<QString, StopRecoRouteRec> &route
                 // There is not really a schedule offset (since no schedule exists for added trips)
                 tripRecord.realTimeOffsetSec = 0;
 
-                // Trip has an arrival time, so we can mark a trip as arriving withing 30 seconds
-                if (!prArrTime.isNull()) {
-                    if (_agencyTime.secsTo(prArrTime) < 0)
-                        tripRecord.tripStatus = IRRELEVANT;
-                    else if (_agencyTime.secsTo(prArrTime) < 30)
-                        tripRecord.tripStatus = ARRIVE;
-                }
-
-                // Trip has already departed but still shows up in the feed (and within 30 seconds since leaving)
-                qint64 secondsUntilDeparture = _agencyTime.secsTo(prDepTime);
-                if (!prDepTime.isNull() && secondsUntilDeparture <=0) {
-                    if (secondsUntilDeparture > -30)
-                        tripRecord.tripStatus = DEPART;
-                    else
-                        tripRecord.tripStatus = IRRELEVANT;
-                }
-
-                // Trip is boarding (current time is between the drop-off and pickup - requires both times))
-                if (!prArrTime.isNull() && !prDepTime.isNull()) {
-                    if (_agencyTime >= prArrTime && _agencyTime < prDepTime)
-                        tripRecord.tripStatus = BOARD;
-                }
+                // Added trips are always running, so only their predictions drive the status
+                rtTripStopStatus rtStatus;
+                rtStatus.inFeed        = true;
+                rtStatus.supplemental  = true;
+                rtStatus.cancelled     = false;
+                rtStatus.skipsStop     = false;
+                rtStatus.running       = true;
+                rtStatus.alreadyPassed = false;
+                rtStatus.predArrUTC    = prArrTime;
+                rtStatus.predDepUTC    = prDepTime;
+                tripRecord.tripStatus = resolveTripStatus(tripRecord.tripStatus,
+                                                          rtStatus,
+                                                          _agencyTime,
+                                                          QDateTime(),
+                                                          QDateTime(),
+                                                          0);
 
                 // Dumb hack to figure out where the train is going (will not properly match the "headsign" field!)
                 const QString finalStopID = rActiveFeed->getFinalStopIdForAddedTrip(tripRecord.tripID);
                 tripRecord.headsign = (*sStops)[finalStopID].stop_name;
 
-                fullTrips[routeID].tripRecos.push_back(tripRecord);
+                stopTrips[routeID].tripRecos.push_back(tripRecord);
             }
         }
     }  // End of real-time data integration block
-    }  // End of loop on stop ID list
-
-    // Invalidate trips which fall outside of the lookaheadTime
-    for (const QString &routeID : fullTrips.keys()) {
-        invalidateTrips(routeID, fullTrips, routeTrips);
-    }
-
-    // Now that all requested stops and routes have been filled, each trip must be sorted by arrival time or else any
-    // reordering based on available real-time data will not be accounted for
-    for (const QString &routeID : routeTrips.keys()) {
-        std::sort(routeTrips[routeID].tripRecos.begin(),
-                  routeTrips[routeID].tripRecos.end(),
-                  [](const StopRecoTripRec &rt1, const StopRecoTripRec &rt2) {
-            return rt1.waitTimeSec < rt2.waitTimeSec;
-        });
-    }
 }
 
 void TripStopReconciler::addTripRecordsForServiceDay(const QString    &routeID,
@@ -358,142 +282,312 @@ void TripStopReconciler::addTripRecordsForServiceDay(const QString    &routeID,
     // Go through all the trips from the static feed and find all that hit this stop
     for (qint32 tripIdx = 0; tripIdx < (*sStops)[stopID].stopTripsRoutes[routeID].length(); ++tripIdx)
     {
-        // Offset into the individual stop-trip array (so the entire trip information can be found)
-        qint32        stopTripIdx  = (*sStops)[stopID].stopTripsRoutes[routeID].at(tripIdx).tripStopIndex;
-        const QString curTripId    = (*sStops)[stopID].stopTripsRoutes[routeID].at(tripIdx).tripID;
+        const QString curTripId = (*sStops)[stopID].stopTripsRoutes[routeID].at(tripIdx).tripID;
 
         // Ensure that the trip actually runs for this service day
-        if (! sService->serviceRunning(serviceDay, (*sTripDB)[curTripId].service_id))
+        if (! tripRunsOnServiceDay(serviceDay, curTripId))
             continue;
-        // Populate the trip-record with all the pertinent / necessary details
+
+        // Add the trip to the trips-for-route
         StopRecoTripRec tripRec;
-        tripRec.tripID          = curTripId;
-        tripRec.routeID         = routeID;
-        tripRec.stopID          = (*sStopTimes)[curTripId].at(stopTripIdx).stop_id;
-        tripRec.stopSequenceNum = (*sStopTimes)[curTripId].at(stopTripIdx).stop_sequence;
-        tripRec.beginningOfTrip = (stopTripIdx == 0) ? true : false;
-        tripRec.endOfTrip       = (stopTripIdx == (*sStopTimes)[curTripId].length() - 1) ? true : false;
-        tripRec.interp          = (*sStopTimes)[curTripId].at(stopTripIdx).interpolated;
-        tripRec.dropoffType     = (*sStopTimes)[curTripId].at(stopTripIdx).drop_off_type;
-        tripRec.pickupType      = (*sStopTimes)[curTripId].at(stopTripIdx).pickup_type;
-        tripRec.headsign        = ((*sStopTimes)[curTripId].at(stopTripIdx).stop_headsign != "")
-                                                            ? (*sStopTimes)[curTripId].at(stopTripIdx).stop_headsign
-                                                            : (*sTripDB)[curTripId].trip_headsign;
-        tripRec.stopTimesIndex  = stopTripIdx;
-        tripRec.tripServiceDate = serviceDay;
-        tripRec.waitTimeSec     = 0;
-
-        // The schedule times are always offset from the local noon (to handle DST fluctuations)
-        bool scheduleTimeAvail     = false;
-        QDateTime localNoon        = QDateTime(serviceDay, QTime(12, 0, 0), _agencyTime.timeZone());
-        if ((*sStopTimes)[curTripId].at(stopTripIdx).departure_time != StopTimes::kNoTime) {
-            tripRec.schDepTime  = localNoon.addSecs((*sStopTimes)[curTripId].at(stopTripIdx).departure_time);
-            tripRec.waitTimeSec = _agencyTime.secsTo(tripRec.schDepTime);
-            scheduleTimeAvail   = true;
-        } else {
-            tripRec.schDepTime  = QDateTime();
-        }
-        if ((*sStopTimes)[curTripId].at(stopTripIdx).arrival_time != StopTimes::kNoTime) {
-            tripRec.schArrTime  = localNoon.addSecs((*sStopTimes)[curTripId].at(stopTripIdx).arrival_time);
-            // NOTE: Prefer the arrival time for the wait-time calculations, so that's process arr. after dep.!
-            tripRec.waitTimeSec = _agencyTime.secsTo(tripRec.schArrTime);
-            scheduleTimeAvail   = true;
-        } else {
-            tripRec.schArrTime  = QDateTime();
-        }
+        fillTripRecord(routeID, serviceDay, stopID, tripIdx, tripRec);
+        routeRecord.tripRecos.push_back(tripRec);
+    }
+}
 
-        // Determine the actual date and time of the trip's first departure (needed when comparing actual dates
-        // for real-time date integration instead of the default stricter service-date-level comparison).
-        // Therefore it is assumed that the first stop MUST have a departure time for this to work.
-        tripRec.tripFirstDeparture = localNoon.addSecs((*sStopTimes)[curTripId].at(0).departure_time);
-
-        // There is neither a departure nor arrival time from which to countdown
-        // Some stops aren't timed at all, so the "next possible time" is used (called the sort time)
-        if ((*sStopTimes)[curTripId].at(stopTripIdx).arrival_time == StopTimes::kNoTime &&
-            (*sStopTimes)[curTripId].at(stopTripIdx).departure_time == StopTimes::kNoTime) {
-            QDateTime localNoon(tripRec.tripServiceDate, QTime(12, 0, 0), _agencyTime.timeZone());
-            tripRec.schSortTime = localNoon.addSecs((*sStops)[stopID].stopTripsRoutes[routeID].at(tripIdx).sortTime);
-            tripRec.waitTimeSec = _agencyTime.secsTo(tripRec.schSortTime);
-            scheduleTimeAvail   = false;
-        }
+void TripStopReconciler::fillTripRecord(const QString   &routeID,
+                                        const QDate     &serviceDay,
+                                        const QString   &stopID,
+                                        qint32           tripIdx,
+                                        StopRecoTripRec &tripRec) const
+{
+    // Offset into the individual stop-trip array (so the entire trip information can be found)
+    qint32        stopTripIdx  = (*sStops)[stopID].stopTripsRoutes[routeID].at(tripIdx).tripStopIndex;
+    const QString curTripId    = (*sStops)[stopID].stopTripsRoutes[routeID].at(tripIdx).tripID;
+
+    // Populate the trip-record with all the pertinent / necessary details
+    tripRec.tripID          = curTripId;
+    tripRec.routeID         = routeID;
+    tripRec.stopID          = (*sStopTimes)[curTripId].at(stopTripIdx).stop_id;
+    tripRec.stopSequenceNum = (*sStopTimes)[curTripId].at(stopTripIdx).stop_sequence;
+    tripRec.beginningOfTrip = (stopTripIdx == 0) ? true : false;
+    tripRec.endOfTrip       = (stopTripIdx == (*sStopTimes)[curTripId].length() - 1) ? true : false;
+    tripRec.interp          = (*sStopTimes)[curTripId].at(stopTripIdx).interpolated;
+    tripRec.dropoffType     = (*sStopTimes)[curTripId].at(stopTripIdx).drop_off_type;
+    tripRec.pickupType      = (*sStopTimes)[curTripId].at(stopTripIdx).pickup_type;
+    tripRec.headsign        = ((*sStopTimes)[curTripId].at(stopTripIdx).stop_headsign != "")
+                                                        ? (*sStopTimes)[curTripId].at(stopTripIdx).stop_headsign
+                                                        : (*sTripDB)[curTripId].trip_headsign;
+    tripRec.stopTimesIndex  = stopTripIdx;
+    tripRec.tripServiceDate = serviceDay;
+    tripRec.waitTimeSec     = 0;
+
+    // The schedule times are always offset from the local noon (to handle DST fluctuations)
+    bool scheduleTimeAvail     = false;
+    QDateTime localNoon        = QDateTime(serviceDay, QTime(12, 0, 0), _agencyTime.timeZone());
+    if ((*sStopTimes)[curTripId].at(stopTripIdx).departure_time != StopTimes::kNoTime) {
+        tripRec.schDepTime  = localNoon.addSecs((*sStopTimes)[curTripId].at(stopTripIdx).departure_time);
+        tripRec.waitTimeSec = _agencyTime.secsTo(tripRec.schDepTime);
+        scheduleTimeAvail   = true;
+    } else {
+        tripRec.schDepTime  = QDateTime();
+    }
+    if ((*sStopTimes)[curTripId].at(stopTripIdx).arrival_time != StopTimes::kNoTime) {
+        tripRec.schArrTime  = localNoon.addSecs((*sStopTimes)[curTripId].at(stopTripIdx).arrival_time);
+        // NOTE: Prefer the arrival time for the wait-time calculations, so that's process arr. after dep.!
+        tripRec.waitTimeSec = _agencyTime.secsTo(tripRec.schArrTime);
+        scheduleTimeAvail   = true;
+    } else {
+        tripRec.schArrTime  = QDateTime();
+    }
 
-        // Trip status will always start as "SCHEDULE" because all other values are based on real-time processing
-        tripRec.tripStatus = scheduleTimeAvail ? SCHEDULE : NOSCHEDULE;
+    // Determine the actual date and time of the trip's first departure (needed when comparing actual dates
+    // for real-time date integration instead of the default stricter service-date-level comparison).
+    // Therefore it is assumed that the first stop MUST have a departure time for this to work.
+    tripRec.tripFirstDeparture = localNoon.addSecs((*sStopTimes)[curTripId].at(0).departure_time);
+
+    // There is neither a departure nor arrival time from which to countdown
+    // Some stops aren't timed at all, so the "next possible time" is used (called the sort time)
+    if ((*sStopTimes)[curTripId].at(stopTripIdx).arrival_time == StopTimes::kNoTime &&
+        (*sStopTimes)[curTripId].at(stopTripIdx).departure_time == StopTimes::kNoTime) {
+        tripRec.schSortTime = localNoon.addSecs((*sStops)[stopID].stopTripsRoutes[routeID].at(tripIdx).sortTime);
+        tripRec.waitTimeSec = _agencyTime.secsTo(tripRec.schSortTime);
+        scheduleTimeAvail   = false;
+    }
 
-        // Also we won't start out with real-time availability from a static schedule stop-time
-        tripRec.realTimeDataAvail = false;
+    // Trip status will always start as "SCHEDULE" because all other values are based on real-time processing
+    tripRec.tripStatus = scheduleTimeAvail ? SCHEDULE : NOSCHEDULE;
 
-        // Add the trip to the trips-for-route
-        routeRecord.tripRecos.push_back(tripRec);
-    }
+    // Also we won't start out with real-time availability from a static schedule stop-time
+    tripRec.realTimeDataAvail = false;
 }
 
-void TripStopReconciler::invalidateTrips(const QString                    &routeID,
-                                         QHash<QString, StopRecoRouteRec> &fullTrips,
-                                         QHash<QString, StopRecoRouteRec> &relevantRouteTrips)
+void TripStopReconciler::addBoundedTripRecords(const QString    &routeID,
+                                               const QString    &stopID,
+                                               StopRecoRouteRec &routeRecord) const
 {
-    for (quint32 tripIdx = 0; tripIdx < fullTrips[routeID].tripRecos.length(); ++tripIdx) {
-        StopRecoTripRec &tripRecord = fullTrips[routeID].tripRecos[tripIdx];
-        QDateTime stopTime;
-        if (tripRecord.realTimeDataAvail && tripRecord.stopStatus != "SCHD") {
-            // Use real-time data for the lookahead determination unless the trip is running but no data is present...
-            if (!tripRecord.realTimeArrival.isNull()) {
-                stopTime = tripRecord.realTimeArrival;
-            } else if (!tripRecord.realTimeDeparture.isNull()) {
-                stopTime = tripRecord.realTimeDeparture;
+    /*
+     * Real-time data can move a trip by at most delayBound seconds (in either direction) from its scheduled time at the
+     * stop, so a trip scheduled more than delayBound seconds past the maxTripsPerRoute-th best wait time found so far
+     * can never be displayed. Trips are therefore walked in scheduled order across the three service days, and a
+     * max-heap keeps the wait times of the best trips which would be displayed. Trips which could never be displayed
+     * are not even built (scheduled too far in the past, or too far beyond the lookahead time).
+     */
+    typedef struct {
+        qint64 schedTime;    // Scheduled sort time at the stop (seconds since epoch)
+        QDate  serviceDay;   // Service day the trip belongs to
+        qint32 tripIdx;      // Index of the trip in the stopTripsRoutes of the stop / route
+    } BoundedCandidate;
+
+    const QVector<tripStopSeqInfo> &stopTrips = (*sStops)[stopID].stopTripsRoutes[routeID];
+    const qint64 delayBound  = sStatus->getNexDelayBoundSec();
+    const qint64 nowSec      = _agencyTime.toSecsSinceEpoch();
+    const qint64 pastCutoff  = nowSec - std::max(delayBound, static_cast<qint64>(120));  // CNCL/SKIP show for 2 mins
+    const qint64 aheadCutoff = _agencyTime.addSecs(_lookaheadMins * 60).toSecsSinceEpoch() + delayBound;
+    const bool   hideEnding  = sStatus->hideTerminatingTripsForNEXNCF();
+
+    // Gather the trips running on each service day (each day is already sorted by the sortTime from linking)
+    QVector<BoundedCandidate> candidates;
+    for (const QDate &serviceDay : {_svcYesterday, _svcToday, _svcTomorrow}) {
+        const qint64 localNoonSec = QDateTime(serviceDay, QTime(12, 0, 0), _agencyTime.timeZone()).toSecsSinceEpoch();
+        for (qint32 tripIdx = 0; tripIdx < stopTrips.length(); ++tripIdx) {
+            // A trip without any time at the stop cannot be bounded, so it is always evaluated first
+            qint64 schedTime = pastCutoff;
+            if (stopTrips.at(tripIdx).sortTime != StopTimes::kNoTime) {
+                schedTime = localNoonSec + stopTrips.at(tripIdx).sortTime;
+                if (schedTime < pastCutoff) {
+                    continue;
+                }
+                if (_lookaheadMins != 0 && schedTime > aheadCutoff) {
+                    break;
+                }
             }
-        } else {
-            // ... unless it is not available
-            if (!tripRecord.schArrTime.isNull()) {
-                stopTime = tripRecord.schArrTime;
-            } else if (!tripRecord.schDepTime.isNull()) {
-                stopTime = tripRecord.schDepTime;
+            if (! tripRunsOnServiceDay(serviceDay, stopTrips.at(tripIdx).tripID)) {
+                continue;
             }
+            candidates.push_back({schedTime, serviceDay, tripIdx});
         }
+    }
 
-        // Mark trips as invalid if they are outside the time window requested
-        if (_lookaheadMins != 0 &&
-            (((tripRecord.tripStatus == SCHEDULE || tripRecord.stopStatus == "SCHD")
-              && stopTime > _lookaheadTime) ||
-             (tripRecord.tripStatus == NOSCHEDULE && tripRecord.schSortTime > _lookaheadTime))) {
-            tripRecord.tripStatus = IRRELEVANT;
+    // Service days overlap (after-midnight trips of yesterday run alongside the early trips of today)
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const BoundedCandidate &c1, const BoundedCandidate &c2) {
+        return c1.schedTime < c2.schedTime;
+    });
+
+    std::priority_queue<qint64> bestWaitTimes;
+    for (const BoundedCandidate &candidate : qAsConst(candidates)) {
+        if (bestWaitTimes.size() == _maxTripsPerRoute &&
+            candidate.schedTime - delayBound - nowSec > bestWaitTimes.top()) {
+            break;
         }
+        bool untimed = stopTrips.at(candidate.tripIdx).sortTime == StopTimes::kNoTime;
 
-        // Mark the trip-stop as invalid if it occurred in the past
-        // There are two notions: scheduled and unscheduled times. Unscheduled times should NOT display a time
-        // but we allow a countdown (probably the client should warn that the data is missing). If realtime
-        // data were to be associated with these 'untimed' stops, then hopefully that would supplement it :) )
-        if ((tripRecord.tripStatus == SCHEDULE   && _agencyTime.secsTo(stopTime) < 0) ||
-            (tripRecord.tripStatus == NOSCHEDULE && _agencyTime > tripRecord.schSortTime)) {
-            tripRecord.tripStatus = IRRELEVANT;
+        StopRecoTripRec tripRecord;
+        fillTripRecord(routeID, candidate.serviceDay, stopID, candidate.tripIdx, tripRecord);
+        if (_realTimeMode) {
+            applyRealTimeData(stopID, tripRecord);
         }
 
-        // With realtime data available, the invalidation process needs to take extra parameters into consideration
-        else if (tripRecord.realTimeDataAvail) {
-            if (tripRecord.tripStatus == RUNNING || tripRecord.tripStatus == DEPART ||
-                tripRecord.tripStatus == BOARD   || tripRecord.tripStatus == ARRIVE) {
-                if (!tripRecord.realTimeArrival.isNull() &&
-                    ((_lookaheadMins != 0 && tripRecord.realTimeArrival > _lookaheadTime))) {
-                    tripRecord.tripStatus = IRRELEVANT;
-                } else if (!tripRecord.realTimeDeparture.isNull() &&
-                         ((_lookaheadMins != 0 && tripRecord.realTimeDeparture > _lookaheadTime))) {
-                    tripRecord.tripStatus = IRRELEVANT;
-                }
-            } else if (tripRecord.tripStatus == CANCEL || tripRecord.tripStatus == SKIP) {
-                // Excpetion for cancelled and stop-skip trips: show for 2 minutes past the scheduled time
-                if (!tripRecord.schArrTime.isNull()) {
-                    qint64 secUntilSchArr = _agencyTime.secsTo(tripRecord.schArrTime);
-                    if (secUntilSchArr < -120 || secUntilSchArr > _lookaheadMins * 60) {
-                        tripRecord.tripStatus = IRRELEVANT;
-                    }
-                } else if (!tripRecord.schDepTime.isNull()) {
-                    qint64 secUntilSchDep = _agencyTime.secsTo(tripRecord.schDepTime);
-                    if (secUntilSchDep < -120 || secUntilSchDep > _lookaheadMins * 60) {
-                        tripRecord.tripStatus = IRRELEVANT;
-                    }
-                }
+        // See if the trip would actually be displayed (invalidateTrips will run on the retained trips later on)
+        StopRecoTripRec probeRecord = tripRecord;
+        invalidateTripRecord(probeRecord);
+        if (probeRecord.tripStatus != IRRELEVANT && !(hideEnding && probeRecord.endOfTrip) && !untimed) {
+            bestWaitTimes.push(probeRecord.waitTimeSec);
+            if (bestWaitTimes.size() > _maxTripsPerRoute) {
+                bestWaitTimes.pop();
             }
         }
+
+        routeRecord.tripRecos.push_back(tripRecord);
+    }
+}
+
+bool TripStopReconciler::tripRunsOnServiceDay(const QDate &serviceDay, const QString &tripID) const
+{
+    const QString &serviceID = (*sTripDB)[tripID].service_id;
+    if (sServiceDays != nullptr) {
+        QHash<QDate, QSet<QString>>::const_iterator day = sServiceDays->runningServices.constFind(serviceDay);
+        if (day != sServiceDays->runningServices.constEnd()) {
+            return day.value().contains(serviceID);
+        }
+    }
+    return sService->serviceRunning(serviceDay, serviceID);
+}
+
+void TripStopReconciler::applyRealTimeData(const QString &stopID, StopRecoTripRec &tripRecord) const
+{
+    // Everything the feed knows about the trip at this stop comes from a single lookup
+    rtTripStopStatus rtStatus;
+    rActiveFeed->getTripStopStatus(tripRecord.tripID,
+                                   tripRecord.stopSequenceNum,
+                                   stopID,
+                                   _agencyTime.timeZone(),
+                                   (*sStopTimes)[tripRecord.tripID],
+                                   tripRecord.tripServiceDate,
+                                   tripRecord.tripFirstDeparture.date(),
+                                   rtStatus);
+
+    // Do not return undefined values for offset for canceled / skipping-stop trips
+    tripRecord.realTimeOffsetSec = 0;
+    if (rtStatus.cancelled || rtStatus.skipsStop) {
+        tripRecord.realTimeDataAvail = true;
+    }
+
+    // Inject realtime information in running trips which will still serve the stop (realTimeActual, realTimeOffsetSec,
+    // waitTimeSec). It is possible that a trip only has partial real-time information, and this stop isn't covered by
+    // it even though it is on the trip's static schedule and NOT explicitly skipped: the predictions are null then.
+    if (rtStatus.running && !rtStatus.cancelled && !rtStatus.skipsStop && !rtStatus.alreadyPassed) {
+        // Scheduled trip arrival/departure converted to UTC for offset calculation standardization
+        // TODO: this might be unnecessary, but for the sake of all the subsequent time maths, it makes
+        //       more sense to leave the real-time library as "UTC-only" (for now at least)
+        QDateTime schedArrUTC = tripRecord.schArrTime.toUTC();
+        QDateTime schedDepUTC = tripRecord.schDepTime.toUTC();
+
+        // The logic to determine how many seconds to fill for the wait time and what level of real-time
+        // versus schedule information available to compute lateness is actually rather complex.
+        fillStopStatWaitTimeOffset(schedArrUTC,
+                                   schedDepUTC,
+                                   rtStatus.predArrUTC,
+                                   rtStatus.predDepUTC,
+                                   tripRecord.stopStatus,
+                                   tripRecord.waitTimeSec,
+                                   tripRecord.realTimeOffsetSec,
+                                   tripRecord.realTimeArrival,
+                                   tripRecord.realTimeDeparture);
+
+        // Vehicle id and real-time indicators for output to indicate it is actually available
+        tripRecord.vehicleRealTime   = rtStatus.vehicle;
+        tripRecord.realTimeDataAvail = true;
+    }
+
+    tripRecord.tripStatus = resolveTripStatus(tripRecord.tripStatus,
+                                              rtStatus,
+                                              _agencyTime,
+                                              tripRecord.schArrTime,
+                                              tripRecord.schDepTime,
+                                              tripRecord.waitTimeSec);
+}
+
+TripRecStat TripStopReconciler::resolveTripStatus(TripRecStat             currentStatus,
+                                                  const rtTripStopStatus &rtStatus,
+                                                  const QDateTime        &agencyTime,
+                                                  const QDateTime        &schArrTime,
+                                                  const QDateTime        &schDepTime,
+                                                  qint64                  waitTimeSec)
+{
+    // Skipping the stop takes precedence over the cancellation of the trip, neither has predictions to integrate
+    if (rtStatus.skipsStop) {
+        return SKIP;
+    }
+    if (rtStatus.cancelled) {
+        return CANCEL;
+    }
+    if (!rtStatus.running) {
+        return currentStatus;
+    }
+
+    // A scheduled trip with realtime data might have left the stop in question early so we need to account for that
+    // and expunge the trip from displaying. This is not needed for added trips (as there is nothing to compare them
+    // to). This will only be the case if strict stop sequence matching is applied!
+    if (rtStatus.alreadyPassed) {
+        return IRRELEVANT;
+    }
+
+    // At this point, consider a trip as RUNNING (the status will be broken down further here)
+    TripRecStat tripStatus = RUNNING;
+
+    // Trip has an arrival time, so we can mark a trip as arriving withing 30 seconds
+    if (!rtStatus.predArrUTC.isNull()) {
+        if (agencyTime.secsTo(rtStatus.predArrUTC) < 0)
+            tripStatus = IRRELEVANT;
+        else if (agencyTime.secsTo(rtStatus.predArrUTC) < 30)
+            tripStatus = ARRIVE;
+    }
+
+    // Trip has already departed, still shows up in the feed and departed more than 30 seconds ago
+    qint64 secondsUntilDeparture = agencyTime.secsTo(rtStatus.predDepUTC);
+    if (!rtStatus.predDepUTC.isNull() && secondsUntilDeparture <= 0) {
+        if (secondsUntilDeparture > -30)
+            tripStatus = DEPART;
+        else
+            tripStatus = IRRELEVANT;
+    }
+
+    // Trip is boarding (current time is between the drop-off and pickup - requires both times))
+    if (!rtStatus.predArrUTC.isNull() && !rtStatus.predDepUTC.isNull()) {
+        if (agencyTime >= rtStatus.predArrUTC && agencyTime < rtStatus.predDepUTC)
+            tripStatus = BOARD;
+    }
+
+    // Make a scheduled stop irrelevant if it has no arrival nor departure data and its schedule time is
+    // purely in the past -- Could this be handled in invalidateTrips() better?
+    if (!rtStatus.supplemental && rtStatus.predArrUTC.isNull() && rtStatus.predDepUTC.isNull()) {
+        if (!schDepTime.isNull() && agencyTime > schDepTime) {
+            tripStatus = IRRELEVANT;
+        } else if (schDepTime.isNull() && waitTimeSec < 0) {
+            // Interpolated trip-stops should not be allowed to go negative (this can happen when
+            // a trip has passed the stop and stop-sequence based matching is not done)
+            tripStatus = IRRELEVANT;
+        }
+        if (!schArrTime.isNull() && agencyTime > schArrTime) {
+            tripStatus = IRRELEVANT;
+        } else if (schArrTime.isNull() && waitTimeSec < 0) {
+            // Interpolated trip-stops should not be allowed to go negative (this can happen when
+            // a trip has passed the stop and stop-sequence based matching is not done)
+            tripStatus = IRRELEVANT;
+        }
+    }
+
+    return tripStatus;
+}
+
+void TripStopReconciler::invalidateTrips(const QString                    &routeID,
+                                         QHash<QString, StopRecoRouteRec> &fullTrips,
+                                         QHash<QString, StopRecoRouteRec> &relevantRouteTrips)
+{
+    for (StopRecoTripRec &tripRecord : fullTrips[routeID].tripRecos) {
+        invalidateTripRecord(tripRecord);
     }
 
     // If real-time trip-update date matching is disabled (-l 2) then it is possible previous/next
@@ -554,6 +648,70 @@ void TripStopReconciler::invalidateTrips(const QString                    &route
     }
 }
 
+void TripStopReconciler::invalidateTripRecord(StopRecoTripRec &tripRecord) const
+{
+    QDateTime stopTime;
+    if (tripRecord.realTimeDataAvail && tripRecord.stopStatus != "SCHD") {
+        // Use real-time data for the lookahead determination unless the trip is running but no data is present...
+        if (!tripRecord.realTimeArrival.isNull()) {
+            stopTime = tripRecord.realTimeArrival;
+        } else if (!tripRecord.realTimeDeparture.isNull()) {
+            stopTime = tripRecord.realTimeDeparture;
+        }
+    } else {
+        // ... unless it is not available
+        if (!tripRecord.schArrTime.isNull()) {
+            stopTime = tripRecord.schArrTime;
+        } else if (!tripRecord.schDepTime.isNull()) {
+            stopTime = tripRecord.schDepTime;
+        }
+    }
+
+    // Mark trips as invalid if they are outside the time window requested
+    if (_lookaheadMins != 0 &&
+        (((tripRecord.tripStatus == SCHEDULE || tripRecord.stopStatus == "SCHD")
+          && stopTime > _lookaheadTime) ||
+         (tripRecord.tripStatus == NOSCHEDULE && tripRecord.schSortTime > _lookaheadTime))) {
+        tripRecord.tripStatus = IRRELEVANT;
+    }
+
+    // Mark the trip-stop as invalid if it occurred in the past
+    // There are two notions: scheduled and unscheduled times. Unscheduled times should NOT display a time
+    // but we allow a countdown (probably the client should warn that the data is missing). If realtime
+    // data were to be associated with these 'untimed' stops, then hopefully that would supplement it :) )
+    if ((tripRecord.tripStatus == SCHEDULE   && _agencyTime.secsTo(stopTime) < 0) ||
+        (tripRecord.tripStatus == NOSCHEDULE && _agencyTime > tripRecord.schSortTime)) {
+        tripRecord.tripStatus = IRRELEVANT;
+    }
+
+    // With realtime data available, the invalidation process needs to take extra parameters into consideration
+    else if (tripRecord.realTimeDataAvail) {
+        if (tripRecord.tripStatus == RUNNING || tripRecord.tripStatus == DEPART ||
+            tripRecord.tripStatus == BOARD   || tripRecord.tripStatus == ARRIVE) {
+            if (!tripRecord.realTimeArrival.isNull() &&
+                ((_lookaheadMins != 0 && tripRecord.realTimeArrival > _lookaheadTime))) {
+                tripRecord.tripStatus = IRRELEVANT;
+            } else if (!tripRecord.realTimeDeparture.isNull() &&
+                     ((_lookaheadMins != 0 && tripRecord.realTimeDeparture > _lookaheadTime))) {
+                tripRecord.tripStatus = IRRELEVANT;
+            }
+        } else if (tripRecord.tripStatus == CANCEL || tripRecord.tripStatus == SKIP) {
+            // Excpetion for cancelled and stop-skip trips: show for 2 minutes past the scheduled time
+            if (!tripRecord.schArrTime.isNull()) {
+                qint64 secUntilSchArr = _agencyTime.secsTo(tripRecord.schArrTime);
+                if (secUntilSchArr < -120 || secUntilSchArr > _lookaheadMins * 60) {
+                    tripRecord.tripStatus = IRRELEVANT;
+                }
+            } else if (!tripRecord.schDepTime.isNull()) {
+                qint64 secUntilSchDep = _agencyTime.secsTo(tripRecord.schDepTime);
+                if (secUntilSchDep < -120 || secUntilSchDep > _lookaheadMins * 60) {
+                    tripRecord.tripStatus = IRRELEVANT;
+                }
+            }
+        }
+    }
+}
+
 void TripStopReconciler::fillStopStatWaitTimeOffset(const QDateTime &schArrUTC,
                                                     const QDateTime &schDepUTC,
                                                     const QDateTime &preArrUTC,
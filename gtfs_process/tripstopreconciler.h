@@ -26,6 +26,7 @@
 
 #include <QObject>
 #include <QList>
+#include <QSet>
 
 namespace GTFS {
 
@@ -86,6 +87,15 @@ typedef struct {
 } StopRecoRouteRec;
 
 
+/*
+ * Services running on each service day considered by a reconciler. Requests evaluating many stops at once compute it
+ * once (see OperatingDay::servicesRunning) and share it with all their reconcilers instead of having the calendar
+ * checked for every trip of every stop.
+ */
+typedef struct {
+    QHash<QDate, QSet<QString>> runningServices;
+} ServiceDaySnapshot;
+
 /*
  * GTFS::TripStopReconciler is an abstraction layer to the GTFS::DataGateway to specifically process the upcoming
  * service a stop_id. Depending on the available data / style of request, it will return data regarding the upcoming
@@ -101,12 +111,20 @@ public:
      *  - Yesterday (because trips can go past midnight and might still be valid)
      *  - Today (obvious...)
      *  - Tomorrow (in case the future minutes asked for exceeds the end of the day today
+     *
+     * maxTripsPerRoute is the number of trips per route the caller will actually render (the NEX trip cap). When it is
+     * non-zero and a maximum delay bound is configured (nexDelayBoundSec), the trips of each route at each stop_id
+     * are walked in scheduled order and evaluation stops once enough relevant trips have been found
+     * that no later trip could be reordered ahead of them by real-time data. Send 0 to evaluate every trip.
+     *
+     * serviceDays optionally holds the services running yesterday, today and tomorrow (it must outlive the reconciler).
      */
     explicit TripStopReconciler(const QList<QString>     &stop_ids,
                                 bool                      realTimeProcess,
                                 QDate                     serviceDate,
                                 const QDateTime          &currAgencyTime,
                                 qint32                    futureMinutes,
+                                quint32                   maxTripsPerRoute,
                                 const Status             *status,
                                 const OperatingDay       *services,
                                 const StopData           *stopDB,
@@ -114,7 +132,8 @@ public:
                                 const TripData           *tripDB,
                                 const StopTimeData       *stopTimeDB,
                                 const RealTimeTripUpdate *activeFeed,
-                                QObject                  *parent = nullptr);
+                                const ServiceDaySnapshot *serviceDays = nullptr,
+                                QObject                  *parent      = nullptr);
 
     /*
      * Core stop_id information retrieval
@@ -148,12 +167,39 @@ private:
     /*
      * Local Functions for helping retrieve data from the gateway
      */
+    // Fill stopTrips with the trips (scheduled and added, real-time data integrated) of every route serving a single
+    // stop of the request. It only reads shared state, so several stops can be evaluated concurrently.
+    void addTripRecordsForStop(const QString                    &stopID,
+                               bool                              boundedMode,
+                               QHash<QString, StopRecoRouteRec> &stopTrips) const;
+
     // Fill in the StopRecoTripRec for a particular service day and route
     void addTripRecordsForServiceDay(const QString    &routeID,
                                      const QDate      &serviceDay,
                                      const QString    &stopID,
                                      StopRecoRouteRec &routeRecord) const;
 
+    // Fill the StopRecoTripRec of a single trip (the tripIdx-th trip of the route serving the stop) on a service day
+    void fillTripRecord(const QString   &routeID,
+                        const QDate     &serviceDay,
+                        const QString   &stopID,
+                        qint32           tripIdx,
+                        StopRecoTripRec &tripRec) const;
+
+    // Bounded evaluation for a route serving a stop (see maxTripsPerRoute in the constructor). Trips from all three
+    // service days are walked by scheduled time and only those which could make the top maxTripsPerRoute are added to
+    // routeRecord (real-time information is already integrated into them when running in real-time mode).
+    void addBoundedTripRecords(const QString    &routeID,
+                               const QString    &stopID,
+                               StopRecoRouteRec &routeRecord) const;
+
+    // Does the trip run on the service day? (uses the shared snapshot when the day is in it)
+    bool tripRunsOnServiceDay(const QDate &serviceDay, const QString &tripID) const;
+
+    // Integrate the real-time feed into a scheduled trip record: cancellations, skipped stops and predictions are all
+    // taken from a single status lookup of the trip in the feed
+    void applyRealTimeData(const QString &stopID, StopRecoTripRec &tripRecord) const;
+
     // Invalidate trips that fall outside the requested thresholds
     // The input is the fullTrips argument, the output (containing ONLY the trips which should be displayed per the
     // criteria set in the construction of this object) is found in relevantRouteTrips.
@@ -161,6 +207,9 @@ private:
                          QHash<QString, StopRecoRouteRec> &fullTrips,
                          QHash<QString, StopRecoRouteRec> &relevantRouteTrips);
 
+    // Invalidate a single trip record (marks it IRRELEVANT) if it falls outside the requested thresholds
+    void invalidateTripRecord(StopRecoTripRec &tripRecord) const;
+
     // Determines the running type of a scheduled trip with real-time information at a particular stop.
     // (In particular: RUN_FULLPRD vs. RUN_PR_ONLY vs. RUN_SC_ONLY)
     // Depending on the schedule vs. real-time information present, the wait time is also filled.
@@ -177,6 +226,17 @@ private:
                                     QDateTime       &realTimeArrLT,
                                     QDateTime       &realTimeDepLT) const;
 
+    // The trip status state machine: resolves the status of a trip at a stop (CANCEL, SKIP, RUNNING, ARRIVE, BOARD,
+    // DEPART or IRRELEVANT) from its real-time status and the agency time, keeping currentStatus when the feed has no
+    // say on the trip. The (local) scheduled times and the wait time are only consulted for a running scheduled trip
+    // without a prediction at the stop. Added trips go through it too (as supplemental, running trips).
+    static TripRecStat resolveTripStatus(TripRecStat             currentStatus,
+                                         const rtTripStopStatus &rtStatus,
+                                         const QDateTime        &agencyTime,
+                                         const QDateTime        &schArrTime,
+                                         const QDateTime        &schDepTime,
+                                         qint64                  waitTimeSec);
+
     /*
      * Data Members
      */
@@ -184,6 +244,7 @@ private:
     QDate          _svcDate;
     QList<QString> _stopIDs;            // List of Stop IDs to compute all at once
     qint32         _lookaheadMins;      // If set to 0, it is ignored
+    quint32        _maxTripsPerRoute;   // If set to 0, every trip is evaluated
     bool           _realTimeOnly;
 
     QDate          _svcYesterday;
@@ -203,6 +264,8 @@ private:
     const TripData     *sTripDB;
     const StopTimeData *sStopTimes;
 
+    const ServiceDaySnapshot *sServiceDays;
+
     /*
      * GTFS Realtime Feed Handle
      */
@@ -19,6 +19,9 @@ protobuf_impl.commands = $$escape_expand(\n)
 protobuf_impl.variable_out = SOURCES
 QMAKE_EXTRA_COMPILERS += protobuf_impl
 
+# Trip update entities are integrated concurrently
+QT += concurrent
+
 # Wrapper /abstraction objects to avoid coding directly against protobuf files
 INCLUDEPATH += $$PWD
 
@@ -26,10 +29,20 @@ DEPENDPATH += $$PWD
 
 HEADERS += \
     $$PWD/gtfsrealtimegateway.h\
-    $$PWD/gtfsrealtimefeed.h
+    $$PWD/gtfsrealtimefeed.h\
+    $$PWD/gtfsrealtimesource.h\
+    $$PWD/gtfsrealtimevehicles.h\
+    $$PWD/gtfsrealtimealerts.h\
+    $$PWD/gtfsrealtimearchive.h\
+    $$PWD/gtfsrealtimereplay.h
 SOURCES += \
     $$PWD/gtfsrealtimegateway.cpp\
-    $$PWD/gtfsrealtimefeed.cpp
+    $$PWD/gtfsrealtimefeed.cpp\
+    $$PWD/gtfsrealtimesource.cpp\
+    $$PWD/gtfsrealtimevehicles.cpp\
+    $$PWD/gtfsrealtimealerts.cpp\
+    $$PWD/gtfsrealtimearchive.cpp\
+    $$PWD/gtfsrealtimereplay.cpp
 
 # For Debian/Ubunto Linux:
 LIBS += -lprotobuf -latomic
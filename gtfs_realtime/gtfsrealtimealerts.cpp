@@ -0,0 +1,246 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "gtfsrealtimealerts.h"
+
+#include "gtfs-realtime.pb.h"
+#include <google/protobuf/arena.h>
+
+#include <QDebug>
+
+#include <algorithm>
+
+namespace GTFS {
+
+// Text of a translated string: the English (or untagged) translation, otherwise the first one
+static QString translatedText(const transit_realtime::TranslatedString &translated)
+{
+    for (const transit_realtime::TranslatedString::Translation &translation : translated.translation()) {
+        if (translation.language().empty() || translation.language() == "en") {
+            return QString::fromStdString(translation.text());
+        }
+    }
+    return (translated.translation_size() == 0) ? QString()
+                                                : QString::fromStdString(translated.translation(0).text());
+}
+
+RealTimeAlerts::RealTimeAlerts(const QByteArray &gtfsRealTimeData,
+                               bool              displayBufferInfo,
+                               const TripData   *tripsDB,
+                               const RouteData  *routesDB,
+                               QObject          *parent)
+    : QObject(parent),
+      _tripDB(tripsDB),
+      _routeDB(routesDB),
+      _feedTimePOSIX(0),
+      _integrationTimeMSec(0)
+{
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    QDateTime startUTC = QDateTime::currentDateTimeUtc();
+
+    // The protobuf is only needed while the alerts are converted, so it lives in an arena released all at once
+    google::protobuf::Arena arena;
+    transit_realtime::FeedMessage *feed =
+            google::protobuf::Arena::CreateMessage<transit_realtime::FeedMessage>(&arena);
+    feed->ParseFromArray(gtfsRealTimeData, gtfsRealTimeData.size());
+    _feedTimePOSIX = feed->header().timestamp();
+
+    for (const transit_realtime::FeedEntity &entity : feed->entity()) {
+        if (!entity.has_alert() || entity.is_deleted()) {
+            continue;
+        }
+        const transit_realtime::Alert &pbAlert = entity.alert();
+
+        rtServiceAlert alert;
+        alert.alertID         = QString::fromStdString(entity.id());
+        alert.cause           = QString::fromStdString(transit_realtime::Alert::Cause_Name(pbAlert.cause()));
+        alert.effect          = QString::fromStdString(transit_realtime::Alert::Effect_Name(pbAlert.effect()));
+        alert.headerText      = translatedText(pbAlert.header_text());
+        alert.descriptionText = translatedText(pbAlert.description_text());
+        alert.url             = translatedText(pbAlert.url());
+        for (const transit_realtime::TimeRange &period : pbAlert.active_period()) {
+            alert.activePeriods.push_back(qMakePair(static_cast<qint64>(period.start()),
+                                                    static_cast<qint64>(period.end())));
+        }
+
+        // Index each entity under its most specific selector (agency selectors are taken as agency-wide)
+        qint32 alertIdx = _alerts.size();
+        for (const transit_realtime::EntitySelector &selector : pbAlert.informed_entity()) {
+            rtAlertEntity affected;
+            affected.routeID = QString::fromStdString(selector.route_id());
+            affected.stopID  = QString::fromStdString(selector.stop_id());
+            affected.tripID  = QString::fromStdString(selector.trip().trip_id());
+            if (affected.routeID.isEmpty() && !selector.trip().route_id().empty()) {
+                affected.routeID = QString::fromStdString(selector.trip().route_id());
+            }
+            if (selector.has_route_type()) {
+                affected.routeType = QString::number(selector.route_type());
+            }
+
+            rtAlertRef ref;
+            ref.alertIdx  = alertIdx;
+            ref.entityIdx = alert.entities.size();
+            if (!affected.tripID.isEmpty()) {
+                _byTrip[affected.tripID].push_back(ref);
+            } else if (!affected.stopID.isEmpty()) {
+                _byStop[affected.stopID].push_back(ref);
+            } else if (!affected.routeID.isEmpty()) {
+                _byRoute[affected.routeID].push_back(ref);
+            } else if (!affected.routeType.isEmpty()) {
+                _byType[affected.routeType].push_back(ref);
+            } else {
+                ref.entityIdx = -1;
+                _agencyWide.push_back(ref);
+                continue;
+            }
+            alert.entities.push_back(affected);
+        }
+        if (pbAlert.informed_entity_size() == 0) {
+            rtAlertRef ref;
+            ref.alertIdx  = alertIdx;
+            ref.entityIdx = -1;
+            _agencyWide.push_back(ref);
+        }
+
+        _byID[alert.alertID] = alertIdx;
+        _alerts.push_back(alert);
+    }
+
+    _integrationTimeMSec = startUTC.msecsTo(QDateTime::currentDateTimeUtc());
+    if (displayBufferInfo) {
+        qDebug() << "  (RTSA) GTFS-Realtime : LIVE Protobuf: " << gtfsRealTimeData.size() << "bytes consisting of"
+                 << _alerts.size() << "alerts, integrated in" << _integrationTimeMSec << "ms.";
+    }
+}
+
+RealTimeAlerts::~RealTimeAlerts()
+{
+}
+
+QDateTime RealTimeAlerts::getFeedTime() const
+{
+    // An empty buffer has a header of 0 seconds-since-epoch, which really means there is no feed time
+    if (_feedTimePOSIX == 0) {
+        return QDateTime();
+    } else {
+        return QDateTime::fromSecsSinceEpoch(_feedTimePOSIX);
+    }
+}
+
+quint64 RealTimeAlerts::getFeedTimePOSIX() const
+{
+    return _feedTimePOSIX;
+}
+
+qint32 RealTimeAlerts::getNbAlerts() const
+{
+    return _alerts.size();
+}
+
+qint64 RealTimeAlerts::getIntegrationTimeMSec() const
+{
+    return _integrationTimeMSec;
+}
+
+const rtServiceAlert *RealTimeAlerts::alertForID(const QString &alertID) const
+{
+    QHash<QString, qint32>::const_iterator alertIt = _byID.constFind(alertID);
+    if (alertIt == _byID.constEnd()) {
+        return nullptr;
+    }
+    return &_alerts.at(alertIt.value());
+}
+
+void RealTimeAlerts::alertsFor(const QString &routeID, const QString &stopID, const QString &tripID,
+                               const QDateTime &atTime, QVector<QString> &alertIDs) const
+{
+    QString tripRouteID = routeID;
+    if (tripRouteID.isEmpty() && !tripID.isEmpty() && _tripDB != nullptr && _tripDB->contains(tripID)) {
+        tripRouteID = (*_tripDB)[tripID].route_id;
+    }
+    QString routeType;
+    if (!tripRouteID.isEmpty() && _routeDB != nullptr && _routeDB->contains(tripRouteID)) {
+        routeType = (*_routeDB)[tripRouteID].route_type;
+    }
+
+    // Only the buckets of the selectors requested are looked at
+    qint64 atPOSIX = atTime.toSecsSinceEpoch();
+    QVector<qint32> matched;
+    if (!tripID.isEmpty()) {
+        matchBucket(_byTrip.value(tripID), tripRouteID, routeType, stopID, tripID, atPOSIX, matched);
+    }
+    if (!stopID.isEmpty()) {
+        matchBucket(_byStop.value(stopID), tripRouteID, routeType, stopID, tripID, atPOSIX, matched);
+    }
+    if (!tripRouteID.isEmpty()) {
+        matchBucket(_byRoute.value(tripRouteID), tripRouteID, routeType, stopID, tripID, atPOSIX, matched);
+    }
+    if (!routeType.isEmpty()) {
+        matchBucket(_byType.value(routeType), tripRouteID, routeType, stopID, tripID, atPOSIX, matched);
+    }
+    matchBucket(_agencyWide, tripRouteID, routeType, stopID, tripID, atPOSIX, matched);
+
+    std::sort(matched.begin(), matched.end());
+    for (qint32 alertIdx : matched) {
+        alertIDs.push_back(_alerts.at(alertIdx).alertID);
+    }
+}
+
+bool RealTimeAlerts::alertActive(const rtServiceAlert &alert, qint64 atPOSIX) const
+{
+    // An alert without any active period is always active
+    if (alert.activePeriods.isEmpty()) {
+        return true;
+    }
+    for (const QPair<qint64, qint64> &period : alert.activePeriods) {
+        if ((period.first == 0 || period.first <= atPOSIX) && (period.second == 0 || atPOSIX < period.second)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RealTimeAlerts::matchBucket(const QVector<rtAlertRef> &bucket, const QString &routeID, const QString &routeType,
+                                 const QString &stopID, const QString &tripID, qint64 atPOSIX,
+                                 QVector<qint32> &matched) const
+{
+    for (const rtAlertRef &ref : bucket) {
+        if (matched.contains(ref.alertIdx)) {
+            continue;
+        }
+        const rtServiceAlert &alert = _alerts.at(ref.alertIdx);
+        if (ref.entityIdx >= 0) {
+            // Every selector of the entity must match what was asked for (unless nothing was asked for it)
+            const rtAlertEntity &affected = alert.entities.at(ref.entityIdx);
+            if ((!affected.routeID.isEmpty() && !routeID.isEmpty() && affected.routeID != routeID) ||
+                (!affected.routeType.isEmpty() && !routeType.isEmpty() && affected.routeType != routeType) ||
+                (!affected.stopID.isEmpty() && !stopID.isEmpty() && affected.stopID != stopID) ||
+                (!affected.tripID.isEmpty() && !tripID.isEmpty() && affected.tripID != tripID)) {
+                continue;
+            }
+        }
+        if (alertActive(alert, atPOSIX)) {
+            matched.push_back(ref.alertIdx);
+        }
+    }
+}
+
+} // namespace GTFS
@@ -0,0 +1,131 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef GTFSREALTIMEALERTS_H
+#define GTFSREALTIMEALERTS_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QDateTime>
+
+#include <memory>
+
+// For alerts on trips which do not include their route, the static feed's trips provide it (and its routes the type)
+#include "gtfstrip.h"
+#include "gtfsroute.h"
+
+namespace GTFS {
+
+// Entity affected by an alert: every selector which is not empty must match
+typedef struct {
+    QString routeID;
+    QString stopID;
+    QString tripID;
+    QString routeType;   // route_type of the static routes.txt
+} rtAlertEntity;
+
+// Service alert, converted from the protobuf once when the feed is integrated
+typedef struct {
+    QString                        alertID;        // ID of the feed entity
+    QString                        cause;          // Cause of the alert (like STRIKE, CONSTRUCTION, UNKNOWN_CAUSE)
+    QString                        effect;         // Effect of the alert (like DETOUR, NO_SERVICE, UNKNOWN_EFFECT)
+    QString                        headerText;     // Translations are reduced to the English / untagged one if any
+    QString                        descriptionText;
+    QString                        url;
+    QVector<QPair<qint64, qint64>> activePeriods;  // POSIX start / end of each active period (0 when open-ended)
+    QVector<rtAlertEntity>         entities;       // Routes, stops and trips affected (empty if agency-wide)
+} rtServiceAlert;
+
+// Reference from an index of the alerts to one of the entities of an alert
+typedef struct {
+    qint32 alertIdx;
+    qint32 entityIdx;    // -1 for agency-wide alerts
+} rtAlertRef;
+
+/*
+ * RealTimeAlerts holds the GTFS-Realtime Alerts feed of the agency. Each entity affected by an alert is indexed under
+ * its most specific selector (trip, then stop, then route, then route type, otherwise agency-wide), so the alerts
+ * relevant to a trip at a stop are found by looking up a handful of short lists: a request only ever goes through the
+ * alerts which may match it, never through all of them.
+ *
+ * Like the trip updates, an integrated feed is never modified: it is published by the RealTimeGateway and freed once
+ * the last request holding it is done.
+ */
+class RealTimeAlerts : public QObject
+{
+    Q_OBJECT
+public:
+    // Constructor from the bytes of an Alerts feed
+    explicit RealTimeAlerts(const QByteArray &gtfsRealTimeData,
+                            bool              displayBufferInfo,
+                            const TripData   *tripsDB,
+                            const RouteData  *routesDB,
+                            QObject          *parent = nullptr);
+
+    virtual ~RealTimeAlerts();
+
+    // Feed header time (null / 0 if the feed is empty)
+    QDateTime getFeedTime() const;
+    quint64 getFeedTimePOSIX() const;
+
+    // Integration statistics
+    qint32 getNbAlerts() const;
+    qint64 getIntegrationTimeMSec() const;
+
+    // Alert with the ID (nullptr if the feed has no such alert)
+    const rtServiceAlert *alertForID(const QString &alertID) const;
+
+    // IDs of the alerts active at a time which affect a trip of a route at a stop (empty IDs match any trip / stop),
+    // in feed order. The route of a trip is taken from the static feed when not given, and so is the type of the route.
+    void alertsFor(const QString &routeID, const QString &stopID, const QString &tripID, const QDateTime &atTime,
+                   QVector<QString> &alertIDs) const;
+
+private:
+    // Does the alert apply at the time?
+    bool alertActive(const rtServiceAlert &alert, qint64 atPOSIX) const;
+
+    // Gather the matching alerts of one index bucket (each alert is only gathered once)
+    void matchBucket(const QVector<rtAlertRef> &bucket, const QString &routeID, const QString &routeType,
+                     const QString &stopID, const QString &tripID, qint64 atPOSIX, QVector<qint32> &matched) const;
+
+    const TripData  *_tripDB;
+    const RouteData *_routeDB;
+
+    QVector<rtServiceAlert>             _alerts;      // Every alert of the feed, in feed order
+    QHash<QString, qint32>              _byID;        // Alert of each ID
+    QHash<QString, QVector<rtAlertRef>> _byTrip;      // Entities selecting a trip
+    QHash<QString, QVector<rtAlertRef>> _byStop;      // Entities selecting a stop (and no trip)
+    QHash<QString, QVector<rtAlertRef>> _byRoute;     // Entities selecting a route (and no stop nor trip)
+    QHash<QString, QVector<rtAlertRef>> _byType;      // Entities selecting only a route type
+    QVector<rtAlertRef>                 _agencyWide;  // Alerts affecting everything (agency selectors)
+
+    quint64 _feedTimePOSIX;
+    qint64  _integrationTimeMSec;
+};
+
+// Alerts held by a request (or published by the RealTimeGateway): freed once nothing holds them anymore
+typedef std::shared_ptr<const RealTimeAlerts> RealTimeAlertsPin;
+
+} // namespace GTFS
+
+#endif // GTFSREALTIMEALERTS_H
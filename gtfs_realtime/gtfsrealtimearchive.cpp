@@ -0,0 +1,137 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "gtfsrealtimearchive.h"
+
+#include <QDebug>
+
+namespace GTFS {
+
+// First bytes of every archive (the digit is the version of the record layout)
+const QByteArray kArchiveHeader("GTFSRTA1");
+
+// Records are serialized in a layout that does not change with the Qt version running the server
+const QDataStream::Version kArchiveStreamVersion = QDataStream::Qt_6_0;
+
+RealTimeArchiveWriter::RealTimeArchiveWriter(const QString &archivePath, bool trace, QObject *parent)
+    : QObject(parent),
+      _archive(archivePath),
+      _trace(trace)
+{
+    if (!_archive.open(QIODevice::ReadWrite)) {
+        qDebug() << "  (RTAR) ERROR : Could not open the real-time archive" << archivePath << "for recording";
+        return;
+    }
+
+    // A new archive starts with its header, fetches are appended after those already recorded in an existing one
+    if (_archive.size() == 0) {
+        _archive.write(kArchiveHeader);
+    } else if (_archive.read(kArchiveHeader.size()) != kArchiveHeader) {
+        qDebug() << "  (RTAR) ERROR :" << archivePath << "is not a real-time archive, not recording to it";
+        _archive.close();
+        return;
+    } else {
+        // A record cut short (the server stopped while writing it) is dropped, for the fetches appended to be readable
+        RealTimeArchiveReader recorded(archivePath);
+        RealTimeArchiveRecord record;
+        while (recorded.readNext(record)) {}
+        if (recorded.validSize() < _archive.size()) {
+            _archive.resize(recorded.validSize());
+        }
+    }
+    _archive.seek(_archive.size());
+    _stream.setDevice(&_archive);
+    _stream.setVersion(kArchiveStreamVersion);
+}
+
+bool RealTimeArchiveWriter::isOpen() const
+{
+    return _archive.isOpen();
+}
+
+void RealTimeArchiveWriter::append(const RealTimeArchiveRecord &record)
+{
+    if (!_archive.isOpen()) {
+        return;
+    }
+
+    _stream << record.fetchMSec
+            << static_cast<quint8>(record.outcome)
+            << record.source
+            << record.downloadMSec
+            << record.data;
+    if (_stream.status() != QDataStream::Ok || !_archive.flush()) {
+        qDebug() << "  (RTAR) ERROR : Could not write to the real-time archive, recording stopped";
+        _archive.close();
+        return;
+    }
+
+    if (_trace) {
+        qDebug() << "  (RTAR) Recorded a fetch of" << record.source << "(" << record.data.size() << "bytes)";
+    }
+}
+
+RealTimeArchiveReader::RealTimeArchiveReader(const QString &archivePath)
+    : _archive(archivePath),
+      _open(false),
+      _validSize(0)
+{
+    if (!_archive.open(QIODevice::ReadOnly) || _archive.read(kArchiveHeader.size()) != kArchiveHeader) {
+        return;
+    }
+    _stream.setDevice(&_archive);
+    _stream.setVersion(kArchiveStreamVersion);
+    _open      = true;
+    _validSize = _archive.pos();
+}
+
+bool RealTimeArchiveReader::isOpen() const
+{
+    return _open;
+}
+
+bool RealTimeArchiveReader::readNext(RealTimeArchiveRecord &record)
+{
+    if (!_open || _stream.atEnd()) {
+        return false;
+    }
+
+    quint8 outcome;
+    _stream >> record.fetchMSec
+            >> outcome
+            >> record.source
+            >> record.downloadMSec
+            >> record.data;
+    if (_stream.status() != QDataStream::Ok || outcome > ARCHIVED_FAILED) {
+        // The server stopped while the record was written: the archive ends with the previous one
+        _open = false;
+        return false;
+    }
+    record.outcome = static_cast<RealTimeArchiveOutcome>(outcome);
+    _validSize     = _archive.pos();
+    return true;
+}
+
+qint64 RealTimeArchiveReader::validSize() const
+{
+    return _validSize;
+}
+
+} // namespace GTFS
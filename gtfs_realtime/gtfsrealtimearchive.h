@@ -0,0 +1,99 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef GTFSREALTIMEARCHIVE_H
+#define GTFSREALTIMEARCHIVE_H
+
+#include <QObject>
+#include <QFile>
+#include <QDataStream>
+
+namespace GTFS {
+
+// Outcome of a fetch, as recorded in an archive
+typedef enum {
+    ARCHIVED_DATA      = 0,     // Data was fetched (kept as-is, even if empty)
+    ARCHIVED_UNCHANGED = 1,     // Same data as the data activated ("304 Not Modified" or identical content), not kept
+    ARCHIVED_FAILED    = 2      // The download failed or was aborted
+} RealTimeArchiveOutcome;
+
+// A fetch recorded in an archive
+typedef struct {
+    qint64                 fetchMSec;       // Time the fetch completed (milliseconds since the epoch)
+    QString                source;          // Name of the source which fetched it (RTTU, RTVP, RTSA, ...)
+    RealTimeArchiveOutcome outcome;         // What came out of the fetch
+    qint64                 downloadMSec;    // Time spent downloading / reading the data
+    QByteArray             data;            // GTFS-Realtime protobuf (ARCHIVED_DATA only)
+} RealTimeArchiveRecord;
+
+/*
+ * GTFS::RealTimeArchiveWriter appends every fetch of the real-time sources to an archive file, for them to be replayed
+ * later (see RealTimeFeedReplay). The archive is append-only: recording again to the same file carries on after the
+ * fetches already recorded there (dropping a record cut short when the server stopped while writing it).
+ *
+ * The archive starts with the 8 bytes "GTFSRTA1", then each fetch is a record serialized by QDataStream: fetch time
+ * (qint64 ms since the epoch), outcome (quint8), source name (QString), download time (qint64 ms) and protobuf data
+ * (QByteArray). Each record is flushed as it is written.
+ */
+class RealTimeArchiveWriter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RealTimeArchiveWriter(const QString &archivePath, bool trace, QObject *parent = nullptr);
+
+    // Could the archive be opened (or created) for appending?
+    bool isOpen() const;
+
+    // Append a fetch to the archive (recording stops at the first write error)
+    void append(const RealTimeArchiveRecord &record);
+
+private:
+    QFile       _archive;    // Archive file, opened for appending
+    QDataStream _stream;     // Serializes the records into the archive
+    bool        _trace;      // true if the archive traces should show
+};
+
+/*
+ * GTFS::RealTimeArchiveReader reads back the fetches recorded by a RealTimeArchiveWriter, in the order they happened.
+ */
+class RealTimeArchiveReader
+{
+public:
+    explicit RealTimeArchiveReader(const QString &archivePath);
+
+    // Is the file an archive? (false if it cannot be read or does not start with the archive header)
+    bool isOpen() const;
+
+    // Read the next fetch recorded, false once the archive is over (or its last record was cut short)
+    bool readNext(RealTimeArchiveRecord &record);
+
+    // Size of the archive up to the end of the last record read (the header only until a record is read)
+    qint64 validSize() const;
+
+private:
+    QFile       _archive;    // Archive file, opened for reading
+    QDataStream _stream;     // Deserializes the records from the archive
+    bool        _open;       // The file is an archive which can be read from
+    qint64      _validSize;  // Size of the archive up to the end of the last record read
+};
+
+} // namespace GTFS
+
+#endif // GTFSREALTIMEARCHIVE_H
@@ -22,49 +22,41 @@
 
 #include <QTimeZone>
 #include <QSet>
+#include <QThread>
+#include <QtConcurrent>
 #include <QDebug>
-#include <fstream>
+#include <algorithm>
+#include <limits>
 
 #include <google/protobuf/text_format.h>
 #include <google/protobuf/util/json_util.h>
 
 namespace GTFS {
 
-RealTimeTripUpdate::RealTimeTripUpdate(const QString      &rtPath,
-                                       rtDateLevel         skipDateMatching,
-                                       bool                loosenStopSeqEnf,
-                                       bool                allSkippedCanceled,
-                                       const TripData     *tripsDB,
-                                       const StopTimeData *stopTimeDB,
-                                       QObject            *parent)
-    : QObject(parent),
-      _tripDB(tripsDB),
-      _stopTimeDB(stopTimeDB),
-      _dateEnforcement(skipDateMatching),
-      _loosenStopSeqEnf(loosenStopSeqEnf),
-      _allSkippedCan(allSkippedCanceled)
-{
-    GOOGLE_PROTOBUF_VERIFY_VERSION;
-
-    QDateTime startUTC = QDateTime::currentDateTimeUtc();
-
-    std::fstream pbfstream(rtPath.toUtf8(), std::ios::in | std::ios::binary);
-    _tripUpdate.ParseFromIstream(&pbfstream);
-
-    processUpdateDetails(startUTC);
-}
-
-RealTimeTripUpdate::RealTimeTripUpdate(const QByteArray   &gtfsRealTimeData,
-                                       rtDateLevel         skipDateMatching,
-                                       bool                loosenStopSeqEnf,
-                                       bool                displayBufferInfo,
-                                       bool                allSkippedCanceled,
-                                       const TripData     *tripsDB,
-                                       const StopTimeData *stopTimeDB,
-                                       QObject            *parent)
+// Fewest items (trip update entities or active trips) worth handing to a separate worker thread during integration
+const qint32 kMinItemsPerPartition = 256;
+
+// Bounds of the first arena block of a feed: a feed's protobuf objects rarely fit in less, and no more is allocated up
+// front than the largest feeds (MTA NYCT, MBTA) need altogether
+const size_t kMinArenaBlockBytes = 256 * 1024;
+const size_t kMaxArenaBlockBytes = 64 * 1024 * 1024;
+
+const qint64 RealTimeTripUpdate::kNoStartDay = std::numeric_limits<qint64>::min();
+
+RealTimeTripUpdate::RealTimeTripUpdate(const QByteArray         &gtfsRealTimeData,
+                                       rtDateLevel               skipDateMatching,
+                                       bool                      loosenStopSeqEnf,
+                                       bool                      displayBufferInfo,
+                                       bool                      allSkippedCanceled,
+                                       const TripData           *tripsDB,
+                                       const StopTimeData       *stopTimeDB,
+                                       const RealTimeTripUpdate *previousFeed,
+                                       QObject                  *parent)
     : QObject(parent),
       _tripDB(tripsDB),
       _stopTimeDB(stopTimeDB),
+      _arena(arenaOptions(previousFeed)),
+      _tripUpdate(*google::protobuf::Arena::CreateMessage<transit_realtime::FeedMessage>(&_arena)),
       _dateEnforcement(skipDateMatching),
       _loosenStopSeqEnf(loosenStopSeqEnf),
       _allSkippedCan(allSkippedCanceled)
@@ -74,18 +66,22 @@ RealTimeTripUpdate::RealTimeTripUpdate(const QByteArray   &gtfsRealTimeData,
     QDateTime startUTC = QDateTime::currentDateTimeUtc();
 
     _tripUpdate.ParseFromArray(gtfsRealTimeData, gtfsRealTimeData.size());
+    _parseTimeMSec = startUTC.msecsTo(QDateTime::currentDateTimeUtc());
+    _arenaBytes    = _arena.SpaceUsed();
 
     if (displayBufferInfo) {
         qDebug() << "  (RTTU) GTFS-Realtime : LIVE Protobuf: " << _tripUpdate.ByteSizeLong()
                  << "bytes consisting of" << _tripUpdate.entity_size() << "real-time records.";
+        qDebug() << "  (RTTU) GTFS-Realtime : Parsed in" << _parseTimeMSec << "ms into an arena of"
+                 << _arenaBytes << "bytes.";
     }
 
-    processUpdateDetails(startUTC);
+    processUpdateDetails(startUTC, previousFeed);
 }
 
 RealTimeTripUpdate::~RealTimeTripUpdate()
 {
-    // The default destructor **should** be enough
+    // The default destructor **should** be enough (the arena releases the whole FeedMessage at once)
 }
 
 QDateTime RealTimeTripUpdate::getFeedTime() const
@@ -130,6 +126,26 @@ qint64 RealTimeTripUpdate::getIntegrationTimeMSec() const
     return _integrationTimeMSec;
 }
 
+qint32 RealTimeTripUpdate::getIntegrationThreads() const
+{
+    return _integrationThreads;
+}
+
+qint32 RealTimeTripUpdate::getReusedEntities() const
+{
+    return _reusedEntities;
+}
+
+qint64 RealTimeTripUpdate::getParseTimeMSec() const
+{
+    return _parseTimeMSec;
+}
+
+quint64 RealTimeTripUpdate::getArenaBytes() const
+{
+    return _arenaBytes;
+}
+
 bool RealTimeTripUpdate::tripExists(const QString &trip_id) const
 {
     return _activeTrips.contains(trip_id) || _addedTrips.contains(trip_id) || _noRouteTrips.contains(trip_id);
@@ -139,16 +155,11 @@ bool RealTimeTripUpdate::tripIsCancelled(const QString &trip_id,
                                          const QDate   &serviceDate,
                                          const QDate   &actualDate) const
 {
-    if (_cancelledTrips.contains(trip_id)) {
-        const transit_realtime::FeedEntity &entity = _tripUpdate.entity(_cancelledTrips[trip_id]);
-        const QString startDate = QString::fromStdString(entity.trip_update().trip().start_date());
-        const QString serviceDateStr = serviceDate.toString("yyyyMMdd");
-        const QString actualDateStr  = actualDate.toString("yyyyMMdd");
-        if ((_dateEnforcement == NO_MATCHING) ||
-            (_dateEnforcement == SERVICE_DATE && startDate == serviceDateStr) ||
-            (_dateEnforcement == ACTUAL_DATE  && startDate == actualDateStr)) {
+    QHash<QString, qint32>::const_iterator cancelled = _cancelledTrips.constFind(trip_id);
+    if (cancelled != _cancelledTrips.constEnd()) {
+        if (startDateMatches(cancelled.value(), serviceDate, actualDate)) {
             return true;
-        } else if (startDate == "" && _allSkippedCan) {
+        } else if (_entityOverlay[cancelled.value()].noStartDate && _allSkippedCan) {
             // If there is no start date field, but the "ALL_SKIPPED_IS_CANCELED" flag is on, then let it mark canceled
             return true;
         }
@@ -159,29 +170,20 @@ bool RealTimeTripUpdate::tripIsCancelled(const QString &trip_id,
 void RealTimeTripUpdate::getAddedTripsServingStop(const QString &stop_id,
                                                   QHash<QString, QVector<QPair<QString, quint32>>> &addedTrips) const
 {
-    for (const QString &tripID : _addedTrips.keys()) {
-        const transit_realtime::FeedEntity &entity = _tripUpdate.entity(_addedTrips[tripID]);
-        QString qRouteId = QString::fromStdString(entity.trip_update().trip().route_id());
-        const transit_realtime::TripUpdate desc = entity.trip_update();
-
-        for (qint32 stopTimeIdx = 0; stopTimeIdx < entity.trip_update().stop_time_update_size(); ++stopTimeIdx) {
-            const transit_realtime::TripUpdate_StopTimeUpdate &stu = desc.stop_time_update(stopTimeIdx);
-            const QString rtStopId = QString::fromStdString(stu.stop_id());
-            if (rtStopId == stop_id) {
-                QString trip_id = QString::fromStdString(desc.trip().trip_id());
-                QPair<QString, quint32> routeAddedTrip(trip_id, stu.stop_sequence());
-                addedTrips[qRouteId].push_back(routeAddedTrip);
-            }
-        }
+    QHash<QString, QVector<rtAddedStopEvent>>::const_iterator stopEvents = _addedStopEvents.constFind(stop_id);
+    if (stopEvents == _addedStopEvents.constEnd()) {
+        return;
+    }
+    for (const rtAddedStopEvent &stopEvent : stopEvents.value()) {
+        QPair<QString, quint32> routeAddedTrip(stopEvent.tripID, stopEvent.stopSequence);
+        addedTrips[stopEvent.routeID].push_back(routeAddedTrip);
     }
 }
 
 const QString RealTimeTripUpdate::getFinalStopIdForAddedTrip(const QString &trip_id) const
 {
-    qint32 recIdx = _addedTrips[trip_id];
-    const transit_realtime::FeedEntity &entity = _tripUpdate.entity(recIdx);
-    qint32 lastStopTimeIdx = entity.trip_update().stop_time_update_size() - 1;
-    return QString::fromStdString(entity.trip_update().stop_time_update(lastStopTimeIdx).stop_id());
+    const rtTripOverlay &overlay = _entityOverlay[_addedTrips[trip_id]];
+    return overlay.stopIDs.isEmpty() ? QString() : overlay.stopIDs.last();
 }
 
 bool RealTimeTripUpdate::stopIsEndOfAddedTrip(const QString &trip_id, qint64 stop_seq, const QString &stop_id) const
@@ -189,11 +191,15 @@ bool RealTimeTripUpdate::stopIsEndOfAddedTrip(const QString &trip_id, qint64 sto
     qint32 recIdx = _addedTrips[trip_id];
     const transit_realtime::FeedEntity &entity = _tripUpdate.entity(recIdx);
     qint32 lastStopTimeIdx = entity.trip_update().stop_time_update_size() - 1;
+    if (lastStopTimeIdx < 0) {
+        return false;
+    }
 
+    const QString &lastStopID = _entityOverlay[recIdx].stopIDs.at(lastStopTimeIdx);
     if (_loosenStopSeqEnf) {
-        return QString::fromStdString(entity.trip_update().stop_time_update(lastStopTimeIdx).stop_id()) == stop_id;
+        return lastStopID == stop_id;
     } else {
-        return QString::fromStdString(entity.trip_update().stop_time_update(lastStopTimeIdx).stop_id()) == stop_id &&
+        return lastStopID == stop_id &&
                entity.trip_update().stop_time_update(lastStopTimeIdx).stop_sequence() == stop_seq;
     }
 }
@@ -207,7 +213,7 @@ const QString RealTimeTripUpdate::getRouteID(const QString &trip_id) const
         return routeIDrt;
     }
 
-    routeIDrt = QString::fromStdString(_tripUpdate.entity(tripUpdateEntity).trip_update().trip().route_id());
+    routeIDrt = _entityOverlay[tripUpdateEntity].rtRouteID;
     return routeIDrt;
 }
 
@@ -218,13 +224,8 @@ bool RealTimeTripUpdate::scheduledTripIsRunning(const QString &trip_id,
 {
     bool tripIsRunning = false;
 
-    if (_activeTrips.contains(trip_id)) {
-        const transit_realtime::FeedEntity &entity = _tripUpdate.entity(_activeTrips[trip_id]);
-
-        const QString rtStartDateStr = QString::fromStdString(entity.trip_update().trip().start_date());
-        const QString serviceDateStr = serviceDate.toString("yyyyMMdd");
-        const QString actualDateStr  = actualDate.toString("yyyyMMdd");
-
+    QHash<QString, qint32>::const_iterator active = _activeTrips.constFind(trip_id);
+    if (active != _activeTrips.constEnd()) {
         /*
          * If no date matching is requested: sure, this trip counts as running, no further check required
          *
@@ -234,9 +235,7 @@ bool RealTimeTripUpdate::scheduledTripIsRunning(const QString &trip_id,
          * Strictest date matching (the default) means the real-time start date is that of the service date (which,
          * for after-midnight trips (times >= 24:00:00) is technically the day before)
          */
-        if ((_dateEnforcement == NO_MATCHING) ||
-            (_dateEnforcement == SERVICE_DATE && rtStartDateStr == serviceDateStr) ||
-            (_dateEnforcement == ACTUAL_DATE  && rtStartDateStr == actualDateStr)) {
+        if (startDateMatches(active.value(), serviceDate, actualDate)) {
             rtDateUsed    = serviceDate;
             tripIsRunning = true;
         }
@@ -254,24 +253,21 @@ bool RealTimeTripUpdate::tripSkipsStop(const QString &stop_id,
     /*
      * See if the stop is specifically skipped (based on a normally-schedule route)
      */
-    if (_skippedStops.contains(stop_id)) {
-        const QString serviceDateStr = serviceDate.toString("yyyyMMdd");
-        const QString actualDateStr  = actualDate.toString("yyyyMMdd");
-        for (const QPair<QString, quint32> &stopList : _skippedStops[stop_id]) {
-            const QString rtStartDateStr =
-                    QString::fromStdString(_tripUpdate.entity(_activeTrips[trip_id]).trip_update().trip().start_date());
-            if ((_dateEnforcement == NO_MATCHING) ||
-                (_dateEnforcement == SERVICE_DATE && rtStartDateStr == serviceDateStr) ||
-                (_dateEnforcement == ACTUAL_DATE  && rtStartDateStr == actualDateStr)) {
-                if (!_loosenStopSeqEnf) {
-                    if (stopList.first == trip_id && stopList.second == stopSeq) return true;
-                } else {
-                    if (stopList.first == trip_id) return true;
-                }
-            }
-        }
+    QHash<QString, qint32>::const_iterator active = _activeTrips.constFind(trip_id);
+    if (active == _activeTrips.constEnd()) {
+        return false;
     }
-    return false;
+
+    const rtTripOverlay &overlay = _entityOverlay[active.value()];
+    if (!overlay.skippedStops.contains(stop_id) || !startDateMatches(active.value(), serviceDate, actualDate)) {
+        return false;
+    }
+
+    if (!_loosenStopSeqEnf) {
+        return stopSeq >= 0 && stopSeq <= std::numeric_limits<quint32>::max() &&
+               overlay.skippedStops.contains(stop_id, static_cast<quint32>(stopSeq));
+    }
+    return true;
 }
 
 bool RealTimeTripUpdate::scheduledTripAlreadyPassed(const QString &trip_id, qint64 stopSeq) const
@@ -281,15 +277,12 @@ bool RealTimeTripUpdate::scheduledTripAlreadyPassed(const QString &trip_id, qint
      * stop sequence we find in the realtime feed is higher than that of the one requested by stopSeq, we should
      * note that the trip has already passed through the stop and therefore not display it
      */
-    qint32 entityIdx;
-
-    if (_activeTrips.contains(trip_id)) {
-        entityIdx = _activeTrips[trip_id];
-    } else {
+    QHash<QString, qint32>::const_iterator active = _activeTrips.constFind(trip_id);
+    if (active == _activeTrips.constEnd()) {
         return false;
     }
 
-    const transit_realtime::TripUpdate &tri = _tripUpdate.entity(entityIdx).trip_update();
+    const transit_realtime::TripUpdate &tri = _tripUpdate.entity(active.value()).trip_update();
 
     if (tri.stop_time_update_size() > 0) {
         if (!_loosenStopSeqEnf && tri.stop_time_update(0).has_stop_sequence()) {
@@ -310,6 +303,71 @@ bool RealTimeTripUpdate::scheduledTripAlreadyPassed(const QString &trip_id, qint
     return false;
 }
 
+void RealTimeTripUpdate::getTripStopStatus(const QString              &tripID,
+                                           qint64                      stopSeq,
+                                           const QString              &stopID,
+                                           const QTimeZone            &agencyTZ,
+                                           const QVector<StopTimeRec> &tripTimes,
+                                           const QDate                &serviceDate,
+                                           const QDate                &actualDate,
+                                           rtTripStopStatus           &status) const
+{
+    status.inFeed        = false;
+    status.supplemental  = false;
+    status.cancelled     = false;
+    status.skipsStop     = false;
+    status.running       = false;
+    status.alreadyPassed = false;
+    status.rtDateUsed    = QDate();
+    status.predArrUTC    = QDateTime();
+    status.predDepUTC    = QDateTime();
+    status.vehicle       = "";
+
+    QHash<QString, qint32>::const_iterator cancelled = _cancelledTrips.constFind(tripID);
+    if (cancelled != _cancelledTrips.constEnd()) {
+        status.inFeed    = true;
+        status.cancelled = startDateMatches(cancelled.value(), serviceDate, actualDate) ||
+                           (_entityOverlay[cancelled.value()].noStartDate && _allSkippedCan);
+    }
+
+    qint32 tripUpdateEntity;
+    bool   isSupplementalTrip;
+    if (!findEntityIndex(tripID, tripUpdateEntity, isSupplementalTrip)) {
+        return;
+    }
+    status.inFeed = true;
+
+    status.vehicle = _entityOverlay[tripUpdateEntity].vehicle;
+
+    // Only a scheduled trip (active trip update) can be running, skip stops or have passed the stop already
+    QHash<QString, qint32>::const_iterator active = _activeTrips.constFind(tripID);
+    if (active == _activeTrips.constEnd() || !startDateMatches(active.value(), serviceDate, actualDate)) {
+        return;
+    }
+    status.running    = true;
+    status.rtDateUsed = serviceDate;
+
+    const rtTripOverlay &overlay = _entityOverlay[active.value()];
+    if (overlay.skippedStops.contains(stopID)) {
+        status.skipsStop = _loosenStopSeqEnf ||
+                           (stopSeq >= 0 && stopSeq <= std::numeric_limits<quint32>::max() &&
+                            overlay.skippedStops.contains(stopID, static_cast<quint32>(stopSeq)));
+    }
+
+    const transit_realtime::TripUpdate &act = _tripUpdate.entity(active.value()).trip_update();
+    if (act.stop_time_update_size() > 0 && !_loosenStopSeqEnf && act.stop_time_update(0).has_stop_sequence() &&
+        act.stop_time_update(0).stop_sequence() > stopSeq) {
+        status.alreadyPassed = true;
+    }
+
+    // Predictions are of no use for a trip which will not serve the stop
+    if (status.cancelled || status.skipsStop || status.alreadyPassed) {
+        return;
+    }
+    entityStopActualTime(tripUpdateEntity, tripID, stopSeq, stopID, agencyTZ, tripTimes, serviceDate,
+                         status.predArrUTC, status.predDepUTC);
+}
+
 void RealTimeTripUpdate::tripStopActualTime(const QString              &tripID,
                                             qint64                      stopSeq,
                                             const QString              &stop_id,
@@ -327,32 +385,29 @@ void RealTimeTripUpdate::tripStopActualTime(const QString              &tripID,
     if (!findEntityIndex(tripID, tripUpdateEntity, isSupplementalTrip)) {
         return;
     }
+    entityStopActualTime(tripUpdateEntity, tripID, stopSeq, stop_id, agencyTZ, tripTimes, serviceDate,
+                         realArrTimeUTC, realDepTimeUTC);
+}
+
+void RealTimeTripUpdate::entityStopActualTime(qint32                      tripUpdateEntity,
+                                              const QString              &tripID,
+                                              qint64                      stopSeq,
+                                              const QString              &stop_id,
+                                              const QTimeZone            &agencyTZ,
+                                              const QVector<StopTimeRec> &tripTimes,
+                                              const QDate                &serviceDate,
+                                              QDateTime                  &realArrTimeUTC,
+                                              QDateTime                  &realDepTimeUTC) const
+{
     const transit_realtime::TripUpdate &tri = _tripUpdate.entity(tripUpdateEntity).trip_update();
 
     /*
      * STEP 2) Trip Update has POSIX timestamps: no need to fill entire trip with predictions with offset extrapolation
      *         Find the matching stop in the realtime feed so the times may be filled
      */
-    qint32 rtSTUpd;
-    for (rtSTUpd = 0; rtSTUpd < tri.stop_time_update_size(); ++rtSTUpd) {
-        // Despite the specification indicating otherwise, it is possible that stop sequences do not match the static
-        // schedule. So this is put in place to ensure that the sequence is in line. Should there be a mismatch, then
-        // a different check (based ONLY on the stop ID) may be attempted. It is not guaranteed to be "as good",
-        // especially if a trip visits the same stop more than once.
-        // Discovered with CTTransit data, but Google Maps rendering seems to figure it out whereas GtfsProc didn't.
-        // (for quality assurance, these kinds of trips will still be considered mimatches as they violate spec)
-        QString stopIdRT = QString::fromStdString(tri.stop_time_update(rtSTUpd).stop_id());
-        if ((!tri.stop_time_update(rtSTUpd).has_stop_sequence() || _loosenStopSeqEnf) && stop_id == stopIdRT) {
-            // Trip Update has no stop sequence information, just match the stop ID
-            break;
-        } else if (tri.stop_time_update(rtSTUpd).has_stop_sequence() &&
-                   stopSeq == tri.stop_time_update(rtSTUpd).stop_sequence()) {
-            // Match Stop ID and Stop Sequence when both are provided
-            break;
-        }
-    }
+    qint32 rtSTUpd = findStopTimeUpdateIdx(tripUpdateEntity, stopSeq, stop_id);
 
-    if (rtSTUpd < tri.stop_time_update_size()) {
+    if (rtSTUpd != -1) {
         if ((tri.stop_time_update(rtSTUpd).has_arrival()   && tri.stop_time_update(rtSTUpd).arrival().has_time()) ||
             (tri.stop_time_update(rtSTUpd).has_departure() && tri.stop_time_update(rtSTUpd).departure().has_time())) {
             QDateTime arrTimeDummy, depTimeDummy;
@@ -370,9 +425,23 @@ void RealTimeTripUpdate::tripStopActualTime(const QString              &tripID,
 
     /*
      * STEP 3) It was not possible to match an exact sequence or stop ID. Trip may have offsets that can propagate
-     *         for a running trip to the rest of its stop IDs. Use the RTR transactions stop-times-for-trip function
-     *         to determine the date/times based on those offsets if possible.
+     *         for a running trip to the rest of its stop IDs. These were predicted for every stop of an active trip
+     *         when the feed was integrated, so the requested stop is simply looked up.
      */
+    const rtTripOverlay &overlay = _entityOverlay[tripUpdateEntity];
+    if (_activeTrips.value(tripID, -1) == tripUpdateEntity && !_addedTrips.contains(tripID) &&
+        overlay.predictions.size() == tripTimes.size() && serviceDate.isValid()) {
+        qint32 stopPos = predictedStopPos(overlay, tripTimes, stopSeq, stop_id);
+        if (stopPos != -1) {
+            const QDateTime        localNoon = QDateTime(serviceDate, QTime(12, 0, 0), agencyTZ);
+            const rtPredictedStop &predicted = overlay.predictions.at(stopPos);
+            realArrTimeUTC = predictedTime(predicted.arrTime, predicted.arrBased, localNoon);
+            realDepTimeUTC = predictedTime(predicted.depTime, predicted.depBased, localNoon);
+        }
+        return;
+    }
+
+    // Otherwise use the RTR transactions stop-times-for-trip function to determine the date/times from the offsets
     QVector<rtStopTimeUpdate> rtStopTimes;
     fillStopTimesForTrip(TRIPID_RECONCILE, -1, tripID, agencyTZ, serviceDate, tripTimes, rtStopTimes);
 
@@ -485,72 +554,28 @@ void RealTimeTripUpdate::fillStopTimesForTrip(rtUpdateMatch               realTi
 
     const transit_realtime::TripUpdate &tri = _tripUpdate.entity(tripUpdateEntity).trip_update();
 
-    QDateTime localNoon = QDateTime(serviceDate, QTime(12, 0, 0), agencyTZ);
-
     // If this is not a supplemental trip, then we can match 1-to-1 the offsets or POSIX timestamps to the trip and
-    // render the entire thing, showing the schedule vs. prediction for each stop along the trip
+    // render the entire thing, showing the schedule vs. prediction for each stop along the trip (as predicted when the
+    // feed was integrated, unless the trip's service day is not well-formed)
     if (!supplementalStyle) {
-        bool   tripUsesOffset  = false;
-        qint32 lastKnownOffset = 0;
-        for (const StopTimeRec &stopRec : tripTimes) {
-            rtStopTimeUpdate stu;
-            stu.stopSequence = -1;
-
-            // Find the first real-time trip update that pertains to the schedule
-            qint32 stUpdIdx = getStopTimeUpdateIdx(tri, stopRec, stu);
-
-            // Fill in the stop ID
-            stu.stopID = stopRec.stop_id;
-            stu.stopSequence = stopRec.stop_sequence;
-
-            // Retrieve scheduled time for storage
-            QDateTime schArrTime = localNoon.addSecs(stopRec.arrival_time);
-            QDateTime schDepTime = localNoon.addSecs(stopRec.departure_time);
-
-            // With the stop/sequence matched, fill in the matched time (POSIX-style or offset) directly
-            if (stUpdIdx != -1 && stUpdIdx < tri.stop_time_update_size()) {
-                // Determine if offset-in-seconds are used at all, save once it is found in case it needs extrapolation
-                // For the purposes of propagation to the remaining itinerary, the DEPARTURE should be preferred
-                if (tri.stop_time_update(stUpdIdx).has_arrival() &&
-                    tri.stop_time_update(stUpdIdx).arrival().has_delay()) {
-                    lastKnownOffset = tri.stop_time_update(stUpdIdx).arrival().delay();
-                    tripUsesOffset  = true;
-                }
-                if (tri.stop_time_update(stUpdIdx).has_departure() &&
-                    tri.stop_time_update(stUpdIdx).departure().has_delay()) {
-                    lastKnownOffset = tri.stop_time_update(stUpdIdx).departure().delay();
-                    tripUsesOffset  = true;
-                }
-
-                // Fill the known offsets for this matched stop
-                fillPredictedTime(tri.stop_time_update(stUpdIdx), schArrTime, schDepTime, false,
-                                  stu.arrTime, stu.depTime, stu.arrOffset, stu.depOffset, stu.arrBased, stu.depBased);
-
-                // The stop may be skipped
-                stu.stopSkipped = tri.stop_time_update(stUpdIdx).schedule_relationship() ==
-                                  transit_realtime::TripUpdate_StopTimeUpdate_ScheduleRelationship_SKIPPED;
-            }
-
-            // But if no match was found AND offset-in-seconds is used, try and fill with what we had before
-            else {
-                if (tripUsesOffset) {
-                    // Try and fill in based on the last-known offsets
-                    stu.arrBased     = 'E';
-                    stu.depBased     = 'E';
-                    stu.arrTime      = schArrTime.addSecs(lastKnownOffset);
-                    stu.depTime      = schDepTime.addSecs(lastKnownOffset);
-                    stu.stopSkipped  = false;
-                } else {
-                    // Only POSIX-times were used, so we cannot extrapolate offsets to the rest of the trip
-                    stu.arrBased     = 'N';
-                    stu.depBased     = 'N';
-                    stu.arrTime      = QDateTime();
-                    stu.depTime      = QDateTime();
-                    stu.stopSkipped  = false;
-                }
-            }
+        const QVector<rtPredictedStop> &predictions = _entityOverlay[tripUpdateEntity].predictions;
+        if (predictions.size() != tripTimes.size() || !serviceDate.isValid()) {
+            reconcileStopTimes(tripUpdateEntity, agencyTZ, serviceDate, tripTimes, rtStopTimes);
+            return;
+        }
 
-            // Save the information for this trip
+        QDateTime localNoon = QDateTime(serviceDate, QTime(12, 0, 0), agencyTZ);
+        rtStopTimes.reserve(rtStopTimes.size() + tripTimes.size());
+        for (qint32 stopPos = 0; stopPos < tripTimes.size(); ++stopPos) {
+            const rtPredictedStop &predicted = predictions.at(stopPos);
+            rtStopTimeUpdate stu;
+            stu.stopID       = tripTimes.at(stopPos).stop_id;
+            stu.stopSequence = tripTimes.at(stopPos).stop_sequence;
+            stu.arrTime      = predictedTime(predicted.arrTime, predicted.arrBased, localNoon);
+            stu.depTime      = predictedTime(predicted.depTime, predicted.depBased, localNoon);
+            stu.arrBased     = predicted.arrBased;
+            stu.depBased     = predicted.depBased;
+            stu.stopSkipped  = predicted.stopSkipped;
             rtStopTimes.push_back(stu);
         }
     }
@@ -566,7 +591,7 @@ void RealTimeTripUpdate::fillStopTimesForTrip(rtUpdateMatch               realTi
                 stu.stopSequence = tri.stop_time_update(stUpdIdx).stop_sequence();
             }
             if (tri.stop_time_update(stUpdIdx).has_stop_id()) {
-                stu.stopID = QString::fromStdString(tri.stop_time_update(stUpdIdx).stop_id());
+                stu.stopID = _entityOverlay[tripUpdateEntity].stopIDs.at(stUpdIdx);
             }
 
             // Get arrival/departure times based on POSIX timestamps
@@ -586,6 +611,81 @@ void RealTimeTripUpdate::fillStopTimesForTrip(rtUpdateMatch               realTi
     }
 }
 
+void RealTimeTripUpdate::reconcileStopTimes(qint32                      tripUpdateEntity,
+                                            const QTimeZone            &agencyTZ,
+                                            const QDate                &serviceDate,
+                                            const QVector<StopTimeRec> &tripTimes,
+                                            QVector<rtStopTimeUpdate>  &rtStopTimes) const
+{
+    const transit_realtime::TripUpdate &tri = _tripUpdate.entity(tripUpdateEntity).trip_update();
+
+    QDateTime localNoon = QDateTime(serviceDate, QTime(12, 0, 0), agencyTZ);
+
+    bool   tripUsesOffset  = false;
+    qint32 lastKnownOffset = 0;
+    for (const StopTimeRec &stopRec : tripTimes) {
+        rtStopTimeUpdate stu;
+        stu.stopSequence = -1;
+
+        // Find the first real-time trip update that pertains to the schedule
+        qint32 stUpdIdx = getStopTimeUpdateIdx(tripUpdateEntity, stopRec, stu);
+
+        // Fill in the stop ID
+        stu.stopID = stopRec.stop_id;
+        stu.stopSequence = stopRec.stop_sequence;
+
+        // Retrieve scheduled time for storage
+        QDateTime schArrTime = localNoon.addSecs(stopRec.arrival_time);
+        QDateTime schDepTime = localNoon.addSecs(stopRec.departure_time);
+
+        // With the stop/sequence matched, fill in the matched time (POSIX-style or offset) directly
+        if (stUpdIdx != -1 && stUpdIdx < tri.stop_time_update_size()) {
+            // Determine if offset-in-seconds are used at all, save once it is found in case it needs extrapolation
+            // For the purposes of propagation to the remaining itinerary, the DEPARTURE should be preferred
+            if (tri.stop_time_update(stUpdIdx).has_arrival() &&
+                tri.stop_time_update(stUpdIdx).arrival().has_delay()) {
+                lastKnownOffset = tri.stop_time_update(stUpdIdx).arrival().delay();
+                tripUsesOffset  = true;
+            }
+            if (tri.stop_time_update(stUpdIdx).has_departure() &&
+                tri.stop_time_update(stUpdIdx).departure().has_delay()) {
+                lastKnownOffset = tri.stop_time_update(stUpdIdx).departure().delay();
+                tripUsesOffset  = true;
+            }
+
+            // Fill the known offsets for this matched stop
+            fillPredictedTime(tri.stop_time_update(stUpdIdx), schArrTime, schDepTime, false,
+                              stu.arrTime, stu.depTime, stu.arrOffset, stu.depOffset, stu.arrBased, stu.depBased);
+
+            // The stop may be skipped
+            stu.stopSkipped = tri.stop_time_update(stUpdIdx).schedule_relationship() ==
+                              transit_realtime::TripUpdate_StopTimeUpdate_ScheduleRelationship_SKIPPED;
+        }
+
+        // But if no match was found AND offset-in-seconds is used, try and fill with what we had before
+        else {
+            if (tripUsesOffset) {
+                // Try and fill in based on the last-known offsets
+                stu.arrBased     = 'E';
+                stu.depBased     = 'E';
+                stu.arrTime      = schArrTime.addSecs(lastKnownOffset);
+                stu.depTime      = schDepTime.addSecs(lastKnownOffset);
+                stu.stopSkipped  = false;
+            } else {
+                // Only POSIX-times were used, so we cannot extrapolate offsets to the rest of the trip
+                stu.arrBased     = 'N';
+                stu.depBased     = 'N';
+                stu.arrTime      = QDateTime();
+                stu.depTime      = QDateTime();
+                stu.stopSkipped  = false;
+            }
+        }
+
+        // Save the information for this trip
+        rtStopTimes.push_back(stu);
+    }
+}
+
 const QString RealTimeTripUpdate::getOperatingVehicle(const QString &tripID) const
 {
     qint32 tripUpdateEntity;
@@ -594,8 +694,7 @@ const QString RealTimeTripUpdate::getOperatingVehicle(const QString &tripID) con
         return "";
     }
 
-    const transit_realtime::TripUpdate &tri = _tripUpdate.entity(tripUpdateEntity).trip_update();
-    return QString::fromStdString(tri.vehicle().label());
+    return _entityOverlay[tripUpdateEntity].vehicle;
 }
 
 quint32 RealTimeTripUpdate::getDirectionId(const QString &tripID) const
@@ -630,8 +729,7 @@ const QString RealTimeTripUpdate::getTripStartTime(const QString &tripID) const
         return "";
     }
 
-    const transit_realtime::TripUpdate &tri = _tripUpdate.entity(tripUpdateEntity).trip_update();
-    return QString::fromStdString(tri.trip().start_time());
+    return _entityOverlay[tripUpdateEntity].startTime;
 }
 
 const QString RealTimeTripUpdate::getTripStartDate(const QString &tripID) const
@@ -642,8 +740,7 @@ const QString RealTimeTripUpdate::getTripStartDate(const QString &tripID) const
         return "";
     }
 
-    const transit_realtime::TripUpdate &tri = _tripUpdate.entity(tripUpdateEntity).trip_update();
-    return QString::fromStdString(tri.trip().start_date());
+    return _entityOverlay[tripUpdateEntity].startDateStr;
 }
 
 void RealTimeTripUpdate::getAllTripsWithPredictions(QHash<QString, QVector<QString>> &addedRouteTrips,
@@ -654,47 +751,23 @@ void RealTimeTripUpdate::getAllTripsWithPredictions(QHash<QString, QVector<QStri
                                                     QList<QString> &tripsWithoutRoutes) const
 {
     for (const QString &tripID : _addedTrips.keys()) {
-        const transit_realtime::FeedEntity &entity = _tripUpdate.entity(_addedTrips[tripID]);
-        QString qRouteId;
-        if (entity.trip_update().trip().has_route_id()) {
-            qRouteId = QString::fromStdString(entity.trip_update().trip().route_id());
-        } else if (_tripDB->contains(tripID)) {
-            qRouteId = (*_tripDB)[tripID].route_id;
-        }
+        const QString &qRouteId = _entityOverlay[_addedTrips[tripID]].routeID;
         addedRouteTrips[qRouteId].push_back(tripID);
     }
 
     for (const QString &tripID : _activeTrips.keys()) {
-        const transit_realtime::FeedEntity &entity = _tripUpdate.entity(_activeTrips[tripID]);
-        QString qRouteId;
-        if (entity.trip_update().trip().has_route_id()) {
-            qRouteId = QString::fromStdString(entity.trip_update().trip().route_id());
-        } else if (_tripDB->contains(tripID)) {
-            qRouteId = (*_tripDB)[tripID].route_id;
-        }
+        const QString &qRouteId = _entityOverlay[_activeTrips[tripID]].routeID;
         activeRouteTrips[qRouteId].push_back(tripID);
     }
 
     for (const QString &tripID : _cancelledTrips.keys()) {
-        const transit_realtime::FeedEntity &entity = _tripUpdate.entity(_cancelledTrips[tripID]);
-        QString qRouteId;
-        if (entity.trip_update().trip().has_route_id()) {
-            qRouteId = QString::fromStdString(entity.trip_update().trip().route_id());
-        } else if (_tripDB->contains(tripID)) {
-            qRouteId = (*_tripDB)[tripID].route_id;
-        }
+        const QString &qRouteId = _entityOverlay[_cancelledTrips[tripID]].routeID;
         cancelledRouteTrips[qRouteId].push_back(tripID);
     }
 
     for (const QString &tripID : _duplicateTrips.keys()) {
         for (qint32 rttuIdx : _duplicateTrips[tripID]) {
-            const transit_realtime::FeedEntity &entity = _tripUpdate.entity(rttuIdx);
-            QString qRouteId = "";
-            if (entity.trip_update().trip().has_route_id()) {
-                qRouteId = QString::fromStdString(entity.trip_update().trip().route_id());
-            } else if (_tripDB->contains(tripID)) {
-                qRouteId = (*_tripDB)[tripID].route_id;
-            }
+            const QString &qRouteId = _entityOverlay[rttuIdx].routeID;
             duplicateRTTrips[qRouteId][tripID].push_back(rttuIdx);
         }
     }
@@ -707,26 +780,14 @@ void RealTimeTripUpdate::getAllTripsWithPredictions(QHash<QString, QVector<QStri
 void RealTimeTripUpdate::getActiveTripsForRouteID(const QString &routeID, QVector<QString> &tripsForRoute) const
 {
     for (const QString &tripID : _addedTrips.keys()) {
-        const transit_realtime::FeedEntity &entity = _tripUpdate.entity(_addedTrips[tripID]);
-        QString qRouteId;
-        if (entity.trip_update().trip().has_route_id()) {
-            qRouteId = QString::fromStdString(entity.trip_update().trip().route_id());
-        } else if (_tripDB->contains(tripID)) {
-            qRouteId = (*_tripDB)[tripID].route_id;
-        }
+        const QString &qRouteId = _entityOverlay[_addedTrips[tripID]].routeID;
         if (routeID == qRouteId) {
             tripsForRoute.push_back(tripID);
         }
     }
 
     for (const QString &tripID : _activeTrips.keys()) {
-        const transit_realtime::FeedEntity &entity = _tripUpdate.entity(_activeTrips[tripID]);
-        QString qRouteId;
-        if (entity.trip_update().trip().has_route_id()) {
-            qRouteId = QString::fromStdString(entity.trip_update().trip().route_id());
-        } else if (_tripDB->contains(tripID)) {
-            qRouteId = (*_tripDB)[tripID].route_id;
-        }
+        const QString &qRouteId = _entityOverlay[_activeTrips[tripID]].routeID;
         if (routeID == qRouteId) {
             tripsForRoute.push_back(tripID);
         }
@@ -752,7 +813,7 @@ QString RealTimeTripUpdate::getTripIdFromEntity(quint64 realtimeTripUpdateEntity
     if (realtimeTripUpdateEntity >= this->getNbEntities()) {
         return "";
     }
-    return QString::fromStdString(_tripUpdate.entity(realtimeTripUpdateEntity).trip_update().trip().trip_id());
+    return _entityOverlay[realtimeTripUpdateEntity].tripID;
 }
 
 bool RealTimeTripUpdate::getLoosenStopSeqEnf() const
@@ -765,14 +826,51 @@ rtDateLevel RealTimeTripUpdate::getDateEnforcement() const
     return _dateEnforcement;
 }
 
-void RealTimeTripUpdate::processUpdateDetails(const QDateTime &startProcTimeUTC)
+void RealTimeTripUpdate::processUpdateDetails(const QDateTime &startProcTimeUTC, const RealTimeTripUpdate *previousFeed)
 {
-    // Process every trip update entity
-    for (qint32 recIdx = 0; recIdx < _tripUpdate.entity_size(); ++recIdx) {
-        const transit_realtime::FeedEntity &entity = _tripUpdate.entity(recIdx);
+    /*
+     * Resolving and classifying an entity (which category it belongs to, whether its route is missing or mismatching)
+     * only depends on the entity itself and the static feed, so the entities are split into contiguous partitions
+     * which are processed concurrently, each worker writing exclusively to the overlays of its own partition. The merge
+     * afterwards walks the entities in order so that duplicate detection (the first occurrence of a trip wins) is the
+     * same as if the whole feed had been processed sequentially.
+     *
+     * Consecutive feeds are mostly identical: an entity whose trip update is byte-for-byte the same as one from the
+     * previous feed takes that entity's overlay (and classification) rather than being resolved all over again.
+     *
+     * Active trips also have their times predicted at each of their static stops, so that requests for a trip's stop
+     * times (or for a single stop of it) no longer propagate the delays along the trip every time.
+     */
+    const qint32 nbEntities = _tripUpdate.entity_size();
+    QVector<rtEntityPartition> partitions;
+    splitPartitions(nbEntities, partitions);
+    _integrationThreads = partitions.size();
+
+    _entityOverlay.resize(nbEntities);
+    QtConcurrent::blockingMap(partitions, [this, previousFeed](rtEntityPartition &partition) {
+        for (qint32 recIdx = partition.firstIdx; recIdx < partition.endIdx; ++recIdx) {
+            if (reuseEntity(recIdx, previousFeed)) {
+                ++partition.reused;
+            } else {
+                resolveEntity(recIdx);
+                classifyEntity(recIdx);
+                predictEntity(recIdx);
+            }
+        }
+    });
+
+    _reusedEntities = 0;
+    for (const rtEntityPartition &partition : partitions) {
+        _reusedEntities += partition.reused;
+    }
+
+    // Merge the classifications in entity order
+    for (qint32 recIdx = 0; recIdx < nbEntities; ++recIdx) {
+        const rtTripOverlay &overlay = _entityOverlay.at(recIdx);
+        const QString       &tripID  = overlay.tripID;
+        _fingerprintIdx.insert(overlay.fingerprint, recIdx);
 
         // Each time a trip is attempted to be added, see if it was already added and save it's trip ID + route ID
-        QString tripID = QString::fromStdString(entity.trip_update().trip().trip_id());
         if (_addedTrips.contains(tripID)) {
             if (_duplicateTrips[tripID].empty()) {
                 // First discovery of a duplicate ... so add the original index comprising the duplicate
@@ -801,141 +899,427 @@ void RealTimeTripUpdate::processUpdateDetails(const QDateTime &startProcTimeUTC)
         }
 
         // Store a trip which does not contain the route information, or has a bad route ID
-        if (!entity.trip_update().trip().has_route_id() && !_tripDB->contains(tripID)) {
+        if (overlay.noRoute) {
             _noRouteTrips[tripID] = recIdx;
-            continue;
-        } else if (entity.trip_update().trip().has_route_id() && _tripDB->contains(tripID)) {
-            const QString routeFromTrip   = QString::fromStdString(entity.trip_update().trip().route_id());
-            const QString routeFromUpdate = (*_tripDB)[tripID].route_id;
-            if (!routeFromUpdate.isEmpty() && routeFromTrip != routeFromUpdate) {
-                _noRouteTrips[tripID] = recIdx;
-            }
-        } else if (entity.trip_update().trip().has_route_id() && !_tripDB->contains(tripID) &&
-                   !entity.trip_update().trip().has_schedule_relationship()) {
-            // Route is provided, but the referenced trip doesn't exist and is not supplemental/added
-            _noRouteTrips[tripID] = recIdx;
-            continue;
         }
 
         // Put the trip update into its relevant category
-        if (entity.trip_update().trip().schedule_relationship() ==
-            transit_realtime::TripDescriptor_ScheduleRelationship_ADDED) {
-            QString tripAdded = QString::fromStdString(entity.trip_update().trip().trip_id());
-            _addedTrips[tripAdded] = recIdx;
-        } else if (entity.trip_update().trip().schedule_relationship() ==
-            transit_realtime::TripDescriptor_ScheduleRelationship_CANCELED) {
-            QString tripCancelled = QString::fromStdString(entity.trip_update().trip().trip_id());
-            _cancelledTrips[tripCancelled] = recIdx;
-        } else {
-            QString tripRealTime = QString::fromStdString(entity.trip_update().trip().trip_id());
-
-            // Some agencies mark all the stops in a trip as skipped if they are actually canceled trips, but it's not
-            // a hard / accurate implementation of the GTFS specification, so this is optional.
-            if (_allSkippedCan) {
-                bool tripHasAllSkipped = false;
-                for (qint32 stopTimeIdx = 0; stopTimeIdx < entity.trip_update().stop_time_update_size(); ++stopTimeIdx) {
-                    const transit_realtime::TripUpdate_StopTimeUpdate &stopTime = entity.trip_update().
-                                                                                  stop_time_update(stopTimeIdx);
-                    if (stopTime.schedule_relationship() !=
-                        transit_realtime::TripUpdate_StopTimeUpdate_ScheduleRelationship_SKIPPED) {
-                        tripHasAllSkipped = true;
-                        break;
-                    }
-                }
-                if (!tripHasAllSkipped) {
-                    QString tripCancelled = QString::fromStdString(entity.trip_update().trip().trip_id());
-                    _cancelledTrips[tripCancelled] = recIdx;
-                    continue;
-                }
+        switch (overlay.category) {
+        case RT_ENTITY_ADDED:
+            _addedTrips[tripID] = recIdx;
+            break;
+        case RT_ENTITY_CANCELED:
+            _cancelledTrips[tripID] = recIdx;
+            break;
+        case RT_ENTITY_ACTIVE:
+            _activeTrips[tripID] = recIdx;
+            break;
+        case RT_ENTITY_UNUSABLE:
+            break;
+        }
+    }
+
+    // Index the added trips for the stop-level queries made by every NEX/NCF request
+    buildOverlay();
+
+    /*
+     * Post-Process the activeTrips and determine if unexpected stop_sequence or stop_ids are present. The trips are
+     * checked concurrently (each check is saved in the trip's own overlay, unless it was carried over from the previous
+     * feed) and then merged in the same order as the keys.
+     */
+    const QList<QString> activeTripIDs = _activeTrips.keys();
+    QVector<rtEntityPartition> mismatchPartitions;
+    splitPartitions(activeTripIDs.size(), mismatchPartitions);
+
+    QtConcurrent::blockingMap(mismatchPartitions, [this, &activeTripIDs](rtEntityPartition &partition) {
+        for (qint32 tripIdx = partition.firstIdx; tripIdx < partition.endIdx; ++tripIdx) {
+            const qint32   recIdx  = _activeTrips.value(activeTripIDs.at(tripIdx));
+            rtTripOverlay &overlay = _entityOverlay[recIdx];
+            if (!overlay.mismatchChecked) {
+                overlay.staticMismatch  = tripMismatchesStatic(recIdx);
+                overlay.mismatchChecked = true;
             }
+        }
+    });
 
-            // We consider this an active trip (not canceled), continue to check if stops are skipped
-            _activeTrips[tripRealTime] = recIdx;
+    // The RPS transaction will do a further breakdown per route, so let's to the breakdown here upon reading and not at
+    // every request.
+    for (const QString &tripID : activeTripIDs) {
+        if (_entityOverlay.at(_activeTrips.value(tripID)).staticMismatch) {
+            _stopsMismatchTrips[(*_tripDB)[tripID].route_id].push_back(tripID);
+        }
+    }
 
-            // For active trips which are scheduled, there is a chance that individual stops have been removed from
-            // the trip (running express / run-as-directed / etc.) so we should scan the stop_time_updates!
-            for (qint32 stopTimeIdx = 0; stopTimeIdx < entity.trip_update().stop_time_update_size(); ++stopTimeIdx) {
-                const transit_realtime::TripUpdate_StopTimeUpdate &stopTime = entity.trip_update().
-                                                                              stop_time_update(stopTimeIdx);
-                if (stopTime.schedule_relationship() ==
-                    transit_realtime::TripUpdate_StopTimeUpdate_ScheduleRelationship_SKIPPED) {
-                    QString qStopId = QString::fromStdString(stopTime.stop_id());
-                    QPair<QString, quint32> qTripId(QString::fromStdString(entity.trip_update().trip().trip_id()),
-                                                    stopTime.stop_sequence());
+    setIntegrationTimeMSec(startProcTimeUTC.msecsTo(QDateTime::currentDateTimeUtc()));
+}
 
-                    _skippedStops[qStopId].push_back(qTripId);
-                }
+google::protobuf::ArenaOptions RealTimeTripUpdate::arenaOptions(const RealTimeTripUpdate *previousFeed)
+{
+    // Consecutive feeds are about the same size: the arena is likely to hold the new feed in a single block
+    google::protobuf::ArenaOptions options;
+    size_t blockBytes = kMinArenaBlockBytes;
+    if (previousFeed != nullptr) {
+        blockBytes = qBound(kMinArenaBlockBytes, static_cast<size_t>(previousFeed->_arenaBytes), kMaxArenaBlockBytes);
+    }
+    options.start_block_size = blockBytes;
+    options.max_block_size   = qMax(blockBytes, options.max_block_size);
+    return options;
+}
+
+void RealTimeTripUpdate::splitPartitions(qint32 nbItems, QVector<rtEntityPartition> &partitions)
+{
+    // Small feeds are not worth the hand-off to the worker threads, so keep a reasonable amount of work per partition
+    qint32 nbPartitions = qBound(1, nbItems / kMinItemsPerPartition, QThread::idealThreadCount());
+    qint32 perPartition = nbItems / nbPartitions;
+    qint32 remainder    = nbItems % nbPartitions;
+
+    qint32 firstIdx = 0;
+    for (qint32 partIdx = 0; partIdx < nbPartitions; ++partIdx) {
+        rtEntityPartition partition;
+        partition.firstIdx = firstIdx;
+        partition.endIdx   = firstIdx + perPartition + (partIdx < remainder ? 1 : 0);
+        partition.reused   = 0;
+        firstIdx = partition.endIdx;
+        partitions.push_back(partition);
+    }
+}
+
+bool RealTimeTripUpdate::reuseEntity(qint32 recIdx, const RealTimeTripUpdate *previousFeed)
+{
+    // The trip update is fingerprinted whether or not there is a previous feed, so the next feed may use this one
+    std::string tripUpdateBytes;
+    _tripUpdate.entity(recIdx).trip_update().SerializeToString(&tripUpdateBytes);
+    quint64 fingerprint = qHash(QByteArrayView(tripUpdateBytes.data(), tripUpdateBytes.size()), tripUpdateBytes.size());
+
+    if (previousFeed != nullptr) {
+        QHash<quint64, qint32>::const_iterator previous = previousFeed->_fingerprintIdx.constFind(fingerprint);
+        if (previous != previousFeed->_fingerprintIdx.constEnd() &&
+            previousFeed->_entityOverlay.at(previous.value()).byteSize == static_cast<qint64>(tripUpdateBytes.size())) {
+            // Fingerprints may collide: only the very same bytes make the same trip update
+            std::string previousBytes;
+            previousFeed->_tripUpdate.entity(previous.value()).trip_update().SerializeToString(&previousBytes);
+            if (previousBytes == tripUpdateBytes) {
+                _entityOverlay[recIdx] = previousFeed->_entityOverlay.at(previous.value());
+                return true;
             }
         }
     }
 
-    // Post-Process the activeTrips and determine if unexpected stop_sequence or stop_ids are present
-    for (const QString &tripID : _activeTrips.keys()) {
-        // Make a set of all stop_sequences and stop_ids for the trip from the static feed
-        QSet<qint64>  staticSequnces;
-        QSet<QString> staticStopIDs;
-        if (_stopTimeDB->contains(tripID)) {
-            for (const StopTimeRec &stopTimeItem : (*_stopTimeDB)[tripID]) {
-                staticSequnces.insert(stopTimeItem.stop_sequence);
-                staticStopIDs.insert(stopTimeItem.stop_id);
+    rtTripOverlay &overlay = _entityOverlay[recIdx];
+    overlay.fingerprint     = fingerprint;
+    overlay.byteSize        = tripUpdateBytes.size();
+    overlay.mismatchChecked = false;
+    overlay.staticMismatch  = false;
+    return false;
+}
+
+void RealTimeTripUpdate::classifyEntity(qint32 recIdx)
+{
+    const transit_realtime::TripDescriptor &trip    = _tripUpdate.entity(recIdx).trip_update().trip();
+    rtTripOverlay                          &overlay = _entityOverlay[recIdx];
+    overlay.noRoute  = false;
+    overlay.category = RT_ENTITY_UNUSABLE;
+
+    // Trips which do not contain the route information, or have a bad route ID
+    const QString &tripID = overlay.tripID;
+    if (!trip.has_route_id() && !_tripDB->contains(tripID)) {
+        overlay.noRoute = true;
+        return;
+    } else if (trip.has_route_id() && _tripDB->contains(tripID)) {
+        const QString &routeFromTrip   = overlay.rtRouteID;
+        const QString  routeFromUpdate = (*_tripDB)[tripID].route_id;
+        if (!routeFromUpdate.isEmpty() && routeFromTrip != routeFromUpdate) {
+            overlay.noRoute = true;
+        }
+    } else if (trip.has_route_id() && !_tripDB->contains(tripID) && !trip.has_schedule_relationship()) {
+        // Route is provided, but the referenced trip doesn't exist and is not supplemental/added
+        overlay.noRoute = true;
+        return;
+    }
+
+    if (trip.schedule_relationship() == transit_realtime::TripDescriptor_ScheduleRelationship_ADDED) {
+        overlay.category = RT_ENTITY_ADDED;
+    } else if (trip.schedule_relationship() == transit_realtime::TripDescriptor_ScheduleRelationship_CANCELED) {
+        overlay.category = RT_ENTITY_CANCELED;
+    } else {
+        // Some agencies mark all the stops in a trip as skipped if they are actually canceled trips, but it's not
+        // a hard / accurate implementation of the GTFS specification, so this is optional.
+        if (_allSkippedCan) {
+            const transit_realtime::TripUpdate &tri = _tripUpdate.entity(recIdx).trip_update();
+            bool tripHasAllSkipped = false;
+            for (qint32 stopTimeIdx = 0; stopTimeIdx < tri.stop_time_update_size(); ++stopTimeIdx) {
+                if (tri.stop_time_update(stopTimeIdx).schedule_relationship() !=
+                    transit_realtime::TripUpdate_StopTimeUpdate_ScheduleRelationship_SKIPPED) {
+                    tripHasAllSkipped = true;
+                    break;
+                }
+            }
+            if (!tripHasAllSkipped) {
+                overlay.category = RT_ENTITY_CANCELED;
+                return;
             }
         }
 
-        // The RPS transaction will do a further breakdown per route, so let's to the breakdown here
-        // upon reading and not at every request.
-        const transit_realtime::FeedEntity &entity = _tripUpdate.entity(_activeTrips[tripID]);
-        QString routeID = (*_tripDB)[tripID].route_id;
+        // We consider this an active trip (not canceled), skipped stops are indexed in the overlay
+        overlay.category = RT_ENTITY_ACTIVE;
+    }
+}
+
+void RealTimeTripUpdate::predictEntity(qint32 recIdx)
+{
+    rtTripOverlay &overlay = _entityOverlay[recIdx];
+    overlay.predictions.clear();
+    overlay.revisitsStops = false;
 
-        // If any sequences or stops in the real-time buffer are not in the static, flag this trip as mismatching
-        const transit_realtime::TripUpdate &tri = entity.trip_update();
-        for (qint32 stopTimeIdx = 0; stopTimeIdx < tri.stop_time_update_size(); ++stopTimeIdx) {
-            bool foundMismatch = false;
-            if (tri.stop_time_update(stopTimeIdx).has_stop_sequence()) {
-                if (!staticSequnces.contains(tri.stop_time_update(stopTimeIdx).stop_sequence())) {
-                    foundMismatch = true;
-                }
+    StopTimeData::const_iterator staticTrip = _stopTimeDB->constFind(overlay.tripID);
+    if (overlay.category != RT_ENTITY_ACTIVE || staticTrip == _stopTimeDB->constEnd()) {
+        return;
+    }
+
+    /*
+     * Same reconciliation as fillStopTimesForTrip would do for the trip, but with the times kept relative to noon of
+     * the service day: a matched stop takes its offsets (or POSIX times) and the last known offset is propagated to
+     * the stops which are not in the trip update.
+     */
+    const transit_realtime::TripUpdate &tri = _tripUpdate.entity(recIdx).trip_update();
+    QSet<QString> stopsServed;
+    bool          tripUsesOffset  = false;
+    qint32        lastKnownOffset = 0;
+    overlay.predictions.reserve(staticTrip.value().size());
+    for (const StopTimeRec &stopRec : staticTrip.value()) {
+        if (stopsServed.contains(stopRec.stop_id)) {
+            overlay.revisitsStops = true;
+        }
+        stopsServed.insert(stopRec.stop_id);
+
+        rtPredictedStop predicted;
+        predicted.arrTime     = 0;
+        predicted.depTime     = 0;
+        predicted.stopSkipped = false;
+
+        qint32 stUpdIdx = findStopTimeUpdateIdx(recIdx, stopRec.stop_sequence, stopRec.stop_id);
+        if (stUpdIdx != -1 && stUpdIdx < tri.stop_time_update_size()) {
+            const transit_realtime::TripUpdate_StopTimeUpdate &stu = tri.stop_time_update(stUpdIdx);
+            if (stu.has_arrival() && stu.arrival().has_delay()) {
+                lastKnownOffset = stu.arrival().delay();
+                tripUsesOffset  = true;
             }
-            if (tri.stop_time_update(stopTimeIdx).has_stop_id()) {
-                if (!staticStopIDs.contains(QString::fromStdString(tri.stop_time_update(stopTimeIdx).stop_id()))) {
-                    foundMismatch = true;
+            if (stu.has_departure() && stu.departure().has_delay()) {
+                lastKnownOffset = stu.departure().delay();
+                tripUsesOffset  = true;
+            }
+
+            // The arrival offset is extrapolated to the departure if the departure is not provided at all
+            predicted.arrBased = 'X';
+            predicted.depBased = 'X';
+            if (stu.has_arrival() && stu.arrival().has_delay()) {
+                predicted.arrTime  = static_cast<qint64>(stopRec.arrival_time) + stu.arrival().delay();
+                predicted.arrBased = 'O';
+                if (!stu.has_departure()) {
+                    predicted.depTime  = static_cast<qint64>(stopRec.departure_time) + stu.arrival().delay();
+                    predicted.depBased = 'E';
                 }
+            } else if (stu.has_arrival() && stu.arrival().has_time()) {
+                predicted.arrTime  = stu.arrival().time();
+                predicted.arrBased = 'P';
             }
-            if (foundMismatch) {
-                // Save the real-time trip-update's index, then move to the next
-                _stopsMismatchTrips[routeID].push_back(tripID);
-                break;
+            if (stu.has_departure() && stu.departure().has_delay()) {
+                predicted.depTime  = static_cast<qint64>(stopRec.departure_time) + stu.departure().delay();
+                predicted.depBased = 'O';
+            } else if (stu.has_departure() && stu.departure().has_time()) {
+                predicted.depTime  = stu.departure().time();
+                predicted.depBased = 'P';
             }
+
+            predicted.stopSkipped = stu.schedule_relationship() ==
+                                    transit_realtime::TripUpdate_StopTimeUpdate_ScheduleRelationship_SKIPPED;
+        } else if (tripUsesOffset) {
+            predicted.arrTime  = static_cast<qint64>(stopRec.arrival_time) + lastKnownOffset;
+            predicted.depTime  = static_cast<qint64>(stopRec.departure_time) + lastKnownOffset;
+            predicted.arrBased = 'E';
+            predicted.depBased = 'E';
+        } else {
+            predicted.arrBased = 'N';
+            predicted.depBased = 'N';
         }
+        overlay.predictions.push_back(predicted);
     }
+}
 
-    setIntegrationTimeMSec(startProcTimeUTC.msecsTo(QDateTime::currentDateTimeUtc()));
+QDateTime RealTimeTripUpdate::predictedTime(qint64 time, char based, const QDateTime &localNoon)
+{
+    if (based == 'O' || based == 'E') {
+        return localNoon.addSecs(time);
+    } else if (based == 'P') {
+        return QDateTime::fromSecsSinceEpoch(time, QTimeZone::utc());
+    }
+    return QDateTime();
+}
+
+qint32 RealTimeTripUpdate::predictedStopPos(const rtTripOverlay        &overlay,
+                                            const QVector<StopTimeRec> &tripTimes,
+                                            qint64                      stopSeq,
+                                            const QString              &stopID)
+{
+    // The static stop times are sorted by stop sequence, which finds the stop if the trip serves each stop only once
+    if (!overlay.revisitsStops) {
+        QVector<StopTimeRec>::const_iterator stopRec =
+            std::lower_bound(tripTimes.constBegin(), tripTimes.constEnd(), stopSeq,
+                             [](const StopTimeRec &rec, qint64 seq) { return rec.stop_sequence < seq; });
+        if (stopRec != tripTimes.constEnd() && stopRec->stop_sequence == stopSeq && stopRec->stop_id == stopID) {
+            return static_cast<qint32>(stopRec - tripTimes.constBegin());
+        }
+    }
+
+    // Otherwise the first visit of the stop is the one which is predicted
+    for (qint32 stopPos = 0; stopPos < tripTimes.size(); ++stopPos) {
+        if (tripTimes.at(stopPos).stop_id == stopID) {
+            return stopPos;
+        }
+    }
+    return -1;
+}
+
+bool RealTimeTripUpdate::tripMismatchesStatic(qint32 recIdx) const
+{
+    // Make a set of all stop_sequences and stop_ids for the trip from the static feed
+    const rtTripOverlay &overlay = _entityOverlay.at(recIdx);
+    QSet<qint64>  staticSequnces;
+    QSet<QString> staticStopIDs;
+    StopTimeData::const_iterator staticTrip = _stopTimeDB->constFind(overlay.tripID);
+    if (staticTrip != _stopTimeDB->constEnd()) {
+        for (const StopTimeRec &stopTimeItem : staticTrip.value()) {
+            staticSequnces.insert(stopTimeItem.stop_sequence);
+            staticStopIDs.insert(stopTimeItem.stop_id);
+        }
+    }
+
+    // If any sequences or stops in the real-time buffer are not in the static, flag this trip as mismatching
+    const transit_realtime::TripUpdate &tri = _tripUpdate.entity(recIdx).trip_update();
+    for (qint32 stopTimeIdx = 0; stopTimeIdx < tri.stop_time_update_size(); ++stopTimeIdx) {
+        if (tri.stop_time_update(stopTimeIdx).has_stop_sequence()) {
+            if (!staticSequnces.contains(tri.stop_time_update(stopTimeIdx).stop_sequence())) {
+                return true;
+            }
+        }
+        if (tri.stop_time_update(stopTimeIdx).has_stop_id()) {
+            if (!staticStopIDs.contains(overlay.stopIDs.at(stopTimeIdx))) {
+                return true;
+            }
+        }
+    }
+    return false;
 }
 
-qint32 RealTimeTripUpdate::getStopTimeUpdateIdx(const transit_realtime::TripUpdate &tri,
+void RealTimeTripUpdate::resolveEntity(qint32 recIdx)
+{
+    const transit_realtime::TripUpdate &tri = _tripUpdate.entity(recIdx).trip_update();
+    rtTripOverlay &overlay = _entityOverlay[recIdx];
+
+    // Scheduled trips share the static feed's trip ID, the route is resolved from the static trip if not provided
+    overlay.tripID    = QString::fromStdString(tri.trip().trip_id());
+    overlay.rtRouteID = QString::fromStdString(tri.trip().route_id());
+    TripData::const_iterator staticTrip = _tripDB->constFind(overlay.tripID);
+    if (staticTrip != _tripDB->constEnd()) {
+        overlay.tripID = staticTrip.key();
+    }
+    if (tri.trip().has_route_id()) {
+        overlay.routeID = overlay.rtRouteID;
+    } else if (staticTrip != _tripDB->constEnd()) {
+        overlay.routeID = staticTrip.value().route_id;
+    }
+
+    // Dates are matched as strings in the feed: only keep dates which render back to the exact same string
+    overlay.startDateStr = QString::fromStdString(tri.trip().start_date());
+    overlay.noStartDate  = overlay.startDateStr.isEmpty();
+    overlay.startDay     = kNoStartDay;
+    QDate startDate = QDate::fromString(overlay.startDateStr, "yyyyMMdd");
+    if (startDate.isValid() && startDate.toString("yyyyMMdd") == overlay.startDateStr) {
+        overlay.startDay = startDate.toJulianDay();
+    }
+    overlay.startTime = QString::fromStdString(tri.trip().start_time());
+    overlay.vehicle   = QString::fromStdString(tri.vehicle().label());
+
+    overlay.stopIDs.reserve(tri.stop_time_update_size());
+    for (qint32 stopTimeIdx = 0; stopTimeIdx < tri.stop_time_update_size(); ++stopTimeIdx) {
+        const transit_realtime::TripUpdate_StopTimeUpdate &stopTime = tri.stop_time_update(stopTimeIdx);
+        const QString stopID = QString::fromStdString(stopTime.stop_id());
+        overlay.stopIDs.push_back(stopID);
+
+        // Despite the specification indicating otherwise, it is possible that stop sequences do not match the
+        // static schedule. So a stop ID alone may be matched if the update has no sequence or the loosener is on.
+        // It is not guaranteed to be "as good", especially if a trip visits the same stop more than once.
+        // Discovered with CTTransit data, but Google Maps rendering seems to figure it out whereas GtfsProc didn't.
+        // (for quality assurance, these kinds of trips will still be considered mimatches as they violate spec)
+        if (stopTime.has_stop_sequence() && !overlay.seqToStu.contains(stopTime.stop_sequence())) {
+            overlay.seqToStu[stopTime.stop_sequence()] = stopTimeIdx;
+        }
+        if ((!stopTime.has_stop_sequence() || _loosenStopSeqEnf) && !overlay.stopToStu.contains(stopID)) {
+            overlay.stopToStu[stopID] = stopTimeIdx;
+        }
+
+        // For active trips which are scheduled, there is a chance that individual stops have been removed from
+        // the trip (running express / run-as-directed / etc.)
+        if (stopTime.schedule_relationship() ==
+            transit_realtime::TripUpdate_StopTimeUpdate_ScheduleRelationship_SKIPPED) {
+            overlay.skippedStops.insert(stopID, stopTime.stop_sequence());
+        }
+    }
+}
+
+void RealTimeTripUpdate::buildOverlay()
+{
+    // Every stop served by an added trip, in the same order a scan of the added trips would find them
+    for (const QString &tripID : _addedTrips.keys()) {
+        const qint32                        recIdx  = _addedTrips[tripID];
+        const transit_realtime::TripUpdate &tri     = _tripUpdate.entity(recIdx).trip_update();
+        const rtTripOverlay                &overlay = _entityOverlay[recIdx];
+        rtAddedStopEvent stopEvent;
+        stopEvent.tripID  = tripID;
+        stopEvent.routeID = overlay.rtRouteID;
+        for (qint32 stopTimeIdx = 0; stopTimeIdx < tri.stop_time_update_size(); ++stopTimeIdx) {
+            stopEvent.stopSequence = tri.stop_time_update(stopTimeIdx).stop_sequence();
+            _addedStopEvents[overlay.stopIDs.at(stopTimeIdx)].push_back(stopEvent);
+        }
+    }
+}
+
+bool RealTimeTripUpdate::startDateMatches(qint32 entityIdx, const QDate &serviceDate, const QDate &actualDate) const
+{
+    const qint64 rtStartDay = _entityOverlay[entityIdx].startDay;
+    return (_dateEnforcement == NO_MATCHING) ||
+           (_dateEnforcement == SERVICE_DATE && rtStartDay != kNoStartDay && rtStartDay == serviceDate.toJulianDay()) ||
+           (_dateEnforcement == ACTUAL_DATE  && rtStartDay != kNoStartDay && rtStartDay == actualDate.toJulianDay());
+}
+
+qint32 RealTimeTripUpdate::findStopTimeUpdateIdx(qint32 entityIdx, qint64 stopSeq, const QString &stopID) const
+{
+    // Whichever of the stop sequence or the stop ID matches first in the trip update is used
+    const rtTripOverlay &overlay = _entityOverlay[entityIdx];
+    qint32 stopIdx = overlay.stopToStu.value(stopID, -1);
+    qint32 seqIdx  = (stopSeq >= 0 && stopSeq <= std::numeric_limits<quint32>::max())
+                   ? overlay.seqToStu.value(static_cast<quint32>(stopSeq), -1)
+                   : -1;
+    if (stopIdx == -1) {
+        return seqIdx;
+    } else if (seqIdx == -1) {
+        return stopIdx;
+    }
+    return qMin(stopIdx, seqIdx);
+}
+
+qint32 RealTimeTripUpdate::getStopTimeUpdateIdx(qint32 entityIdx,
                                                 const StopTimeRec &stopRec,
                                                 rtStopTimeUpdate &stu) const
 {
-    bool foundIdx = false;
-    qint32 stUpdIdx;
-    for (stUpdIdx = 0; stUpdIdx < tri.stop_time_update_size(); ++stUpdIdx) {
-        // Stop-Sequences are preferred per the GTFS-Realtime specification, even if a stop_id is also present
-        // (should also enforce that the stop id matches the trip update contents)
-        QString stopIdRT = QString::fromStdString(tri.stop_time_update(stUpdIdx).stop_id());
-        if ((!tri.stop_time_update(stUpdIdx).has_stop_sequence() || _loosenStopSeqEnf) &&
-            (stopRec.stop_id == stopIdRT)) {
-            // Fill stop sequence from static feed, this could help clients debug in case wrong sequence/id
-            // matched when using the _loosenStopSeqEnf option has been requested.
-            stu.stopSequence = stopRec.stop_sequence;
-            foundIdx = true;
-            break;
-        } else if (tri.stop_time_update(stUpdIdx).has_stop_sequence() &&
-                   static_cast<quint32>(stopRec.stop_sequence) == tri.stop_time_update(stUpdIdx).stop_sequence()) {
-            stu.stopSequence = stopRec.stop_sequence;
-            foundIdx = true;
-            break;
-        }
+    // Stop-Sequences are preferred per the GTFS-Realtime specification, even if a stop_id is also present
+    qint32 stUpdIdx = findStopTimeUpdateIdx(entityIdx, stopRec.stop_sequence, stopRec.stop_id);
+    if (stUpdIdx != -1) {
+        // Fill stop sequence from static feed, this could help clients debug in case wrong sequence/id
+        // matched when using the _loosenStopSeqEnf option has been requested.
+        stu.stopSequence = stopRec.stop_sequence;
     }
-    return foundIdx ? stUpdIdx : -1;
+    return stUpdIdx;
 }
 
 void RealTimeTripUpdate::showProtobufData() const
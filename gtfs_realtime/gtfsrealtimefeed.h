@@ -29,8 +29,11 @@
 #include <QDate>
 #include <QDateTime>
 
+#include <memory>
+
 // And of course have a space for the protobuf
 #include "gtfs-realtime.pb.h"
+#include <google/protobuf/arena.h>
 
 // For feeds which do not use UNIX timestamps but instead just offsets, the static feed must be compared
 #include "gtfsstoptimes.h"
@@ -52,6 +55,72 @@ typedef struct {
     bool      stopSkipped;
 } rtStopTimeUpdate;
 
+// Category a trip update entity is placed into when the feed is integrated
+typedef enum {
+    RT_ENTITY_UNUSABLE = 0,  // Neither added nor scheduled (unknown trip without a route / schedule relationship)
+    RT_ENTITY_ADDED    = 1,
+    RT_ENTITY_CANCELED = 2,
+    RT_ENTITY_ACTIVE   = 3
+} rtEntityCategory;
+
+// Predicted times of an active trip at one of its static stops, computed once when the feed is integrated (the same
+// as fillStopTimesForTrip would reconcile them). Offset-based times are kept in seconds relative to local noon of the
+// service day, like the static stop times, since the day is only known to the request.
+typedef struct {
+    qint64 arrTime;     // Seconds relative to local noon ('O' / 'E'), or POSIX time ('P'), unused otherwise
+    qint64 depTime;     // Seconds relative to local noon ('O' / 'E'), or POSIX time ('P'), unused otherwise
+    char   arrBased;    // Same as rtStopTimeUpdate::arrBased
+    char   depBased;    // Same as rtStopTimeUpdate::depBased
+    bool   stopSkipped; // The stop_time_update matched is SKIPPED
+} rtPredictedStop;
+
+// Lookups into a single trip update entity, prepared once when the feed is integrated so that queries need not scan
+// the stop_time_updates nor convert any of the protobuf strings for every trip considered by every request
+typedef struct {
+    QString                      tripID;          // Trip ID (shares the static feed's key for scheduled trips)
+    QString                      rtRouteID;       // Route ID provided by the trip update (empty if missing)
+    QString                      routeID;         // Route ID of the trip update, otherwise that of the static trip
+    QString                      startDateStr;    // Trip start_date as provided by the trip update
+    qint64                       startDay;        // Trip start_date as a julian day (or kNoStartDay)
+    bool                         noStartDate;     // The start_date field is empty
+    QString                      startTime;       // Trip start_time as provided by the trip update
+    QString                      vehicle;         // Vehicle label operating the trip
+    QVector<QString>             stopIDs;         // Stop ID of each stop_time_update (empty if not provided)
+    QHash<quint32, qint32>       seqToStu;        // First stop_time_update index carrying each stop sequence
+    QHash<QString, qint32>       stopToStu;       // First stop_time_update index matchable by stop ID only
+    QMultiHash<QString, quint32> skippedStops;    // Stop IDs (and their stop sequence) marked as SKIPPED
+    quint64                      fingerprint;     // Hash of the serialized trip update (see reuseEntity)
+    qint64                       byteSize;        // Size of the serialized trip update
+    bool                         noRoute;         // Route information is missing or does not match the static feed
+    rtEntityCategory             category;        // Category the trip update is placed into
+    bool                         mismatchChecked; // The trip update was compared against the static feed's stops
+    bool                         staticMismatch;  // Stops / sequences absent from the static feed (if mismatchChecked)
+    QVector<rtPredictedStop>     predictions;     // Predicted times at each static stop of an active trip
+    bool                         revisitsStops;   // The static trip serves one of its stops more than once
+} rtTripOverlay;
+
+// A stop served by an added trip
+typedef struct {
+    QString tripID;
+    QString routeID;
+    quint32 stopSequence;
+} rtAddedStopEvent;
+
+// Everything the real-time feed knows about a scheduled trip at one of its stops, gathered in a single lookup of the
+// trip's entity (predicted times are only filled when the trip is running, serves the stop and has not passed it)
+typedef struct {
+    bool      inFeed;        // The trip has a trip update (or cancellation) in the feed
+    bool      supplemental;  // Added trip: there is no static schedule to fall back on (never set by getTripStopStatus)
+    bool      cancelled;     // Trip is cancelled (see tripIsCancelled)
+    bool      skipsStop;     // The stop is explicitly skipped (see tripSkipsStop)
+    bool      running;       // Scheduled trip is running (see scheduledTripIsRunning)
+    bool      alreadyPassed; // Trip has already gone through the stop (see scheduledTripAlreadyPassed)
+    QDate     rtDateUsed;    // Date used by the real-time feed when the trip is running
+    QDateTime predArrUTC;    // Predicted arrival at the stop (null if not available)
+    QDateTime predDepUTC;    // Predicted departure from the stop (null if not available)
+    QString   vehicle;       // Vehicle operating the trip (see getOperatingVehicle)
+} rtTripStopStatus;
+
 typedef enum {
     SERVICE_DATE = 0,
     ACTUAL_DATE  = 1,
@@ -64,6 +133,13 @@ typedef enum {
     RTTUIDX_FEED_ONLY = 2
 } rtUpdateMatch;
 
+// Contiguous range of items (entities or active trips) processed by a single worker thread while integrating the feed
+typedef struct {
+    qint32 firstIdx;
+    qint32 endIdx;    // One past the last item of the partition
+    qint32 reused;    // Entities carried over from the previous feed
+} rtEntityPartition;
+
 /*
  * RealTimeTripUpdate is the main interface to the GTFS Realtime feed information. This class Qt-ifies the ProtoBuf
  * data so that it is quicker to search and provide useful real-time trip data to which the static feeds can be
@@ -91,23 +167,20 @@ class RealTimeTripUpdate : public QObject
 {
     Q_OBJECT
 public:
-    explicit RealTimeTripUpdate(const QString      &rtPath,
-                                rtDateLevel         skipDateMatching,
-                                bool                loosenStopSeqEnf,
-                                bool                allSkippedCanceled,
-                                const TripData     *tripsDB,
-                                const StopTimeData *stopTimeDB,
-                                QObject            *parent = nullptr);
-    explicit RealTimeTripUpdate(const QByteArray   &gtfsRealTimeData,
-                                rtDateLevel         skipDateMatching,
-                                bool                loosenStopSeqEnf,
-                                bool                displayBufferInfo,
-                                bool                allSkippedCanceled,
-                                const TripData     *tripsDB,
-                                const StopTimeData *stopTimeDB,
-                                QObject            *parent = nullptr);
+    explicit RealTimeTripUpdate(const QByteArray         &gtfsRealTimeData,
+                                rtDateLevel               skipDateMatching,
+                                bool                      loosenStopSeqEnf,
+                                bool                      displayBufferInfo,
+                                bool                      allSkippedCanceled,
+                                const TripData           *tripsDB,
+                                const StopTimeData       *stopTimeDB,
+                                const RealTimeTripUpdate *previousFeed = nullptr,
+                                QObject                  *parent = nullptr);
     virtual ~RealTimeTripUpdate();
 
+    // Start day of a trip update entity without a (well-formed) start_date
+    const static qint64 kNoStartDay;
+
     /*
      * General status functions / diagnostics
      */
@@ -128,6 +201,16 @@ public:
     void setIntegrationTimeMSec(qint64 integrationTime);
     qint64 getIntegrationTimeMSec() const;
 
+    // Number of partitions the trip update entities were split into (and processed concurrently) during integration
+    qint32 getIntegrationThreads() const;
+
+    // Number of trip update entities carried over (unchanged) from the previous feed rather than integrated again
+    qint32 getReusedEntities() const;
+
+    // Time it took to parse the protobuf (milliseconds) and the memory its arena holds (bytes)
+    qint64 getParseTimeMSec() const;
+    quint64 getArenaBytes() const;
+
     /*
      * Stop-Route-Trip-Time calculation functions
      */
@@ -172,6 +255,18 @@ public:
     // full trip will need to be enumerated against the current system time using tripStopActualTime anyway.
     bool scheduledTripAlreadyPassed(const QString &trip_id, qint64 stopSeq) const;
 
+    // Fill the real-time status of a scheduled trip at a stop with a single lookup of its trip update: this gives the
+    // same answers as tripIsCancelled, tripSkipsStop, scheduledTripIsRunning, scheduledTripAlreadyPassed,
+    // tripStopActualTime and getOperatingVehicle would (predictions are only computed when they would be used)
+    void getTripStopStatus(const QString              &tripID,
+                           qint64                      stopSeq,
+                           const QString              &stopID,
+                           const QTimeZone            &agencyTZ,
+                           const QVector<StopTimeRec> &tripTimes,
+                           const QDate                &serviceDate,
+                           const QDate                &actualDate,
+                           rtTripStopStatus           &status) const;
+
     // What is the actual time of arrival? (returns the QDateTime in UTC of the actual arrival/departure times)
     // The service date (of an operating trip)
     // If no match was found, realArrTimeUTC/realDepTimeUTC will be NULL QDateTimes
@@ -258,18 +353,77 @@ private:
     /*
      * Helper functions
      */
-    // Once data is ingested (either from a byte array from a URL or a local file's fstream), the process to ingest
-    // trip updates is the same and encapsulated in this function to prevent previous code duplication
-    void processUpdateDetails(const QDateTime &startProcTimeUTC);
+    // Once data is ingested (either from a byte array from a URL or a local file mapped in memory), the process to
+    // ingest trip updates is the same and encapsulated in this function to prevent previous code duplication
+    // (entities identical to those of the previous feed, if one is provided, are carried over from it)
+    void processUpdateDetails(const QDateTime &startProcTimeUTC, const RealTimeTripUpdate *previousFeed);
+
+    // Arena for a new feed, starting with blocks sized after the memory the previous feed needed (if there is one)
+    static google::protobuf::ArenaOptions arenaOptions(const RealTimeTripUpdate *previousFeed);
+
+    // Convert everything queries need from a trip update entity into its overlay (safe to run concurrently)
+    void resolveEntity(qint32 recIdx);
+
+    // Predict the times of an active trip at each of its static stops (safe to run concurrently)
+    void predictEntity(qint32 recIdx);
+
+    // Predicted time at a stop of a trip whose service day has localNoon for its noon (null if there is none)
+    static QDateTime predictedTime(qint64 time, char based, const QDateTime &localNoon);
+
+    // Position of a stop in the static stop times of a trip, the first visit of the stop if it is served twice
+    static qint32 predictedStopPos(const rtTripOverlay        &overlay,
+                                   const QVector<StopTimeRec> &tripTimes,
+                                   qint64                      stopSeq,
+                                   const QString              &stopID);
+
+    // Build the added-trips-by-stop index once all trip updates are resolved and categorized
+    void buildOverlay();
+
+    // Split a number of items (entities or trips) into contiguous partitions, one per worker thread
+    static void splitPartitions(qint32 nbItems, QVector<rtEntityPartition> &partitions);
+
+    // Fingerprint an entity, then take the overlay of an identical entity from the previous feed if there is one
+    bool reuseEntity(qint32 recIdx, const RealTimeTripUpdate *previousFeed);
+
+    // Classify a resolved trip update entity (only reads its overlay and the static feed, safe to run concurrently)
+    void classifyEntity(qint32 recIdx);
+
+    // Does an active trip's update contain stop sequences or stop IDs which are absent from the static feed?
+    bool tripMismatchesStatic(qint32 recIdx) const;
+
+    // Does the start date of the trip update entity satisfy the date enforcement for the service / actual dates?
+    bool startDateMatches(qint32 entityIdx, const QDate &serviceDate, const QDate &actualDate) const;
+
+    // Index of the stop_time_update of an entity matching a stop sequence / stop ID (-1 if the stop is not updated)
+    qint32 findStopTimeUpdateIdx(qint32 entityIdx, qint64 stopSeq, const QString &stopID) const;
+
+    // Reconcile the stop times of a trip from its trip update, only for what was not predicted at integration (see
+    // fillStopTimesForTrip: a request for a trip without a well-formed service day)
+    void reconcileStopTimes(qint32                      tripUpdateEntity,
+                            const QTimeZone            &agencyTZ,
+                            const QDate                &serviceDate,
+                            const QVector<StopTimeRec> &tripTimes,
+                            QVector<rtStopTimeUpdate>  &rtStopTimes) const;
 
     // Determines the index within a trip to then fill the stop time update(s) for it
-    qint32 getStopTimeUpdateIdx(const transit_realtime::TripUpdate &tri,
+    qint32 getStopTimeUpdateIdx(qint32 entityIdx,
                                 const StopTimeRec &stopRec,
                                 rtStopTimeUpdate &stu) const;
 
     // Dump the protocol buffer real time update into QDebug
     void showProtobufData() const;
 
+    // Predicted times of a trip (already resolved to its trip update entity) at a stop, see tripStopActualTime
+    void entityStopActualTime(qint32                      entityIdx,
+                              const QString              &tripID,
+                              qint64                      stopSeq,
+                              const QString              &stop_id,
+                              const QTimeZone            &agencyTZ,
+                              const QVector<StopTimeRec> &tripTimes,
+                              const QDate                &serviceDate,
+                              QDateTime                  &realArrTimeUTC,
+                              QDateTime                  &realDepTimeUTC) const;
+
     // Checks the _addedTrips and _activeTrips fields and fills in the entityIdx with the position in the trip_update
     // FeedMessage. isSupplemental is filled with true if the trip came from the supplemental trips. A false is returned
     // in the event no entityIdx was found for the requested tripID.
@@ -281,14 +435,18 @@ private:
     const TripData                 *_tripDB;         // Trips Database for feeds which do not provide Route ID w/ Trips
     const StopTimeData             *_stopTimeDB;     // Stop-Times Database for sanity-checking real-time trip updates
 
-    transit_realtime::FeedMessage   _tripUpdate;     // Hold the raw protobuf here, but it is not optimized for reading
+    google::protobuf::Arena         _arena;          // Every protobuf object of the feed, released in one step
+    transit_realtime::FeedMessage  &_tripUpdate;     // Hold the raw protobuf here, but it is not optimized for reading
 
     QHash<QString, qint32>          _cancelledTrips; // Track cancelled trips with associated entity idx
     QHash<QString, qint32>          _addedTrips;     // Trips running which do not correspond to the GTFS Static data
     QHash<QString, qint32>          _activeTrips;    // Trips running with real-time data (to replace schedule times)
 
-    // Stop-IDs which have been skipped by any number of trips
-    QHash<QString, QVector<QPair<QString, quint32>>> _skippedStops;
+    // Overlay of every trip update entity (same indexing as the FeedMessage entities)
+    QVector<rtTripOverlay> _entityOverlay;
+
+    // Stop-IDs served by added trips, so added trips need not all be scanned at every request
+    QHash<QString, QVector<rtAddedStopEvent>> _addedStopEvents;
 
     /*
      * The early design decision to use route ID indexes means that anytime we have a duplicate trip ID (this could
@@ -313,12 +471,19 @@ private:
 
     qint64      _downloadTimeMSec;
     qint64      _integrationTimeMSec;
+    qint32      _integrationThreads;
+    qint32      _reusedEntities;
+    qint64      _parseTimeMSec;
+    quint64     _arenaBytes;
 
     rtDateLevel _dateEnforcement;   // Service / operating date enforcement level
     bool        _loosenStopSeqEnf;  // Match stop_id from static and realtime feeds regardless of stop seq (if provided)
     bool        _allSkippedCan;     // If a trip update is all skipped stops, consider it canceled
 };
 
+// A real-time feed held by a request (or published by the RealTimeGateway): freed once nothing holds it anymore
+typedef std::shared_ptr<const RealTimeTripUpdate> RealTimeFeedPin;
+
 } // namespace GTFS
 
 #endif // GTFSREALTIMEFEED_H
@@ -21,84 +21,231 @@
 #include "gtfsrealtimegateway.h"
 
 #include <QDateTime>
-#include <QTimer>
 #include <QEventLoop>
-#include <QtNetwork/QNetworkRequest>
-#include <QtNetwork/QNetworkReply>
+#include <QThread>
+#include <QtConcurrent>
 #include <QDebug>
 
+// Merged trip updates carry a header of their own
+#include "gtfs-realtime.pb.h"
+
 namespace GTFS {
 
+// Seconds without any real-time request after which fetching is idled
+const qint64 kIdleAfterSec = 180;
+
 RealTimeGateway &RealTimeGateway::inst()
 {
     static RealTimeGateway *_instance = nullptr;
     if (_instance == nullptr) {
         _instance = new RealTimeGateway();
-        _instance->_activeSide = DISABLED;
-        _instance->_sideA      = nullptr;
-        _instance->_sideB      = nullptr;
+
+        std::shared_ptr<RealTimeSnapshot> disabled = std::make_shared<RealTimeSnapshot>();
+        disabled->generation = 0;
+        disabled->idled      = false;
+        _instance->_published.store(new std::shared_ptr<const RealTimeSnapshot>(disabled));
+        _instance->_publishEpoch.store(0);
+        _instance->_epochReaders[0].store(0);
+        _instance->_epochReaders[1].store(0);
+        _instance->_trace            = false;
+        _instance->_staticFeedTripDB = nullptr;
+        _instance->_staticStopTimeDB = nullptr;
+        _instance->_skipDateMatching = SERVICE_DATE;
+        _instance->_loosenStopSeqEnf = false;
+        _instance->_allSkippedCan    = false;
+        _instance->_mergeWatcher     = nullptr;
+        _instance->_merging          = false;
+        _instance->_vehicleSource    = nullptr;
+        _instance->_alertSource      = nullptr;
+        _instance->_archive          = nullptr;
+        _instance->_replay           = nullptr;
     }
     return *_instance;
 }
 
-void RealTimeGateway::setRealTimeFeedPath(const QString      &realTimeFeedPath,
-                                          qint32              refreshIntervalSec,
-                                          rtDateLevel         rtDateMatchLevel,
-                                          bool                loosenStopSeqEnf,
-                                          bool                allSkippedCan,
-                                          bool                showDebugTrace,
-                                          const TripData     *tripsDB,
-                                          const StopTimeData *stopTimeDB)
+void RealTimeGateway::setRealTimeFeedPaths(const QStringList  &realTimeFeedPaths,
+                                           qint32              refreshIntervalSec,
+                                           qint32              fetchTimeoutSec,
+                                           rtDateLevel         rtDateMatchLevel,
+                                           bool                loosenStopSeqEnf,
+                                           bool                allSkippedCan,
+                                           bool                showDebugTrace,
+                                           const TripData     *tripsDB,
+                                           const StopTimeData *stopTimeDB)
 {
-    // TODO : Make this more robust?
-    if (realTimeFeedPath.startsWith("http://") || realTimeFeedPath.startsWith("https://")) {
-        _dataPathRemote = QUrl(realTimeFeedPath);
-        _feedNAM = new QNetworkAccessManager(this);
-    } else {
-        _dataPathRemote = QUrl();
-        _dataPathLocal = realTimeFeedPath;
-        _feedNAM = nullptr;
-    }
-
-    // Set how many seconds should elapse between data fetches
-    _refreshIntervalSec = refreshIntervalSec;
-
     // Upon the first call to setting the realtime path, the refresh should happen right away
-    _latestRealTimeTxn = _nextFetchTimeUTC = QDateTime::currentDateTimeUtc();
-
-    // Run-time matching and offset parameters
-    _skipDateMatching = rtDateMatchLevel;
+    _latestRealTimeTxn = QDateTime::currentDateTimeUtc();
 
     // Process traces
     _trace = showDebugTrace;
 
-    // Trip database
+    // Trip and stop times databases
     _staticFeedTripDB = tripsDB;
-
-    // Stop Times Database
     _staticStopTimeDB = stopTimeDB;
 
-    // Skip strict stop sequence and stop id matching when reconciling realtime and static feeds
+    // Run-time matching parameters
+    _skipDateMatching = rtDateMatchLevel;
     _loosenStopSeqEnf = loosenStopSeqEnf;
+    _allSkippedCan    = allSkippedCan;
+
+    // The trip updates of all the feeds are merged and integrated by a single worker, one merge at a time
+    _mergePool.setMaxThreadCount(1);
+    _mergeWatcher = new QFutureWatcher<RealTimeFeedPin>(this);
+    connect(_mergeWatcher, SIGNAL(finished()), SLOT(tripUpdatesMerged()));
+
+    // The sources of merged feeds only keep the data they fetch (and read its header), it is integrated once merged
+    RealTimeFeedSource::Integrator integrator = [](const RealTimeFetchedData &fetched,
+                                                   const RealTimeDataPin &) -> RealTimeIntegration {
+        std::shared_ptr<RealTimeFeedPayload> payload = std::make_shared<RealTimeFeedPayload>(fetched);
+
+        RealTimeIntegration integrated;
+        integrated.data          = payload;
+        integrated.feedTimePOSIX = payload->getFeedTimePOSIX();
+        return integrated;
+    };
+
+    // A single feed has nothing to be merged with: it is integrated by its source, parsed once from the data fetched
+    // (the mapping of a local file is released right after), carrying over what did not change since its previous feed
+    if (realTimeFeedPaths.size() == 1) {
+        integrator = [=](const RealTimeFetchedData &fetched, const RealTimeDataPin &previous) -> RealTimeIntegration {
+            RealTimeFeedPin previousFeed = std::static_pointer_cast<const RealTimeTripUpdate>(previous);
+            std::shared_ptr<RealTimeTripUpdate> nextFeed =
+                    std::make_shared<RealTimeTripUpdate>(fetched.data,
+                                                         rtDateMatchLevel,
+                                                         loosenStopSeqEnf,
+                                                         showDebugTrace,
+                                                         allSkippedCan,
+                                                         tripsDB,
+                                                         stopTimeDB,
+                                                         previousFeed.get());
+            nextFeed->setDownloadTimeMSec(fetched.downloadMSec);
+
+            RealTimeIntegration integrated;
+            integrated.data          = nextFeed;
+            integrated.feedTimePOSIX = nextFeed->getFeedTimePOSIX();
+            return integrated;
+        };
+    }
+
+    for (qint32 feedIdx = 0; feedIdx < realTimeFeedPaths.size(); ++feedIdx) {
+        QString name = (realTimeFeedPaths.size() == 1) ? QString("RTTU") : QString("RTTU%1").arg(feedIdx + 1);
+        RealTimeFeedSource *source = new RealTimeFeedSource(name, realTimeFeedPaths.at(feedIdx).trimmed(),
+                                                            refreshIntervalSec, fetchTimeoutSec, showDebugTrace,
+                                                            integrator, this);
+        connect(source, &RealTimeFeedSource::activated, this, [this, feedIdx](RealTimeDataPin data) {
+            tripUpdatesActivated(feedIdx, data);
+        });
+        connect(source, &RealTimeFeedSource::failed, this, [this, feedIdx]() {
+            tripUpdatesFailed(feedIdx);
+        });
+        _tripSources.push_back(source);
+        _tripPayloads.push_back(RealTimeFeedPayloadPin());
+    }
+}
 
-    // Assume a trip with all skipped stops is just canceled
-    _allSkippedCan = allSkippedCan;
+void RealTimeGateway::setVehiclePositionsPath(const QString &vehiclePositionsPath,
+                                              qint32         refreshIntervalSec,
+                                              qint32         fetchTimeoutSec)
+{
+    const TripData     *tripsDB    = _staticFeedTripDB;
+    const StopTimeData *stopTimeDB = _staticStopTimeDB;
+    bool                trace      = _trace;
+
+    // Vehicle positions are small and always integrated from scratch (the indexes are rebuilt each time)
+    RealTimeFeedSource::Integrator integrator = [=](const RealTimeFetchedData &fetched,
+                                                    const RealTimeDataPin &) -> RealTimeIntegration {
+        std::shared_ptr<RealTimeVehiclePositions> nextVehicles =
+                std::make_shared<RealTimeVehiclePositions>(fetched.data, trace, tripsDB, stopTimeDB);
+
+        RealTimeIntegration integrated;
+        integrated.data          = nextVehicles;
+        integrated.feedTimePOSIX = nextVehicles->getFeedTimePOSIX();
+        return integrated;
+    };
+
+    _vehicleSource = new RealTimeFeedSource("RTVP", vehiclePositionsPath, refreshIntervalSec, fetchTimeoutSec,
+                                            _trace, integrator, this);
+    connect(_vehicleSource, &RealTimeFeedSource::activated, this, &RealTimeGateway::vehiclesActivated);
+    connect(_vehicleSource, &RealTimeFeedSource::failed, this, &RealTimeGateway::vehiclesFailed);
 }
 
-qint64 RealTimeGateway::secondsToFetch() const
+void RealTimeGateway::setAlertsPath(const QString   &alertsPath,
+                                    qint32           refreshIntervalSec,
+                                    qint32           fetchTimeoutSec,
+                                    const RouteData *routesDB)
 {
-    return QDateTime::currentDateTimeUtc().secsTo(_nextFetchTimeUTC);
+    const TripData *tripsDB = _staticFeedTripDB;
+    bool            trace   = _trace;
+
+    // Alerts are few and always integrated from scratch (the indexes are rebuilt each time)
+    RealTimeFeedSource::Integrator integrator = [=](const RealTimeFetchedData &fetched,
+                                                    const RealTimeDataPin &) -> RealTimeIntegration {
+        std::shared_ptr<RealTimeAlerts> nextAlerts = std::make_shared<RealTimeAlerts>(fetched.data, trace,
+                                                                                      tripsDB, routesDB);
+
+        RealTimeIntegration integrated;
+        integrated.data          = nextAlerts;
+        integrated.feedTimePOSIX = nextAlerts->getFeedTimePOSIX();
+        return integrated;
+    };
+
+    _alertSource = new RealTimeFeedSource("RTSA", alertsPath, refreshIntervalSec, fetchTimeoutSec,
+                                          _trace, integrator, this);
+    connect(_alertSource, &RealTimeFeedSource::activated, this, &RealTimeGateway::alertsActivated);
+    connect(_alertSource, &RealTimeFeedSource::failed, this, &RealTimeGateway::alertsFailed);
+}
+
+void RealTimeGateway::setRecordPath(const QString &archivePath)
+{
+    _archive = new RealTimeArchiveWriter(archivePath, _trace, this);
+    if (!_archive->isOpen()) {
+        return;
+    }
+    for (RealTimeFeedSource *source : sources()) {
+        source->setArchive(_archive);
+    }
+}
+
+void RealTimeGateway::setReplayPath(const QString &archivePath, const QDateTime &startTime, double speed)
+{
+    _replay = new RealTimeFeedReplay(archivePath, startTime, speed, _trace, this);
+    connect(_replay, &RealTimeFeedReplay::clockAdvanced, this, &RealTimeGateway::replayClockAdvanced);
+
+    // A fetch is only replayed once the previous one was integrated and published (checked once the signals settle)
+    connect(this, &RealTimeGateway::tripUpdatesSettled, this, &RealTimeGateway::replaySettled, Qt::QueuedConnection);
+    for (RealTimeFeedSource *source : sources()) {
+        _replay->addSource(source);
+        connect(source, &RealTimeFeedSource::settled, this, &RealTimeGateway::replaySettled, Qt::QueuedConnection);
+    }
+}
+
+qint64 RealTimeGateway::secondsToFetch()
+{
+    QDateTime nextFetchUTC;
+    for (RealTimeFeedSource *source : qAsConst(_tripSources)) {
+        RealTimeSourceStatus status;
+        source->getStatus(status);
+        if (!status.nextFetchUTC.isNull() && (nextFetchUTC.isNull() || status.nextFetchUTC < nextFetchUTC)) {
+            nextFetchUTC = status.nextFetchUTC;
+        }
+    }
+    if (nextFetchUTC.isNull()) {
+        return 0;
+    }
+    return QDateTime::currentDateTimeUtc().secsTo(nextFetchUTC);
 }
 
 void RealTimeGateway::dataRetrievalLoop()
 {
-    // Setup the refetching
-    QTimer *dataTimer = new QTimer();
-    connect(dataTimer, SIGNAL(timeout()), SLOT(refetchData()));
+    // Each source's timer was armed by its initial fetch, which happened before the gateway moved to this thread
+    for (RealTimeFeedSource *source : sources()) {
+        source->startScheduling();
+    }
 
-    // Check interval is 5 seconds, but data will only refresh at the specified interval setting when not "idle"
-    // TODO: this could be more event driven maybe?
-    dataTimer->start(5000);
+    // The fetches recorded after the start of the replay follow on their own schedule
+    if (_replay != nullptr) {
+        _replay->start();
+    }
 }
 
 void RealTimeGateway::realTimeTransactionHandled()
@@ -106,193 +253,393 @@ void RealTimeGateway::realTimeTransactionHandled()
     _lock_lastRTTxn.lock();
     _latestRealTimeTxn = QDateTime::currentDateTimeUtc();
     _lock_lastRTTxn.unlock();
+
+    // The first real-time request since the fetching was idled wakes it up right away (only once, until it has run)
+    if (fetchingIdled() && _wakeRequested.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "wakeSources", Qt::QueuedConnection);
+    }
 }
 
-void RealTimeGateway::refetchData()
+void RealTimeGateway::initialFetch()
 {
-    QDateTime        currentUTC = QDateTime::currentDateTimeUtc();
-    RealTimeDataRepo current    = activeBuffer();
-    QDateTime        latestTxn  = mostRecentTransaction();
+    // Replayed sources start with the data they had at the start of the replay (and then fetch nothing themselves)
+    if (_replay != nullptr) {
+        _replay->initialReplay();
+    }
 
-    // Should the refresh even be attempted?
-    if (latestTxn.secsTo(currentUTC) > 180) {
-        if (current == IDLED) {
-            return;
-        }
+    for (RealTimeFeedSource *source : sources()) {
+        source->initialFetch();
+    }
 
-        // If no realtime requests have been sent recently (> 3 minutes), disable the realtime fetching
-        // Do not bother idling when using locally-sourced data (annoying for local testing when data disappears)
-        if (_dataPathLocal.isEmpty()) {
-            if (_trace) {
-                qDebug() << "  (RTTU) Last realtime request more than 3 minutes ago, stop fetching";
-            }
-            _nextFetchTimeUTC = QDateTime();
-            setActiveFeed(IDLED);
-            return;
+    // The trip updates fetched may still be merging
+    if (_merging) {
+        QEventLoop event;
+        connect(this, SIGNAL(tripUpdatesSettled()), &event, SLOT(quit()));
+        event.exec();
+    }
+}
+
+bool RealTimeGateway::idleIfUnused()
+{
+    // Do not bother idling when using locally-sourced data (annoying for local testing when data disappears), a replay
+    // is never idled either (it would no longer go through the recorded feeds)
+    if (_replay != nullptr) {
+        return false;
+    }
+    for (RealTimeFeedSource *source : sources()) {
+        if (source->isLocal()) {
+            return false;
         }
-    } else if (latestTxn.secsTo(currentUTC) <= 180 && current == IDLED) {
-        // Otherwise we will have to restart the retrieval
+    }
+
+    // Fetching carries on as long as realtime requests were sent recently (in the last 3 minutes)
+    if (mostRecentTransaction().secsTo(QDateTime::currentDateTimeUtc()) <= kIdleAfterSec) {
+        return false;
+    }
+
+    if (!fetchingIdled()) {
         if (_trace) {
-            qDebug() << "  (RTTU) Last realtime request less than 3 minutes ago, updates idled, start refetching";
+            qDebug() << "  (RTGW) Last realtime request more than 3 minutes ago, stop fetching";
+        }
+        for (RealTimeFeedSource *source : sources()) {
+            source->idle();
         }
-        _nextFetchTimeUTC = currentUTC;
+        _tripPayloads.fill(RealTimeFeedPayloadPin());
+        publish([](RealTimeSnapshot &next) {
+            next.idled    = true;
+            next.feed     = RealTimeFeedPin();
+            next.vehicles = RealTimeVehiclesPin();
+            next.alerts   = RealTimeAlertsPin();
+        });
+    }
+    return true;
+}
+
+void RealTimeGateway::wakeSources()
+{
+    _wakeRequested.storeRelease(0);
+    for (RealTimeFeedSource *source : sources()) {
+        source->wake();
     }
+}
 
-    // Make sure enough time has passed since the last refresh, otherwise just idle the thread again
-    // Due to OS thread scheduling, be a little permissive with the time (+/- 2 seconds) and not a STRICT compare
-    if (_nextFetchTimeUTC.isNull() || currentUTC.msecsTo(_nextFetchTimeUTC) > 2000) {
+void RealTimeGateway::replaySettled()
+{
+    if (_merging || !_pendingMerges.isEmpty()) {
         return;
     }
+    for (RealTimeFeedSource *source : sources()) {
+        if (!source->isSettled()) {
+            return;
+        }
+    }
+    _replay->previousSettled();
+}
 
-    if (_trace) {
-        qDebug() << "  (RTTU) Refetching realtime data at " << QDateTime::currentDateTimeUtc();
+void RealTimeGateway::tripUpdatesActivated(qint32 feedIdx, RealTimeDataPin data)
+{
+    // A single feed is integrated by its source, and published as it is
+    if (_tripSources.size() == 1) {
+        setActiveFeed(std::static_pointer_cast<const RealTimeTripUpdate>(data));
+        return;
     }
 
-    // We want to time how long the download
-    qint64 start = QDateTime::currentMSecsSinceEpoch();
+    _tripPayloads[feedIdx] = std::static_pointer_cast<const RealTimeFeedPayload>(data);
+    mergeTripUpdates();
+}
 
-    // Do the download into memory if required, otherwise we are in local file mode, so skip the download
-    QByteArray GtfsRealTimePB;
-    if (!_dataPathRemote.isEmpty()) {
-        QNetworkReply *response = _feedNAM->get(QNetworkRequest(_dataPathRemote));
-        QEventLoop     event;
-        QTimer         dataTimer = QTimer();
-        connect(&dataTimer, SIGNAL(timeout()), &event, SLOT(quit()));
-        connect(response, SIGNAL(finished()), &event, SLOT(quit()));
-        dataTimer.start(4000);                 // 4 seconds to download or we stop to clear for next check
-        event.exec();
-        GtfsRealTimePB = response->readAll();
-        response->deleteLater();               // Need to do this or else we leak memory from the QNetworkReply pointer
+void RealTimeGateway::tripUpdatesFailed(qint32 feedIdx)
+{
+    // Simply drop the trip updates of the feed, the other feeds are still merged (and published) without them
+    _tripPayloads[feedIdx] = RealTimeFeedPayloadPin();
+    for (const RealTimeFeedPayloadPin &payload : qAsConst(_tripPayloads)) {
+        if (payload != nullptr) {
+            mergeTripUpdates();
+            return;
+        }
     }
 
-    qint64 end   = QDateTime::currentMSecsSinceEpoch();
+    // Nothing left: drop the active feed. This should help the processor to not seek any realtime information, but will
+    // also prevent existing transactions not seg-fault. When a good feed is found, it is activated.
+    setActiveFeed(RealTimeFeedPin());
+}
 
-    // An empty GtfsRealTimePB is either because of an error or no data available. Either way, it's an error.
-    // Simply force the active side to disabled but leave the rest alone. This should help the processor to not seek
-    // any realtime information, but will also prevent existing transactions not seg-fault. When good data is found,
-    // the processor will start populating SIDE_A per the logic below for non-empty data.
-    // ... unless we have a local file, that is!
-    if (GtfsRealTimePB.isEmpty() && _dataPathLocal.isEmpty()) {
-        if (_trace) {
-            qDebug() << "  (RTTU) ERROR : Data feed was empty, setting active feed to DISABLED";
+void RealTimeGateway::mergeTripUpdates()
+{
+    // A replay publishes the exact sequence of feeds recorded: none of the changes are superseded while merging
+    QVector<RealTimeFeedPayloadPin> payloads;
+    for (const RealTimeFeedPayloadPin &payload : qAsConst(_tripPayloads)) {
+        if (payload != nullptr) {
+            payloads.push_back(payload);
         }
-        setActiveFeed(DISABLED);
-
-        // Try again at the standard refresh interval!
-        _nextFetchTimeUTC = QDateTime::currentDateTimeUtc().addMSecs(_refreshIntervalSec * 1000);
-        return;
     }
+    if (_replay == nullptr) {
+        _pendingMerges.clear();
+    }
+    _pendingMerges.enqueue(payloads);
+    if (!_merging) {
+        startMerge();
+    }
+}
 
-    // Non-empty data is considered valid: place the data in the correct buffer, then activate it when ready
-    try {
-        RealTimeDataRepo currentSide = activeBuffer();
-        RealTimeDataRepo nextSide    = DISABLED;
-        if (currentSide == DISABLED || currentSide == IDLED || currentSide == SIDE_B) {
-            // This **should** be safe enough. Most transactions should take < 250 ms, so nothing should be using the
-            // currently-inactive side by the time the next fetch occurs. Therefore only deleting the inactive side
-            // when it comes time to actually allocate into it again.
-            nextSide = SIDE_A;
-
-            if (_sideA != nullptr)
-                delete _sideA;
-
-            if (!_dataPathLocal.isNull()) {
-                _sideA = new RealTimeTripUpdate(_dataPathLocal,
-                                                _skipDateMatching,
-                                                _loosenStopSeqEnf,
-                                                _allSkippedCan,
-                                                _staticFeedTripDB,
-                                                _staticStopTimeDB);
-            } else {
-                _sideA = new RealTimeTripUpdate(GtfsRealTimePB,
-                                                _skipDateMatching,
-                                                _loosenStopSeqEnf,
-                                                _trace,
-                                                _allSkippedCan,
-                                                _staticFeedTripDB,
-                                                _staticStopTimeDB);
+void RealTimeGateway::startMerge()
+{
+    _merging = true;
+
+    /*
+     * The new feed is a snapshot of its own: requests still holding the currently-active feed keep on using it
+     * (however long they take), and it is only freed once the last of them is done. Entities which did not change
+     * since the active feed are carried over from it instead of integrated again (the worker holds on to it as well).
+     */
+    QVector<RealTimeFeedPayloadPin> payloads = _pendingMerges.dequeue();
+    RealTimeFeedPin     previousFeed     = getActiveFeed();
+    rtDateLevel         skipDateMatching = _skipDateMatching;
+    bool                loosenStopSeqEnf = _loosenStopSeqEnf;
+    bool                trace            = _trace;
+    bool                allSkippedCan    = _allSkippedCan;
+    const TripData     *tripsDB          = _staticFeedTripDB;
+    const StopTimeData *stopTimeDB       = _staticStopTimeDB;
+
+    QFuture<RealTimeFeedPin> merge = QtConcurrent::run(&_mergePool, [=]() -> RealTimeFeedPin {
+        try {
+            /*
+             * Concatenated FeedMessages parse as a single one holding the entities of each in turn (so the first feed
+             * configured wins the trips present in several, see RealTimeTripUpdate). The header of the last message
+             * would win, so one carrying the oldest timestamp of the feeds is appended: the age of the merged feed is
+             * that of its stalest part. The only feed left (when the others failed) is parsed as it was fetched.
+             */
+            QByteArray mergedData   = (payloads.size() == 1) ? payloads.first()->data() : QByteArray();
+            qint64     downloadMSec = 0;
+            quint64    oldestPOSIX  = 0;
+            for (const RealTimeFeedPayloadPin &payload : payloads) {
+                if (payloads.size() > 1) {
+                    mergedData.append(payload->data());
+                }
+                downloadMSec = qMax(downloadMSec, payload->getDownloadTimeMSec());
+                if (payload->getFeedTimePOSIX() != 0 &&
+                    (oldestPOSIX == 0 || payload->getFeedTimePOSIX() < oldestPOSIX)) {
+                    oldestPOSIX = payload->getFeedTimePOSIX();
+                }
             }
-        } else if (currentSide == SIDE_A) {
-            nextSide = SIDE_B;
-
-            if (_sideB != nullptr)
-                delete _sideB;
-
-            if (!_dataPathLocal.isNull()) {
-                _sideB = new RealTimeTripUpdate(_dataPathLocal,
-                                                _skipDateMatching,
-                                                _loosenStopSeqEnf,
-                                                _allSkippedCan,
-                                                _staticFeedTripDB,
-                                                _staticStopTimeDB);
-            } else {
-                _sideB = new RealTimeTripUpdate(GtfsRealTimePB,
-                                                _skipDateMatching,
-                                                _loosenStopSeqEnf,
-                                                _trace,
-                                                _allSkippedCan,
-                                                _staticFeedTripDB,
-                                                _staticStopTimeDB);
+            if (payloads.size() > 1) {
+                transit_realtime::FeedMessage mergedHeader;
+                mergedHeader.mutable_header()->set_gtfs_realtime_version(
+                            payloads.first()->getFeedGTFSVersion().toStdString());
+                mergedHeader.mutable_header()->set_timestamp(oldestPOSIX);
+                mergedData.append(QByteArray::fromStdString(mergedHeader.SerializeAsString()));
             }
-        }
 
-        // Is the new RealTimeTripUpdate actually filled with anything?
-        // (Sometimes it trolls us by being empty, in which case just fall back to the version we have)
-        bool skipBufferSwitch = false;
-        if ((currentSide == SIDE_B && nextSide == SIDE_A && _sideA->getFeedTimePOSIX() == 0) ||
-            (currentSide == SIDE_A && nextSide == SIDE_B && _sideB->getFeedTimePOSIX() == 0)) {
-            if (_trace) {
-                qDebug() << "  (RTTU) EMPTY TRIP UPDATES FILE, Skipping buffer swap";
-            }
-            skipBufferSwitch = true;
+            std::shared_ptr<RealTimeTripUpdate> nextFeed =
+                    std::make_shared<RealTimeTripUpdate>(mergedData,
+                                                         skipDateMatching,
+                                                         loosenStopSeqEnf,
+                                                         trace,
+                                                         allSkippedCan,
+                                                         tripsDB,
+                                                         stopTimeDB,
+                                                         previousFeed.get());
+            nextFeed->setDownloadTimeMSec(downloadMSec);
+            return nextFeed;
+        } catch (...) {
+            // Handled by the gateway the same as an empty dataset error
+            return RealTimeFeedPin();
         }
+    });
+    _mergeWatcher->setFuture(merge);
+}
 
-        // Make the switch to the next side after the data is successfully ingested
-        if (!skipBufferSwitch) {
-            if (nextSide == SIDE_A) {
-                _sideA->setDownloadTimeMSec(end - start);
-                setActiveFeed(SIDE_A);
-            } else if (nextSide == SIDE_B) {
-                _sideB->setDownloadTimeMSec(end - start);
-                setActiveFeed(SIDE_B);
-            }
+void RealTimeGateway::tripUpdatesMerged()
+{
+    RealTimeFeedPin nextFeed = _mergeWatcher->result();
+    _merging = false;
+
+    bool anyPayload = false;
+    for (const RealTimeFeedPayloadPin &payload : qAsConst(_tripPayloads)) {
+        anyPayload = anyPayload || (payload != nullptr);
+    }
+
+    if (fetchingIdled() || !anyPayload) {
+        // Fetching was idled (or every feed failed) while the worker was busy, there is nothing left to publish
+        if (_trace) {
+            qDebug() << "  (RTGW) Trip updates merged after they were dropped, discarding them";
         }
-    } catch (...) {
+        _pendingMerges.clear();
+    } else if (nextFeed == nullptr) {
         // If an exception is raised at any point, it should be considered the same as an empty dataset error
         if (_trace) {
-            qDebug() << "  (RTTU) Exception raised while ingesting realtime data, set active feed to DISABLED";
+            qDebug() << "  (RTGW) Exception raised while ingesting realtime data, disable the active feed";
         }
-        setActiveFeed(DISABLED);
+        setActiveFeed(RealTimeFeedPin());
+    } else {
+        // Make the switch to the next feed after the data is successfully ingested
+        setActiveFeed(nextFeed);
     }
 
-    _nextFetchTimeUTC = QDateTime::currentDateTimeUtc().addMSecs(_refreshIntervalSec * 1000);
+    if (!_pendingMerges.isEmpty()) {
+        startMerge();
+    } else {
+        emit tripUpdatesSettled();
+    }
 }
 
-RealTimeDataRepo RealTimeGateway::activeBuffer()
+void RealTimeGateway::vehiclesActivated(RealTimeDataPin data)
 {
-    _lock_activeSide.lock();
-    RealTimeDataRepo currentSide = _activeSide;
-    _lock_activeSide.unlock();
-    return currentSide;
+    setActiveVehicles(std::static_pointer_cast<const RealTimeVehiclePositions>(data));
 }
 
-void RealTimeGateway::setActiveFeed(RealTimeDataRepo nextSide)
+void RealTimeGateway::vehiclesFailed()
 {
-    _lock_activeSide.lock();
-    _activeSide = nextSide;
-    _lock_activeSide.unlock();
+    setActiveVehicles(RealTimeVehiclesPin());
 }
 
-RealTimeTripUpdate *RealTimeGateway::getActiveFeed()
+void RealTimeGateway::alertsActivated(RealTimeDataPin data)
 {
-    RealTimeDataRepo activeSide = activeBuffer();
-    if (activeSide == SIDE_A) {
-        return _sideA;
-    } else if (activeSide == SIDE_B) {
-        return _sideB;
-    } else {
-        return nullptr;
+    setActiveAlerts(std::static_pointer_cast<const RealTimeAlerts>(data));
+}
+
+void RealTimeGateway::alertsFailed()
+{
+    setActiveAlerts(RealTimeAlertsPin());
+}
+
+std::shared_ptr<const RealTimeSnapshot> RealTimeGateway::activeSnapshot() const
+{
+    // Enter the current epoch (again if a publisher moved on before we were counted, it may not have waited for us)
+    quint32 epoch = _publishEpoch.load();
+    ++_epochReaders[epoch & 1];
+    while (_publishEpoch.load() != epoch) {
+        --_epochReaders[epoch & 1];
+        epoch = _publishEpoch.load();
+        ++_epochReaders[epoch & 1];
+    }
+
+    // The holder read cannot be freed until we leave the epoch
+    std::shared_ptr<const RealTimeSnapshot> snapshot = *_published.load();
+    --_epochReaders[epoch & 1];
+    return snapshot;
+}
+
+bool RealTimeGateway::fetchingIdled() const
+{
+    return activeSnapshot()->idled;
+}
+
+void RealTimeGateway::setActiveFeed(RealTimeFeedPin nextFeed)
+{
+    // Trip updates only come from fetches, so any of them means fetching is no longer idled
+    publish([=](RealTimeSnapshot &next) {
+        next.idled = false;
+        next.feed  = nextFeed;
+    });
+}
+
+void RealTimeGateway::setActiveVehicles(RealTimeVehiclesPin nextVehicles)
+{
+    publish([=](RealTimeSnapshot &next) {
+        next.vehicles = nextVehicles;
+    });
+}
+
+void RealTimeGateway::setActiveAlerts(RealTimeAlertsPin nextAlerts)
+{
+    publish([=](RealTimeSnapshot &next) {
+        next.alerts = nextAlerts;
+    });
+}
+
+void RealTimeGateway::publish(const std::function<void(RealTimeSnapshot &)> &change)
+{
+    // Only publishers are serialized, so that generations are never handed out twice (and nothing published is lost)
+    _lock_publish.lock();
+    const std::shared_ptr<const RealTimeSnapshot> *current = _published.load();
+    std::shared_ptr<RealTimeSnapshot> next = std::make_shared<RealTimeSnapshot>(**current);
+    change(*next);
+    next->generation = (*current)->generation + 1;
+    quint64 generation = next->generation;
+
+    // Readers entering the next epoch only see the new holder, those of the previous epoch may still copy from the
+    // superseded one (the snapshot it holds lives on in their copies, the holder itself is freed once they are done)
+    _published.store(new std::shared_ptr<const RealTimeSnapshot>(next));
+    quint32 previousEpoch = _publishEpoch++;
+    while (_epochReaders[previousEpoch & 1].load() != 0) {
+        QThread::yieldCurrentThread();
+    }
+    delete current;
+    _lock_publish.unlock();
+
+    emit feedActivated(generation);
+}
+
+RealTimeFeedPin RealTimeGateway::getActiveFeed() const
+{
+    return activeSnapshot()->feed;
+}
+
+RealTimeVehiclesPin RealTimeGateway::getActiveVehicles() const
+{
+    return activeSnapshot()->vehicles;
+}
+
+RealTimeAlertsPin RealTimeGateway::getActiveAlerts() const
+{
+    return activeSnapshot()->alerts;
+}
+
+quint64 RealTimeGateway::feedGeneration() const
+{
+    return activeSnapshot()->generation;
+}
+
+qint32 RealTimeGateway::nbTripUpdateFeeds() const
+{
+    return _tripSources.size();
+}
+
+bool RealTimeGateway::tripUpdatesStatus(RealTimeSourceStatus &status, qint32 feedIdx)
+{
+    if (feedIdx < 0 || feedIdx >= _tripSources.size()) {
+        return false;
+    }
+    _tripSources.at(feedIdx)->getStatus(status);
+    return true;
+}
+
+bool RealTimeGateway::vehiclePositionsStatus(RealTimeSourceStatus &status)
+{
+    if (_vehicleSource == nullptr) {
+        return false;
+    }
+    _vehicleSource->getStatus(status);
+    return true;
+}
+
+bool RealTimeGateway::alertsStatus(RealTimeSourceStatus &status)
+{
+    if (_alertSource == nullptr) {
+        return false;
+    }
+    _alertSource->getStatus(status);
+    return true;
+}
+
+bool RealTimeGateway::replayStatus(RealTimeReplayStatus &status)
+{
+    if (_replay == nullptr) {
+        return false;
+    }
+    _replay->getStatus(status);
+    return true;
+}
+
+QVector<RealTimeFeedSource *> RealTimeGateway::sources() const
+{
+    QVector<RealTimeFeedSource *> configured = _tripSources;
+    for (RealTimeFeedSource *source : {_vehicleSource, _alertSource}) {
+        if (source != nullptr) {
+            configured.push_back(source);
+        }
     }
+    return configured;
 }
 
 QDateTime RealTimeGateway::mostRecentTransaction()
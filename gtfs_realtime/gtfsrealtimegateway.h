@@ -23,21 +23,38 @@
 
 #include <QObject>
 #include <QDateTime>
-#include <QUrl>
 #include <QMutex>
-#include <QtNetwork/QNetworkAccessManager>
+#include <QQueue>
+#include <QAtomicInt>
+#include <QVector>
+#include <QStringList>
+#include <QThreadPool>
+#include <QFutureWatcher>
+
+#include <atomic>
+#include <memory>
+#include <functional>
 
 #include "gtfsrealtimefeed.h"
+#include "gtfsrealtimevehicles.h"
+#include "gtfsrealtimealerts.h"
+#include "gtfsrealtimesource.h"
+#include "gtfsrealtimearchive.h"
+#include "gtfsrealtimereplay.h"
 
 namespace GTFS {
 
-// Mechanism to avoid clashes when multithreading is processing new data
-typedef enum {
-    DISABLED,
-    SIDE_A,
-    SIDE_B,
-    IDLED
-} RealTimeDataRepo;
+/*
+ * A published state of the real-time data. Snapshots are immutable once published: a request holds on to (pins) the
+ * snapshot it started with, and the feed is freed once the last request holding a superseded snapshot is done with it.
+ */
+typedef struct {
+    quint64             generation;  // Number of times the active data was switched (see feedGeneration)
+    bool                idled;       // Fetching was idled (there is no active feed until it is woken up)
+    RealTimeFeedPin     feed;        // Active feed (nullptr if real-time data is disabled, failed or idled)
+    RealTimeVehiclesPin vehicles;    // Active vehicle positions (nullptr if there is no vehicle positions feed)
+    RealTimeAlertsPin   alerts;      // Active service alerts (nullptr if there is no alerts feed)
+} RealTimeSnapshot;
 
 class RealTimeGateway : public QObject
 {
@@ -46,43 +63,125 @@ public:
     // Singleton Operations
     static RealTimeGateway &inst();
 
-    // Store the path from which to grab new protobuf data
-    void setRealTimeFeedPath(const QString      &realTimeFeedPath,
-                             qint32              refreshIntervalSec,
-                             rtDateLevel         rtDateMatchLevel,
-                             bool                loosenStopSeqEnf,
-                             bool                allSkippedCan,
-                             bool                showDebugTrace,
-                             const TripData     *tripsDB,
-                             const StopTimeData *stopTimeDB);
+    /*
+     * Store the paths from which to grab new trip updates. Each feed is fetched on its own schedule, and the latest
+     * data of every feed is merged into the active feed each time one of them changes: the entities of the feeds are
+     * taken in the order of the paths, so a trip updated by several feeds is taken from the first of them.
+     */
+    void setRealTimeFeedPaths(const QStringList  &realTimeFeedPaths,
+                              qint32              refreshIntervalSec,
+                              qint32              fetchTimeoutSec,
+                              rtDateLevel         rtDateMatchLevel,
+                              bool                loosenStopSeqEnf,
+                              bool                allSkippedCan,
+                              bool                showDebugTrace,
+                              const TripData     *tripsDB,
+                              const StopTimeData *stopTimeDB);
+
+    // Store the path from which to grab the vehicle positions (optional, after setRealTimeFeedPaths)
+    void setVehiclePositionsPath(const QString &vehiclePositionsPath,
+                                 qint32         refreshIntervalSec,
+                                 qint32         fetchTimeoutSec);
+
+    // Store the path from which to grab the service alerts (optional, after setRealTimeFeedPaths), the routes of the
+    // static feed give the type of the route of each trip for the alerts selecting a route type
+    void setAlertsPath(const QString   &alertsPath,
+                       qint32           refreshIntervalSec,
+                       qint32           fetchTimeoutSec,
+                       const RouteData *routesDB);
+
+    // Record every fetch of the sources (once they are all set) to an archive, for it to be replayed later
+    void setRecordPath(const QString &archivePath);
+
+    /*
+     * Replay the fetches recorded in an archive to the sources (once they are all set) instead of fetching anything.
+     * The replay starts at startTime (the first fetch recorded if null) and goes speed times faster than recorded.
+     */
+    void setReplayPath(const QString &archivePath, const QDateTime &startTime, double speed);
+
+    // How long until the next fetch of any of the trip updates?
+    qint64 secondsToFetch();
 
-    // How long until the next fetch?
-    qint64 secondsToFetch() const;
+    // Pin the published real-time state (generation, idling and feed are consistent with one another)
+    std::shared_ptr<const RealTimeSnapshot> activeSnapshot() const;
 
-    // Query the active feed
-    RealTimeDataRepo activeBuffer();
+    // Was fetching idled for lack of real-time requests?
+    bool fetchingIdled() const;
 
-    // Switch over the active feed side
-    void setActiveFeed(RealTimeDataRepo nextSide);
+    // Switch over the active feed (nullptr disables it until a good feed is activated)
+    void setActiveFeed(RealTimeFeedPin nextFeed);
 
-    // Retrieve the active feed (returns NULL if we are in the DISABLED mode)
-    RealTimeTripUpdate *getActiveFeed();
+    // Switch over the active vehicle positions (nullptr when there are none)
+    void setActiveVehicles(RealTimeVehiclesPin nextVehicles);
+
+    // Retrieve (and pin, for as long as it is held) the active feed (returns nullptr if there is no active feed)
+    RealTimeFeedPin getActiveFeed() const;
+
+    // Retrieve (and pin) the active vehicle positions (returns nullptr if there are none)
+    RealTimeVehiclesPin getActiveVehicles() const;
+
+    // Switch over the active service alerts (nullptr when there are none)
+    void setActiveAlerts(RealTimeAlertsPin nextAlerts);
+
+    // Retrieve (and pin) the active service alerts (returns nullptr if there are none)
+    RealTimeAlertsPin getActiveAlerts() const;
+
+    // Number of times the active data was switched (lets cached responses know they are stale)
+    quint64 feedGeneration() const;
 
     // Get the date and time of the most recent transaction which used realtime information
     QDateTime mostRecentTransaction();
 
+    // Fetch statistics of the trip updates (of each of their feeds), of the vehicle positions and of the alerts (false
+    // if the feed is not configured)
+    qint32 nbTripUpdateFeeds() const;
+    bool tripUpdatesStatus(RealTimeSourceStatus &status, qint32 feedIdx = 0);
+    bool vehiclePositionsStatus(RealTimeSourceStatus &status);
+    bool alertsStatus(RealTimeSourceStatus &status);
+
+    // Progress of the replay (false if the fetches are not replayed)
+    bool replayStatus(RealTimeReplayStatus &status);
+
+    // Fetch and integrate the feeds, only returning once they were activated (or failed), for the server startup
+    void initialFetch();
+
+    // Idle every source if no realtime request was made for a while (true if fetching is idled), called by the
+    // sources when a fetch is due. Fetching is never idled when any feed is read from a local file (or replayed).
+    bool idleIfUnused();
+
 signals:
+    // The active data was switched (new real-time data, or the feed was disabled / idled)
+    void feedActivated(quint64 generation);
 
-public slots:
-    // Single Fetch-and-Stop -- This should probably be made private!
-    void refetchData();
+    // The trip updates are done merging (nothing is left to merge)
+    void tripUpdatesSettled();
 
-    // Infinite loop to fetch new data, checks every 10 seconds the number of seconds which have elapsed since a refresh
+    // A fetch recorded at this time is being replayed (transactions should be processed as if it is this time)
+    void replayClockAdvanced(const QDateTime &fetchTimeUTC);
+
+public slots:
+    // Start fetching on the gateway's thread (each fetch of a source plans when its next one happens)
     void dataRetrievalLoop();
 
     // Indicate that a transaction with real-time data was just requested so we don't idle the fetching process
     void realTimeTransactionHandled();
 
+private slots:
+    // The merge worker is done with the trip updates handed over to it
+    void tripUpdatesMerged();
+
+    // Publish the data activated by a source, or drop it when the source failed
+    void vehiclesActivated(GTFS::RealTimeDataPin data);
+    void vehiclesFailed();
+    void alertsActivated(GTFS::RealTimeDataPin data);
+    void alertsFailed();
+
+    // Wake the sources up after fetching was idled
+    void wakeSources();
+
+    // A source or the merge worker settled: the replay moves on to its next fetch once they all did
+    void replaySettled();
+
 private:
     // Singleton Pattern Requirements
     explicit RealTimeGateway(QObject *parent = nullptr);
@@ -90,26 +189,61 @@ private:
     RealTimeGateway &operator =(RealTimeGateway const &other);
     virtual ~RealTimeGateway();
 
+    // Publish the next snapshot: a copy of the published one, changed by the publisher (under _lock_publish)
+    void publish(const std::function<void(RealTimeSnapshot &)> &change);
+
+    // Every source configured
+    QVector<RealTimeFeedSource *> sources() const;
+
+    // Merge the latest trip updates of each feed, once one of them activated new data or failed
+    void tripUpdatesActivated(qint32 feedIdx, RealTimeDataPin data);
+    void tripUpdatesFailed(qint32 feedIdx);
+
+    // Hand the trip updates of every feed over to the merge worker (only the latest are merged once it is busy, unless
+    // replaying: then every change is merged in turn)
+    void mergeTripUpdates();
+
+    // Merge the next trip updates waiting for the worker
+    void startMerge();
+
     // Dataset Members
-    qint32              _refreshIntervalSec; // Time between each data refresh attempt (in seconds)
-    QMutex              _lock_activeSide;    // Prevent messing up the active side 'pointer'
+    QMutex              _lock_publish;       // Serializes the publishers of snapshots (readers never take it)
     QMutex              _lock_lastRTTxn;     // Prevent messing up the last realtime transaction time
-    RealTimeDataRepo    _activeSide;         // Atomic indicator to denote data which is both active and ready
-    QString             _dataPathLocal;      // Data Fetch Path (local file)
-    QUrl                _dataPathRemote;     // Data Fetch Path (remote URL)
-    QDateTime           _nextFetchTimeUTC;   // Time at which new data real-time data should be fetched
     QDateTime           _latestRealTimeTxn;  // Stores the date of the most recent transaction requesting realtime data
-    rtDateLevel         _skipDateMatching;   // true to skip all date matching from schedule trips and realtime feed
-    bool                _loosenStopSeqEnf;   // true to skip stop seq checks from stop ids from static vs. realtime feed
-    bool                _allSkippedCan;      // true to automatically mark a trip update as a canceled trip if skipping
+    QAtomicInt          _wakeRequested;      // A real-time request asked to wake the idled fetching up
     bool                _trace;              // true if the periodic real-time trip update refresh traces should show
-    RealTimeTripUpdate *_sideA;
-    RealTimeTripUpdate *_sideB;
-
-    const TripData     *_staticFeedTripDB;   // Pointer to the static trip database (for route ID matching)
-    const StopTimeData *_staticStopTimeDB;   // Pointer to the static stop time database (for trip sanity-checks)
-
-    QNetworkAccessManager *_feedNAM;        // Pointer to the network access manager (reusable) for data retrieval
+    const TripData     *_staticFeedTripDB;   // Trips of the static feed (to match the vehicles with)
+    const StopTimeData *_staticStopTimeDB;   // Stop times of the static feed (to resolve the stops of the vehicles)
+
+    /*
+     * Published state. Readers never lock: they count themselves in the slot of the publication epoch they read under,
+     * then copy the snapshot out of the holder published. A publisher swaps the holder, moves on to the next epoch
+     * and only frees the superseded holder once the readers counted in the slot of the previous epoch are done.
+     */
+    mutable std::atomic<const std::shared_ptr<const RealTimeSnapshot> *> _published;
+    mutable std::atomic<quint32>                                        _publishEpoch;
+    mutable std::atomic<qint32>                                         _epochReaders[2];
+
+    // Integration parameters of the trip updates
+    rtDateLevel         _skipDateMatching;   // Service / operating date enforcement level
+    bool                _loosenStopSeqEnf;   // Match stop_id from static and realtime feeds regardless of stop seq
+    bool                _allSkippedCan;      // If a trip update is all skipped stops, consider it canceled
+
+    // Trip updates of each feed, merged on a single worker (while the gateway's thread keeps fetching)
+    QVector<RealTimeFeedPayloadPin>   _tripPayloads;   // Latest data of each feed (unused with a single feed)
+    QThreadPool                       _mergePool;      // Single worker merging and integrating the trip updates
+    QFutureWatcher<RealTimeFeedPin>  *_mergeWatcher;   // Notifies the gateway of the merged trip updates
+    bool                              _merging;        // The worker is merging trip updates
+    QQueue<QVector<RealTimeFeedPayloadPin>> _pendingMerges; // Trip updates changed while the worker was merging
+
+    // Feeds fetched (children of the gateway, so they run on its thread)
+    QVector<RealTimeFeedSource *> _tripSources;  // Trip updates, in merge order (empty if real-time data is disabled)
+    RealTimeFeedSource *_vehicleSource;      // Vehicle positions (nullptr if there is no vehicle positions feed)
+    RealTimeFeedSource *_alertSource;        // Service alerts (nullptr if there is no alerts feed)
+
+    // Recording / replaying of the fetches
+    RealTimeArchiveWriter *_archive;         // Every fetch is recorded to it (nullptr if not recording)
+    RealTimeFeedReplay    *_replay;          // Replays the fetches to the sources (nullptr if fetching for real)
 };
 
 } // Namespace GTFS
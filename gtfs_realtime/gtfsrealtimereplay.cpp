@@ -0,0 +1,196 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "gtfsrealtimereplay.h"
+
+#include <QTimeZone>
+#include <QDebug>
+
+#include <algorithm>
+
+namespace GTFS {
+
+RealTimeFeedReplay::RealTimeFeedReplay(const QString   &archivePath,
+                                       const QDateTime &startTime,
+                                       double           speed,
+                                       bool             trace,
+                                       QObject         *parent)
+    : QObject(parent),
+      _archive(archivePath),
+      _speed((speed > 0) ? speed : 1.0),
+      _trace(trace),
+      _hasNext(false),
+      _settling(false),
+      _archiveStartMSec(startTime.isNull() ? 0 : startTime.toMSecsSinceEpoch()),
+      _replayStartMSec(0)
+{
+    if (!_archive.isOpen()) {
+        qDebug() << "  (RTRP) ERROR : Could not read the real-time archive" << archivePath;
+    }
+
+    _replayTimer = new QTimer(this);
+    _replayTimer->setSingleShot(true);
+    _replayTimer->setTimerType(Qt::PreciseTimer);
+    connect(_replayTimer, SIGNAL(timeout()), SLOT(replayDue()));
+
+    _status.records  = 0;
+    _status.finished = false;
+}
+
+bool RealTimeFeedReplay::isOpen() const
+{
+    return _archive.isOpen();
+}
+
+void RealTimeFeedReplay::addSource(RealTimeFeedSource *source)
+{
+    source->setReplaying();
+    _sources[source->name()] = source;
+}
+
+void RealTimeFeedReplay::initialReplay()
+{
+    // Without a start time, the replay starts with the first fetch recorded (there is nothing to replay without any)
+    if (!readNext() && _archiveStartMSec == 0) {
+        return;
+    } else if (_archiveStartMSec == 0) {
+        _archiveStartMSec = _next.fetchMSec;
+    }
+
+    // Only the latest data of each source matters at the start time, the fetches which kept it are skipped
+    QHash<QString, RealTimeArchiveRecord> latestData;
+    while (_hasNext && _next.fetchMSec <= _archiveStartMSec) {
+        if (_next.outcome == ARCHIVED_DATA) {
+            latestData[_next.source] = _next;
+        } else if (_next.outcome == ARCHIVED_FAILED) {
+            latestData.remove(_next.source);
+        }
+        readNext();
+    }
+
+    QVector<RealTimeArchiveRecord> startData = latestData.values();
+    std::sort(startData.begin(), startData.end(),
+              [](const RealTimeArchiveRecord &a, const RealTimeArchiveRecord &b) {return a.fetchMSec < b.fetchMSec;});
+
+    QDateTime startUTC = QDateTime::fromMSecsSinceEpoch(_archiveStartMSec, QTimeZone::utc());
+    _lock_status.lock();
+    _status.replayedUTC = startUTC;
+    _lock_status.unlock();
+    emit clockAdvanced(startUTC);
+
+    if (_trace) {
+        qDebug() << "  (RTRP) Replay starting at" << startUTC << "with the data of" << startData.size() << "sources";
+    }
+    for (const RealTimeArchiveRecord &record : qAsConst(startData)) {
+        replayRecord(record);
+    }
+}
+
+void RealTimeFeedReplay::getStatus(RealTimeReplayStatus &status)
+{
+    _lock_status.lock();
+    status = _status;
+    _lock_status.unlock();
+}
+
+void RealTimeFeedReplay::start()
+{
+    _replayStartMSec = QDateTime::currentMSecsSinceEpoch();
+    replayDue();
+}
+
+void RealTimeFeedReplay::previousSettled()
+{
+    if (!_settling) {
+        return;
+    }
+    _settling = false;
+    replayDue();
+}
+
+void RealTimeFeedReplay::replayDue()
+{
+    // The next fetch waits for the previous one, even if it is overdue
+    if (_settling) {
+        return;
+    }
+
+    while (_hasNext && dueMSec(_next) <= QDateTime::currentMSecsSinceEpoch()) {
+        // The fetch is replayed after its clock advanced (it is what the transactions see from then on)
+        QDateTime fetchUTC = QDateTime::fromMSecsSinceEpoch(_next.fetchMSec, QTimeZone::utc());
+        _lock_status.lock();
+        _status.replayedUTC = fetchUTC;
+        _lock_status.unlock();
+        emit clockAdvanced(fetchUTC);
+
+        bool replayed = replayRecord(_next);
+        readNext();
+        if (replayed) {
+            _settling = true;
+            return;
+        }
+    }
+
+    if (_hasNext) {
+        _replayTimer->start(static_cast<int>(qMax(static_cast<qint64>(0),
+                                                  dueMSec(_next) - QDateTime::currentMSecsSinceEpoch())));
+        return;
+    }
+
+    _lock_status.lock();
+    _status.finished = true;
+    _lock_status.unlock();
+    if (_trace) {
+        qDebug() << "  (RTRP) Every fetch of the archive was replayed";
+    }
+}
+
+bool RealTimeFeedReplay::readNext()
+{
+    _hasNext = _archive.readNext(_next);
+    if (!_hasNext) {
+        _next = RealTimeArchiveRecord();
+    }
+    return _hasNext;
+}
+
+qint64 RealTimeFeedReplay::dueMSec(const RealTimeArchiveRecord &record) const
+{
+    return _replayStartMSec + static_cast<qint64>((record.fetchMSec - _archiveStartMSec) / _speed);
+}
+
+bool RealTimeFeedReplay::replayRecord(const RealTimeArchiveRecord &record)
+{
+    RealTimeFeedSource *source = _sources.value(record.source, nullptr);
+    if (source == nullptr) {
+        if (_trace) {
+            qDebug() << "  (RTRP) No source named" << record.source << "is configured, skipping its fetch";
+        }
+        return false;
+    }
+
+    _lock_status.lock();
+    ++_status.records;
+    _lock_status.unlock();
+    source->replayFetch(record);
+    return true;
+}
+
+} // namespace GTFS
@@ -0,0 +1,124 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef GTFSREALTIMEREPLAY_H
+#define GTFSREALTIMEREPLAY_H
+
+#include "gtfsrealtimearchive.h"
+#include "gtfsrealtimesource.h"
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QTimer>
+
+namespace GTFS {
+
+// Progress of a replay (for status reporting)
+typedef struct {
+    QDateTime replayedUTC;      // Fetch time of the latest fetch replayed (the start time until one is)
+    quint64   records;          // Number of fetches replayed
+    bool      finished;         // Every fetch of the archive was replayed
+} RealTimeReplayStatus;
+
+/*
+ * GTFS::RealTimeFeedReplay hands the fetches recorded in an archive (see RealTimeArchiveWriter) over to the sources
+ * which fetched them (matched by name), instead of the sources fetching anything themselves. The fetches are replayed
+ * on the schedule they were recorded with (or faster), and each one advances the clock of the transactions to the time
+ * it was recorded at: the server goes through the exact sequence of feeds it saw, at the time it saw them.
+ *
+ * The replay starts at a given time (the -f time of the server): the latest data each source had fetched by then is
+ * replayed right away, for the server startup, and the fetches recorded after that follow on their schedule. A fetch
+ * (and the clock it advances) waits until the previous one settled, integrated and published, however long it takes:
+ * every fetch recorded goes through in turn, so two replays of an archive publish the same feeds at the same times.
+ */
+class RealTimeFeedReplay : public QObject
+{
+    Q_OBJECT
+public:
+    /*
+     * archivePath: archive of the fetches to replay
+     * startTime:   time at which the replay starts (null to start at the first fetch recorded)
+     * speed:       how many times faster than recorded the fetches are replayed (1 for the recorded schedule)
+     * trace:       show the replay traces
+     */
+    RealTimeFeedReplay(const QString   &archivePath,
+                       const QDateTime &startTime,
+                       double           speed,
+                       bool             trace,
+                       QObject         *parent = nullptr);
+
+    // Could the archive be read?
+    bool isOpen() const;
+
+    // Replay the fetches recorded by the source of the same name to this source
+    void addSource(RealTimeFeedSource *source);
+
+    // Replay the latest data each source fetched up to the start time (on the thread of the sources, for the startup)
+    void initialReplay();
+
+    // Replay progress
+    void getStatus(RealTimeReplayStatus &status);
+
+    // The fetch replayed last is done with (the sources and the gateway settled): the next one is replayed when due
+    void previousSettled();
+
+signals:
+    // A fetch recorded at this time is being replayed (the transactions should be processed as if it is this time)
+    void clockAdvanced(const QDateTime &fetchTimeUTC);
+
+public slots:
+    // Replay the fetches recorded after the start time, on their schedule from now on
+    void start();
+
+private slots:
+    // Replay every fetch due, then wait for the next one
+    void replayDue();
+
+private:
+    // Read the fetch to replay next, false once the archive is over
+    bool readNext();
+
+    // Time (ms since the epoch) at which a fetch is due to be replayed
+    qint64 dueMSec(const RealTimeArchiveRecord &record) const;
+
+    // Hand a fetch over to its source (false if no source of its name is configured)
+    bool replayRecord(const RealTimeArchiveRecord &record);
+
+    RealTimeArchiveReader                _archive;          // Fetches recorded
+    double                               _speed;            // Speed-up of the replay over the recorded schedule
+    bool                                 _trace;            // true if the replay traces should show
+    QHash<QString, RealTimeFeedSource *> _sources;          // Sources fed with the fetches, by name
+    QTimer                              *_replayTimer;      // Armed for the next fetch due
+    RealTimeArchiveRecord                _next;             // Fetch to replay next
+    bool                                 _hasNext;          // false once the archive is over
+    bool                                 _settling;         // The fetch replayed last did not settle yet
+    qint64                               _archiveStartMSec; // Time of the archive at which the replay started
+    qint64                               _replayStartMSec;  // Time at which the replay started (0 until started)
+
+    // Replay progress, also read from the request threads
+    QMutex                               _lock_status;      // Prevent messing up the replay progress
+    RealTimeReplayStatus                 _status;           // Replay progress
+};
+
+} // namespace GTFS
+
+#endif // GTFSREALTIMEREPLAY_H
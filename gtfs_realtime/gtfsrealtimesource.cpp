@@ -0,0 +1,713 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "gtfsrealtimesource.h"
+#include "gtfsrealtimegateway.h"
+
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QTimeZone>
+#include <QtConcurrent>
+#include <QtNetwork/QNetworkRequest>
+#include <QDebug>
+
+// Only the header of merged feeds is decoded, the entities are skipped over
+#include "gtfs-realtime.pb.h"
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+namespace GTFS {
+
+// Download time budget when none is configured (seconds)
+const qint32 kDefaultFetchTimeoutSec = 4;
+
+// Delay before retrying a failed fetch the first time, doubled at each consecutive failure (up to the refresh interval)
+const qint64 kRetryDelayMSec = 5000;
+
+// Delay after the expected publication of the feed at which it is first fetched (grows while fetches find it stale)
+const qint64 kMinPublishLagMSec = 1000;
+
+// Consecutive stale fetches double the time between fetches up to this many times (8 update intervals)
+const quint32 kMaxStaleDoublings = 3;
+
+// Changes to a local file are only fetched once none happened for this long (a file may take a few events to replace)
+const qint32 kLocalChangeSettleMSec = 50;
+
+RealTimeFeedPayload::RealTimeFeedPayload(const RealTimeFetchedData &fetched, QObject *parent)
+    : QObject(parent),
+      _data((fetched.mappedFile != nullptr) ? QByteArray(fetched.data.constData(), fetched.data.size()) : fetched.data),
+      _feedTimePOSIX(0),
+      _downloadMSec(fetched.downloadMSec)
+{
+    using google::protobuf::internal::WireFormatLite;
+
+    // The header is field 1 of the FeedMessage (merged like the protobuf library would if it appeared several times)
+    transit_realtime::FeedHeader header;
+    google::protobuf::io::CodedInputStream input(reinterpret_cast<const quint8 *>(_data.constData()), _data.size());
+    for (quint32 tag = input.ReadTag(); tag != 0; tag = input.ReadTag()) {
+        if (WireFormatLite::GetTagFieldNumber(tag) == 1 &&
+            WireFormatLite::GetTagWireType(tag) == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+            quint32     length;
+            std::string headerBytes;
+            if (!input.ReadVarint32(&length) || !input.ReadString(&headerBytes, length)) {
+                break;
+            }
+            header.MergeFromString(headerBytes);
+        } else if (!WireFormatLite::SkipField(&input, tag)) {
+            break;
+        }
+    }
+    _feedTimePOSIX = header.timestamp();
+    _gtfsVersion   = QString::fromStdString(header.gtfs_realtime_version());
+}
+
+const QByteArray &RealTimeFeedPayload::data() const
+{
+    return _data;
+}
+
+quint64 RealTimeFeedPayload::getFeedTimePOSIX() const
+{
+    return _feedTimePOSIX;
+}
+
+const QString &RealTimeFeedPayload::getFeedGTFSVersion() const
+{
+    return _gtfsVersion;
+}
+
+qint64 RealTimeFeedPayload::getDownloadTimeMSec() const
+{
+    return _downloadMSec;
+}
+
+RealTimeFeedSource::RealTimeFeedSource(const QString &name,
+                                       const QString &location,
+                                       qint32         refreshIntervalSec,
+                                       qint32         fetchTimeoutSec,
+                                       bool           trace,
+                                       Integrator     integrator,
+                                       QObject       *parent)
+    : QObject(parent),
+      _name(name),
+      _traceTag("  (" + name.toUtf8() + ")"),
+      _integrator(integrator),
+      _refreshIntervalSec(refreshIntervalSec),
+      _fetchTimeoutMSec(((fetchTimeoutSec > 0) ? fetchTimeoutSec : kDefaultFetchTimeoutSec) * 1000),
+      _trace(trace),
+      _localWatcher(nullptr),
+      _localFileBytes(-1),
+      _archive(nullptr),
+      _replaying(false),
+      _unchangedFetches(0),
+      _failedFetches(0),
+      _publishCadenceMSec(0),
+      _activeFeedTime(0),
+      _feedReply(nullptr),
+      _downloadStartMSec(0),
+      _lastPayloadBytes(0),
+      _integrating(false),
+      _fetchStartMSec(0),
+      _lastHeaderMSec(0),
+      _publishLagMSec(kMinPublishLagMSec),
+      _staleFetches(0)
+{
+    // TODO : Make this more robust?
+    if (location.startsWith("http://") || location.startsWith("https://")) {
+        _dataPathRemote = QUrl(location);
+        _feedNAM = new QNetworkAccessManager(this);
+    } else {
+        _dataPathLocal = location;
+        _feedNAM = nullptr;
+    }
+
+    // Downloads still incomplete after their time budget are aborted (and retried)
+    _fetchTimer = new QTimer(this);
+    _fetchTimer->setSingleShot(true);
+    connect(_fetchTimer, SIGNAL(timeout()), SLOT(downloadTimedOut()));
+
+    // Fetches are started when due rather than polled for, the timer is re-armed each time the next fetch is planned
+    _scheduleTimer = new QTimer(this);
+    _scheduleTimer->setSingleShot(true);
+    _scheduleTimer->setTimerType(Qt::PreciseTimer);
+    connect(_scheduleTimer, SIGNAL(timeout()), SLOT(refetchData()));
+
+    // Changes to the local file are fetched once they settle
+    _localChangeTimer = new QTimer(this);
+    _localChangeTimer->setSingleShot(true);
+    connect(_localChangeTimer, SIGNAL(timeout()), SLOT(localFileSettled()));
+
+    // Feeds are parsed and integrated by a single worker, while the source's thread is free to download the next one
+    _integrationPool.setMaxThreadCount(1);
+    _integrationWatcher = new QFutureWatcher<RealTimeIntegration>(this);
+    connect(_integrationWatcher, SIGNAL(finished()), SLOT(integrationFinished()));
+
+    // The first fetch should happen right away
+    _nextFetchTimeUTC = QDateTime::currentDateTimeUtc();
+}
+
+RealTimeFeedSource::~RealTimeFeedSource()
+{
+    // The integration worker must be done before the data it was handed is released
+    _integrationPool.waitForDone();
+}
+
+const QString &RealTimeFeedSource::name() const
+{
+    return _name;
+}
+
+bool RealTimeFeedSource::isLocal() const
+{
+    return !_dataPathLocal.isEmpty();
+}
+
+void RealTimeFeedSource::getStatus(RealTimeSourceStatus &status)
+{
+    _lock_fetchInfo.lock();
+    status.name              = _name;
+    status.feedTimePOSIX     = _activeFeedTime;
+    status.lastFetchUTC      = _lastFetchUTC;
+    status.nextFetchUTC      = _nextFetchTimeUTC;
+    status.unchangedFetches  = _unchangedFetches;
+    status.failedFetches     = _failedFetches;
+    status.publishCadenceSec = _publishCadenceMSec / 1000;
+    _lock_fetchInfo.unlock();
+}
+
+bool RealTimeFeedSource::isSettled() const
+{
+    return _feedReply == nullptr && !_integrating && _pendingFetches.isEmpty();
+}
+
+void RealTimeFeedSource::initialFetch()
+{
+    QEventLoop event;
+    connect(this, SIGNAL(settled()), &event, SLOT(quit()));
+    refetchData();
+    if (_feedReply != nullptr || _integrating) {
+        event.exec();
+    }
+}
+
+void RealTimeFeedSource::startScheduling()
+{
+    // The timer was armed by the initial fetch, which happened before the source moved to this thread
+    scheduleFetch(_nextFetchTimeUTC);
+
+    // A file replaced by renaming another over it is no longer the file watched, but its directory sees the rename
+    if (isLocal() && !_replaying && _localWatcher == nullptr) {
+        _localWatcher = new QFileSystemWatcher(this);
+        _localWatcher->addPath(QFileInfo(_dataPathLocal).absolutePath());
+        _localWatcher->addPath(_dataPathLocal);
+        connect(_localWatcher, SIGNAL(fileChanged(QString)), SLOT(localFileChanged()));
+        connect(_localWatcher, SIGNAL(directoryChanged(QString)), SLOT(localFileChanged()));
+    }
+}
+
+void RealTimeFeedSource::idle()
+{
+    abortDownload();
+    scheduleFetch(QDateTime());
+    _activeData = RealTimeDataPin();
+    _activeContentHash.clear();
+    setActiveFeedTime(0);
+}
+
+void RealTimeFeedSource::setArchive(RealTimeArchiveWriter *archive)
+{
+    _archive = archive;
+}
+
+void RealTimeFeedSource::setReplaying()
+{
+    _replaying = true;
+    _scheduleTimer->stop();
+}
+
+void RealTimeFeedSource::replayFetch(const RealTimeArchiveRecord &record)
+{
+    if (_trace) {
+        qDebug() << _traceTag.constData() << "Replaying the data fetched at"
+                 << QDateTime::fromMSecsSinceEpoch(record.fetchMSec, QTimeZone::utc());
+    }
+
+    // The next fetch is planned from the replayed one, although nothing is fetched when it is due
+    _fetchStartMSec = QDateTime::currentMSecsSinceEpoch();
+    if (record.outcome == ARCHIVED_FAILED) {
+        fetchFailed();
+        return;
+    }
+
+    RealTimeFetchedData fetched;
+    fetched.data         = record.data;
+    fetched.contentHash  = QCryptographicHash::hash(fetched.data, QCryptographicHash::Sha1);
+    fetched.downloadMSec = record.downloadMSec;
+    dataFetched(fetched, record.outcome == ARCHIVED_UNCHANGED);
+}
+
+void RealTimeFeedSource::wake()
+{
+    if (_nextFetchTimeUTC.isNull()) {
+        if (_trace) {
+            qDebug() << _traceTag.constData() << "Real-time data requested while idled, start refetching";
+        }
+        scheduleFetch(QDateTime::currentDateTimeUtc());
+        refetchData();
+    }
+}
+
+void RealTimeFeedSource::refetchData()
+{
+    // Replayed fetches come from the archive only
+    if (_replaying) {
+        return;
+    }
+
+    // Nobody used real-time data recently: stop fetching until woken up
+    if (RealTimeGateway::inst().idleIfUnused()) {
+        return;
+    }
+
+    // A download still in progress is aborted by its own timer once its time budget is spent (and plans the next)
+    QDateTime currentUTC = QDateTime::currentDateTimeUtc();
+    if (_feedReply != nullptr || _nextFetchTimeUTC.isNull()) {
+        return;
+    }
+
+    // Not due yet (woken up while a fetch was planned), just make sure the timer is armed for it
+    if (currentUTC < _nextFetchTimeUTC) {
+        scheduleFetch(_nextFetchTimeUTC);
+        return;
+    }
+
+    if (_trace) {
+        qDebug() << _traceTag.constData() << "Refetching realtime data at " << currentUTC;
+    }
+
+    // Until the outcome of the fetch plans the next one, fetches keep their cadence however long it takes
+    _fetchStartMSec = currentUTC.toMSecsSinceEpoch();
+    scheduleFetch(currentUTC.addMSecs(_refreshIntervalSec * 1000));
+
+    // Start the download, otherwise we are in local file mode, so read the file
+    if (!_dataPathRemote.isEmpty()) {
+        startDownload();
+        return;
+    }
+
+    RealTimeFetchedData fetched;
+    readLocalFile(fetched);
+    dataFetched(fetched, false);
+}
+
+void RealTimeFeedSource::readLocalFile(RealTimeFetchedData &fetched)
+{
+    qint64 start = QDateTime::currentMSecsSinceEpoch();
+
+    // The data refers to the file mapped in memory (parsed from there), unless it cannot be mapped (or is empty)
+    std::shared_ptr<QFile> localFeed = std::make_shared<QFile>(_dataPathLocal);
+    if (localFeed->open(QIODevice::ReadOnly)) {
+        QFileInfo localInfo(*localFeed);
+        _localFileModified = localInfo.lastModified();
+        _localFileBytes    = localInfo.size();
+
+        const uchar *mapped = (_localFileBytes > 0) ? localFeed->map(0, _localFileBytes) : nullptr;
+        if (mapped != nullptr) {
+            fetched.data       = QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), _localFileBytes);
+            fetched.mappedFile = localFeed;
+        } else {
+            fetched.data = localFeed->readAll();
+        }
+    }
+    fetched.contentHash  = QCryptographicHash::hash(fetched.data, QCryptographicHash::Sha1);
+    fetched.downloadMSec = QDateTime::currentMSecsSinceEpoch() - start;
+}
+
+void RealTimeFeedSource::localFileChanged()
+{
+    // The file renamed over the one watched is watched from then on
+    if (!_localWatcher->files().contains(_dataPathLocal) && QFile::exists(_dataPathLocal)) {
+        _localWatcher->addPath(_dataPathLocal);
+    }
+    _localChangeTimer->start(kLocalChangeSettleMSec);
+}
+
+void RealTimeFeedSource::localFileSettled()
+{
+    // Nothing to fetch when idled, nor for changes to other files of the directory
+    QFileInfo localInfo(_dataPathLocal);
+    if (_nextFetchTimeUTC.isNull() ||
+        (localInfo.lastModified() == _localFileModified && localInfo.size() == _localFileBytes)) {
+        return;
+    }
+
+    if (_trace) {
+        qDebug() << _traceTag.constData() << "Local file replaced, fetching it right away";
+    }
+    scheduleFetch(QDateTime::currentDateTimeUtc());
+    refetchData();
+}
+
+void RealTimeFeedSource::startDownload()
+{
+    // Conditional requests only make sense while there is active data to keep
+    bool activeDataExists = (_activeData != nullptr);
+
+    QNetworkRequest feedRequest(_dataPathRemote);
+    if (activeDataExists && !_activeETag.isEmpty()) {
+        feedRequest.setRawHeader("If-None-Match", _activeETag);
+    }
+    if (activeDataExists && !_activeLastModified.isEmpty()) {
+        feedRequest.setRawHeader("If-Modified-Since", _activeLastModified);
+    }
+
+    // The data is streamed into a buffer sized after the previous download (grown to the Content-Length if known)
+    _downloadBuffer = QByteArray();
+    _downloadBuffer.reserve(_lastPayloadBytes);
+
+    _downloadStartMSec = QDateTime::currentMSecsSinceEpoch();
+    _feedReply = _feedNAM->get(feedRequest);
+    connect(_feedReply, SIGNAL(readyRead()), SLOT(downloadReadyRead()));
+    connect(_feedReply, SIGNAL(finished()), SLOT(downloadFinished()));
+    _fetchTimer->start(_fetchTimeoutMSec);
+}
+
+void RealTimeFeedSource::downloadReadyRead()
+{
+    if (_downloadBuffer.isEmpty()) {
+        qint64 contentLength = _feedReply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+        if (contentLength > _downloadBuffer.capacity()) {
+            _downloadBuffer.reserve(contentLength);
+        }
+    }
+    _downloadBuffer.append(_feedReply->readAll());
+}
+
+void RealTimeFeedSource::downloadTimedOut()
+{
+    if (_trace) {
+        qDebug() << _traceTag.constData() << "ERROR : Download still incomplete after" << _fetchTimeoutMSec
+                 << "ms, aborting it";
+    }
+
+    // Aborting finishes the reply right away (with an error), downloadFinished handles it as a failure
+    _feedReply->abort();
+}
+
+void RealTimeFeedSource::downloadFinished()
+{
+    _fetchTimer->stop();
+
+    QNetworkReply *response = _feedReply;
+    _feedReply = nullptr;
+    response->deleteLater();               // Need to do this or else we leak memory from the QNetworkReply pointer
+
+    bool notModified = response->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304;
+    if (response->error() != QNetworkReply::NoError && !notModified) {
+        if (_trace) {
+            qDebug() << _traceTag.constData() << "ERROR : Download failed:" << response->errorString();
+        }
+        _downloadBuffer = QByteArray();
+
+        RealTimeFetchedData failedFetch;
+        failedFetch.downloadMSec = QDateTime::currentMSecsSinceEpoch() - _downloadStartMSec;
+        archiveFetch(ARCHIVED_FAILED, failedFetch);
+        fetchFailed();
+        return;
+    }
+
+    RealTimeFetchedData fetched;
+    _downloadBuffer.append(response->readAll());
+    fetched.data         = _downloadBuffer;
+    fetched.contentHash  = QCryptographicHash::hash(fetched.data, QCryptographicHash::Sha1);
+    fetched.eTag         = response->rawHeader("ETag");
+    fetched.lastModified = response->rawHeader("Last-Modified");
+    fetched.downloadMSec = QDateTime::currentMSecsSinceEpoch() - _downloadStartMSec;
+    _downloadBuffer = QByteArray();
+    if (!fetched.data.isEmpty()) {
+        _lastPayloadBytes = fetched.data.size();
+    }
+
+    dataFetched(fetched, notModified);
+}
+
+void RealTimeFeedSource::dataFetched(const RealTimeFetchedData &fetched, bool notModified)
+{
+    // Nothing changed since the active data (the server says so, or the content is the same): keep it, and every
+    // response cached from it, and only record that the fetch happened
+    bool unchanged = _activeData != nullptr &&
+                     (notModified || (!fetched.data.isEmpty() && fetched.contentHash == _activeContentHash));
+    archiveFetch(unchanged ? ARCHIVED_UNCHANGED : ARCHIVED_DATA, fetched);
+    if (unchanged) {
+        if (_trace) {
+            qDebug() << _traceTag.constData() << "Real-time data unchanged since the active data, skipping integration";
+        }
+        recordFetch(true);
+        planNextFetch(false);
+        checkSettled();
+        return;
+    }
+
+    // An empty GtfsRealTimePB is either because of an error or no data available. Either way, it's an error.
+    // ... unless we have a local file, that is!
+    if (fetched.data.isEmpty() && _dataPathLocal.isEmpty()) {
+        if (_trace) {
+            qDebug() << _traceTag.constData() << "ERROR : Data feed was empty";
+        }
+        fetchFailed();
+        return;
+    }
+    recordFetch(false);
+
+    // The worker integrates one feed at a time: the latest data fetched meanwhile is integrated once it is done, while
+    // every fetch replayed is integrated in turn (for the replay to publish the exact sequence of feeds recorded)
+    if (!_replaying) {
+        _pendingFetches.clear();
+    }
+    _pendingFetches.enqueue(fetched);
+    if (!_integrating) {
+        startIntegration();
+    }
+}
+
+void RealTimeFeedSource::startIntegration()
+{
+    _integratingFetch = _pendingFetches.dequeue();
+    _integrating      = true;
+
+    // The worker holds on to the data activated last (the integrator may carry parts of it over)
+    RealTimeFetchedData fetched    = _integratingFetch;
+    RealTimeDataPin     previous   = _activeData;
+    Integrator          integrator = _integrator;
+
+    QFuture<RealTimeIntegration> integration = QtConcurrent::run(&_integrationPool, [=]() -> RealTimeIntegration {
+        try {
+            return integrator(fetched, previous);
+        } catch (...) {
+            // Handled by the source the same as an empty dataset error
+            RealTimeIntegration failure;
+            failure.feedTimePOSIX = 0;
+            return failure;
+        }
+    });
+    _integrationWatcher->setFuture(integration);
+}
+
+void RealTimeFeedSource::integrationFinished()
+{
+    RealTimeIntegration integrated = _integrationWatcher->result();
+    _integrating = false;
+
+    if (_nextFetchTimeUTC.isNull()) {
+        // Nobody asked for real-time data while the worker was busy, the source stays idled
+        if (_trace) {
+            qDebug() << _traceTag.constData() << "Real-time data integrated after fetching was idled, discarding it";
+        }
+    } else if (integrated.data == nullptr) {
+        // If an exception is raised at any point, it should be considered the same as an empty dataset error
+        if (_trace) {
+            qDebug() << _traceTag.constData() << "Exception raised while ingesting realtime data";
+        }
+        fetchFailed();
+    } else if (_activeData != nullptr && integrated.feedTimePOSIX == 0) {
+        // Is the new data actually filled with anything?
+        // (Sometimes it trolls us by being empty, in which case just fall back to the version we have)
+        if (_trace) {
+            qDebug() << _traceTag.constData() << "EMPTY FEED FILE, Skipping buffer swap";
+        }
+        planNextFetch(false);
+    } else {
+        // Make the switch after the data is successfully ingested
+        _activeData         = integrated.data;
+        _activeContentHash  = _integratingFetch.contentHash;
+        _activeETag         = _integratingFetch.eTag;
+        _activeLastModified = _integratingFetch.lastModified;
+        setActiveFeedTime(integrated.feedTimePOSIX);
+        emit activated(integrated.data);
+
+        learnPublishCadence(integrated.feedTimePOSIX);
+        planNextFetch(true);
+    }
+    _integratingFetch = RealTimeFetchedData();
+
+    if (!_pendingFetches.isEmpty()) {
+        startIntegration();
+    } else {
+        checkSettled();
+    }
+}
+
+void RealTimeFeedSource::recordFetch(bool unchanged)
+{
+    _lock_fetchInfo.lock();
+    _lastFetchUTC  = QDateTime::currentDateTimeUtc();
+    _failedFetches = 0;
+    if (unchanged) {
+        ++_unchangedFetches;
+    }
+    _lock_fetchInfo.unlock();
+}
+
+void RealTimeFeedSource::archiveFetch(RealTimeArchiveOutcome outcome, const RealTimeFetchedData &fetched)
+{
+    if (_archive == nullptr) {
+        return;
+    }
+
+    // Unchanged data is not kept again, replaying the fetch keeps the data activated the same way
+    RealTimeArchiveRecord record;
+    record.fetchMSec    = QDateTime::currentMSecsSinceEpoch();
+    record.source       = _name;
+    record.outcome      = outcome;
+    record.downloadMSec = fetched.downloadMSec;
+    if (outcome == ARCHIVED_DATA) {
+        record.data = fetched.data;
+    }
+    _archive->append(record);
+}
+
+void RealTimeFeedSource::setActiveFeedTime(quint64 feedTimePOSIX)
+{
+    _lock_fetchInfo.lock();
+    _activeFeedTime = feedTimePOSIX;
+    _lock_fetchInfo.unlock();
+}
+
+void RealTimeFeedSource::fetchFailed()
+{
+    _lock_fetchInfo.lock();
+    quint32 failedFetches = ++_failedFetches;
+    _lock_fetchInfo.unlock();
+
+    // Simply drop the active data but leave the rest alone. This should help the processor to not seek any realtime
+    // information, but will also prevent existing transactions not seg-fault. When good data is found, it is activated.
+    _activeData = RealTimeDataPin();
+    _activeContentHash.clear();
+    setActiveFeedTime(0);
+    emit failed();
+
+    // Retry sooner than the refresh interval at first, then back off (doubling the delay up to the refresh interval)
+    qint64 retryMSec = qMin(static_cast<qint64>(_refreshIntervalSec) * 1000,
+                            kRetryDelayMSec << qMin(failedFetches - 1, 10u));
+    scheduleFetch(QDateTime::currentDateTimeUtc().addMSecs(retryMSec));
+    if (_trace) {
+        qDebug() << _traceTag.constData() << "Fetch failure" << failedFetches << "in a row, retrying in"
+                 << retryMSec << "ms";
+    }
+
+    checkSettled();
+}
+
+void RealTimeFeedSource::abortDownload()
+{
+    if (_feedReply == nullptr) {
+        return;
+    }
+    _fetchTimer->stop();
+    disconnect(_feedReply, nullptr, this, nullptr);
+    _feedReply->abort();
+    _feedReply->deleteLater();
+    _feedReply = nullptr;
+    _downloadBuffer = QByteArray();
+}
+
+void RealTimeFeedSource::checkSettled()
+{
+    if (isSettled()) {
+        emit settled();
+    }
+}
+
+void RealTimeFeedSource::planNextFetch(bool freshData)
+{
+    // Fetching too early for a publication finds the previous feed: aim later after the next expected publications
+    if (freshData) {
+        _staleFetches   = 0;
+        _publishLagMSec = qMax(kMinPublishLagMSec, _publishLagMSec * 3 / 4);
+    } else {
+        ++_staleFetches;
+        if (_publishCadenceMSec > 0) {
+            _publishLagMSec = qMin(_publishLagMSec * 2, _publishCadenceMSec / 2);
+        }
+    }
+
+    // Never fetch more often than the refresh interval, and back off while the agency keeps publishing the same feed
+    quint32 stale        = (_staleFetches > 0) ? qMin(_staleFetches - 1, kMaxStaleDoublings) : 0;
+    qint64  earliestMSec = _fetchStartMSec + ((static_cast<qint64>(_refreshIntervalSec) * 1000) << stale);
+    qint64  nextMSec     = earliestMSec;
+
+    // Once the cadence is known, fetch just after the first publication expected from then on
+    if (_publishCadenceMSec > 0 && _lastHeaderMSec > 0) {
+        qint64 expectedMSec = _lastHeaderMSec + _publishLagMSec;
+        if (expectedMSec < earliestMSec) {
+            expectedMSec += ((earliestMSec - expectedMSec + _publishCadenceMSec - 1) / _publishCadenceMSec)
+                            * _publishCadenceMSec;
+        }
+        nextMSec = qMin(expectedMSec, earliestMSec + _publishCadenceMSec);
+    }
+
+    QDateTime nextFetchUTC = QDateTime::fromMSecsSinceEpoch(qMax(nextMSec, QDateTime::currentMSecsSinceEpoch()),
+                                                            QTimeZone::utc());
+    scheduleFetch(nextFetchUTC);
+    if (_trace) {
+        qDebug() << _traceTag.constData() << "Next fetch at" << nextFetchUTC << "(cadence" << _publishCadenceMSec
+                 << "ms, lag" << _publishLagMSec << "ms," << _staleFetches << "stale fetches)";
+    }
+}
+
+void RealTimeFeedSource::learnPublishCadence(quint64 feedTimePOSIX)
+{
+    qint64 headerMSec = static_cast<qint64>(feedTimePOSIX) * 1000;
+    if (headerMSec <= 0) {
+        return;
+    }
+
+    // Time between the headers of successive feeds (publications missed in between only lengthen the cadence learned,
+    // which then remains a multiple of the actual one), ignoring anything longer than fetches ever get apart
+    qint64 sampleMSec = headerMSec - _lastHeaderMSec;
+    if (_lastHeaderMSec > 0 && sampleMSec > 0 &&
+        sampleMSec <= (static_cast<qint64>(_refreshIntervalSec) * 1000) << kMaxStaleDoublings) {
+        _lock_fetchInfo.lock();
+        if (_publishCadenceMSec == 0) {
+            _publishCadenceMSec = sampleMSec;
+        } else {
+            _publishCadenceMSec += (sampleMSec - _publishCadenceMSec) / 4;
+        }
+        _lock_fetchInfo.unlock();
+    }
+    _lastHeaderMSec = headerMSec;
+}
+
+void RealTimeFeedSource::scheduleFetch(const QDateTime &nextFetchUTC)
+{
+    _lock_fetchInfo.lock();
+    _nextFetchTimeUTC = nextFetchUTC;
+    _lock_fetchInfo.unlock();
+
+    if (nextFetchUTC.isNull() || _replaying) {
+        _scheduleTimer->stop();
+        return;
+    }
+    qint64 dueMSec = QDateTime::currentDateTimeUtc().msecsTo(nextFetchUTC);
+    _scheduleTimer->start(static_cast<int>(qMax(static_cast<qint64>(0), dueMSec)));
+}
+
+} // namespace GTFS
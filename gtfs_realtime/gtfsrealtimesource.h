@@ -0,0 +1,305 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef GTFSREALTIMESOURCE_H
+#define GTFSREALTIMESOURCE_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QUrl>
+#include <QFile>
+#include <QFileSystemWatcher>
+#include <QMutex>
+#include <QQueue>
+#include <QTimer>
+#include <QThreadPool>
+#include <QFutureWatcher>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+
+#include "gtfsrealtimearchive.h"
+
+#include <functional>
+#include <memory>
+
+namespace GTFS {
+
+// Data of a completed fetch, handed over to the integration worker
+typedef struct {
+    QByteArray data;            // GTFS-Realtime protobuf
+    QByteArray contentHash;     // SHA-1 of the data (change detection)
+    QByteArray eTag;            // ETag response header (If-None-Match of the next request)
+    QByteArray lastModified;    // Last-Modified response header (If-Modified-Since of the next request)
+    qint64     downloadMSec;    // Time spent downloading / reading the data
+    std::shared_ptr<const QFile> mappedFile; // Local file the data is mapped from until it is integrated (or nullptr)
+} RealTimeFetchedData;
+
+// Data integrated from a feed (a RealTimeTripUpdate, RealTimeVehiclePositions, ...), pinned by whoever holds on to it
+typedef std::shared_ptr<const QObject> RealTimeDataPin;
+
+// Outcome of the integration of the data fetched
+typedef struct {
+    RealTimeDataPin data;           // Integrated data (nullptr if the integration failed)
+    quint64         feedTimePOSIX;  // Header timestamp of the feed (0 if the feed is empty)
+} RealTimeIntegration;
+
+// Fetch statistics of a source (for status reporting)
+typedef struct {
+    QString   name;               // Label of the source
+    quint64   feedTimePOSIX;      // Header timestamp of the data activated (0 if none)
+    QDateTime lastFetchUTC;       // Time of the latest fetch, whether or not the feed had changed (null if none yet)
+    QDateTime nextFetchUTC;       // Time at which the next fetch is planned (null if idled)
+    quint64   unchangedFetches;   // Fetches which found the same data as the data activated
+    quint32   failedFetches;      // Consecutive fetches which failed (timed out, errors, no data)
+    qint64    publishCadenceSec;  // Learned time between publications of the feed (0 until known)
+} RealTimeSourceStatus;
+
+/*
+ * GTFS::RealTimeFeedPayload keeps a feed as it was fetched, for feeds which are merged with others before they are
+ * integrated. Only the header of the feed is decoded (its entities are skipped), for the scheduling of the fetches.
+ * The payload owns its data: a feed mapped from a local file is copied, as it is merged again whenever another feed
+ * changes (long after the file may have been replaced).
+ */
+class RealTimeFeedPayload : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RealTimeFeedPayload(const RealTimeFetchedData &fetched, QObject *parent = nullptr);
+
+    // Protobuf of the feed
+    const QByteArray &data() const;
+
+    // Header of the feed (timestamp 0 and empty version if it has none)
+    quint64 getFeedTimePOSIX() const;
+    const QString &getFeedGTFSVersion() const;
+
+    // Time spent downloading / reading the feed
+    qint64 getDownloadTimeMSec() const;
+
+private:
+    QByteArray _data;
+    quint64    _feedTimePOSIX;
+    QString    _gtfsVersion;
+    qint64     _downloadMSec;
+};
+
+// A payload held by whoever merges it: freed once nothing holds it anymore
+typedef std::shared_ptr<const RealTimeFeedPayload> RealTimeFeedPayloadPin;
+
+/*
+ * GTFS::RealTimeFeedSource fetches a single GTFS-Realtime feed (from a URL or a local file) on its own schedule and
+ * integrates what it fetches on its own worker thread. What the data is integrated into is up to the integrator given
+ * at construction, the RealTimeGateway publishes whatever is activated.
+ *
+ * A fetch goes through a few stages, driven by signals on the thread of the source (that of the RealTimeGateway):
+ *  - the download is requested (conditionally, see below) and streamed into a buffer sized after the previous one,
+ *    and aborted once its time budget is spent,
+ *  - the data fetched is compared with the data activated (a "304 Not Modified" reply, or identical content), in
+ *    which case the activated data is kept and nothing is integrated,
+ *  - the data is handed over to the worker, while the next download may already proceed (only the latest data
+ *    fetched meanwhile waits for the worker, but every fetch replayed is integrated in turn),
+ *  - the integrated data is activated, unless the feed turned out empty.
+ *
+ * Each fetch plans the next one: the publication cadence of the feed is learned from its header timestamps, and the
+ * feed is fetched just after the first publication expected at least the refresh interval after the previous fetch.
+ * Fetches back off while the agency keeps publishing the same feed, and failed fetches are retried sooner than the
+ * refresh interval at first, backing off at each consecutive failure.
+ *
+ * Every fetch may be recorded to an archive, and a source may replay the fetches of an archive instead of fetching
+ * anything (see RealTimeFeedReplay): the data replayed goes through the same stages from the comparison onwards.
+ *
+ * A local file is mapped in memory rather than read (the data refers to the mapping until it is integrated), so it
+ * must be replaced atomically (written aside, then renamed over) rather than rewritten in place. The file is watched
+ * as well: it is fetched as soon as it is replaced, the refresh interval only matters if no change is noticed.
+ */
+class RealTimeFeedSource : public QObject
+{
+    Q_OBJECT
+public:
+    // Builds the data of a feed (on the worker) from the data fetched and the data the source activated last, if any
+    typedef std::function<RealTimeIntegration(const RealTimeFetchedData &fetched,
+                                              const RealTimeDataPin     &previous)> Integrator;
+
+    /*
+     * name:               label of the source in the traces and the status reports
+     * location:           URL (http:// or https://) or path of a local file holding the feed
+     * refreshIntervalSec: shortest time between two fetches
+     * fetchTimeoutSec:    time budget of a download, after which it is aborted (0 for the default, 4 seconds)
+     * trace:              show the fetch traces
+     * integrator:         builds the data of the feed from the data fetched (see Integrator)
+     */
+    RealTimeFeedSource(const QString &name,
+                       const QString &location,
+                       qint32         refreshIntervalSec,
+                       qint32         fetchTimeoutSec,
+                       bool           trace,
+                       Integrator     integrator,
+                       QObject       *parent = nullptr);
+    virtual ~RealTimeFeedSource();
+
+    // Label of the source
+    const QString &name() const;
+
+    // Is the feed read from a local file?
+    bool isLocal() const;
+
+    // Fetch statistics
+    void getStatus(RealTimeSourceStatus &status);
+
+    // Is every fetch done with (nothing is downloading, integrating or waiting for the worker)?
+    bool isSettled() const;
+
+    // Fetch and integrate the feed, only returning once it was activated (or the fetch failed), for the server startup
+    void initialFetch();
+
+    // Stop fetching (until woken up), dropping the download in progress and forgetting the data activated
+    void idle();
+
+    // Record every fetch (its outcome and data) to the archive from now on
+    void setArchive(RealTimeArchiveWriter *archive);
+
+    // Stop fetching anything for good: the fetches are replayed from an archive instead (see replayFetch)
+    void setReplaying();
+
+    // Go through a fetch recorded in an archive as if it just completed (the data is then integrated as usual)
+    void replayFetch(const RealTimeArchiveRecord &record);
+
+signals:
+    // New data was integrated, to be published
+    void activated(GTFS::RealTimeDataPin data);
+
+    // The fetch or the integration failed, the data activated was dropped
+    void failed();
+
+    // A fetch is done with: its download and integration are over (nothing else is downloading / integrating)
+    void settled();
+
+public slots:
+    // Start a fetch if one is due (the download and integration then proceed asynchronously)
+    void refetchData();
+
+    // Fetch right away if fetching was idled
+    void wake();
+
+    // Arm the fetch timer from the thread of the source (the initial fetch happens before the thread starts)
+    void startScheduling();
+
+private slots:
+    // The download in progress received data, completed (or was aborted), or spent its time budget
+    void downloadReadyRead();
+    void downloadFinished();
+    void downloadTimedOut();
+
+    // The integration worker is done with the data handed over to it
+    void integrationFinished();
+
+    // The local file (or its directory) changed, the file is fetched once the changes settle
+    void localFileChanged();
+    void localFileSettled();
+
+private:
+    // A fetch completed, unchanged if the data activated was kept as-is
+    void recordFetch(bool unchanged);
+
+    // Append the fetch which just completed to the archive, if recording
+    void archiveFetch(RealTimeArchiveOutcome outcome, const RealTimeFetchedData &fetched);
+
+    // Record the header timestamp of the data activated (for the status reports)
+    void setActiveFeedTime(quint64 feedTimePOSIX);
+
+    // Stages of a fetch: request the remote feed (or map the local file), check the data fetched, then integrate it on
+    // the worker
+    void startDownload();
+    void readLocalFile(RealTimeFetchedData &fetched);
+    void dataFetched(const RealTimeFetchedData &fetched, bool notModified);
+    void startIntegration();
+
+    // The fetch failed: drop the data activated and retry after a backoff growing with each consecutive failure
+    void fetchFailed();
+
+    // Drop the download in progress (without considering it a failure)
+    void abortDownload();
+
+    // Signal settled if neither a download nor an integration is in progress
+    void checkSettled();
+
+    // Plan the next fetch after one which found new data (fresh) or the same data (the agency is stale)
+    void planNextFetch(bool freshData);
+
+    // Refine the publication cadence with the header timestamp of newly-activated data
+    void learnPublishCadence(quint64 feedTimePOSIX);
+
+    // Plan the next fetch and arm the fetch timer for it (a null time stops fetching)
+    void scheduleFetch(const QDateTime &nextFetchUTC);
+
+    QString                 _name;               // Label of the source
+    QByteArray              _traceTag;           // Prefix of the traces of the source
+    Integrator              _integrator;         // Builds the data of the feed from the data fetched
+    qint32                  _refreshIntervalSec; // Time between each data refresh attempt (in seconds)
+    qint32                  _fetchTimeoutMSec;   // Time budget of a download, after which it is aborted
+    bool                    _trace;              // true if the periodic refresh traces should show
+    QString                 _dataPathLocal;      // Data Fetch Path (local file)
+    QUrl                    _dataPathRemote;     // Data Fetch Path (remote URL)
+    QNetworkAccessManager  *_feedNAM;            // Network access manager (reusable) for data retrieval
+    QFileSystemWatcher     *_localWatcher;       // Notices the local file being replaced (nullptr until scheduling)
+    QTimer                 *_localChangeTimer;   // Lets a burst of changes to the local file settle before fetching it
+    QDateTime               _localFileModified;  // Modification time of the local file as it was read last
+    qint64                  _localFileBytes;     // Size of the local file as it was read last
+    RealTimeArchiveWriter  *_archive;            // Archive every fetch is recorded to (nullptr if not recording)
+    bool                    _replaying;          // The fetches are replayed from an archive, nothing is fetched
+
+    // Fetch statistics, also read from the request threads
+    QMutex                  _lock_fetchInfo;     // Prevent messing up the fetch statistics
+    QDateTime               _nextFetchTimeUTC;   // Time at which new real-time data should be fetched (null if idled)
+    QDateTime               _lastFetchUTC;       // Time of the latest fetch, whether or not the feed had changed
+    quint64                 _unchangedFetches;   // Fetches which found the same data as the data activated
+    quint32                 _failedFetches;      // Consecutive fetches which failed (retries back off accordingly)
+    qint64                  _publishCadenceMSec; // Learned time between publications of the feed (0 until known)
+    quint64                 _activeFeedTime;     // Header timestamp of the data activated (0 if none)
+
+    // Data activated, and what the next fetch is compared against
+    RealTimeDataPin         _activeData;         // Data activated last (nullptr if none, or dropped)
+    QByteArray              _activeContentHash;  // SHA-1 of the data the active data was integrated from
+    QByteArray              _activeETag;         // ETag returned with the active data (If-None-Match)
+    QByteArray              _activeLastModified; // Last-Modified returned with the active data (If-Modified-Since)
+
+    // Fetch pipeline, only ever driven from the thread of the source
+    QNetworkReply          *_feedReply;          // Download in progress (nullptr if none)
+    QTimer                 *_fetchTimer;         // Aborts the download in progress once its time budget is spent
+    QByteArray              _downloadBuffer;     // Data received by the download in progress (preallocated)
+    qint64                  _downloadStartMSec;  // Time at which the download in progress was requested
+    qint32                  _lastPayloadBytes;   // Size of the latest data downloaded (preallocation of the next one)
+    bool                    _integrating;        // The worker is integrating data
+    QQueue<RealTimeFetchedData> _pendingFetches; // Data waiting for the worker (the latest only, unless replaying)
+    RealTimeFetchedData     _integratingFetch;   // Data being integrated by the worker
+    QThreadPool             _integrationPool;    // Single worker parsing and integrating the data fetched
+    QFutureWatcher<RealTimeIntegration> *_integrationWatcher; // Signals the source's thread when the worker is done
+
+    // Fetch scheduling
+    QTimer                 *_scheduleTimer;      // Fires when the next fetch is due
+    qint64                  _fetchStartMSec;     // Time at which the latest fetch started
+    qint64                  _lastHeaderMSec;     // Header timestamp of the latest data activated (0 if none)
+    qint64                  _publishLagMSec;     // Delay after the expected publication at which the feed is fetched
+    quint32                 _staleFetches;       // Consecutive fetches which found the same data (the agency is stale)
+};
+
+} // Namespace GTFS
+
+#endif // GTFSREALTIMESOURCE_H
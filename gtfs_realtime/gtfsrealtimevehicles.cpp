@@ -0,0 +1,236 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "gtfsrealtimevehicles.h"
+
+#include "gtfs-realtime.pb.h"
+#include <google/protobuf/arena.h>
+
+#include <QtMath>
+#include <QDebug>
+
+namespace GTFS {
+
+// Size of the grid cells the vehicles are indexed on (degrees of latitude and longitude)
+const double kGridCellDeg = 0.01;
+
+// Number of grid columns around the globe (the key of a cell is its row * kGridColumns + its column)
+const qint64 kGridColumns = 36000;
+const qint32 kGridRows    = 18000;
+
+RealTimeVehiclePositions::RealTimeVehiclePositions(const QByteArray   &gtfsRealTimeData,
+                                                   bool                displayBufferInfo,
+                                                   const TripData     *tripsDB,
+                                                   const StopTimeData *stopTimeDB,
+                                                   QObject            *parent)
+    : QObject(parent),
+      _feedTimePOSIX(0),
+      _integrationTimeMSec(0)
+{
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    QDateTime startUTC = QDateTime::currentDateTimeUtc();
+
+    // The protobuf is only needed while the vehicles are converted, so it lives in an arena released all at once
+    google::protobuf::Arena arena;
+    transit_realtime::FeedMessage *feed =
+            google::protobuf::Arena::CreateMessage<transit_realtime::FeedMessage>(&arena);
+    feed->ParseFromArray(gtfsRealTimeData, gtfsRealTimeData.size());
+    _feedTimePOSIX = feed->header().timestamp();
+
+    _vehicles.reserve(feed->entity_size());
+    for (const transit_realtime::FeedEntity &entity : feed->entity()) {
+        if (!entity.has_vehicle() || entity.is_deleted()) {
+            continue;
+        }
+        const transit_realtime::VehiclePosition &pbVehicle = entity.vehicle();
+
+        rtVehiclePosition vehicle;
+        vehicle.label     = QString::fromStdString(pbVehicle.vehicle().label());
+        vehicle.vehicleID = QString::fromStdString(pbVehicle.vehicle().id());
+        if (vehicle.vehicleID.isEmpty()) {
+            vehicle.vehicleID = vehicle.label.isEmpty() ? QString::fromStdString(entity.id()) : vehicle.label;
+        }
+        vehicle.tripID  = QString::fromStdString(pbVehicle.trip().trip_id());
+        vehicle.routeID = QString::fromStdString(pbVehicle.trip().route_id());
+        if (vehicle.routeID.isEmpty() && tripsDB != nullptr && tripsDB->contains(vehicle.tripID)) {
+            vehicle.routeID = (*tripsDB)[vehicle.tripID].route_id;
+        }
+
+        // The current stop is either given directly or as a stop sequence of the trip in the static feed
+        vehicle.stopID       = QString::fromStdString(pbVehicle.stop_id());
+        vehicle.stopSequence = pbVehicle.has_current_stop_sequence() ? pbVehicle.current_stop_sequence() : -1;
+        if (vehicle.stopID.isEmpty() && vehicle.stopSequence >= 0 &&
+            stopTimeDB != nullptr && stopTimeDB->contains(vehicle.tripID)) {
+            for (const StopTimeRec &stopTime : (*stopTimeDB)[vehicle.tripID]) {
+                if (stopTime.stop_sequence == vehicle.stopSequence) {
+                    vehicle.stopID = stopTime.stop_id;
+                    break;
+                }
+            }
+        }
+
+        if (pbVehicle.current_status() == transit_realtime::VehiclePosition::INCOMING_AT) {
+            vehicle.status = "INCOMING_AT";
+        } else if (pbVehicle.current_status() == transit_realtime::VehiclePosition::STOPPED_AT) {
+            vehicle.status = "STOPPED_AT";
+        } else {
+            vehicle.status = "IN_TRANSIT_TO";
+        }
+
+        vehicle.hasPosition = pbVehicle.has_position();
+        vehicle.latitude    = pbVehicle.position().latitude();
+        vehicle.longitude   = pbVehicle.position().longitude();
+        vehicle.bearing     = pbVehicle.position().has_bearing() ? pbVehicle.position().bearing() : -1;
+        vehicle.speed       = pbVehicle.position().has_speed() ? pbVehicle.position().speed() : -1;
+        if (pbVehicle.timestamp() != 0) {
+            vehicle.timestamp = QDateTime::fromSecsSinceEpoch(pbVehicle.timestamp());
+        }
+
+        // Index the vehicle (a trip reported by several vehicles keeps the most recent position)
+        qint32 vehicleIdx = _vehicles.size();
+        if (!vehicle.tripID.isEmpty()) {
+            if (!_byTrip.contains(vehicle.tripID) ||
+                _vehicles.at(_byTrip[vehicle.tripID]).timestamp < vehicle.timestamp) {
+                _byTrip[vehicle.tripID] = vehicleIdx;
+            }
+        }
+        if (!vehicle.routeID.isEmpty()) {
+            _byRoute[vehicle.routeID].push_back(vehicleIdx);
+        }
+        if (vehicle.hasPosition) {
+            _byCell[gridRow(vehicle.latitude) * kGridColumns + gridColumn(vehicle.longitude)].push_back(vehicleIdx);
+        }
+        _vehicles.push_back(vehicle);
+    }
+
+    _integrationTimeMSec = startUTC.msecsTo(QDateTime::currentDateTimeUtc());
+    if (displayBufferInfo) {
+        qDebug() << "  (RTVP) GTFS-Realtime : LIVE Protobuf: " << gtfsRealTimeData.size() << "bytes consisting of"
+                 << _vehicles.size() << "vehicles in" << _byCell.size() << "grid cells, integrated in"
+                 << _integrationTimeMSec << "ms.";
+    }
+}
+
+RealTimeVehiclePositions::~RealTimeVehiclePositions()
+{
+}
+
+QDateTime RealTimeVehiclePositions::getFeedTime() const
+{
+    // An empty buffer has a header of 0 seconds-since-epoch, which really means there is no feed time
+    if (_feedTimePOSIX == 0) {
+        return QDateTime();
+    } else {
+        return QDateTime::fromSecsSinceEpoch(_feedTimePOSIX);
+    }
+}
+
+quint64 RealTimeVehiclePositions::getFeedTimePOSIX() const
+{
+    return _feedTimePOSIX;
+}
+
+qint32 RealTimeVehiclePositions::getNbVehicles() const
+{
+    return _vehicles.size();
+}
+
+qint64 RealTimeVehiclePositions::getIntegrationTimeMSec() const
+{
+    return _integrationTimeMSec;
+}
+
+const rtVehiclePosition *RealTimeVehiclePositions::vehicleForTrip(const QString &tripID) const
+{
+    QHash<QString, qint32>::const_iterator vehicleIt = _byTrip.constFind(tripID);
+    if (vehicleIt == _byTrip.constEnd()) {
+        return nullptr;
+    }
+    return &_vehicles.at(vehicleIt.value());
+}
+
+void RealTimeVehiclePositions::vehiclesOnRoute(const QString                      &routeID,
+                                               QVector<const rtVehiclePosition *> &vehicles) const
+{
+    for (qint32 vehicleIdx : _byRoute.value(routeID)) {
+        vehicles.push_back(&_vehicles.at(vehicleIdx));
+    }
+}
+
+void RealTimeVehiclePositions::vehiclesInBox(double lat1, double lon1, double lat2, double lon2,
+                                             QVector<const rtVehiclePosition *> &vehicles) const
+{
+    double minLat = qMin(lat1, lat2);
+    double maxLat = qMax(lat1, lat2);
+    double minLon = qMin(lon1, lon2);
+    double maxLon = qMax(lon1, lon2);
+    qint32 firstRow = gridRow(minLat);
+    qint32 lastRow  = gridRow(maxLat);
+    qint32 firstCol = gridColumn(minLon);
+    qint32 lastCol  = gridColumn(maxLon);
+
+    // Cells overlapping the box: a large box goes through the occupied cells instead of every cell it covers
+    QVector<const QVector<qint32> *> cells;
+    qint64 boxCells = static_cast<qint64>(lastRow - firstRow + 1) * (lastCol - firstCol + 1);
+    if (boxCells > _byCell.size()) {
+        for (QHash<qint64, QVector<qint32>>::const_iterator cellIt = _byCell.constBegin();
+             cellIt != _byCell.constEnd(); ++cellIt) {
+            qint32 row = static_cast<qint32>(cellIt.key() / kGridColumns);
+            qint32 col = static_cast<qint32>(cellIt.key() % kGridColumns);
+            if (row >= firstRow && row <= lastRow && col >= firstCol && col <= lastCol) {
+                cells.push_back(&cellIt.value());
+            }
+        }
+    } else {
+        for (qint32 row = firstRow; row <= lastRow; ++row) {
+            for (qint32 col = firstCol; col <= lastCol; ++col) {
+                QHash<qint64, QVector<qint32>>::const_iterator cellIt = _byCell.constFind(row * kGridColumns + col);
+                if (cellIt != _byCell.constEnd()) {
+                    cells.push_back(&cellIt.value());
+                }
+            }
+        }
+    }
+
+    // Cells along the edges of the box are only partly inside of it
+    for (const QVector<qint32> *cell : cells) {
+        for (qint32 vehicleIdx : *cell) {
+            const rtVehiclePosition &vehicle = _vehicles.at(vehicleIdx);
+            if (vehicle.latitude >= minLat && vehicle.latitude <= maxLat &&
+                vehicle.longitude >= minLon && vehicle.longitude <= maxLon) {
+                vehicles.push_back(&vehicle);
+            }
+        }
+    }
+}
+
+qint32 RealTimeVehiclePositions::gridRow(double latitude)
+{
+    return qBound(0, static_cast<qint32>(qFloor((latitude + 90.0) / kGridCellDeg)), kGridRows - 1);
+}
+
+qint32 RealTimeVehiclePositions::gridColumn(double longitude)
+{
+    return qBound(0, static_cast<qint32>(qFloor((longitude + 180.0) / kGridCellDeg)),
+                  static_cast<qint32>(kGridColumns) - 1);
+}
+
+} // namespace GTFS
@@ -0,0 +1,113 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef GTFSREALTIMEVEHICLES_H
+#define GTFSREALTIMEVEHICLES_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QString>
+#include <QDateTime>
+
+#include <memory>
+
+// For vehicles which do not include their route or stop, the static feed's trips and stop times provide them
+#include "gtfsstoptimes.h"
+#include "gtfstrip.h"
+
+namespace GTFS {
+
+// Position of one vehicle, converted from the protobuf once when the feed is integrated
+typedef struct {
+    QString   vehicleID;     // Vehicle ID (otherwise its label, otherwise the ID of the feed entity)
+    QString   label;         // User-visible label of the vehicle (empty if not provided)
+    QString   tripID;        // Trip operated by the vehicle (empty if not provided)
+    QString   routeID;       // Route of the vehicle, otherwise that of the static trip (empty if unknown)
+    QString   stopID;        // Current stop of the vehicle, otherwise that of its stop sequence (empty if unknown)
+    qint64    stopSequence;  // Stop sequence of the current stop (-1 if not provided)
+    QString   status;        // Relation to the current stop: INCOMING_AT, STOPPED_AT or IN_TRANSIT_TO
+    bool      hasPosition;   // The latitude and longitude are provided
+    double    latitude;
+    double    longitude;
+    float     bearing;       // Degrees clockwise from true north (-1 if not provided)
+    float     speed;         // Meters per second (-1 if not provided)
+    QDateTime timestamp;     // Time at which the position was measured (null if not provided)
+} rtVehiclePosition;
+
+/*
+ * RealTimeVehiclePositions holds the GTFS-Realtime VehiclePositions feed of the agency. The vehicles are indexed when
+ * the feed is integrated, by the trip they operate, by their route and on a grid of 0.01 x 0.01 degree cells (roughly
+ * a kilometer across) so that the vehicles around a place are found without going through the whole fleet.
+ *
+ * Like the trip updates, an integrated feed is never modified: it is published by the RealTimeGateway and freed once
+ * the last request holding it is done.
+ */
+class RealTimeVehiclePositions : public QObject
+{
+    Q_OBJECT
+public:
+    // Constructor from the bytes of a VehiclePositions feed
+    explicit RealTimeVehiclePositions(const QByteArray   &gtfsRealTimeData,
+                                      bool                displayBufferInfo,
+                                      const TripData     *tripsDB,
+                                      const StopTimeData *stopTimeDB,
+                                      QObject            *parent = nullptr);
+
+    virtual ~RealTimeVehiclePositions();
+
+    // Feed header time (null / 0 if the feed is empty)
+    QDateTime getFeedTime() const;
+    quint64 getFeedTimePOSIX() const;
+
+    // Integration statistics
+    qint32 getNbVehicles() const;
+    qint64 getIntegrationTimeMSec() const;
+
+    // Vehicle operating a trip (nullptr if the trip has no vehicle in the feed)
+    const rtVehiclePosition *vehicleForTrip(const QString &tripID) const;
+
+    // Vehicles on a route (appended to vehicles)
+    void vehiclesOnRoute(const QString &routeID, QVector<const rtVehiclePosition *> &vehicles) const;
+
+    // Vehicles positioned inside the box made of two opposite corners (appended to vehicles)
+    void vehiclesInBox(double lat1, double lon1, double lat2, double lon2,
+                       QVector<const rtVehiclePosition *> &vehicles) const;
+
+private:
+    // Grid cell of a position (rows run from the south pole, columns from the antimeridian)
+    static qint32 gridRow(double latitude);
+    static qint32 gridColumn(double longitude);
+
+    QVector<rtVehiclePosition>      _vehicles;   // Every vehicle of the feed, in feed order
+    QHash<QString, qint32>          _byTrip;     // Vehicle operating each trip (the latest position if several)
+    QHash<QString, QVector<qint32>> _byRoute;    // Vehicles on each route
+    QHash<qint64, QVector<qint32>>  _byCell;     // Positioned vehicles in each occupied grid cell
+
+    quint64 _feedTimePOSIX;
+    qint64  _integrationTimeMSec;
+};
+
+// Vehicle positions held by a request (or published by the RealTimeGateway): freed once nothing holds them anymore
+typedef std::shared_ptr<const RealTimeVehiclePositions> RealTimeVehiclesPin;
+
+} // namespace GTFS
+
+#endif // GTFSREALTIMEVEHICLES_H
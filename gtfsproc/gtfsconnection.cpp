@@ -4,27 +4,49 @@
 
 #include "gtfsconnection.h"
 #include "gtfsrequestprocessor.h"
+#include "upcomingstopsubscriptions.h"
 
 #include <QDebug>
 #include <QThreadPool>
 #include <QDateTime>
 
-GtfsConnection::GtfsConnection(bool logTransactionsToTerminal, QObject *parent) : TcpConnection(parent)
+// Time without any more data after which an unterminated request is handed off as it is (milliseconds), only for the
+// clients which never terminated a request
+const qint32 kUnterminatedRequestMSec = 20;
+
+GtfsConnection::GtfsConnection(bool logTransactionsToTerminal, QObject *parent) :
+    TcpConnection(parent),
+    _terminatesRequests(false),
+    _nextRequestSeq(0),
+    _nextResponseSeq(0)
 {
     _showTransactions = logTransactionsToTerminal;
+
+    _unterminatedTimer = new QTimer(this);
+    _unterminatedTimer->setSingleShot(true);
+    connect(_unterminatedTimer, SIGNAL(timeout()), this, SLOT(unterminatedRequest()));
+
+    // Requests refer to the connection by its ID (they are processed on other threads, which must not hold on to it)
+    _clientID = GTFS::UpcomingStopSubscriptions::inst().registerClient(this);
 }
 
 GtfsConnection::~GtfsConnection()
 {
 //    qDebug() << "GtfsConnection " << this << " destroyed";
+
+    // Nothing may be pushed to the connection anymore (no-op if it was unregistered when it disconnected)
+    GTFS::UpcomingStopSubscriptions::inst().unregisterClient(_clientID);
 }
 
 void GtfsConnection::requestApplication(QString applicationRequest)
 {
-    // The request processor
-    GtfsRequestProcessor *userRequest = new GtfsRequestProcessor(applicationRequest);
+    // The request processor, its response takes its turn after those of the requests handed off before it
+    GtfsRequestProcessor *userRequest = new GtfsRequestProcessor(applicationRequest, _clientID);
     userRequest->setAutoDelete(true);
-    connect(userRequest, SIGNAL(Result(QString)), this, SLOT(taskResult(QString)), Qt::QueuedConnection);
+    quint64 requestSeq = _nextRequestSeq++;
+    connect(userRequest, &GtfsRequestProcessor::Result, this, [this, requestSeq](QString userResponse) {
+        requestResult(requestSeq, userResponse);
+    }, Qt::QueuedConnection);
 
     // Schedule for execution
     QThreadPool::globalInstance()->start(userRequest);
@@ -38,6 +60,9 @@ void GtfsConnection::connected()
 void GtfsConnection::disconnected()
 {
 //    qDebug() << "GtfsConnection " << this << " disconnected";
+
+    // Nobody is left to push board changes to
+    GTFS::UpcomingStopSubscriptions::inst().unregisterClient(_clientID);
 }
 
 void GtfsConnection::readyRead()
@@ -48,9 +73,47 @@ void GtfsConnection::readyRead()
 
 //    qDebug() << "GtfsConnection " << this << " ReadyRead: " << m_socket;
 
+    // Every complete request received is handed off, what remains waits for the rest of its request
+    _unterminatedTimer->stop();
+    _requestBuffer.append(m_socket->readAll());
+    qsizetype requestStart = 0;
+    for (qsizetype requestEnd = _requestBuffer.indexOf('\n'); requestEnd != -1;
+         requestEnd = _requestBuffer.indexOf('\n', requestStart)) {
+        QByteArray request = _requestBuffer.mid(requestStart, requestEnd - requestStart);
+        if (request.endsWith('\r')) {
+            request.chop(1);
+        }
+        requestStart = requestEnd + 1;
+
+        // Blank lines between requests are not requests
+        if (!request.trimmed().isEmpty()) {
+            dispatchRequest(request);
+        }
+    }
+    _requestBuffer.remove(0, requestStart);
+    if (requestStart > 0) {
+        _terminatesRequests = true;
+    }
+
+    // Legacy clients do not terminate their requests: what they sent is a request once nothing more arrives
+    if (!_requestBuffer.isEmpty() && !_terminatesRequests) {
+        _unterminatedTimer->start(kUnterminatedRequestMSec);
+    }
+}
+
+void GtfsConnection::unterminatedRequest()
+{
+    QByteArray request = _requestBuffer;
+    _requestBuffer.clear();
+    if (!request.trimmed().isEmpty()) {
+        dispatchRequest(request);
+    }
+}
+
+void GtfsConnection::dispatchRequest(const QByteArray &request)
+{
     // Let's print the query sent in to the local debug
-    QByteArray socketInput = m_socket->readAll();
-    QString qSocketInput = socketInput;
+    QString qSocketInput = request;
 
     if (_showTransactions) {
         qDebug().noquote().nospace()
@@ -72,8 +135,26 @@ void GtfsConnection::bytesWritten(qint64 bytes)
 //    qDebug() << "GtfsConnection " << this << " BytesWritten: " << m_socket;
 }
 
+void GtfsConnection::requestResult(quint64 requestSeq, QString userResponse)
+{
+    // Responses completed out of order wait for those of the earlier requests
+    _pendingResponses.insert(requestSeq, userResponse);
+    for (QMap<quint64, QString>::iterator next = _pendingResponses.begin();
+         next != _pendingResponses.end() && next.key() == _nextResponseSeq;
+         next = _pendingResponses.erase(next)) {
+        if (m_socket) {
+            m_socket->write(next.value().toUtf8());
+        }
+        ++_nextResponseSeq;
+    }
+}
+
 void GtfsConnection::taskResult(QString userResponse)
 {
+    if (!m_socket) {
+        return;
+    }
+
     QByteArray dataOut = userResponse.toUtf8();
     m_socket->write(dataOut);
 }
@@ -86,5 +167,5 @@ void GtfsConnection::stateChanged(QAbstractSocket::SocketState socketState)
 
 void GtfsConnection::error(QAbstractSocket::SocketError socketError)
 {
-    qDebug() << "GtfsConnection " << this << " error " << m_socket << socketError;
+    qDebug() << "GtfsConnection " << this << " error " << m_socket.data() << socketError;
 }
@@ -7,6 +7,9 @@
 
 #include "tcpconnection.h"
 
+#include <QMap>
+#include <QTimer>
+
 // Access data
 #include "gtfsstatus.h"
 
@@ -14,7 +17,15 @@
  * GtfsConnection is a class which binds to a QThreadPool for the purposes of processing a client's request. Client
  * connections are handled with connected() and disconnected(), readyRead() is signaled when a request come from a
  * client (the handling of such a request is sent to requestApplication() which actually hands off the request to the
- * QThreadPool), and taskResult() is signaled from the thread processing a request so the data can be sent client-side.
+ * QThreadPool), and requestResult() is signaled from the thread processing a request so the data can be sent
+ * client-side. taskResult() sends data the client did not request (subscription pushes) right away.
+ *
+ * Requests are terminated by a '\n': the bytes received are buffered until a request is complete, and every complete
+ * request is handed off at once, so a client may send several requests without waiting for the responses (pipelining).
+ * The responses are sent in the order of the requests, however the thread pool happens to complete them. Clients
+ * which never terminated a request (sending one request at a time) still have their data taken as a single request
+ * once nothing more arrives for a moment. Once a client sent a '\n', it is only ever framed by them: a request split
+ * over several packets is never cut short.
  */
 class GtfsConnection : public TcpConnection
 {
@@ -26,6 +37,9 @@ public:
 protected:
     void requestApplication(QString applicationRequest);
 
+    // Hands off a complete request (without its terminating '\n')
+    void dispatchRequest(const QByteArray &request);
+
 signals:
 
 public slots:
@@ -38,9 +52,15 @@ public slots:
     // Responds to the clients with JSON data
     virtual void bytesWritten(qint64 bytes);
 
-    // Accepts the asynchronous result of a task to respond to the client
+    // Accepts the asynchronous result of a request, sent once the responses to all the earlier requests were sent
+    virtual void requestResult(quint64 requestSeq, QString userResponse);
+
+    // Sends data to the client right away (pushed rather than requested)
     virtual void taskResult(QString userResponse);
 
+    // Data without a terminating '\n' received no follow-up: hand it off as a request of its own
+    virtual void unterminatedRequest();
+
     virtual void stateChanged(QAbstractSocket::SocketState socketState);
     virtual void error(QAbstractSocket::SocketError socketError);
 
@@ -48,6 +68,15 @@ private:
     // Data stores for application?
     GTFS::Status const *Status;
     bool                _showTransactions;
+    quint64             _clientID;          // Registered to GTFS::UpcomingStopSubscriptions for the pushed data
+
+    // Request framing and response ordering
+    QByteArray              _requestBuffer;     // Bytes received which do not form a complete request yet
+    QTimer                 *_unterminatedTimer; // Hands off an unterminated request once nothing more arrives
+    bool                    _terminatesRequests; // The client sent a '\n': its requests are never taken unterminated
+    quint64                 _nextRequestSeq;    // Sequence number of the next request handed off
+    quint64                 _nextResponseSeq;   // Sequence number of the next response to send
+    QMap<quint64, QString>  _pendingResponses;  // Responses completed ahead of those of earlier requests
 };
 
 #endif // GTFSCONNECTION_H
@@ -35,7 +35,11 @@
 #include "realtimeproductstatus.h"
 #include "routerealtimedata.h"
 #include "upcomingstopservice.h"
+#include "upcomingstopbatch.h"
+#include "upcomingstopsubscriber.h"
 #include "servicebetweenstops.h"
+#include "vehiclepositions.h"
+#include "servicealerts.h"
 
 // Qt Framework Dependencies
 #include <QVector>
@@ -46,7 +50,9 @@
 #include <QTime>
 #include <QDebug>
 
-GtfsRequestProcessor::GtfsRequestProcessor(QString userRequest) : request(userRequest)
+GtfsRequestProcessor::GtfsRequestProcessor(QString userRequest, quint64 clientID) :
+    request(userRequest),
+    requester(clientID)
 {
 
 }
@@ -55,9 +61,14 @@ GtfsRequestProcessor::GtfsRequestProcessor(QString userRequest) : request(userRe
  * Application Kick-Off
  */
 void GtfsRequestProcessor::run()
+{
+    emit Result(QString::fromUtf8(processRequest()));
+}
+
+QByteArray GtfsRequestProcessor::processRequest()
 {
     QJsonObject respJson;
-    QString     SystemResponse;
+    QByteArray  SystemResponse;
 
 //    qDebug() << "GtfsRequestProcessor: Answering on thread " << this;
 
@@ -127,6 +138,33 @@ void GtfsRequestProcessor::run()
             listifyIDs(userReq, decodedStopIDs);
             GTFS::UpcomingStopService NXR(decodedStopIDs, 4320, false, true);
             NXR.fillResponseData(respJson);
+        } else if (! userApp.compare("NEB", Qt::CaseInsensitive) || ! userApp.compare("NCB", Qt::CaseInsensitive)) {
+            // Batch of independent NEX (or NCF) boards, each group of stop IDs is separated by a ";"
+            bool combinedFormat = false;
+            if (! userApp.compare("NCB", Qt::CaseInsensitive)) {
+                combinedFormat = true;
+            }
+            QString remainingReq;
+            qint32 futureMinutes = determineMinuteRange(userReq, remainingReq);
+            QList<QList<QString>> stopGroups;
+            for (const QString &stopGroup : remainingReq.split(';', Qt::SkipEmptyParts)) {
+                QList<QString> decodedStopIDs;
+                listifyIDs(stopGroup, decodedStopIDs);
+                stopGroups.append(decodedStopIDs);
+            }
+            GTFS::UpcomingStopBatch NEB(stopGroups, futureMinutes, combinedFormat);
+            NEB.fillResponseData(respJson);
+        } else if (! userApp.compare("SUB", Qt::CaseInsensitive)) {
+            // Board of the stop ID(s) like NCF, later changes to it are pushed to the client as they happen
+            QString remainingReq;
+            qint32 futureMinutes = determineMinuteRange(userReq, remainingReq);
+            QList<QString> decodedStopIDs;
+            listifyIDs(remainingReq, decodedStopIDs);
+            GTFS::UpcomingStopSubscriber SUB(requester, decodedStopIDs, futureMinutes);
+            SUB.fillResponseData(respJson);
+        } else if (! userApp.compare("UNS", Qt::CaseInsensitive)) {
+            GTFS::UpcomingStopSubscriber UNS(requester, userReq.toULongLong());
+            UNS.fillResponseData(respJson);
         } else if (! userApp.compare("SNT", Qt::CaseInsensitive)) {
             GTFS::StopsWithoutTrips SNT;
             SNT.fillResponseData(respJson);
@@ -185,7 +223,9 @@ void GtfsRequestProcessor::run()
             E2E.fillResponseData(respJson);
         } else if (! userApp.compare("DRT", Qt::CaseInsensitive)) {
             GTFS::RealtimeTripInformation DRT;
-            DRT.dumpRealTime(SystemResponse);
+            QString decodedRealtime;
+            DRT.dumpRealTime(decodedRealtime);
+            SystemResponse = decodedRealtime.toUtf8();
         } else if (! userApp.compare("RPS", Qt::CaseInsensitive)) {
             GTFS::RealtimeProductStatus RPS;
             RPS.fillResponseData(respJson);
@@ -195,6 +235,37 @@ void GtfsRequestProcessor::run()
             listifyIDs(remainingReq, decodedRouteIDs);
             GTFS::RouteRealtimeData TRR(decodedRouteIDs);
             TRR.fillResponseData(respJson);
+        } else if (! userApp.compare("ALR", Qt::CaseInsensitive)) {
+            QList<QString> decodedAlertIDs;
+            listifyIDs(userReq, decodedAlertIDs);
+            GTFS::ServiceAlerts ALR(decodedAlertIDs);
+            ALR.fillResponseData(respJson);
+        } else if (! userApp.compare("VEH", Qt::CaseInsensitive)) {
+            // Vehicles either on routes ("R route1|route2") or inside of a box ("B lat1 lon1 lat2 lon2")
+            QString vehicleMode  = userReq.left(userReq.indexOf(" "));
+            QString remainingReq = userReq.mid(userReq.indexOf(" ") + 1);
+            QList<QString> corners = remainingReq.split(' ', Qt::SkipEmptyParts);
+            bool cornersOk = (corners.size() == 4);
+            QVector<double> coords;
+            for (const QString &corner : corners) {
+                bool coordOk = false;
+                coords.push_back(corner.toDouble(&coordOk));
+                cornersOk = cornersOk && coordOk;
+            }
+            if (! vehicleMode.compare("R", Qt::CaseInsensitive) && userReq.indexOf(" ") != -1) {
+                QList<QString> decodedRouteIDs;
+                listifyIDs(remainingReq, decodedRouteIDs);
+                GTFS::VehiclePositions VEH(decodedRouteIDs);
+                VEH.fillResponseData(respJson);
+            } else if (! vehicleMode.compare("B", Qt::CaseInsensitive) && cornersOk) {
+                GTFS::VehiclePositions VEH(coords[0], coords[1], coords[2], coords[3]);
+                VEH.fillResponseData(respJson);
+            } else {
+                // Neither mode could be decoded
+                QList<QString> noRouteIDs;
+                GTFS::VehiclePositions VEH(noRouteIDs);
+                VEH.fillProtocolFields("VEH", 1102, respJson);
+            }
         } else {
             // Return ERROR 1: Unknown request (userApp)
             respJson["error"] = 1;
@@ -213,7 +284,7 @@ void GtfsRequestProcessor::run()
     } else {
         SystemResponse += "\n";
     }
-    emit Result(SystemResponse);
+    return SystemResponse;
 }
 
 QDate GtfsRequestProcessor::determineServiceDay(const QString &userReq, QString &remUserQuery)
@@ -33,7 +33,12 @@ class GtfsRequestProcessor : public QObject , public QRunnable
 {
     Q_OBJECT
 public:
-    GtfsRequestProcessor(QString userRequest);
+    // clientID is the requesting client as registered to GTFS::UpcomingStopSubscriptions (needed by the requests
+    // subscribing to pushed data, 0 if the request does not come from a connected client)
+    GtfsRequestProcessor(QString userRequest, quint64 clientID = 0);
+
+    // Process the request right away on the calling thread, returning the UTF-8 response (terminated with a '\n')
+    QByteArray processRequest();
 
 signals:
     // JSON-style response, terminated with a '\n' (required for clients to detect the end of output over a socket)
@@ -103,8 +108,9 @@ private:
      */
     void listifyIDs(const QString &remUserQuery, QList<QString> &listOfIDs);
 
-    // Data member
-    QString request;
+    // Data members
+    QString  request;
+    quint64  requester;
 };
 
 #endif // GTFSREQUESTPROCESSOR_H
@@ -23,26 +23,42 @@
 // GTFS Static Data
 #include "datagateway.h"
 #include "gtfsconnection.h"
+#include "serverstatus.h"
+#include "upcomingstopcache.h"
+#include "upcomingstopprecompute.h"
+#include "upcomingstopsubscriptions.h"
 
 // GTFS RealTime Data
 #include "gtfsrealtimegateway.h"
 
 #include <QThread>
+#include <QTimeZone>
 #include <QDebug>
 
 ServeGTFS::ServeGTFS(QString  dbRootPath,
-                     QString  realTimePath,
+                     QStringList realTimePaths,
                      qint32   rtInterval,
+                     qint32   rtTimeout,
+                     QString  vehiclesPath,
+                     QString  alertsPath,
+                     QString  recordPath,
+                     QString  replayPath,
+                     double   replaySpeed,
                      QString  frozenTime,
                      bool     use12h,
                      quint32  rtDateMatchLev,
                      bool     showTraces,
                      quint32  numberTripsPerRouteNEX,
                      bool     hideEndingTrips,
+                     qint32   delayBoundNEX,
+                     qint32   cacheSecNEX,
+                     qint32   precompNEX,
+                     qint32   precompMSecNEX,
                      bool     loosenRealTimeStopSeq,
                      QString  zOptions,
                      QObject *parent) :
-    TcpServer(parent)
+    TcpServer(parent),
+    _statusTimer(nullptr)
 {
     // Transaction and update logging:
     _showTraces = showTraces;
@@ -58,7 +74,7 @@ ServeGTFS::ServeGTFS(QString  dbRootPath,
     // Populate each data set
 
     // "Status" is special: it holds server parameters as well as the content from feed_info.txt and agency.txt
-    data.initStatus(frozenTime, use12h, numberTripsPerRouteNEX, hideEndingTrips,
+    data.initStatus(frozenTime, use12h, numberTripsPerRouteNEX, hideEndingTrips, delayBoundNEX,
                     rtDateMatchLev, loosenRealTimeStopSeq, zOptions);
     data.initRoutes();                   // Fill the Routes database from routes.txt
     data.initOperatingDay();             // Fill the calendar.txt and calendar_dates.txt
@@ -73,8 +89,14 @@ ServeGTFS::ServeGTFS(QString  dbRootPath,
     // Note when we finished loading (for performance analysis)
     GTFS::DataGateway::inst().setStatusLoadFinishTimeUTC();
 
+    // Responses to upcoming-service requests may be reused for a short while (see UpcomingStopCache)
+    GTFS::UpcomingStopCache::inst().setGranularity(cacheSecNEX);
+
+    // Boards subscribed to (SUB) are refreshed from the server's thread on new real-time data and every minute
+    GTFS::UpcomingStopSubscriptions::inst().startRefreshing();
+
     // If Real-Time data is requested, then we also need to load it
-    if (realTimePath.isEmpty()) {
+    if (realTimePaths.isEmpty()) {
         return;
     }
 
@@ -86,21 +108,44 @@ ServeGTFS::ServeGTFS(QString  dbRootPath,
         dateEnforcement = GTFS::NO_MATCHING;
     }
 
-    rtData.setRealTimeFeedPath(realTimePath,
-                               rtInterval,
-                               dateEnforcement,
-                               loosenRealTimeStopSeq,
-                               allSkippedIsCanceled,
-                               _showTraces,
-                               data.getTripsDB(),
-                               data.getStopTimesDB());
-    rtData.refetchData();
+    rtData.setRealTimeFeedPaths(realTimePaths,
+                                rtInterval,
+                                rtTimeout,
+                                dateEnforcement,
+                                loosenRealTimeStopSeq,
+                                allSkippedIsCanceled,
+                                _showTraces,
+                                data.getTripsDB(),
+                                data.getStopTimesDB());
+    if (!vehiclesPath.isEmpty()) {
+        rtData.setVehiclePositionsPath(vehiclesPath, rtInterval, rtTimeout);
+    }
+    if (!alertsPath.isEmpty()) {
+        rtData.setAlertsPath(alertsPath, rtInterval, rtTimeout, data.getRoutesDB());
+    }
+
+    // A replay goes through recorded fetches instead of fetching (starting at the -f time), moving the time of every
+    // transaction along with the fetches replayed, otherwise the fetches may be recorded for a replay
+    if (!replayPath.isEmpty()) {
+        const QTimeZone &agencyTZ = data.getStatus()->getAgencyTZ();
+        connect(&rtData, &GTFS::RealTimeGateway::replayClockAdvanced, [agencyTZ](const QDateTime &fetchTimeUTC) {
+            GTFS::DataGateway::inst().setStatusOverrideDateTime(fetchTimeUTC.toTimeZone(agencyTZ));
+        });
+        rtData.setReplayPath(replayPath, data.getStatus()->getOverrideDateTime(), replaySpeed);
+    } else if (!recordPath.isEmpty()) {
+        rtData.setRecordPath(recordPath);
+    }
+    rtData.initialFetch();
 
     // The real-time processor must be able to independently download new realtime protobuf files
     QThread *rtThread = new QThread;
     GTFS::RealTimeGateway::inst().moveToThread(rtThread);
     connect(rtThread, SIGNAL(started()), &GTFS::RealTimeGateway::inst(), SLOT(dataRetrievalLoop()));
     rtThread->start();
+
+    // The most requested boards are computed in the background as soon as new real-time data is activated
+    GTFS::UpcomingStopPrecompute::inst().setParameters(precompNEX, precompMSecNEX);
+    GTFS::UpcomingStopPrecompute::inst().startPrecomputing();
 }
 
 ServeGTFS::~ServeGTFS()
@@ -123,6 +168,36 @@ void ServeGTFS::displayDebugging() const
     qDebug() << "Feed Version  . . ." << data->getVersion() << Qt::endl;
 }
 
+bool ServeGTFS::listen(const QHostAddress &address, quint16 port)
+{
+    if (!TcpServer::listen(address, port)) {
+        return false;
+    }
+
+    // The event loop lag of the I/O threads is probed every 250 ms, every second is plenty for the status to report
+    _statusTimer = new QTimer(this);
+    connect(_statusTimer, &QTimer::timeout, this, &ServeGTFS::publishStatus);
+    _statusTimer->start(1000);
+    publishStatus();
+    return true;
+}
+
+void ServeGTFS::publishStatus()
+{
+    QVector<TcpShardStatus> shards;
+    shardStatus(shards);
+
+    QVector<GTFS::IoThreadStatus> ioThreads;
+    for (const TcpShardStatus &shard : qAsConst(shards)) {
+        GTFS::IoThreadStatus ioThread;
+        ioThread.connections = shard.connections;
+        ioThread.lagMSec     = shard.lagMSec;
+        ioThread.maxLagMSec  = shard.maxLagMSec;
+        ioThreads.push_back(ioThread);
+    }
+    GTFS::ServerStatus::inst().setIoThreads(ioThreads);
+}
+
 void ServeGTFS::incomingConnection(qintptr descriptor)
 {
 //    qDebug() << "Discovered an incoming GTFS Request: " << descriptor;
@@ -24,6 +24,7 @@
 #include "tcpserver.h"
 
 #include <QString>
+#include <QTimer>
 
 /*
  * ServeGTFS is used to initialize the data from the requested data path(s), it also spawns the GTFS Realtime data
@@ -41,8 +42,14 @@ public:
      * GTFS / TCP Server object, this persists through the entire process
      *
      * dbRootPath:     path to the folder containing all GTFS *.txt files as the static dataset
-     * realTimePath:   path (local or URI) to the GTFS real-time data to supplement the processor
+     * realTimePaths:  paths (local or URI) to the GTFS real-time trip updates to supplement the processor (merged)
      * rtInterval:     number of seconds to wait between each refresh of the real-time data feed
+     * rtTimeout:      number of seconds a real-time feed download may take before it is aborted (0 = default, 4 s)
+     * vehiclesPath:   path (local or URI) to the GTFS real-time vehicle positions (empty = none)
+     * alertsPath:     path (local or URI) to the GTFS real-time service alerts (empty = none)
+     * recordPath:     archive to which every real-time fetch is appended, for it to be replayed (empty = no recording)
+     * replayPath:     archive of real-time fetches replayed instead of fetching, from the frozenTime on (empty = none)
+     * replaySpeed:    how many times faster than recorded the real-time fetches are replayed (0 = as recorded)
      * frozenTime:     yyyy,mm,dd,hh,mm,ss to force the transactions to always process as if it is the date specified
      *                     NOTE: this is in the timezone of the GTFS agency.txt file time
      * use12h:         all date-times should render with AM/PM indicator using a 12-hour clock instead of default 24-h
@@ -50,18 +57,32 @@ public:
      * showTraces:     set to true if all transactions and real-time update operations should be logged to the terminal
      * nbTripsRtNEX:   number of trips per route that should be serialized in NEX responses
      * hideTermTrips:  set to true if trips terminating at the requested stop should be hidden (NEX/NCF only)
+     * delayBoundNEX:  max. seconds real-time data may shift a trip, allows NEX to stop evaluating trips early (0 = off)
+     * cacheSecNEX:    seconds for which a computed NEX/NCF response may be served to identical requests (0 = off)
+     * precompNEX:     number of most-requested NEX/NCF boards to precompute after each real-time refresh (0 = off)
+     * precompMSecNEX: time budget (ms) of the precomputation after each real-time refresh (0 = no limit)
      * looseRTStopSeq: do not enforce strict stop sequence / stop id checks when sequences are avail. in realtime feed
      * zOptions:       special GtfsProc server processing override flags for various work-arounds
      */
     ServeGTFS(QString  dbRootPath,
-              QString  realTimePath,
+              QStringList realTimePaths,
               qint32   rtInterval,
+              qint32   rtTimeout,
+              QString  vehiclesPath,
+              QString  alertsPath,
+              QString  recordPath,
+              QString  replayPath,
+              double   replaySpeed,
               QString  frozenTime,
               bool     use12h,
               quint32  rtDateMatchLev,
               bool     showTraces,
               quint32  nbTripsRtNEX,
               bool     hideTermTrips,
+              qint32   delayBoundNEX,
+              qint32   cacheSecNEX,
+              qint32   precompNEX,
+              qint32   precompMSecNEX,
               bool     looseRTStopSeq,
               QString  zOptions,
               QObject *parent        = nullptr);
@@ -69,14 +90,22 @@ public:
 
     void displayDebugging() const;
 
+    // Listen for the requests, the status of the I/O threads is then pushed to GTFS::ServerStatus every second
+    virtual bool listen(const QHostAddress &address, quint16 port);
+
 protected:
     virtual void incomingConnection(qintptr descriptor); //qint64, qHandle, qintptr, uint
 
+private slots:
+    // Push the status of the I/O threads for the requests to report (SDS)
+    void publishStatus();
+
 private:
     QStringList CreateZOptions(QString zOptComma);
     bool IsInZOptions(const QStringList &zOpts, const QString zOpt);
 
-    bool _showTraces;
+    bool    _showTraces;
+    QTimer *_statusTimer;  // Pushes the status of the I/O threads while listening
 };
 
 #endif // SERVEGTFS_H
@@ -24,8 +24,14 @@
 #include <QThreadPool>
 #include <QTextStream>
 #include <QSettings>
+#include <QDateTime>
 
 #include "servegtfs.h"
+#include "gtfsrequestprocessor.h"
+#include "upcomingstopsubscriptions.h"
+#ifdef Q_OS_LINUX
+#include "epollserver.h"
+#endif
 
 int main(int argc, char *argv[])
 {
@@ -90,29 +96,98 @@ int main(int argc, char *argv[])
     quint16 portNum                      = gtfsProcSettings.value("static/serverPort").toUInt();
     bool    use12HourTimes               = gtfsProcSettings.value("static/clock12hFormat").toBool();
     int     nbProcThreads                = gtfsProcSettings.value("static/numberThreads").toInt();
+    int     nbIoThreads                  = gtfsProcSettings.value("static/ioThreads", 1).toInt();
+    QString serverBackend                = gtfsProcSettings.value("static/serverBackend", "qt").toString();
     quint32 nbTripsPerNEXRoute           = gtfsProcSettings.value("static/nexTripsPerRoute").toUInt();
     bool    hideTerminatingTripsNEXNCF   = gtfsProcSettings.value("static/hideTerminating").toBool();
+    qint32  nexDelayBoundSeconds         = gtfsProcSettings.value("static/nexDelayBoundSec").toInt();
+    qint32  nexCacheSeconds              = gtfsProcSettings.value("static/nexCacheSec").toInt();
+    qint32  nexPrecomputeBoards          = gtfsProcSettings.value("static/nexPrecomputeBoards").toInt();
+    qint32  nexPrecomputeMSec            = gtfsProcSettings.value("static/nexPrecomputeMSec").toInt();
     QString zOptions                     = gtfsProcSettings.value("static/zOptions").toString();
 
-    QString realTimePath                 = gtfsProcSettings.value("realtime/feedLocation").toString();
+    QStringList realTimePaths            = gtfsProcSettings.value("realtime/feedLocation").toStringList();
     bool    loosenRTStopSeqStopIDEnforce = gtfsProcSettings.value("realtime/skipStopSeqMatch").toBool();
     quint32 realTimeDateMatchLevel       = gtfsProcSettings.value("realtime/serviceDateMatch").toUInt();
     qint32  rtDataInterval               = gtfsProcSettings.value("realtime/updateInterval").toInt();
+    qint32  rtFetchTimeout               = gtfsProcSettings.value("realtime/fetchTimeoutSec").toInt();
+    QString vehiclePositionsPath         = gtfsProcSettings.value("realtime/vehiclePositionsLocation").toString();
+    QString alertsPath                   = gtfsProcSettings.value("realtime/alertsLocation").toString();
+    QString recordPath                   = gtfsProcSettings.value("realtime/recordPath").toString();
+    QString replayPath                   = gtfsProcSettings.value("realtime/replayPath").toString();
+    double  replaySpeed                  = gtfsProcSettings.value("realtime/replaySpeed").toDouble();
 
     QThreadPool::globalInstance()->setMaxThreadCount(nbProcThreads);
     ServeGTFS gtfsRequestServer(databaseRootPath,
-                                realTimePath,
+                                realTimePaths,
                                 rtDataInterval,
+                                rtFetchTimeout,
+                                vehiclePositionsPath,
+                                alertsPath,
+                                recordPath,
+                                replayPath,
+                                replaySpeed,
                                 unchangingLocalTime,
                                 use12HourTimes,
                                 realTimeDateMatchLevel,
                                 showTransactions,
                                 nbTripsPerNEXRoute,
                                 hideTerminatingTripsNEXNCF,
+                                nexDelayBoundSeconds,
+                                nexCacheSeconds,
+                                nexPrecomputeBoards,
+                                nexPrecomputeMSec,
                                 loosenRTStopSeqStopIDEnforce,
                                 zOptions);
     gtfsRequestServer.displayDebugging();
 
+#ifdef Q_OS_LINUX
+    /*
+     * NATIVE EPOLL BACKEND: the requests are read, processed and answered without going through the Qt event loop
+     */
+    if (serverBackend == "epoll") {
+        EpollServer epollRequestServer(
+            [showTransactions](const QByteArray &request, quint64 clientID) {
+                if (showTransactions) {
+                    qDebug().noquote().nospace()
+                            << "[" << QDateTime::currentDateTimeUtc().toString("yyyy-MM-dd hh:mm:ss t")
+                            << "] '" << QString::fromUtf8(request) << "'";
+                }
+                GtfsRequestProcessor userRequest(QString::fromUtf8(request), clientID);
+                return userRequest.processRequest();
+            },
+            [](QObject *client) {
+                return GTFS::UpcomingStopSubscriptions::inst().registerClient(client);
+            },
+            [](quint64 clientID) {
+                // Nobody is left to push board changes to
+                GTFS::UpcomingStopSubscriptions::inst().unregisterClient(clientID);
+            });
+        epollRequestServer.setIoThreads(nbIoThreads);
+        epollRequestServer.setWorkerThreads(nbProcThreads);
+
+        // The workers take over the processing threads: the global pool is only left the parallel parts of the requests
+        // (whose calling worker takes part in them) and of the real-time integration, a single thread (Qt keeps one)
+        QThreadPool::globalInstance()->setMaxThreadCount(1);
+
+        if (epollRequestServer.listen(portNum)) {
+            console << "SERVER STARTED - READY TO ACCEPT INCOMING CONNECTIONS" << Qt::endl << Qt::endl;
+        } else {
+            console << epollRequestServer.errorString();
+            console << Qt::endl << "(!) COULD NOT START SERVER - SEE ERROR STRING ABOVE" << Qt::endl;
+            return 1;
+        }
+
+        return a.exec();
+    }
+#endif
+    if (serverBackend != "qt") {
+        qDebug() << "NOTE: Server backend" << serverBackend << "is not available, using the Qt backend instead.";
+    }
+
+    // Connections are spread over the I/O threads, each reading / writing its own clients' sockets
+    gtfsRequestServer.setIoThreads(nbIoThreads);
+
     /*
      * BEGIN LISTENING FOR CONNECTIONS
      */
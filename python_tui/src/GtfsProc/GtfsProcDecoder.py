@@ -91,9 +91,9 @@ class GtfsProcDecoder:
                 "",
             ]
         elif message_type == 'RDS':
-            if data['active_side'] in ['A', 'B']:
+            if 'active_rt_version' in data:
                 return [
-                    f"Mutex Side . . . . . {data['active_side']}",
+                    f"Published Gen  . . . {data['feed_generation']}",
                     f"Data Generation  . . {data['active_feed_time']}",
                     f"GTFS-Realtime Ver  . {data['active_rt_version']}",
                     f"Fetch Time . . . . . {data['active_download_ms']} ms",
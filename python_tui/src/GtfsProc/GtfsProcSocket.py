@@ -12,6 +12,7 @@ class GtfsProcSocket:
             sock.connect((self.host_name, self.host_port))
             cmdb = bytearray()
             cmdb.extend(command.encode())
+            cmdb.extend(b'\n')
             sock.sendall(cmdb)
 
             # Receive the data until the termination character (\n)
@@ -0,0 +1,682 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "epollserver.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QSet>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+// Time without any more data after which an unterminated request is handed off as it is (milliseconds), only for the
+// clients which never terminated a request
+const qint64 kUnterminatedRequestMSec = 20;
+
+// Capacity kept by the input and output buffers of a connection, and size of the reads (bytes)
+const qsizetype kConnectionBufferBytes = 64 * 1024;
+
+// Events handled per wait of an I/O thread
+const int kEventsPerWait = 64;
+
+// Identifiers of the events which are not those of a connection (connections are numbered from kFirstConnection)
+const quint64 kListenEvent     = 0;
+const quint64 kWakeEvent       = 1;
+const quint64 kFirstConnection = 2;
+
+static QString lastSystemError()
+{
+    return QString::fromLocal8Bit(strerror(errno));
+}
+
+// A connection, only ever touched by the I/O thread which accepted it
+struct EpollConnection {
+    int          fd;
+    quint64      id;
+    QByteArray   input;                  // Received, not yet handed off
+    QByteArray   output;                 // To be written (once written, kept for the next responses)
+    qsizetype    outputSent;             // Bytes of the output already written
+    bool         writeWatched;           // Waiting for the socket to accept more of the output
+    bool         flushQueued;            // Output appended while draining the completions, to be written after
+    quint64      nextRequestSeq;
+    quint64      nextResponseSeq;
+    QMap<quint64, QByteArray> pendingResponses;  // Completed out of order, waiting for those of the earlier requests
+    int          inFlight;               // Requests handed off whose response is not back yet
+    qint64       unterminatedDeadline;   // When the input without terminating newline is handed off
+    bool         terminatesRequests;     // The client sent a newline: its input always waits for the next one
+    bool         readClosed;             // The client is done sending: closed once its responses are all written
+    EpollClient *client;
+    quint64      clientID;               // Given by the OpenHandler
+};
+
+// Response (or pushed data) produced on another thread, for the I/O thread of its connection to write
+struct EpollCompletion {
+    quint64    connectionId;
+    quint64    requestSeq;
+    bool       push;
+    QByteArray data;
+};
+
+/*
+ * EpollLoop is the event loop of one I/O thread of the EpollServer
+ */
+class EpollLoop
+{
+public:
+    EpollLoop(int listenFd, WorkStealingPool *pool, const EpollServer::Handler &handler,
+              const EpollServer::OpenHandler &opened, const EpollServer::CloseHandler &closed);
+    ~EpollLoop();
+
+    bool init(QString &errorString);
+    void run();
+    void stop();
+
+    // Queue data for a connection of the loop and wake it up to write it (thread-safe)
+    void complete(quint64 connectionId, quint64 requestSeq, bool push, const QByteArray &data);
+
+private:
+    void acceptConnection();
+    bool readConnection(EpollConnection *conn);
+    void dispatchRequest(EpollConnection *conn, const QByteArray &request);
+    void handOffUnterminated();
+    void drainCompletions();
+    bool flush(EpollConnection *conn);
+    void watchWrites(EpollConnection *conn, bool watch);
+    void watchEvents(EpollConnection *conn);
+    bool closeIfDone(EpollConnection *conn);
+    void closeConnection(EpollConnection *conn);
+    void releaseClient(EpollConnection *conn);
+    int  waitTimeout();
+
+    int                               m_listenFd;
+    int                               m_epollFd;
+    int                               m_wakeFd;
+    WorkStealingPool                 *m_pool;
+    const EpollServer::Handler       &m_handler;
+    const EpollServer::OpenHandler   &m_opened;
+    const EpollServer::CloseHandler  &m_closed;
+    QAtomicInt                        m_stopping;
+    QElapsedTimer                     m_clock;
+    quint64                           m_nextId;
+    QHash<quint64, EpollConnection*>  m_connections;
+    QSet<quint64>                     m_unterminated;   // Connections with input waiting for its newline
+    QMutex                            m_completionLock;
+    QVector<EpollCompletion>          m_completions;    // Protected by m_completionLock
+    QVector<EpollCompletion>          m_draining;       // Swapped with m_completions to write them without the lock
+    QVector<EpollConnection*>         m_flushes;
+    char                              m_readBuffer[kConnectionBufferBytes];
+};
+
+EpollClient::EpollClient(EpollLoop *loop, quint64 connectionId) :
+    m_loop(loop),
+    m_connectionId(connectionId)
+{
+}
+
+void EpollClient::taskResult(QString userResponse)
+{
+    m_loop->complete(m_connectionId, 0, true, userResponse.toUtf8());
+}
+
+EpollLoop::EpollLoop(int listenFd, WorkStealingPool *pool, const EpollServer::Handler &handler,
+                     const EpollServer::OpenHandler &opened, const EpollServer::CloseHandler &closed) :
+    m_listenFd(listenFd),
+    m_epollFd(-1),
+    m_wakeFd(-1),
+    m_pool(pool),
+    m_handler(handler),
+    m_opened(opened),
+    m_closed(closed),
+    m_stopping(0),
+    m_nextId(kFirstConnection)
+{
+    m_clock.start();
+}
+
+EpollLoop::~EpollLoop()
+{
+    // The server is closed from the thread the clients live on (the main thread), they go away right here
+    for (EpollConnection *conn : qAsConst(m_connections)) {
+        ::close(conn->fd);
+        m_closed(conn->clientID);
+        delete conn->client;
+        delete conn;
+    }
+    if (m_wakeFd != -1) {
+        ::close(m_wakeFd);
+    }
+    if (m_epollFd != -1) {
+        ::close(m_epollFd);
+    }
+}
+
+bool EpollLoop::init(QString &errorString)
+{
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epollFd == -1 || m_wakeFd == -1) {
+        errorString = lastSystemError();
+        return false;
+    }
+
+    epoll_event wakeEvent = {};
+    wakeEvent.events   = EPOLLIN;
+    wakeEvent.data.u64 = kWakeEvent;
+
+    // Only one of the I/O threads is woken up for an incoming connection
+    epoll_event listenEvent = {};
+    listenEvent.events   = EPOLLIN;
+#ifdef EPOLLEXCLUSIVE
+    listenEvent.events  |= EPOLLEXCLUSIVE;
+#endif
+    listenEvent.data.u64 = kListenEvent;
+
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &wakeEvent) == -1 ||
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &listenEvent) == -1) {
+        errorString = lastSystemError();
+        return false;
+    }
+    return true;
+}
+
+void EpollLoop::run()
+{
+    epoll_event events[kEventsPerWait];
+    while (!m_stopping.loadAcquire()) {
+        int nbEvents = epoll_wait(m_epollFd, events, kEventsPerWait, waitTimeout());
+        if (nbEvents == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qDebug() << "EpollServer: waiting for events failed:" << lastSystemError();
+            return;
+        }
+
+        for (int e = 0; e < nbEvents; ++e) {
+            if (events[e].data.u64 == kListenEvent) {
+                acceptConnection();
+            } else if (events[e].data.u64 == kWakeEvent) {
+                eventfd_t wakeUps;
+                eventfd_read(m_wakeFd, &wakeUps);
+                drainCompletions();
+            } else {
+                EpollConnection *conn = m_connections.value(events[e].data.u64, nullptr);
+                if (conn == nullptr) {
+                    continue;
+                }
+                if (conn->readClosed) {
+                    // Nothing is read anymore: a hang-up or an error means the responses cannot be written either
+                    if (events[e].events & (EPOLLHUP | EPOLLERR)) {
+                        closeConnection(conn);
+                        continue;
+                    }
+                } else if ((events[e].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) &&
+                           !readConnection(conn)) {
+                    // Hang-ups and errors are found out by reading
+                    continue;
+                }
+                if (events[e].events & EPOLLOUT) {
+                    flush(conn);
+                }
+            }
+        }
+
+        handOffUnterminated();
+    }
+}
+
+void EpollLoop::stop()
+{
+    m_stopping.storeRelease(1);
+    eventfd_write(m_wakeFd, 1);
+}
+
+void EpollLoop::complete(quint64 connectionId, quint64 requestSeq, bool push, const QByteArray &data)
+{
+    m_completionLock.lock();
+    bool wakeUp = m_completions.isEmpty();
+    m_completions.push_back({connectionId, requestSeq, push, data});
+    m_completionLock.unlock();
+
+    // The loop is already due to drain the completions queued before this one
+    if (wakeUp) {
+        eventfd_write(m_wakeFd, 1);
+    }
+}
+
+void EpollLoop::acceptConnection()
+{
+    // A single connection is accepted per wake-up, leaving the next ones to whichever I/O thread is woken up next
+    int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED) {
+            qDebug() << "EpollServer: accepting a connection failed:" << lastSystemError();
+        }
+        return;
+    }
+
+    // Responses are written whole, there is nothing to gain from delaying them
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    EpollConnection *conn      = new EpollConnection;
+    conn->fd                   = fd;
+    conn->id                   = m_nextId++;
+    conn->outputSent           = 0;
+    conn->writeWatched         = false;
+    conn->flushQueued          = false;
+    conn->nextRequestSeq       = 0;
+    conn->nextResponseSeq      = 0;
+    conn->inFlight             = 0;
+    conn->unterminatedDeadline = 0;
+    conn->terminatesRequests   = false;
+    conn->readClosed           = false;
+    conn->input.reserve(kConnectionBufferBytes);
+    conn->output.reserve(kConnectionBufferBytes);
+
+    // The client receives the pushed data through the event loop of the main thread
+    conn->client   = new EpollClient(this, conn->id);
+    conn->clientID = m_opened(conn->client);
+    conn->client->moveToThread(QCoreApplication::instance()->thread());
+
+    epoll_event connEvent = {};
+    connEvent.events   = EPOLLIN | EPOLLRDHUP;
+    connEvent.data.u64 = conn->id;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &connEvent) == -1) {
+        qDebug() << "EpollServer: watching a connection failed:" << lastSystemError();
+        ::close(fd);
+        releaseClient(conn);
+        return;
+    }
+    m_connections.insert(conn->id, conn);
+}
+
+bool EpollLoop::readConnection(EpollConnection *conn)
+{
+    bool endOfInput = false;
+    for (;;) {
+        ssize_t nbRead = recv(conn->fd, m_readBuffer, sizeof(m_readBuffer), 0);
+        if (nbRead > 0) {
+            conn->input.append(m_readBuffer, nbRead);
+            if (nbRead < static_cast<ssize_t>(sizeof(m_readBuffer))) {
+                break;
+            }
+        } else if (nbRead == 0) {
+            endOfInput = true;
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            closeConnection(conn);
+            return false;
+        }
+    }
+
+    // Every complete request received is handed off, what remains waits for the rest of its request
+    qsizetype requestStart = 0;
+    for (qsizetype requestEnd = conn->input.indexOf('\n'); requestEnd != -1;
+         requestEnd = conn->input.indexOf('\n', requestStart)) {
+        QByteArray request = conn->input.mid(requestStart, requestEnd - requestStart);
+        if (request.endsWith('\r')) {
+            request.chop(1);
+        }
+        requestStart = requestEnd + 1;
+
+        // Blank lines between requests are not requests
+        if (!request.trimmed().isEmpty()) {
+            dispatchRequest(conn, request);
+        }
+    }
+    conn->input.remove(0, requestStart);
+    if (requestStart > 0) {
+        conn->terminatesRequests = true;
+    }
+
+    /*
+     * The client is done sending (it may still be reading): the requests it sent are answered before the connection is
+     * closed. What a legacy client sent is a request of its own, the rest of a terminated request is never coming.
+     */
+    if (endOfInput) {
+        if (!conn->terminatesRequests && !conn->input.trimmed().isEmpty()) {
+            dispatchRequest(conn, conn->input);
+        }
+        conn->input.clear();
+        conn->unterminatedDeadline = 0;
+        m_unterminated.remove(conn->id);
+        conn->readClosed = true;
+        watchEvents(conn);
+        return !closeIfDone(conn);
+    }
+
+    // Legacy clients do not terminate their requests: what they sent is a request once nothing more arrives
+    if (conn->input.isEmpty() || conn->terminatesRequests) {
+        conn->unterminatedDeadline = 0;
+        m_unterminated.remove(conn->id);
+    } else {
+        conn->unterminatedDeadline = m_clock.elapsed() + kUnterminatedRequestMSec;
+        m_unterminated.insert(conn->id);
+    }
+    return true;
+}
+
+void EpollLoop::dispatchRequest(EpollConnection *conn, const QByteArray &request)
+{
+    // The response takes its turn after those of the requests handed off before it
+    quint64 requestSeq   = conn->nextRequestSeq++;
+    quint64 connectionId = conn->id;
+    quint64 clientID     = conn->clientID;
+    ++conn->inFlight;
+
+    m_pool->submit([this, connectionId, requestSeq, request, clientID]() {
+        complete(connectionId, requestSeq, false, m_handler(request, clientID));
+    });
+}
+
+void EpollLoop::handOffUnterminated()
+{
+    if (m_unterminated.isEmpty()) {
+        return;
+    }
+
+    qint64 now = m_clock.elapsed();
+    for (QSet<quint64>::iterator id = m_unterminated.begin(); id != m_unterminated.end();) {
+        EpollConnection *conn = m_connections.value(*id);
+        if (conn->unterminatedDeadline > now) {
+            ++id;
+            continue;
+        }
+        id = m_unterminated.erase(id);
+
+        QByteArray request = conn->input;
+        conn->input.resize(0);
+        conn->unterminatedDeadline = 0;
+        if (!request.trimmed().isEmpty()) {
+            dispatchRequest(conn, request);
+        }
+    }
+}
+
+void EpollLoop::drainCompletions()
+{
+    m_completionLock.lock();
+    m_draining.swap(m_completions);
+    m_completionLock.unlock();
+
+    // Everything completed is appended to the outputs first, so each connection is written to once
+    for (EpollCompletion &completion : m_draining) {
+        EpollConnection *conn = m_connections.value(completion.connectionId, nullptr);
+        if (conn == nullptr) {
+            continue;
+        }
+
+        if (!completion.push) {
+            --conn->inFlight;
+
+            // Responses completed out of order wait for those of the earlier requests
+            if (completion.requestSeq != conn->nextResponseSeq) {
+                conn->pendingResponses.insert(completion.requestSeq, completion.data);
+                continue;
+            }
+            conn->output.append(completion.data);
+            ++conn->nextResponseSeq;
+            for (QMap<quint64, QByteArray>::iterator next = conn->pendingResponses.begin();
+                 next != conn->pendingResponses.end() && next.key() == conn->nextResponseSeq;
+                 next = conn->pendingResponses.erase(next)) {
+                conn->output.append(next.value());
+                ++conn->nextResponseSeq;
+            }
+        } else {
+            // Pushed data is written right away, in between the responses
+            conn->output.append(completion.data);
+        }
+
+        if (!conn->flushQueued) {
+            conn->flushQueued = true;
+            m_flushes.push_back(conn);
+        }
+    }
+    m_draining.clear();
+
+    for (EpollConnection *conn : qAsConst(m_flushes)) {
+        conn->flushQueued = false;
+        if (!conn->writeWatched) {
+            flush(conn);
+        }
+    }
+    m_flushes.clear();
+}
+
+bool EpollLoop::flush(EpollConnection *conn)
+{
+    while (conn->outputSent < conn->output.size()) {
+        ssize_t nbSent = send(conn->fd, conn->output.constData() + conn->outputSent,
+                              conn->output.size() - conn->outputSent, MSG_NOSIGNAL);
+        if (nbSent >= 0) {
+            conn->outputSent += nbSent;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            watchWrites(conn, true);
+            return true;
+        } else {
+            closeConnection(conn);
+            return false;
+        }
+    }
+
+    // Everything is written, the buffer keeps its capacity for the next responses
+    conn->output.resize(0);
+    conn->outputSent = 0;
+    watchWrites(conn, false);
+    return !closeIfDone(conn);
+}
+
+void EpollLoop::watchWrites(EpollConnection *conn, bool watch)
+{
+    if (conn->writeWatched == watch) {
+        return;
+    }
+    conn->writeWatched = watch;
+    watchEvents(conn);
+}
+
+void EpollLoop::watchEvents(EpollConnection *conn)
+{
+    // Hang-ups and errors are always reported, even once nothing is read anymore
+    epoll_event connEvent = {};
+    connEvent.events   = (conn->readClosed ? 0 : EPOLLIN | EPOLLRDHUP) | (conn->writeWatched ? EPOLLOUT : 0);
+    connEvent.data.u64 = conn->id;
+    epoll_ctl(m_epollFd, EPOLL_CTL_MOD, conn->fd, &connEvent);
+}
+
+bool EpollLoop::closeIfDone(EpollConnection *conn)
+{
+    if (!conn->readClosed || conn->inFlight > 0 || conn->outputSent < conn->output.size()) {
+        return false;
+    }
+    closeConnection(conn);
+    return true;
+}
+
+void EpollLoop::closeConnection(EpollConnection *conn)
+{
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    ::close(conn->fd);
+    m_unterminated.remove(conn->id);
+    m_connections.remove(conn->id);
+    releaseClient(conn);
+}
+
+void EpollLoop::releaseClient(EpollConnection *conn)
+{
+    /*
+     * Nobody is left to push data to: the close handler runs on the thread of the client (where pushes are handed to
+     * it), and the client is only released once it has. The responses of the requests still being processed are
+     * dropped as they come back (connections are never given the ID of another).
+     */
+    EpollClient                *client   = conn->client;
+    quint64                     clientID = conn->clientID;
+    EpollServer::CloseHandler   closed   = m_closed;
+    QMetaObject::invokeMethod(client, [client, clientID, closed]() {
+        closed(clientID);
+        client->deleteLater();
+    }, Qt::QueuedConnection);
+
+    delete conn;
+}
+
+int EpollLoop::waitTimeout()
+{
+    // Wait no longer than until the earliest unterminated request is due to be handed off
+    qint64 earliest = -1;
+    for (quint64 id : qAsConst(m_unterminated)) {
+        qint64 deadline = m_connections.value(id)->unterminatedDeadline;
+        if (earliest == -1 || deadline < earliest) {
+            earliest = deadline;
+        }
+    }
+    if (earliest == -1) {
+        return -1;
+    }
+    return static_cast<int>(qMax<qint64>(0, earliest - m_clock.elapsed()));
+}
+
+EpollServer::EpollServer(Handler handler, OpenHandler opened, CloseHandler closed) :
+    m_handler(handler),
+    m_opened(opened),
+    m_closed(closed),
+    m_ioThreads(1),
+    m_workerThreads(1),
+    m_listenFd(-1),
+    m_pool(nullptr)
+{
+}
+
+EpollServer::~EpollServer()
+{
+    close();
+}
+
+void EpollServer::setIoThreads(int ioThreads)
+{
+    m_ioThreads = qMax(1, ioThreads);
+}
+
+void EpollServer::setWorkerThreads(int workerThreads)
+{
+    m_workerThreads = qMax(1, workerThreads);
+}
+
+bool EpollServer::listen(quint16 port)
+{
+    // Dual-stack socket (IPv4 clients show up as IPv4-mapped addresses), IPv4 only where IPv6 is not available
+    bool ipv6 = true;
+    m_listenFd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listenFd == -1) {
+        ipv6 = false;
+        m_listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    }
+    if (m_listenFd == -1) {
+        m_errorString = lastSystemError();
+        return false;
+    }
+
+    int reuseAddress = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+
+    int bound;
+    if (ipv6) {
+        int v6Only = 0;
+        setsockopt(m_listenFd, IPPROTO_IPV6, IPV6_V6ONLY, &v6Only, sizeof(v6Only));
+        sockaddr_in6 address = {};
+        address.sin6_family = AF_INET6;
+        address.sin6_addr   = in6addr_any;
+        address.sin6_port   = htons(port);
+        bound = bind(m_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    } else {
+        sockaddr_in address = {};
+        address.sin_family      = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port        = htons(port);
+        bound = bind(m_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    }
+    if (bound == -1 || ::listen(m_listenFd, SOMAXCONN) == -1) {
+        m_errorString = lastSystemError();
+        ::close(m_listenFd);
+        m_listenFd = -1;
+        return false;
+    }
+
+    m_pool = new WorkStealingPool(m_workerThreads);
+    for (int t = 0; t < m_ioThreads; ++t) {
+        EpollLoop *loop = new EpollLoop(m_listenFd, m_pool, m_handler, m_opened, m_closed);
+        if (!loop->init(m_errorString)) {
+            delete loop;
+            close();
+            return false;
+        }
+        QThread *thread = QThread::create([loop]() { loop->run(); });
+        m_loops.push_back(loop);
+        m_threads.push_back(thread);
+        thread->start();
+    }
+    return true;
+}
+
+void EpollServer::close()
+{
+    for (EpollLoop *loop : qAsConst(m_loops)) {
+        loop->stop();
+    }
+    for (QThread *thread : qAsConst(m_threads)) {
+        thread->wait();
+        delete thread;
+    }
+    m_threads.clear();
+
+    // The requests still queued are processed (their responses are dropped) before the connections go away
+    delete m_pool;
+    m_pool = nullptr;
+    qDeleteAll(m_loops);
+    m_loops.clear();
+
+    if (m_listenFd != -1) {
+        ::close(m_listenFd);
+        m_listenFd = -1;
+    }
+}
+
+QString EpollServer::errorString() const
+{
+    return m_errorString;
+}
@@ -0,0 +1,104 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef EPOLLSERVER_H
+#define EPOLLSERVER_H
+
+#include "workstealingpool.h"
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QThread>
+
+#include <functional>
+
+class EpollLoop;
+
+/*
+ * EpollClient stands for a connection of the EpollServer wherever a connection object is expected (such as the clients
+ * of the pushed departure boards): it lives on the main thread and hands whatever it is given to its taskResult slot
+ * over to the event loop of its connection, to be written right away (or dropped once it is closed). It is deleted on
+ * the main thread, right after the close handler of its connection ran there.
+ */
+class EpollClient : public QObject
+{
+    Q_OBJECT
+public:
+    EpollClient(EpollLoop *loop, quint64 connectionId);
+
+public slots:
+    void taskResult(QString userResponse);
+
+private:
+    EpollLoop *m_loop;
+    quint64    m_connectionId;
+};
+
+/*
+ * EpollServer is an alternative to the TcpServer (Linux only) serving the same newline-framed requests without going
+ * through the Qt event loop: each of its I/O threads waits on an epoll instance of its own for the listening socket
+ * (accepting exclusively, so that a connection wakes a single thread up) and the sockets of the connections it
+ * accepted. Complete requests are handed to a WorkStealingPool and their responses are handed straight back to the
+ * connection's I/O thread, which writes them in the order of the requests from a buffer reused for the life of the
+ * connection. As with GtfsConnection, the requests of a client which never sent a newline are handed off after 20 ms
+ * without more data. A client which is done sending is still answered: its connection is closed once every request it
+ * sent is answered.
+ */
+class EpollServer
+{
+public:
+    // Processes a request (without its newline) received on the connection of a client (as identified by the
+    // OpenHandler), returns the response to write
+    typedef std::function<QByteArray(const QByteArray &request, quint64 clientID)> Handler;
+
+    // Called on the I/O thread of a connection as soon as it is accepted, returns the ID of its client
+    typedef std::function<quint64(QObject *client)> OpenHandler;
+
+    // Called on the main thread (the thread of the clients) once the connection of a client is closed
+    typedef std::function<void(quint64 clientID)> CloseHandler;
+
+    EpollServer(Handler handler, OpenHandler opened, CloseHandler closed);
+    ~EpollServer();
+
+    // Number of I/O threads and of worker threads (1 by default), to be set before listening
+    void setIoThreads(int ioThreads);
+    void setWorkerThreads(int workerThreads);
+
+    // Listen on every address (IPv6 and IPv4) of port
+    bool listen(quint16 port);
+    void close();
+    QString errorString() const;
+
+private:
+    Handler                 m_handler;
+    OpenHandler             m_opened;
+    CloseHandler            m_closed;
+    int                     m_ioThreads;
+    int                     m_workerThreads;
+    int                     m_listenFd;
+    QString                 m_errorString;
+    WorkStealingPool       *m_pool;
+    QVector<EpollLoop*>     m_loops;
+    QVector<QThread*>       m_threads;
+};
+
+#endif // EPOLLSERVER_H
@@ -5,10 +5,17 @@ DEPENDPATH += $$PWD
 HEADERS += \
     $$PWD/tcpserver.h \
     $$PWD/tcpconnections.h \
-    $$PWD/tcpconnection.h
+    $$PWD/tcpconnection.h \
+    $$PWD/workstealingpool.h
 
 SOURCES += \
     $$PWD/tcpserver.cpp \
     $$PWD/tcpconnections.cpp \
-    $$PWD/tcpconnection.cpp
+    $$PWD/tcpconnection.cpp \
+    $$PWD/workstealingpool.cpp
 
+# Native epoll backend (serverBackend = epoll)
+linux {
+    HEADERS += $$PWD/epollserver.h
+    SOURCES += $$PWD/epollserver.cpp
+}
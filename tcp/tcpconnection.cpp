@@ -17,12 +17,12 @@ TcpConnection::~TcpConnection()
 void TcpConnection::setSocket(QTcpSocket *socket)
 {
     m_socket = socket;
-    connect(m_socket,&QTcpSocket::connected, this, &TcpConnection::connected);
-    connect(m_socket,&QTcpSocket::disconnected, this, &TcpConnection::disconnected);
-    connect(m_socket,&QTcpSocket::readyRead, this, &TcpConnection::readyRead);
-    connect(m_socket,&QTcpSocket::bytesWritten, this, &TcpConnection::bytesWritten);
-    connect(m_socket,&QTcpSocket::stateChanged, this, &TcpConnection::stateChanged);
-    connect(m_socket,
+    connect(socket,&QTcpSocket::connected, this, &TcpConnection::connected);
+    connect(socket,&QTcpSocket::disconnected, this, &TcpConnection::disconnected);
+    connect(socket,&QTcpSocket::readyRead, this, &TcpConnection::readyRead);
+    connect(socket,&QTcpSocket::bytesWritten, this, &TcpConnection::bytesWritten);
+    connect(socket,&QTcpSocket::stateChanged, this, &TcpConnection::stateChanged);
+    connect(socket,
             static_cast<void (QTcpSocket::*)(QAbstractSocket::SocketError)>(&QTcpSocket::errorOccurred),
             this, &TcpConnection::error);
 }
@@ -8,6 +8,7 @@
 #include <QObject>
 #include <QDebug>
 #include <QTcpSocket>
+#include <QPointer>
 
 class TcpConnection : public QObject
 {
@@ -19,7 +20,7 @@ public:
     virtual void setSocket(QTcpSocket *socket);
 
 protected:
-    QTcpSocket *m_socket;
+    QPointer<QTcpSocket> m_socket;  // Null until set, and once the socket is deleted (when its connection is removed)
     QTcpSocket *getSocket();
 
 signals:
@@ -4,7 +4,11 @@
 
 #include "tcpconnections.h"
 
-TcpConnections::TcpConnections(QObject *parent) : QObject(parent)
+// Interval at which the event loop of the shard is probed (ms)
+const int kLagProbeMSec = 250;
+
+TcpConnections::TcpConnections(QObject *parent) : QObject(parent), m_count(0), m_lagMSec(0), m_maxLagMSec(0),
+    m_lagProbe(0)
 {
 //    qDebug() << this << "created";
 }
@@ -16,12 +20,30 @@ TcpConnections::~TcpConnections()
 
 int TcpConnections::count()
 {
-    QReadWriteLock lock;
-    lock.lockForRead();
-    int value = m_connections.count();
-    lock.unlock();
+    return m_count.loadAcquire();
+}
+
+void TcpConnections::assigned()
+{
+    m_count.ref();
+}
+
+void TcpConnections::status(TcpShardStatus &status)
+{
+    status.connections = m_count.loadAcquire();
+    status.lagMSec     = m_lagMSec.loadAcquire();
+    status.maxLagMSec  = m_maxLagMSec.loadAcquire();
+}
 
-    return value;
+void TcpConnections::probeLag()
+{
+    // Whatever kept the event loop busy delayed the probe past its interval
+    qint64 lag = qMax(static_cast<qint64>(0), m_lagClock.restart() - kLagProbeMSec);
+    m_lagMSec.storeRelease(lag);
+    if(lag > m_maxLagMSec.loadAcquire())
+    {
+        m_maxLagMSec.storeRelease(lag);
+    }
 }
 
 void TcpConnections::removeSocket(QTcpSocket *socket)
@@ -39,8 +61,11 @@ void TcpConnections::removeSocket(QTcpSocket *socket)
     }
 
 //    qDebug() << this << "deleting socket" << socket;
-    m_connections.remove(socket);
+    // The connection goes away with its socket (the responses of its requests still being processed are dropped)
+    TcpConnection *connection = m_connections.take(socket);
+    m_count.deref();
     socket->deleteLater();
+    connection->deleteLater();
 
 //    qDebug() << this << "client count = " << m_connections.count();
 
@@ -73,6 +98,13 @@ void TcpConnections::error(QAbstractSocket::SocketError socketError)
 void TcpConnections::start()
 {
 //    qDebug() << this << "connections started on" << QThread::currentThread();
+
+    // The probe lives on the shard's thread, it is only as punctual as the event loop it runs on
+    m_lagProbe = new QTimer(this);
+    m_lagProbe->setTimerType(Qt::PreciseTimer);
+    connect(m_lagProbe, &QTimer::timeout, this, &TcpConnections::probeLag);
+    m_lagClock.start();
+    m_lagProbe->start(kLagProbeMSec);
 }
 
 void TcpConnections::quit()
@@ -97,6 +129,7 @@ void TcpConnections::accept(qintptr handle, TcpConnection *connection)
     if(!socket->setSocketDescriptor(handle))
     {
 //        qWarning() << this << "could not accept connection" << handle;
+        m_count.deref();
         connection->deleteLater();
         return;
     }
@@ -10,10 +10,23 @@
 #include <QThread>
 #include <QTcpSocket>
 #include <QMap>
-#include <QReadWriteLock>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
 #include "tcpconnection.h"
 
+// Connections handled by an I/O thread and the responsiveness of its event loop (for status reporting)
+typedef struct {
+    int    connections;  // Connections currently assigned to the thread
+    qint64 lagMSec;      // How late the latest event loop probe ran
+    qint64 maxLagMSec;   // Latest an event loop probe ran since the thread started
+} TcpShardStatus;
 
+/*
+ * TcpConnections holds the connections of a single I/O thread (a shard): their sockets are read and written, and the
+ * responses handed to them are delivered, by the event loop of that thread. A timer probes how late the event loop
+ * runs, the count and the lag may be read from any thread.
+ */
 class TcpConnections : public QObject
 {
     Q_OBJECT
@@ -21,10 +34,22 @@ public:
     explicit TcpConnections(QObject *parent = 0);
     ~TcpConnections();
 
+    // Connections assigned to the shard (including those not accepted by its thread yet)
     virtual int count();
 
+    // A connection is being handed to the shard (counted right away so that the next ones go elsewhere)
+    void assigned();
+
+    // Connections and event loop lag of the shard
+    void status(TcpShardStatus &status);
+
 protected:
     QMap<QTcpSocket*, TcpConnection*> m_connections;
+    QAtomicInt                        m_count;       // Connections assigned to the shard
+    QAtomicInteger<qint64>            m_lagMSec;     // How late the latest event loop probe ran
+    QAtomicInteger<qint64>            m_maxLagMSec;  // Latest an event loop probe ran
+    QTimer                           *m_lagProbe;    // Fires at a fixed interval on the shard's thread
+    QElapsedTimer                     m_lagClock;    // Time since the previous probe
     void removeSocket(QTcpSocket *socket);
 
 signals:
@@ -34,6 +59,7 @@ signals:
 protected slots:
     void disconnected();
     void error(QAbstractSocket::SocketError socketError);
+    void probeLag();
 
 public slots:
 
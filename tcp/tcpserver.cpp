@@ -6,7 +6,7 @@
 
 #include <QDebug>
 
-TcpServer::TcpServer(QObject *parent) : QTcpServer(parent)
+TcpServer::TcpServer(QObject *parent) : QTcpServer(parent), m_ioThreads(1), m_nextShard(0)
 {
 //    qDebug() <<  this << "created on" << QThread::currentThread();
 }
@@ -16,20 +16,30 @@ TcpServer::~TcpServer()
 //    qDebug() <<  this << "destroyed";
 }
 
+void TcpServer::setIoThreads(int ioThreads)
+{
+    m_ioThreads = qMax(1, ioThreads);
+}
+
 bool TcpServer::listen(const QHostAddress &address, quint16 port)
 {
     if(!QTcpServer::listen(address,port)) return false;
 
-    m_thread = new QThread(this);
-    m_connections = new TcpConnections();
+    for(int shardIdx = 0; shardIdx < m_ioThreads; ++shardIdx)
+    {
+        QThread *thread = new QThread(this);
+        TcpConnections *connections = new TcpConnections();
+
+        connect(thread,&QThread::started,connections,&TcpConnections::start, Qt::QueuedConnection);
+        connect(this,&TcpServer::finished,connections,&TcpConnections::quit, Qt::QueuedConnection);
+        connect(connections,&TcpConnections::finished,this,&TcpServer::complete, Qt::QueuedConnection);
 
-    connect(m_thread,&QThread::started,m_connections,&TcpConnections::start, Qt::QueuedConnection);
-    connect(this, &TcpServer::accepting,m_connections,&TcpConnections::accept, Qt::QueuedConnection);
-    connect(this,&TcpServer::finished,m_connections,&TcpConnections::quit, Qt::QueuedConnection);
-    connect(m_connections,&TcpConnections::finished,this,&TcpServer::complete, Qt::QueuedConnection);
+        connections->moveToThread(thread);
+        thread->start();
 
-    m_connections->moveToThread(m_thread);
-    m_thread->start();
+        m_threads.push_back(thread);
+        m_shards.push_back(connections);
+    }
 
     return true;
 }
@@ -53,6 +63,16 @@ qint64 TcpServer::port()
     }
 }
 
+void TcpServer::shardStatus(QVector<TcpShardStatus> &status)
+{
+    for(TcpConnections *connections : qAsConst(m_shards))
+    {
+        TcpShardStatus shard;
+        connections->status(shard);
+        status.push_back(shard);
+    }
+}
+
 void TcpServer::incomingConnection(qintptr descriptor)
 {
 //    qDebug() << this << "attempting to accept connection" << descriptor;
@@ -61,31 +81,59 @@ void TcpServer::incomingConnection(qintptr descriptor)
 
 }
 
+int TcpServer::nextShard()
+{
+    // Fewest connections first, ties going to the shard coming next in turn
+    int shardIdx = m_nextShard;
+    for(int offset = 1; offset < m_shards.size(); ++offset)
+    {
+        int candidate = (m_nextShard + offset) % m_shards.size();
+        if(m_shards[candidate]->count() < m_shards[shardIdx]->count()) shardIdx = candidate;
+    }
+    m_nextShard = (shardIdx + 1) % m_shards.size();
+    return shardIdx;
+}
+
 void TcpServer::accept(qintptr descriptor, TcpConnection *connection)
 {
 //    qDebug() << this << "accepting the connection" << descriptor;
-    connection->moveToThread(m_thread);
-    emit accepting(descriptor, connection);
+    if(m_shards.isEmpty())
+    {
+        connection->deleteLater();
+        return;
+    }
+
+    int shardIdx = nextShard();
+    TcpConnections *connections = m_shards[shardIdx];
+    connections->assigned();
+    connection->moveToThread(m_threads[shardIdx]);
+    QMetaObject::invokeMethod(connections, [connections, descriptor, connection]() {
+        connections->accept(descriptor, connection);
+    }, Qt::QueuedConnection);
 }
 
 void TcpServer::complete()
 {
-    if(!m_thread)
+    TcpConnections *connections = qobject_cast<TcpConnections*>(sender());
+    int shardIdx = m_shards.indexOf(connections);
+    if(shardIdx == -1)
     {
 //        qWarning() << this << "exiting complete there was no thread!";
         return;
     }
 
 //    qDebug() << this << "Complete called, destroying thread";
-    delete m_connections;
+    QThread *thread = m_threads.takeAt(shardIdx);
+    m_shards.removeAt(shardIdx);
+    m_nextShard = 0;
+    delete connections;
 
 //    qDebug() << this << "Quitting thread";
-    m_thread->quit();
-    m_thread->wait();
+    thread->quit();
+    thread->wait();
 
-    delete m_thread;
+    delete thread;
 
 //    qDebug() << this << "complete";
 
 }
-
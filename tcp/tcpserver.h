@@ -9,9 +9,15 @@
 #include <QDebug>
 #include <QTcpServer>
 #include <QThread>
+#include <QVector>
 #include "tcpconnections.h"
 #include "tcpconnection.h"
 
+/*
+ * TcpServer accepts connections and spreads them over its I/O threads, each running a TcpConnections (a shard) of its
+ * own: a connection goes to the shard with the fewest connections, the shards being considered in turn (round-robin)
+ * so that equally-loaded shards share the new connections.
+ */
 class TcpServer : public QTcpServer
 {
     Q_OBJECT
@@ -19,19 +25,28 @@ public:
     explicit TcpServer(QObject *parent = 0);
     ~TcpServer();
 
+    // Number of I/O threads to spread the connections over (1 by default), to be set before listening
+    virtual void setIoThreads(int ioThreads);
+
     virtual bool listen(const QHostAddress &address, quint16 port);
     virtual void close();
     virtual qint64 port();
 
+    // Status of each I/O thread of the server (empty unless it is listening), from the thread of the server
+    void shardStatus(QVector<TcpShardStatus> &status);
 
 protected:
-    QThread *m_thread;
-    TcpConnections *m_connections;
+    int m_ioThreads;
+    int m_nextShard;
+    QVector<QThread*> m_threads;
+    QVector<TcpConnections*> m_shards;
     virtual void incomingConnection(qintptr descriptor); //qint64, qHandle, qintptr, uint
     virtual void accept(qintptr descriptor, TcpConnection *connection);
 
+    // Shard the next connection is assigned to
+    int nextShard();
+
 signals:
-    void accepting(qintptr handle, TcpConnection *connection);
     void finished();
 
 public slots:
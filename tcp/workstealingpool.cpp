@@ -0,0 +1,114 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#include "workstealingpool.h"
+
+WorkStealingPool::WorkStealingPool(int workers) :
+    m_next(0),
+    m_pending(0),
+    m_stopping(false)
+{
+    for (int w = 0; w < qMax(1, workers); ++w) {
+        m_workers.push_back(new Worker);
+    }
+    for (int w = 0; w < m_workers.size(); ++w) {
+        m_workers[w]->thread = QThread::create([this, w]() { work(w); });
+        m_workers[w]->thread->start();
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    // The tasks already queued are still run before the workers end
+    m_sleepLock.lock();
+    m_stopping = true;
+    m_wake.wakeAll();
+    m_sleepLock.unlock();
+
+    for (Worker *worker : m_workers) {
+        worker->thread->wait();
+        delete worker->thread;
+        delete worker;
+    }
+}
+
+void WorkStealingPool::submit(std::function<void()> task)
+{
+    Worker *worker = m_workers[static_cast<quint32>(m_next.fetchAndAddRelaxed(1)) % m_workers.size()];
+    m_pending.ref();
+    worker->lock.lock();
+    worker->tasks.push_back(std::move(task));
+    worker->lock.unlock();
+
+    // A worker about to sleep checks the pending tasks under the same lock, so the wake-up cannot be missed
+    m_sleepLock.lock();
+    m_wake.wakeOne();
+    m_sleepLock.unlock();
+}
+
+int WorkStealingPool::workers() const
+{
+    return m_workers.size();
+}
+
+void WorkStealingPool::work(int self)
+{
+    std::function<void()> task;
+    for (;;) {
+        if (take(self, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        m_sleepLock.lock();
+        if (m_pending.loadAcquire() == 0) {
+            if (m_stopping) {
+                m_sleepLock.unlock();
+                return;
+            }
+            m_wake.wait(&m_sleepLock);
+        }
+        m_sleepLock.unlock();
+    }
+}
+
+bool WorkStealingPool::take(int self, std::function<void()> &task)
+{
+    // Own queue first (oldest task), then the other queues in turn (newest task)
+    for (int offset = 0; offset < m_workers.size(); ++offset) {
+        Worker *worker = m_workers[(self + offset) % m_workers.size()];
+        worker->lock.lock();
+        if (!worker->tasks.empty()) {
+            if (offset == 0) {
+                task = std::move(worker->tasks.front());
+                worker->tasks.pop_front();
+            } else {
+                task = std::move(worker->tasks.back());
+                worker->tasks.pop_back();
+            }
+            worker->lock.unlock();
+            m_pending.deref();
+            return true;
+        }
+        worker->lock.unlock();
+    }
+    return false;
+}
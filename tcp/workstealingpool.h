@@ -0,0 +1,67 @@
+/*
+ * GtfsProc_Server
+ * Copyright (C) 2018-2026, Daniel Brook
+ *
+ * This file is part of GtfsProc.
+ *
+ * GtfsProc is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * GtfsProc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with GtfsProc.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ * See included LICENSE.txt file for full license.
+ */
+
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QThread>
+#include <QVector>
+
+#include <deque>
+#include <functional>
+
+/*
+ * WorkStealingPool runs tasks on a fixed number of worker threads, each with a queue of its own: the tasks submitted
+ * are spread over the queues in turn, a worker takes the oldest task of its own queue and, once it runs dry, steals the
+ * newest task of another worker's queue so that a few long tasks do not hold up those queued behind them.
+ */
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(int workers);
+    ~WorkStealingPool();
+
+    // Queue task for one of the workers (thread-safe)
+    void submit(std::function<void()> task);
+
+    int workers() const;
+
+private:
+    struct Worker {
+        QMutex                             lock;
+        std::deque<std::function<void()>>  tasks;
+        QThread                           *thread;
+    };
+
+    void work(int self);
+    bool take(int self, std::function<void()> &task);
+
+    QVector<Worker*> m_workers;
+    QAtomicInt       m_next;     // Queue the next task submitted goes to
+    QAtomicInt       m_pending;  // Tasks queued but not yet taken by a worker
+    QMutex           m_sleepLock;
+    QWaitCondition   m_wake;     // Signaled (under m_sleepLock) when tasks are queued or the pool stops
+    bool             m_stopping;
+};
+
+#endif // WORKSTEALINGPOOL_H
@@ -14,13 +14,41 @@
 # Any line in the expected responses that begin with a "*" (asterisk) will NOT be
 # checked for equality.
 #
+# A .test file may start the server several times (one @StartParams block each, the cases
+# which follow a block are sent to that server), and may act on the files of its directory
+# between the cases (to replace a local real-time feed, for instance) or wait for a while.
+#
+# Instead of an expected response, the boards of a batch (NEB/NCB) can be checked against the
+# responses to the equivalent single requests (NEX/NCF), sent to the same server right after.
+# A response can also be kept and checked against the response to the same request from a server
+# started later on in the same .test file (with other parameters which must not change the result).
+#
+# A request can also be sent over a connection kept open (to subscribe to a board, for instance):
+# the messages later received on it are checked in turn like responses, pretty-printed with
+# sorted keys. Raw data can be written to that connection as well (several requests at once, or
+# part of one), to check how the server frames the requests it receives.
+#
+# Remote real-time feeds are served by a stand-in HTTP server (the files of the test directory, with
+# an ETag and a Last-Modified date, answering conditional requests with 304 Not Modified). It only
+# answers a given number of requests, later ones are held until the end of the .test file (so the
+# number of fetches seen by GtfsProc does not depend on timing). The status of each request answered
+# can be checked like a response.
+#
 # Again ... this is a VERY basic system.
 #
 # See the example test suites in the included directories under tests/*
 
 import sys
 import os
+import json
+import hashlib
+import queue
+import shutil
+import socket
 import subprocess
+import threading
+from email.utils import formatdate
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
 from time import sleep
 
 # All tests appear within this script's directory ./GtfsProcSuite/tests/*
@@ -32,13 +60,128 @@ class TestCase:
         self.case = ""
         self.query = ""
         self.expect = ""
+        self.boards = []
+        self.received = False
+        self.served = False
+        self.keep = ""
+        self.same_as = ""
+
+
+class TestAction:
+    def __init__(self, action, args):
+        self.action = action
+        self.args = args
+
+
+class Listener:
+    ''' A connection kept open to the server, the messages received on it are queued in order. '''
+    def __init__(self, query, port):
+        self.messages = queue.Queue()
+        self.conn = socket.create_connection(("localhost", port))
+        if query:
+            self.conn.sendall("{}\n".format(query).encode("utf-8"))
+        threading.Thread(target=self.receive, daemon=True).start()
+
+    def send(self, data):
+        ''' Writes the data as it is (in a single write, nothing is appended to it). '''
+        self.conn.sendall(data.encode("utf-8"))
+
+    def receive(self):
+        pending = b""
+        while True:
+            try:
+                data = self.conn.recv(1 << 16)
+            except OSError:
+                return
+            if not data:
+                return
+            pending += data
+            while b"\n" in pending:
+                message, pending = pending.split(b"\n", 1)
+                self.messages.put(message.decode("utf-8"))
+
+    def nextMessage(self, timeout):
+        ''' Returns the next message received (pretty-printed), or "" if none came within the timeout. '''
+        try:
+            message = self.messages.get(timeout=timeout)
+        except queue.Empty:
+            return ""
+        return json.dumps(json.loads(message), indent=4, sort_keys=True) + "\n"
+
+    def close(self):
+        self.conn.close()
+
+
+class FeedStandIn:
+    ''' A stand-in HTTP server for the files of the current directory, answering nb_answered requests. '''
+    def __init__(self, port, nb_answered):
+        self.root = os.getcwd()
+        self.nb_answered = nb_answered
+        self.nb_requests = 0
+        self.statuses = []
+        self.lock = threading.Lock()
+        self.release = threading.Event()
+
+        stand_in = self
+
+        class FeedRequestHandler(BaseHTTPRequestHandler):
+            def do_GET(self):
+                stand_in.answer(self)
+
+            def log_message(self, format, *args):
+                pass
+
+        self.httpd = ThreadingHTTPServer(("localhost", port), FeedRequestHandler)
+        self.httpd.daemon_threads = True
+        threading.Thread(target=self.httpd.serve_forever, daemon=True).start()
+
+    def answer(self, request):
+        with self.lock:
+            request_idx = self.nb_requests
+            self.nb_requests += 1
+        if request_idx >= self.nb_answered:
+            self.release.wait()
+            return
+
+        file_path = os.path.join(self.root, os.path.basename(request.path))
+        if not os.path.isfile(file_path):
+            status = 404
+            request.send_response(status)
+            request.send_header("Content-Length", "0")
+            request.end_headers()
+        else:
+            with open(file_path, "rb") as served_file:
+                content = served_file.read()
+            etag = '"{}"'.format(hashlib.sha1(content).hexdigest())
+            last_modified = formatdate(os.path.getmtime(file_path), usegmt=True)
+            not_modified = (request.headers.get("If-None-Match") == etag and
+                            request.headers.get("If-Modified-Since") == last_modified)
+            status = 304 if not_modified else 200
+            request.send_response(status)
+            request.send_header("ETag", etag)
+            request.send_header("Last-Modified", last_modified)
+            request.send_header("Content-Length", "0" if not_modified else str(len(content)))
+            request.end_headers()
+            if not not_modified:
+                request.wfile.write(content)
+        with self.lock:
+            self.statuses.append(f"{status} {request.path}")
+
+    def servedStatuses(self):
+        ''' Returns the status of each request answered so far (one line each, in order). '''
+        with self.lock:
+            return "".join(f"{status}\n" for status in self.statuses)
+
+    def close(self):
+        self.release.set()
+        self.httpd.shutdown()
+        self.httpd.server_close()
 
 
 class RegressionSet:
     def __init__(self):
         self.descrip = ""
-        self.startup = []
-        self.tests = []
+        self.steps = []
 
 
 def openRegressionFile(regression_path):
@@ -58,11 +201,27 @@ def openRegressionFile(regression_path):
     # Read the file line by line
     # Allowed fields:
     #   @Description - @End: (Multiline case description)
-    #   @StartParams - @End: (GtfsProc startup parameters relevant to the testcases)
+    #   @StartParams - @End: (GtfsProc startup parameters relevant to the testcases which follow,
+    #                         stopping the server started by a previous block if any)
     # +1 or more of:
     #   @Case:               (Description of a testcase)
     #   @Query:              (Query to shoot at running GtfsProc instance)
+    #   or @Received         (Next message received on the connection of the last @Listen)
+    #   or @Served           (Status and path of each request answered by the @Serve stand-in so far)
     #   @Expected - @End:    (Multiline expected JSON results from the Query)
+    #   or @Boards - @End:   (One single request per line, the response of each must be the
+    #                         corresponding board of the batch Query, protocol fields aside)
+    #   or @Keep:label       (The response is kept under the label, it must not be an error)
+    #   or @SameAs:label     (The response must be the one kept under the label, processing time aside)
+    # Any number of (performed in order with the testcases):
+    #   @Copy:src dst        (Replace dst with a copy of src, atomically)
+    #   @Remove:path         (Remove the file if it exists)
+    #   @Wait:seconds        (Wait before going on with the next testcase)
+    #   @Listen:query        (Send the query over a new connection, kept open until the server stops,
+    #                         the query may be left empty to only open the connection)
+    #   @Send:data           (Write the data over the connection of the last @Listen, where "\n"
+    #                         stands for a newline: no newline is added to it)
+    #   @Serve:port requests (Serve the files of the directory over HTTP, only answering that many requests)
     for line in reg_file:
         line_strip = line.rstrip('\n')
         if reg_parse == "None":
@@ -70,13 +229,35 @@ def openRegressionFile(regression_path):
                 reg_parse = "Description"
             elif line_strip == "@StartParams":
                 reg_parse = "Parameters"
+                reg_set.steps.append(TestAction("Start", []))
+            elif line.startswith("@Copy:") or line.startswith("@Remove:") or line.startswith("@Wait:"):
+                action, args = line_strip[1:].split(":", 1)
+                reg_set.steps.append(TestAction(action, args.split()))
+            elif line.startswith("@Listen:"):
+                reg_set.steps.append(TestAction("Listen", [line_strip[8:]]))
+            elif line.startswith("@Send:"):
+                reg_set.steps.append(TestAction("Send", [line_strip[6:].replace("\\n", "\n")]))
+            elif line.startswith("@Serve:"):
+                reg_set.steps.append(TestAction("Serve", line_strip[7:].split()))
             elif line.startswith("@Expected"):
                 reg_parse = "Expected"
+            elif line.startswith("@Boards"):
+                reg_parse = "Boards"
             elif line.startswith("@Case"):
                 test_case = TestCase()
                 test_case.case = line_strip[6:]
             elif line.startswith("@Query"):
                 test_case.query = line_strip[7:]
+            elif line_strip == "@Received":
+                test_case.received = True
+            elif line_strip == "@Served":
+                test_case.served = True
+            elif line.startswith("@Keep:"):
+                test_case.keep = line_strip[6:]
+                reg_set.steps.append(test_case)
+            elif line.startswith("@SameAs:"):
+                test_case.same_as = line_strip[8:]
+                reg_set.steps.append(test_case)
         elif reg_parse == "Description":
             if line_strip == "@End":
                 reg_parse = "None"
@@ -86,14 +267,20 @@ def openRegressionFile(regression_path):
             if line_strip == "@End":
                 reg_parse = "None"
             else:
-                reg_set.startup.append(line_strip)
+                reg_set.steps[-1].args.append(line_strip)
         elif reg_parse == "Expected":
             if line_strip == "@End":
                 test_case.expect = test_case.expect.rstrip('\n')
-                reg_set.tests.append(test_case)
+                reg_set.steps.append(test_case)
                 reg_parse = "None"
             else:
                 test_case.expect = test_case.expect + line
+        elif reg_parse == "Boards":
+            if line_strip == "@End":
+                reg_set.steps.append(test_case)
+                reg_parse = "None"
+            else:
+                test_case.boards.append(line_strip)
         else:
             print(f"Unexptected File Condition: '{reg_parse}'")
 
@@ -130,68 +317,216 @@ def actualMatchesExpected(received, expected):
     return True
 
 
-def loadGtfsProcAndRunCases(regression_file):
-    ''' Loads a GtfsProc server with the flags dictated by the regression_file, then shoots
-        the cases within and compares the expected results. The passed and total cases are
-        counted for the sake of statistics / determining overall pass/fail conditions.
+def boardsMatchSingles(received, board_queries, cli_opts):
+    ''' Determines if each board of a batch response is the response to the equivalent single
+        request, once the fields describing the transaction itself (and not the board) are
+        removed from the latter.
 
         args:
-            regression_file (str): path to the regression file to scan for cases
+            received (str): The JSON response returned from the batch transaction.
+            board_queries (list): The single request equivalent to each board, in order.
+            cli_opts (list): client_cli command line to send the single requests with.
 
-        returns: passed_cases (int), total_cases (int) as a tuple
+        returns: True if every board matches its single request, False if not
     '''
-    passed_cases = 0
-    total_cases = 0
+    protocol_fields = ["message_time", "message_type", "proc_time_ms", "realtime_age_sec", "static_data_modif"]
 
-    # Switch to the file's working directory so GtfsProc can be started relative to it
-    os.chdir(os.path.dirname(regression_file))
+    boards = json.loads(received).get("boards", [])
+    if len(boards) != len(board_queries):
+        print(f"\033[91m         {len(boards)} BOARDS FOR {len(board_queries)} SINGLE REQUESTS\033[00m")
+        return False
 
-    regression_set = openRegressionFile(regression_file)
-    gtfs_start_ops = [gtfsproc_path, *regression_set.startup]
-    gtfs_process = subprocess.Popen(gtfs_start_ops,
+    for board, board_query in zip(boards, board_queries):
+        single = json.loads(sendQuery(board_query, cli_opts))
+        for field in protocol_fields:
+            single.pop(field, None)
+        if board != single:
+            print(f"\033[91m         BOARD DIFFERS FROM: {board_query}")
+            print(f"         EXPECT: {json.dumps(single, sort_keys=True)}")
+            print(f"         ACTUAL: {json.dumps(board, sort_keys=True)}\033[00m")
+            return False
+
+    return True
+
+
+def keptResponseMatches(received, kept):
+    ''' Determines if a response is the one kept from another server for the same request, the
+        time it took to process aside.
+
+        args:
+            received (str): The JSON response returned from the actual transaction.
+            kept (str): The JSON response kept from the earlier transaction ("" if none was kept).
+
+        returns: True if the responses match, False if different
+    '''
+    if not kept:
+        print("\033[91m         NO RESPONSE WAS KEPT UNDER THIS LABEL\033[00m")
+        return False
+
+    received_resp = json.loads(received)
+    kept_resp = json.loads(kept)
+    received_resp.pop("proc_time_ms", None)
+    kept_resp.pop("proc_time_ms", None)
+    if received_resp != kept_resp:
+        print(f"\033[91m         EXPECT: {json.dumps(kept_resp, sort_keys=True)}")
+        print(f"         ACTUAL: {json.dumps(received_resp, sort_keys=True)}\033[00m")
+        return False
+
+    return True
+
+
+def sendQuery(query, cli_opts):
+    ''' Sends a single query with client_cli and returns the (pretty-printed) response.
+    '''
+    gtfs_client = subprocess.Popen(cli_opts,
+                                   shell=False,
+                                   stdout=subprocess.PIPE,
+                                   stdin=subprocess.PIPE)
+    gtfs_client.stdin.write("{}\n".format(query).encode("utf-8"))
+    gtfs_client.stdin.flush()
+    server_resp = ""
+    while True:
+        json_line = gtfs_client.stdout.readline()
+        server_resp = server_resp + json_line.decode("utf-8")
+        if gtfs_client.poll() is not None:
+            break
+    return server_resp
+
+
+def startGtfsProc(startup):
+    ''' Starts a GtfsProc server with the startup parameters and waits until it accepts connections.
+
+        args:
+            startup (list): GtfsProc startup parameters
+
+        returns: the server process, None if it did not start
+    '''
+    gtfs_process = subprocess.Popen([gtfsproc_path, *startup],
                                     shell=False,
                                     stdout=subprocess.PIPE,
                                     stderr=subprocess.PIPE)
 
-    ok_to_test = False
     while True:
         boot_msg = gtfs_process.stdout.readline()
         if gtfs_process.poll() is not None:
-            break
+            return None
         if boot_msg == b"SERVER STARTED - READY TO ACCEPT INCOMING CONNECTIONS\n":
-            ok_to_test = True
-            break
+            return gtfs_process
         if boot_msg == b"(!) COULD NOT START SERVER - SEE ERROR STRING ABOVE\n":
             print("\nCannot run -- perhaps there is another instance of GtfsProc running?")
             exit()
 
-    if ok_to_test:
-        gtfs_cli_opts = [gtfsclnt_path, "localhost", "5000", "P"]
 
-        for test_case in regression_set.tests:
-            gtfs_client = subprocess.Popen(gtfs_cli_opts,
-                                           shell=False,
-                                           stdout=subprocess.PIPE,
-                                           stdin=subprocess.PIPE)
-            gtfs_client.stdin.write("{}\n".format(test_case.query).encode("utf-8"))
-            gtfs_client.stdin.flush()
-            test_case_query = f"[{test_case.query}] {test_case.case}"
-            server_resp = ""
-            while True:
-                json_line = gtfs_client.stdout.readline()
-                server_resp = server_resp + json_line.decode("utf-8")
-                if gtfs_client.poll() is not None:
-                    break
-
-            if actualMatchesExpected(server_resp, test_case.expect):
-                print(f"\033[92m  [PASS] {test_case_query}\033[00m")
-                passed_cases += 1
+def stopGtfsProc(gtfs_process):
+    ''' Stops a GtfsProc server (if one was started) and lets its port be released.
+    '''
+    if gtfs_process is not None:
+        gtfs_process.kill()
+        gtfs_process.wait()
+        sleep(2)
+
+
+def performAction(test_action):
+    ''' Acts on the files of the test directory (relative to it), or waits for a while.
+
+        args:
+            test_action (TestAction): the action and its arguments
+    '''
+    if test_action.action == "Copy":
+        # Written aside then renamed over, as a feed must be replaced
+        src, dst = test_action.args
+        shutil.copyfile(src, f"{dst}.tmp")
+        os.replace(f"{dst}.tmp", dst)
+    elif test_action.action == "Remove":
+        if os.path.exists(test_action.args[0]):
+            os.remove(test_action.args[0])
+    elif test_action.action == "Wait":
+        sleep(float(test_action.args[0]))
+
+
+def loadGtfsProcAndRunCases(regression_file):
+    ''' Loads a GtfsProc server with the flags dictated by the regression_file, then shoots
+        the cases within and compares the expected results. The passed and total cases are
+        counted for the sake of statistics / determining overall pass/fail conditions.
+
+        args:
+            regression_file (str): path to the regression file to scan for cases
+
+        returns: passed_cases (int), total_cases (int) as a tuple
+    '''
+    passed_cases = 0
+    total_cases = 0
+
+    # Switch to the file's working directory so GtfsProc can be started relative to it
+    os.chdir(os.path.dirname(regression_file))
+
+    regression_set = openRegressionFile(regression_file)
+    gtfs_process = None
+    gtfs_cli_opts = [gtfsclnt_path, "localhost", "5000", "P"]
+    listener = None
+    stand_in = None
+    kept_responses = {}
+
+    for step in regression_set.steps:
+        if isinstance(step, TestAction):
+            if step.action == "Start":
+                if listener is not None:
+                    listener.close()
+                    listener = None
+                stopGtfsProc(gtfs_process)
+                gtfs_process = startGtfsProc(step.args)
+            elif step.action == "Listen":
+                if gtfs_process is not None:
+                    listener = Listener(step.args[0], 5000)
+            elif step.action == "Send":
+                if listener is not None:
+                    listener.send(step.args[0])
+            elif step.action == "Serve":
+                stand_in = FeedStandIn(int(step.args[0]), int(step.args[1]))
             else:
-                print(f"\033[91m  [FAIL] {test_case_query}\033[00m")
-            total_cases += 1
+                performAction(step)
+            continue
+
+        # Cases of a server which did not start fail
+        test_case = step
+        if test_case.received:
+            test_case_query = f"[@Received] {test_case.case}"
+        elif test_case.served:
+            test_case_query = f"[@Served] {test_case.case}"
+        else:
+            test_case_query = f"[{test_case.query}] {test_case.case}"
+        total_cases += 1
+        if gtfs_process is None:
+            print(f"\033[91m  [FAIL] {test_case_query}\033[00m")
+            continue
+
+        if test_case.received:
+            server_resp = listener.nextMessage(10) if listener is not None else ""
+        elif test_case.served:
+            server_resp = stand_in.servedStatuses() if stand_in is not None else ""
+        else:
+            server_resp = sendQuery(test_case.query, gtfs_cli_opts)
+        if test_case.boards:
+            case_passed = boardsMatchSingles(server_resp, test_case.boards, gtfs_cli_opts)
+        elif test_case.keep:
+            kept_responses[test_case.keep] = server_resp
+            case_passed = json.loads(server_resp).get("error", 1) == 0
+        elif test_case.same_as:
+            case_passed = keptResponseMatches(server_resp, kept_responses.get(test_case.same_as, ""))
+        else:
+            case_passed = actualMatchesExpected(server_resp, test_case.expect)
+
+        if case_passed:
+            print(f"\033[92m  [PASS] {test_case_query}\033[00m")
+            passed_cases += 1
+        else:
+            print(f"\033[91m  [FAIL] {test_case_query}\033[00m")
 
-    gtfs_process.kill()
-    sleep(2)
+    if listener is not None:
+        listener.close()
+    stopGtfsProc(gtfs_process)
+    if stand_in is not None:
+        stand_in.close()
 
     return passed_cases, total_cases
     
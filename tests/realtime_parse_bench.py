@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+
+# This file is part of GtfsProc
+# (C) 2021, Daniel Brook
+#
+# See the LICENSE and README files in the root of the project directory.
+#
+# A rudimentary benchmark of the real-time feed ingestion (protobuf parse + integration) as the
+# feed size and the number of worker threads grow.
+#
+# The trip updates of a test suite (tests/Agency/*.pb) are scaled up by concatenating the feed
+# with itself (repeated protobuf fields of concatenated messages are merged, so the entities are
+# simply repeated). GtfsProc is then started for each scale / number of worker threads with the
+# suite's .ini, while as many clients as there are worker threads keep requesting the real-time
+# route statistics (RPS) so the parse competes with the transactions for the memory allocator.
+# Once the clients are running, the feed is replaced by a byte-different variant of it (its header
+# repeated at the end: same content, but an unchanged feed would not be integrated again) and the
+# parse and integration times are read from RDS once this refreshed feed has been activated.
+#
+# Usage:  $ tests/realtime_parse_bench.py /path/to/gtfsproc /path/to/client_cli tests/Agency/suite.ini
+#         (optionally followed by the comma-separated scales and numbers of threads to try)
+
+import sys
+import os
+import json
+import shutil
+import subprocess
+import tempfile
+import threading
+from configparser import ConfigParser
+from time import monotonic, sleep
+
+# Seconds between real-time refreshes while benchmarking
+refresh_interval = 5
+
+# Seconds to wait for the refreshed feed to be activated before giving up on a run
+refresh_timeout = 120
+
+
+def headerField(feed):
+    ''' Returns the bytes of the header field (field 1, length-delimited) of a FeedMessage, which the
+        encoders write first. Repeating it at the end of a feed leaves its content unchanged.
+    '''
+    if not feed or feed[0] != 0x0A:
+        return b""
+    length, shift, pos = 0, 0, 1
+    while True:
+        byte = feed[pos]
+        length |= (byte & 0x7F) << shift
+        shift += 7
+        pos += 1
+        if not byte & 0x80:
+            break
+    return feed[:pos + length]
+
+
+def scaleFeed(feed_path, scale, scaled_path, variant=False):
+    ''' Writes the trip updates of feed_path repeated scale times into scaled_path.
+
+        args:
+            feed_path (str): path of the GTFS-Realtime trip updates protobuf to scale up
+            scale (int): number of times the entities of the feed are repeated
+            scaled_path (str): path of the scaled-up protobuf
+            variant (bool): write the byte-different variant (same content, header repeated at the end)
+    '''
+    with open(feed_path, "rb") as feed_file:
+        feed = feed_file.read()
+    with open(scaled_path, "wb") as scaled_file:
+        for _ in range(scale):
+            scaled_file.write(feed)
+        if variant:
+            scaled_file.write(headerField(feed))
+
+
+def queryServer(gtfsclnt_path, port, query):
+    ''' Sends a single query to the running GtfsProc instance and returns the decoded JSON response. '''
+    gtfs_client = subprocess.Popen([gtfsclnt_path, "localhost", str(port), "P"],
+                                   shell=False,
+                                   stdout=subprocess.PIPE,
+                                   stdin=subprocess.PIPE)
+    server_resp, _ = gtfs_client.communicate("{}\n".format(query).encode("utf-8"))
+    return json.loads(server_resp.decode("utf-8"))
+
+
+def loadClients(gtfsclnt_path, port, stop_event):
+    ''' Keeps requesting the real-time route statistics until stop_event is set. '''
+    while not stop_event.is_set():
+        queryServer(gtfsclnt_path, port, "RPS")
+
+
+def benchmarkRun(gtfsproc_path, gtfsclnt_path, ini_path, feed_path, scale, scaled_feed, nb_threads):
+    ''' Starts GtfsProc on the scaled feed with nb_threads worker threads, then returns the RDS
+        response for the variant of the feed refreshed while the server is under load (None if the
+        server could not be started, {} if the refreshed feed was not activated in time).
+    '''
+    scaleFeed(feed_path, scale, scaled_feed)
+
+    settings = ConfigParser()
+    settings.optionxform = str
+    settings.read(ini_path)
+    settings["static"]["numberThreads"] = str(nb_threads)
+    settings["realtime"]["feedLocation"] = scaled_feed
+    settings["realtime"]["updateInterval"] = str(refresh_interval)
+    port = int(settings["static"]["serverPort"])
+
+    bench_ini = os.path.join(os.path.dirname(scaled_feed), "bench.ini")
+    with open(bench_ini, "w") as bench_file:
+        settings.write(bench_file)
+
+    gtfs_process = subprocess.Popen([gtfsproc_path, f"-c{bench_ini}"],
+                                    shell=False,
+                                    stdout=subprocess.PIPE,
+                                    stderr=subprocess.PIPE)
+    while True:
+        boot_msg = gtfs_process.stdout.readline()
+        if gtfs_process.poll() is not None:
+            return None
+        if boot_msg == b"SERVER STARTED - READY TO ACCEPT INCOMING CONNECTIONS\n":
+            break
+
+    # Wait for the first feed, then put the server under load until the next one is activated
+    rds = queryServer(gtfsclnt_path, port, "RDS")
+    while "active_rt_version" not in rds:
+        sleep(0.5)
+        rds = queryServer(gtfsclnt_path, port, "RDS")
+    first_generation = rds["feed_generation"]
+
+    stop_event = threading.Event()
+    clients = [threading.Thread(target=loadClients, args=(gtfsclnt_path, port, stop_event))
+               for _ in range(nb_threads)]
+    for client in clients:
+        client.start()
+
+    # The local feed being watched, its variant is fetched right away
+    scaleFeed(feed_path, scale, scaled_feed, variant=True)
+    deadline = monotonic() + refresh_timeout
+    while rds["feed_generation"] == first_generation or "active_rt_version" not in rds:
+        if monotonic() > deadline:
+            rds = {}
+            break
+        sleep(0.5)
+        rds = queryServer(gtfsclnt_path, port, "RDS")
+
+    stop_event.set()
+    for client in clients:
+        client.join()
+
+    gtfs_process.kill()
+    gtfs_process.wait()
+    sleep(2)
+    return rds
+
+
+if __name__ == "__main__":
+    if len(sys.argv) not in [4, 6]:
+        print("You must provide the path to the gtfsproc server and client_cli binaries and a test suite .ini,")
+        print(f"like so:  $ {sys.argv[0]} /path/to/gtfsproc /path/to/client_cli tests/Agency/suite.ini\n")
+        print("You can also choose the feed scales and numbers of worker threads,")
+        print(f"like so:  $ {sys.argv[0]} /path/to/gtfsproc /path/to/client_cli tests/Agency/suite.ini 1,10,50 1,2,4,8\n")
+        exit()
+
+    current_wrkdir = os.getcwd()
+    gtfsproc_path = f"{current_wrkdir}/{sys.argv[1]}"
+    gtfsclnt_path = f"{current_wrkdir}/{sys.argv[2]}"
+    ini_path = os.path.realpath(sys.argv[3])
+    scales = [int(scale) for scale in sys.argv[4].split(",")] if len(sys.argv) == 6 else [1, 10, 50]
+    threads = [int(nb) for nb in sys.argv[5].split(",")] if len(sys.argv) == 6 else [1, 2, 4, 8]
+
+    # The static feed and real-time feed are relative to the suite's directory
+    os.chdir(os.path.dirname(ini_path))
+    suite_settings = ConfigParser()
+    suite_settings.optionxform = str
+    suite_settings.read(ini_path)
+    feed_path = os.path.realpath(suite_settings["realtime"]["feedLocation"])
+
+    work_dir = tempfile.mkdtemp(dir=os.path.dirname(ini_path))
+    print(f"{'scale':>6} {'threads':>8} {'parse_ms':>9} {'integration_ms':>15} {'integ_threads':>14}")
+    try:
+        for scale in scales:
+            scaled_feed = os.path.join(work_dir, f"scaled_{scale}.pb")
+            for nb_threads in threads:
+                rds = benchmarkRun(gtfsproc_path, gtfsclnt_path, ini_path, feed_path, scale, scaled_feed, nb_threads)
+                if rds is None:
+                    print(f"{scale:>6} {nb_threads:>8}   (GtfsProc could not be started)")
+                    continue
+                if not rds:
+                    print(f"{scale:>6} {nb_threads:>8}   (the refreshed feed was not activated in time)")
+                    continue
+                print(f"{scale:>6} {nb_threads:>8} {rds['active_parse_ms']:>9} "
+                      f"{rds['active_integration_ms']:>15} {rds['active_integration_threads']:>14}")
+    finally:
+        shutil.rmtree(work_dir)
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+
+# This file is part of GtfsProc
+# (C) 2021, Daniel Brook
+#
+# See the LICENSE and README files in the root of the project directory.
+#
+# A rudimentary throughput benchmark of the server backends (serverBackend = qt / epoll) as the
+# number of clients grows.
+#
+# GtfsProc is started for each backend with the test suite's .ini (the backend being the only
+# setting changed), then as many clients as requested each open a connection and keep a window of
+# newline-terminated requests in flight (pipelining) for a few seconds. The number of responses
+# received per second, over all clients, is reported for each backend / number of clients.
+#
+# Usage:  $ tests/server_backend_bench.py /path/to/gtfsproc tests/Agency/suite.ini
+#         (optionally followed by the comma-separated numbers of clients and the request to send)
+
+import sys
+import os
+import socket
+import subprocess
+import tempfile
+import threading
+from configparser import ConfigParser
+from time import monotonic, sleep
+
+# Seconds each run sends requests for
+run_seconds = 10
+
+# Requests each client keeps in flight
+pipeline_depth = 16
+
+
+def clientLoad(port, request, deadline, counts, index):
+    ''' Keeps pipeline_depth requests in flight over a single connection until the deadline, then
+        stores the number of responses received in counts[index].
+    '''
+    payload = "{}\n".format(request).encode("utf-8")
+    responses = 0
+    with socket.create_connection(("localhost", port)) as conn:
+        conn.sendall(payload * pipeline_depth)
+        pending = b""
+        while monotonic() < deadline:
+            data = conn.recv(1 << 16)
+            if not data:
+                break
+            pending += data
+            received = pending.count(b"\n")
+            if received:
+                pending = pending[pending.rfind(b"\n") + 1:]
+                responses += received
+                conn.sendall(payload * received)
+    counts[index] = responses
+
+
+def drainOutput(stream):
+    ''' Reads (and discards) the output of the server until it exits.
+    '''
+    while stream.read(1 << 16):
+        pass
+
+
+def benchmarkRun(gtfsproc_path, ini_path, backend, nb_clients, request):
+    ''' Starts GtfsProc with the backend, then returns the responses per second received by
+        nb_clients clients (None if the server could not be started).
+    '''
+    settings = ConfigParser()
+    settings.optionxform = str
+    settings.read(ini_path)
+    settings["static"]["serverBackend"] = backend
+    port = int(settings["static"]["serverPort"])
+
+    bench_fd, bench_ini = tempfile.mkstemp(suffix=".ini", dir=os.path.dirname(ini_path))
+    with os.fdopen(bench_fd, "w") as bench_file:
+        settings.write(bench_file)
+
+    gtfs_process = subprocess.Popen([gtfsproc_path, f"-c{bench_ini}"],
+                                    shell=False,
+                                    stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT)
+    try:
+        while True:
+            boot_msg = gtfs_process.stdout.readline()
+            if gtfs_process.poll() is not None:
+                return None
+            if boot_msg == b"SERVER STARTED - READY TO ACCEPT INCOMING CONNECTIONS\n":
+                break
+
+        # Keep reading whatever the server prints, it would block once the pipe is full (with the traces enabled)
+        threading.Thread(target=drainOutput, args=(gtfs_process.stdout,), daemon=True).start()
+
+        counts = [0] * nb_clients
+        deadline = monotonic() + run_seconds
+        clients = [threading.Thread(target=clientLoad, args=(port, request, deadline, counts, index))
+                   for index in range(nb_clients)]
+        for client in clients:
+            client.start()
+        for client in clients:
+            client.join()
+        return sum(counts) / run_seconds
+    finally:
+        gtfs_process.kill()
+        gtfs_process.wait()
+        os.remove(bench_ini)
+        sleep(2)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) not in [3, 4, 5]:
+        print("You must provide the path to the gtfsproc server binary and a test suite .ini,")
+        print(f"like so:  $ {sys.argv[0]} /path/to/gtfsproc tests/Agency/suite.ini\n")
+        print("You can also choose the numbers of clients and the request sent,")
+        print(f"like so:  $ {sys.argv[0]} /path/to/gtfsproc tests/Agency/suite.ini 1,8,64 \"RTE\"\n")
+        exit()
+
+    current_wrkdir = os.getcwd()
+    gtfsproc_path = f"{current_wrkdir}/{sys.argv[1]}"
+    ini_path = os.path.realpath(sys.argv[2])
+    clients = [int(nb) for nb in sys.argv[3].split(",")] if len(sys.argv) >= 4 else [1, 8, 64]
+    request = sys.argv[4] if len(sys.argv) == 5 else "SDS"
+
+    # The static feed and real-time feed are relative to the suite's directory
+    os.chdir(os.path.dirname(ini_path))
+    print(f"{'backend':>8} {'clients':>8} {'responses/s':>12}")
+    for nb_clients in clients:
+        for backend in ["qt", "epoll"]:
+            rate = benchmarkRun(gtfsproc_path, ini_path, backend, nb_clients, request)
+            if rate is None:
+                print(f"{backend:>8} {nb_clients:>8}   (GtfsProc could not be started)")
+                continue
+            print(f"{backend:>8} {nb_clients:>8} {rate:>12.0f}")
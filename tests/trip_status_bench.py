@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+
+# This file is part of GtfsProc
+# (C) 2021, Daniel Brook
+#
+# See the LICENSE and README files in the root of the project directory.
+#
+# A rudimentary benchmark of the real-time status resolution of the trips of a board (the status
+# of each trip at the stop: skipped, cancelled, not running, already passed, predicted or not)
+# as the number of clients grows.
+#
+# GtfsProc is started with a test suite's .ini at a fixed date/time (so the real-time feed of the
+# suite applies), then as many clients as requested each keep sending the same board request over
+# a single connection for a few seconds. The responses per second and the median / 95th
+# percentile processing time reported by the server (proc_time_ms) are printed for each number
+# of clients. By default, the board of the status precedence suite of SEPTA_Rail is requested:
+# every trip of it goes through a different step of the precedence.
+#
+# Usage:  $ tests/trip_status_bench.py /path/to/gtfsproc
+#         (optionally followed by a test suite .ini, the -f date/time, the comma-separated
+#          numbers of clients and the request to send)
+
+import sys
+import os
+import json
+import socket
+import subprocess
+import threading
+from configparser import ConfigParser
+from time import monotonic, sleep
+
+# Seconds each run sends requests for
+run_seconds = 10
+
+# Defaults: the SEPTA_Rail status precedence suite
+default_ini = os.path.join(os.path.dirname(os.path.realpath(__file__)), "SEPTA_Rail", "status_precedence.ini")
+default_time = "2020,5,22,19,30,30"
+default_request = "NCF 30 90004"
+
+
+def clientLoad(port, request, deadline, proc_times, index):
+    ''' Sends the request over a single connection (waiting for each response) until the deadline,
+        then stores the processing times reported by the server in proc_times[index].
+    '''
+    payload = "{}\n".format(request).encode("utf-8")
+    times = []
+    with socket.create_connection(("localhost", port)) as conn:
+        pending = b""
+        while monotonic() < deadline:
+            conn.sendall(payload)
+            while b"\n" not in pending:
+                data = conn.recv(1 << 16)
+                if not data:
+                    proc_times[index] = times
+                    return
+                pending += data
+            response, pending = pending.split(b"\n", 1)
+            times.append(json.loads(response.decode("utf-8"))["proc_time_ms"])
+    proc_times[index] = times
+
+
+def drainOutput(stream):
+    ''' Reads (and discards) the output of the server until it exits.
+    '''
+    while stream.read(1 << 16):
+        pass
+
+
+def benchmarkRun(gtfsproc_path, ini_path, fixed_time, nb_clients, request, port):
+    ''' Starts GtfsProc at the fixed time, then returns the processing times of the responses
+        received by nb_clients clients (None if the server could not be started).
+    '''
+    gtfs_process = subprocess.Popen([gtfsproc_path, f"-c{ini_path}", f"-f{fixed_time}"],
+                                    shell=False,
+                                    stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT)
+    try:
+        while True:
+            boot_msg = gtfs_process.stdout.readline()
+            if gtfs_process.poll() is not None:
+                return None
+            if boot_msg == b"SERVER STARTED - READY TO ACCEPT INCOMING CONNECTIONS\n":
+                break
+        threading.Thread(target=drainOutput, args=(gtfs_process.stdout,), daemon=True).start()
+
+        proc_times = [[] for _ in range(nb_clients)]
+        deadline = monotonic() + run_seconds
+        clients = [threading.Thread(target=clientLoad, args=(port, request, deadline, proc_times, index))
+                   for index in range(nb_clients)]
+        for client in clients:
+            client.start()
+        for client in clients:
+            client.join()
+        return sorted(proc_time for times in proc_times for proc_time in times)
+    finally:
+        gtfs_process.kill()
+        gtfs_process.wait()
+        sleep(2)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) not in [2, 3, 4, 5, 6]:
+        print("You must provide the path to the gtfsproc server binary,")
+        print(f"like so:  $ {sys.argv[0]} /path/to/gtfsproc\n")
+        print("You can also choose the suite, the date/time, the numbers of clients and the request sent,")
+        print(f"like so:  $ {sys.argv[0]} /path/to/gtfsproc tests/Agency/suite.ini 2020,5,22,8,0,0 1,8 \"NCF 60 1\"\n")
+        exit()
+
+    current_wrkdir = os.getcwd()
+    gtfsproc_path = f"{current_wrkdir}/{sys.argv[1]}"
+    ini_path = os.path.realpath(sys.argv[2]) if len(sys.argv) >= 3 else default_ini
+    fixed_time = sys.argv[3] if len(sys.argv) >= 4 else default_time
+    clients = [int(nb) for nb in sys.argv[4].split(",")] if len(sys.argv) >= 5 else [1, 8]
+    request = sys.argv[5] if len(sys.argv) == 6 else default_request
+
+    # Find the server port in the suite's settings (the static and real-time feeds are relative to its directory)
+    settings = ConfigParser()
+    settings.read(ini_path)
+    port = int(settings["static"]["serverPort"])
+    os.chdir(os.path.dirname(ini_path))
+
+    print(f"{'clients':>8} {'responses/s':>12} {'median ms':>10} {'p95 ms':>8}")
+    for nb_clients in clients:
+        times = benchmarkRun(gtfsproc_path, ini_path, fixed_time, nb_clients, request, port)
+        if times is None:
+            print(f"{nb_clients:>8}   (GtfsProc could not be started)")
+            continue
+        if not times:
+            print(f"{nb_clients:>8}   (no response received)")
+            continue
+        median = times[len(times) // 2]
+        p95 = times[min(len(times) - 1, (len(times) * 95) // 100)]
+        print(f"{nb_clients:>8} {len(times) / run_seconds:>12.0f} {median:>10} {p95:>8}")